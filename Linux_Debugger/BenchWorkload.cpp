@@ -0,0 +1,342 @@
+/*
+NAME
+    BenchWorkload
+
+DESCRIPTION
+    Calibrated system call heavy workloads for measuring tracer overhead.
+
+    BenchWorkload getpid N      - N calls to getpid
+    BenchWorkload openclose N   - N open/close pairs (BadProgram in a loop)
+    BenchWorkload pipe N        - N one byte round trips over a pair of pipes
+                                  between a parent and a child process
+    BenchWorkload forkexec N    - N fork/exec/wait cycles of a trivial child
+    BenchWorkload tcp N         - N request/response round trips over loopback
+                                  TCP to a child process; each request is sent
+                                  as a small header write then a body write,
+                                  with TCP_NODELAY so the body is not held
+                                  back for the delayed ACK of the header
+    BenchWorkload unix N        - the same over a Unix domain stream socket
+    BenchWorkload uring N       - N 4KiB reads of this program through an
+                                  io_uring, submitted in batches of four
+
+    On completion prints "events <count> seconds <elapsed>" to stdout,
+    where count is the number of system calls of interest made.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <wait.h>
+#include <arpa/inet.h>
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+
+namespace
+{
+  double now()
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+  }
+
+  long getpidLoop(long count)
+  {
+    for (long idx = 0; idx != count; ++idx)
+    {
+      syscall(SYS_getpid); // not cached by the C library
+    }
+    return count;
+  }
+
+  long openCloseLoop(long count, char const *path)
+  {
+    for (long idx = 0; idx != count; ++idx)
+    {
+      int const fd = open(path, O_RDONLY);
+      if (fd != -1)
+      {
+        close(fd);
+      }
+    }
+    return count * 2;
+  }
+
+  long pipeLoop(long count)
+  {
+    int ping[2], pong[2];
+    if (pipe(ping) == -1 || pipe(pong) == -1)
+    {
+      perror("pipe");
+      exit(1);
+    }
+    char ch = 0;
+    pid_t const pid = fork();
+    if (pid == 0)
+    {
+      close(ping[1]);
+      close(pong[0]);
+      while (read(ping[0], &ch, 1) == 1 && write(pong[1], &ch, 1) == 1)
+      {
+      }
+      _exit(0);
+    }
+    close(ping[0]);
+    close(pong[1]);
+    for (long idx = 0; idx != count; ++idx)
+    {
+      if (write(ping[1], &ch, 1) != 1 || read(pong[0], &ch, 1) != 1)
+      {
+        perror("ping-pong");
+        exit(1);
+      }
+    }
+    close(ping[1]);
+    waitpid(pid, 0, 0);
+    return count * 4;
+  }
+
+  /** Read exactly 'len' bytes from 'fd' */
+  bool readFully(int fd, char *buffer, size_t len)
+  {
+    while (len != 0)
+    {
+      ssize_t const rc = read(fd, buffer, len);
+      if (rc <= 0)
+        return false;
+      buffer += rc;
+      len -= rc;
+    }
+    return true;
+  }
+
+  long socketLoop(long count, int family)
+  {
+    sockaddr_storage addr = sockaddr_storage();
+    socklen_t len;
+    if (family == AF_INET)
+    {
+      sockaddr_in &in = reinterpret_cast<sockaddr_in &>(addr);
+      in.sin_family = AF_INET;
+      in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      len = sizeof(in);
+    }
+    else
+    {
+      sockaddr_un &un = reinterpret_cast<sockaddr_un &>(addr);
+      un.sun_family = AF_UNIX;
+      snprintf(un.sun_path, sizeof(un.sun_path), "/tmp/BenchWorkload.%d", getpid());
+      unlink(un.sun_path);
+      len = sizeof(un);
+    }
+    int const server = socket(family, SOCK_STREAM, 0);
+    if (server == -1 || bind(server, (sockaddr *)&addr, len) == -1 ||
+        listen(server, 1) == -1 || getsockname(server, (sockaddr *)&addr, &len) == -1)
+    {
+      perror("listen");
+      exit(1);
+    }
+
+    char request[64] = "request";
+    char reply[256] = "";
+    pid_t const pid = fork();
+    if (pid == 0)
+    {
+      int const fd = accept(server, 0, 0);
+      unsigned size(0);
+      while (readFully(fd, (char *)&size, sizeof(size)) && size <= sizeof(request) &&
+             readFully(fd, request, size) && write(fd, reply, sizeof(reply)) == sizeof(reply))
+      {
+      }
+      _exit(0);
+    }
+    close(server);
+    int const fd = socket(family, SOCK_STREAM, 0);
+    if (fd == -1 || connect(fd, (sockaddr *)&addr, len) == -1)
+    {
+      perror("connect");
+      exit(1);
+    }
+    // Otherwise Nagle waits about 40ms for each header to be ACKed,
+    // and the run times the delayed ACK timer rather than the calls
+    int const one(1);
+    if (family == AF_INET && setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) == -1)
+    {
+      perror("setsockopt");
+      exit(1);
+    }
+    for (long idx = 0; idx != count; ++idx)
+    {
+      unsigned const size = sizeof(request);
+      if (write(fd, &size, sizeof(size)) != sizeof(size) ||
+          write(fd, request, size) != size ||
+          !readFully(fd, reply, sizeof(reply)))
+      {
+        perror("request");
+        exit(1);
+      }
+    }
+    close(fd);
+    waitpid(pid, 0, 0);
+    if (family == AF_UNIX)
+    {
+      unlink(reinterpret_cast<sockaddr_un &>(addr).sun_path);
+    }
+    return count * 6;
+  }
+
+  /** Map part of an io_uring into memory */
+  void *mapRing(int ring, size_t size, unsigned long long offset)
+  {
+    void *const addr = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, offset);
+    if (addr == MAP_FAILED)
+    {
+      perror("mmap");
+      exit(1);
+    }
+    return addr;
+  }
+
+  long uringLoop(long count, char const *path)
+  {
+    unsigned const Batch = 4;
+    io_uring_params params = io_uring_params();
+    int const ring = syscall(__NR_io_uring_setup, Batch * 2, &params);
+    int const fd = open(path, O_RDONLY);
+    if (ring == -1 || fd == -1)
+    {
+      perror("io_uring_setup");
+      exit(1);
+    }
+    char *const sq = (char *)mapRing(ring, params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                                     IORING_OFF_SQ_RING);
+    char *const cq = (char *)mapRing(ring, params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe),
+                                     IORING_OFF_CQ_RING);
+    io_uring_sqe *const sqes = (io_uring_sqe *)mapRing(ring, params.sq_entries * sizeof(io_uring_sqe),
+                                                       IORING_OFF_SQES);
+    unsigned *const sqTail = (unsigned *)(sq + params.sq_off.tail);
+    unsigned const sqMask = *(unsigned *)(sq + params.sq_off.ring_mask);
+    unsigned *const sqArray = (unsigned *)(sq + params.sq_off.array);
+    unsigned *const cqHead = (unsigned *)(cq + params.cq_off.head);
+    unsigned *const cqTail = (unsigned *)(cq + params.cq_off.tail);
+    unsigned const cqMask = *(unsigned *)(cq + params.cq_off.ring_mask);
+    io_uring_cqe const *const cqes = (io_uring_cqe const *)(cq + params.cq_off.cqes);
+
+    static char buffers[Batch][4096];
+    for (long idx = 0; idx < count; idx += Batch)
+    {
+      unsigned const batch = (count - idx < Batch) ? count - idx : Batch;
+      unsigned tail = *sqTail;
+      for (unsigned op = 0; op != batch; ++op, ++tail)
+      {
+        unsigned const slot = tail & sqMask;
+        io_uring_sqe &sqe = sqes[slot];
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = fd;
+        sqe.off = ((idx + op) % 16) * sizeof(buffers[op]);
+        sqe.addr = (unsigned long)buffers[op];
+        sqe.len = sizeof(buffers[op]);
+        sqe.user_data = idx + op;
+        sqArray[slot] = slot;
+      }
+      __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+      if (syscall(__NR_io_uring_enter, ring, batch, batch, IORING_ENTER_GETEVENTS, 0, 0) != batch)
+      {
+        perror("io_uring_enter");
+        exit(1);
+      }
+      unsigned head = *cqHead;
+      for (; head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE); ++head)
+      {
+        if (cqes[head & cqMask].res < 0)
+        {
+          fprintf(stderr, "read failed: %s\n", strerror(-cqes[head & cqMask].res));
+          exit(1);
+        }
+      }
+      __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    }
+    close(fd);
+    close(ring);
+    return count;
+  }
+
+  long forkExecLoop(long count, char const *self)
+  {
+    for (long idx = 0; idx != count; ++idx)
+    {
+      pid_t const pid = fork();
+      if (pid == 0)
+      {
+        execl(self, self, "noop", (char *)0);
+        _exit(127);
+      }
+      waitpid(pid, 0, 0);
+    }
+    return count * 3;
+  }
+} // namespace
+
+int main(int argc, char **argv)
+{
+  if (argc == 2 && strcmp(argv[1], "noop") == 0)
+  {
+    return 0;
+  }
+  if (argc != 3)
+  {
+    fprintf(stderr, "Syntax: BenchWorkload getpid|openclose|pipe|forkexec|tcp|unix|uring count\n");
+    return 1;
+  }
+  char const *const kind = argv[1];
+  long const count = atol(argv[2]);
+
+  double const start = now();
+  long events(0);
+  if (strcmp(kind, "getpid") == 0)
+    events = getpidLoop(count);
+  else if (strcmp(kind, "openclose") == 0)
+    events = openCloseLoop(count, "/dev/null");
+  else if (strcmp(kind, "pipe") == 0)
+    events = pipeLoop(count);
+  else if (strcmp(kind, "forkexec") == 0)
+    events = forkExecLoop(count, "/proc/self/exe");
+  else if (strcmp(kind, "tcp") == 0)
+    events = socketLoop(count, AF_INET);
+  else if (strcmp(kind, "unix") == 0)
+    events = socketLoop(count, AF_UNIX);
+  else if (strcmp(kind, "uring") == 0)
+    events = uringLoop(count, "/proc/self/exe");
+  else
+  {
+    fprintf(stderr, "Unknown workload: %s\n", kind);
+    return 1;
+  }
+  printf("events %ld seconds %.6f\n", events, now() - start);
+  return 0;
+}
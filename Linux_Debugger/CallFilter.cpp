@@ -0,0 +1,440 @@
+/*
+NAME
+    CallFilter
+
+DESCRIPTION
+    Compiled filter expressions over system call arguments and results.
+
+    The expression is parsed once by recursive descent into a postfix
+    bytecode run on a small fixed stack, so testing a call allocates
+    nothing. && and || are compiled as a jump past the right hand side
+    when the left hand side decides the result, followed by an And or
+    Or which combines the two values when it does not.
+
+    Values are three-way: a test whose operand is not yet known, such
+    as rc when a call is entered, is Unknown and only a definite result
+    short-circuits. The tracer tests each call at entry, and only keeps
+    a call whose result is Unknown until it exits. The path argument is
+    read from the target only when a path test is reached.
+
+    The set of calls that can pass is found when the expression is
+    compiled, by running it for each call number with nothing else
+    known, so a call the filter can never pass costs a bit test.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "CallFilter.h"
+#include "SelfStats.h"
+#include "TraceUtils.h"
+
+#include <ctype.h>
+#include <fnmatch.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+  /** The highest system call number the filter selects */
+  int const MaxCall = 512;
+} // namespace
+
+/** Compiles an expression into a CallFilter */
+class CallFilter::Parser
+{
+public:
+  Parser(CallFilter &filter, std::string const &text)
+  : filter(filter), text(text), pos(0), depth(0) {}
+
+  /** Compile the whole expression */
+  void parse()
+  {
+    orExpr();
+    skipSpace();
+    if (pos != text.size())
+    {
+      error("unexpected text");
+    }
+  }
+
+private:
+  // expr := and ('||' and)*
+  void orExpr()
+  {
+    andExpr();
+    while (accept("||"))
+    {
+      size_t const jump = emit(JumpTrue);
+      andExpr();
+      emit(Or);
+      filter.code[jump].target = filter.code.size();
+    }
+  }
+
+  // and := unary ('&&' unary)*
+  void andExpr()
+  {
+    unary();
+    while (accept("&&"))
+    {
+      size_t const jump = emit(JumpFalse);
+      unary();
+      emit(And);
+      filter.code[jump].target = filter.code.size();
+    }
+  }
+
+  // unary := '!' unary | '(' expr ')' | term
+  void unary()
+  {
+    if (accept("!"))
+    {
+      unary();
+      emit(Not);
+    }
+    else if (accept("("))
+    {
+      orExpr();
+      if (!accept(")"))
+      {
+        error("expected )");
+      }
+    }
+    else
+    {
+      term();
+    }
+  }
+
+  // term := call | field op number | 'path' op string
+  void term()
+  {
+    std::string const name = identifier();
+    if (name == "path")
+    {
+      OpCode code(PathEqual);
+      bool negate(false);
+      if (accept("=="))
+        ;
+      else if (accept("!="))
+        negate = true;
+      else if (accept("!~"))
+        code = PathMatch, negate = true;
+      else if (accept("~"))
+        code = PathMatch;
+      else
+        error("expected ==, !=, ~ or !~");
+      emit(code, 0, filter.patterns.size());
+      filter.patterns.push_back(string());
+      if (negate)
+      {
+        emit(Not);
+      }
+      return;
+    }
+
+    int field(-1);
+    if (name.size() == 4 && name.compare(0, 3, "arg") == 0 && name[3] >= '0' && name[3] <= '5')
+      field = Arg0 + name[3] - '0';
+    else if (name == "rc")
+      field = Rc;
+    else if (name == "pid")
+      field = Pid;
+    if (field == -1)
+    {
+      int const func = syscallNumber(name);
+      if (func == -1)
+      {
+        pos -= name.size();
+        error("unknown system call or field '" + name + "'");
+      }
+      emit(Call, 0, func);
+      return;
+    }
+
+    OpCode code(Equal);
+    if (accept("=="))
+      code = Equal;
+    else if (accept("!="))
+      code = NotEqual;
+    else if (accept("<="))
+      code = LessEqual;
+    else if (accept(">="))
+      code = GreaterEqual;
+    else if (accept("<"))
+      code = Less;
+    else if (accept(">"))
+      code = Greater;
+    else
+      error("expected a comparison");
+    emit(code, field, number());
+  }
+
+  /** Append an instruction, returning its index */
+  size_t emit(OpCode code, int field = 0, long value = 0)
+  {
+    switch (code)
+    {
+    case Not:
+    case JumpFalse:
+    case JumpTrue:
+      break;
+    case And:
+    case Or:
+      --depth;
+      break;
+    default:
+      if (++depth > MaxDepth)
+      {
+        error("expression is nested too deeply");
+      }
+      break;
+    }
+    if (filter.code.size() == 0xffff)
+    {
+      error("expression is too long");
+    }
+    Instruction const instruction = { (unsigned char)code, (unsigned char)field, 0, value };
+    filter.code.push_back(instruction);
+    return filter.code.size() - 1;
+  }
+
+  void skipSpace()
+  {
+    while (pos != text.size() && isspace((unsigned char)text[pos]))
+      ++pos;
+  }
+
+  /** Consume 'token' if it is next */
+  bool accept(char const *token)
+  {
+    skipSpace();
+    size_t const len = strlen(token);
+    if (text.compare(pos, len, token) != 0)
+    {
+      return false;
+    }
+    pos += len;
+    return true;
+  }
+
+  std::string identifier()
+  {
+    skipSpace();
+    size_t const begin = pos;
+    while (pos != text.size() && (isalnum((unsigned char)text[pos]) || text[pos] == '_'))
+      ++pos;
+    if (pos == begin)
+    {
+      error("expected a system call or field");
+    }
+    return text.substr(begin, pos - begin);
+  }
+
+  /** A decimal, hex or octal integer, which may be negative */
+  long number()
+  {
+    skipSpace();
+    char const *const begin = text.c_str() + pos;
+    char *end(0);
+    long const value = strtol(begin, &end, 0);
+    if (end == begin || isalnum((unsigned char)*end) || *end == '_')
+    {
+      error("expected a number");
+    }
+    pos += end - begin;
+    return value;
+  }
+
+  /** A double quoted string, in which \ quotes the next character */
+  std::string string()
+  {
+    skipSpace();
+    if (pos == text.size() || text[pos] != '"')
+    {
+      error("expected a string");
+    }
+    std::string result;
+    for (++pos; pos != text.size() && text[pos] != '"'; ++pos)
+    {
+      if (text[pos] == '\\' && pos + 1 != text.size())
+        ++pos;
+      result += text[pos];
+    }
+    if (pos == text.size())
+    {
+      error("unterminated string");
+    }
+    ++pos;
+    return result;
+  }
+
+  void error(std::string const &message)
+  {
+    std::ostringstream oss;
+    oss << "Invalid filter '" << text << "': " << message << " at offset " << pos;
+    throw std::runtime_error(oss.str());
+  }
+
+  CallFilter &filter;
+  std::string const &text;
+  size_t pos;
+  int depth;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+CallFilter::Event::Event(pid_t pid, int func, long const args[])
+: pid(pid), func(func), exited(false), rc(0), fetched(false)
+{
+  memcpy(this->args, args, sizeof(this->args));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+std::string const &CallFilter::Event::path()
+{
+  if (!fetched)
+  {
+    fetched = true;
+    int const arg = pathArgument(func);
+    if (pid && arg != -1)
+    {
+      SelfStats::Timer timer(SelfStats::ReadString);
+      pathName = readRemoteString(pid, args[arg]);
+    }
+  }
+  return pathName;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+CallFilter::CallFilter(std::string const &expression)
+{
+  Parser(*this, expression).parse();
+
+  Event event;
+  calls.resize(MaxCall);
+  for (int func = 0; func != MaxCall; ++func)
+  {
+    event.func = func;
+    calls[func] = (evaluate(event) != Fail);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+CallFilter::Result CallFilter::evaluate(Event &event) const
+{
+  unsigned char stack[MaxDepth];
+  int top(-1);
+  size_t pc(0);
+  while (pc != code.size())
+  {
+    Instruction const &instruction = code[pc++];
+    switch (instruction.code)
+    {
+    case Call:
+      stack[++top] = (event.func == instruction.value) ? Pass : Fail;
+      break;
+
+    case Equal:
+    case NotEqual:
+    case Less:
+    case LessEqual:
+    case Greater:
+    case GreaterEqual:
+    {
+      long value(0);
+      if (instruction.field == Rc ? !event.exited : !event.pid)
+      {
+        stack[++top] = Unknown;
+        break;
+      }
+      if (instruction.field == Rc)
+        value = event.rc;
+      else if (instruction.field == Pid)
+        value = event.pid;
+      else
+        value = event.args[instruction.field - Arg0];
+      bool result(false);
+      switch (instruction.code)
+      {
+      case Equal: result = (value == instruction.value); break;
+      case NotEqual: result = (value != instruction.value); break;
+      case Less: result = (value < instruction.value); break;
+      case LessEqual: result = (value <= instruction.value); break;
+      case Greater: result = (value > instruction.value); break;
+      case GreaterEqual: result = (value >= instruction.value); break;
+      }
+      stack[++top] = result ? Pass : Fail;
+      break;
+    }
+
+    case PathEqual:
+    case PathMatch:
+      if (!event.pid)
+      {
+        stack[++top] = Unknown;
+      }
+      else if (pathArgument(event.func) == -1)
+      {
+        stack[++top] = Fail;
+      }
+      else
+      {
+        std::string const &pattern = patterns[instruction.value];
+        bool const result = (instruction.code == PathEqual)
+          ? event.path() == pattern
+          : fnmatch(pattern.c_str(), event.path().c_str(), 0) == 0;
+        stack[++top] = result ? Pass : Fail;
+      }
+      break;
+
+    case Not:
+      if (stack[top] != Unknown)
+        stack[top] = (stack[top] == Pass) ? Fail : Pass;
+      break;
+
+    case And:
+      --top;
+      if (stack[top] == Fail || stack[top + 1] == Fail)
+        stack[top] = Fail;
+      else if (stack[top] == Unknown || stack[top + 1] == Unknown)
+        stack[top] = Unknown;
+      break;
+
+    case Or:
+      --top;
+      if (stack[top] == Pass || stack[top + 1] == Pass)
+        stack[top] = Pass;
+      else if (stack[top] == Unknown || stack[top + 1] == Unknown)
+        stack[top] = Unknown;
+      break;
+
+    case JumpFalse:
+      if (stack[top] == Fail)
+        pc = instruction.target;
+      break;
+
+    case JumpTrue:
+      if (stack[top] == Pass)
+        pc = instruction.target;
+      break;
+    }
+  }
+  return Result(stack[0]);
+}
@@ -0,0 +1,139 @@
+#ifndef CALL_FILTER_H
+#define CALL_FILTER_H
+
+/**@file
+
+  Compiled filter expressions over system call arguments and results
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+/** A filter expression over system calls, such as
+ *   openat && path ~ "*.so*" && rc < 0
+ *   read && arg2 > 65536
+ * compiled once into a small bytecode which is run against each call.
+ *
+ * A term is a system call name, which matches that call; a comparison
+ * of rc, arg0 to arg5 or pid with an integer using == != < <= > or >=;
+ * or a test of the path name argument with == or != and a string, or
+ * with ~ or !~ and a shell wildcard pattern. Terms are combined with
+ * !, && and || and parentheses in the usual way. */
+class CallFilter
+{
+public:
+  /** Result of a test; a test is unknown when it needs a value not yet
+   * available, such as the result of a call which is being entered */
+  enum Result
+  {
+    Fail,
+    Pass,
+    Unknown
+  };
+
+  /** One system call to be tested */
+  class Event
+  {
+  public:
+    Event() : pid(0), func(-1), exited(false), rc(0), fetched(false) {}
+
+    /** The entry of call 'func' with 'args' in task 'pid' */
+    Event(pid_t pid, int func, long const args[]);
+
+    /** Record the result of the call */
+    void exit(long rc) { exited = true; this->rc = rc; }
+
+    /** The path name argument, read from the target on first use
+     * (empty if the call has none) */
+    std::string const &path();
+
+  private:
+    friend class CallFilter;
+
+    pid_t pid;           // 0 if the task and the arguments are not known
+    int func;
+    long args[6];
+    bool exited;
+    long rc;
+    bool fetched;
+    std::string pathName;
+  };
+
+  /** Compile 'expression', throwing std::runtime_error if it is invalid */
+  explicit CallFilter(std::string const &expression);
+
+  /** Can the filter pass any call to 'func'? */
+  bool selected(int func) const
+  { return func >= 0 && func < (int)calls.size() && calls[func]; }
+
+  /** Test 'event' */
+  Result evaluate(Event &event) const;
+
+private:
+  enum OpCode
+  {
+    Call,        // push func == value
+    Equal,       // push operand(field) <op> value
+    NotEqual,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual,
+    PathEqual,   // push path() == patterns[value]
+    PathMatch,   // push path() matches patterns[value]
+    Not,         // invert the top value
+    And,         // combine the top two values
+    Or,
+    JumpFalse,   // go to target if the top value is false
+    JumpTrue     // go to target if the top value is true
+  };
+
+  /** Numeric operands */
+  enum Field
+  {
+    Arg0, Arg1, Arg2, Arg3, Arg4, Arg5,
+    Rc,
+    Pid
+  };
+
+  struct Instruction
+  {
+    unsigned char code;
+    unsigned char field;
+    unsigned short target;
+    long value;
+  };
+
+  /** Deepest value stack an expression may use */
+  static int const MaxDepth = 32;
+
+  class Parser;
+
+  std::vector<Instruction> code;
+  std::vector<std::string> patterns;
+  std::vector<bool> calls;     // func => may pass
+};
+
+#endif // CALL_FILTER_H
@@ -0,0 +1,153 @@
+/*
+NAME
+    CrashReport
+
+DESCRIPTION
+    Stack and variables of tasks that receive a fatal signal.
+
+    When a task stops for delivery of SIGSEGV, SIGBUS, SIGFPE, SIGILL
+    or SIGABRT and its process has no handler for the signal, the stack
+    is unwound from the task's registers and each frame is listed with
+    its parameters and local variables, decoded from the DWARF debug
+    information of its module, as SimpleStackWalker does on Windows.
+    A frame in inlined code lists the chain of inlined calls innermost
+    first, each with the file and line it was called from and its own
+    parameters and variables, and then the variables of the function
+    they were inlined into.
+
+    The report is made while the task is still stopped, before the
+    signal is delivered; it is written when tracing finishes.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "CrashReport.h"
+#include "ElfDebugInfo.h"
+#include "ElfSymbols.h"
+#include "StackUnwinder.h"
+#include "TraceUtils.h"
+
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/user.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+  /** Number of crashes reported in full */
+  int const MaxCrashes = 4;
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void CrashReport::OnSignal(pid_t pid, int signal)
+{
+  switch (signal)
+  {
+  case SIGSEGV:
+  case SIGBUS:
+  case SIGFPE:
+  case SIGILL:
+  case SIGABRT:
+    break;
+  default:
+    return;
+  }
+  if (caught(pid, signal))
+  {
+    return;
+  }
+  if (++crashes <= MaxCrashes)
+  {
+    record(pid, signal);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool CrashReport::caught(pid_t pid, int signal)
+{
+  std::ifstream is(procName(pid, "status").c_str());
+  std::string line;
+  while (std::getline(is, line))
+  {
+    if (line.compare(0, 7, "SigCgt:") == 0)
+    {
+      unsigned long long const mask = strtoull(line.c_str() + 7, 0, 16);
+      return (mask >> (signal - 1)) & 1;
+    }
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void CrashReport::record(pid_t pid, int signal)
+{
+  Stopwatch const elapsed;
+  std::ostringstream os;
+  os << "Task " << pid << " received " << sigstrm(signal);
+  siginfo_t info;
+  if ((signal == SIGSEGV || signal == SIGBUS) && ptrace(PTRACE_GETSIGINFO, pid, 0, &info) == 0)
+  {
+    os << " accessing " << info.si_addr;
+  }
+  os << '\n';
+
+  user_regs_struct regs;
+  if (ptrace(PTRACE_GETREGS, pid, 0, &regs) == -1)
+  {
+    os << "  registers unavailable\n";
+    text += os.str();
+    return;
+  }
+  ProcessModules modules(pid);
+  RemoteMemory memory(pid);
+  std::vector<StackFrame> frames;
+  unwindStack(pid, modules, regs, memory, frames);
+  for (size_t idx = 0; idx != frames.size(); ++idx)
+  {
+    StackFrame const &frame = frames[idx];
+    os << "  #" << idx << " 0x" << std::hex << frame.pc << std::dec << ' ' << modules.describe(frame.pc) << '\n';
+    // A return address may be the start of the next function
+    unsigned long const lookup = (idx == 0) ? frame.pc : frame.pc - 1;
+    ProcessModules::Module const *module = modules.find(lookup);
+    if (!module)
+      continue;
+    long const vaddr = modules.toVaddr(*module, lookup);
+    if (vaddr == -1)
+      continue;
+    std::shared_ptr<ElfDebugInfo const> const debugInfo = ElfDebugInfo::get(module->path);
+    debugInfo->showVariables(os, vaddr, frame, memory, lookup - vaddr);
+  }
+  os << "  (" << elapsed.usec() / 1000.0 << " ms)\n";
+  text += os.str();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void CrashReport::Report(std::ostream &os)
+{
+  if (crashes == 0)
+  {
+    return;
+  }
+  os << "Crash report:\n" << text;
+  if (crashes > MaxCrashes)
+  {
+    os << "(" << crashes - MaxCrashes << " more crashes not shown)\n";
+  }
+}
@@ -0,0 +1,54 @@
+#ifndef CRASH_REPORT_H
+#define CRASH_REPORT_H
+
+/**@file
+
+  Stack and variables of crashing tasks for ProcessTracer
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "TraceListener.h"
+
+#include <string>
+
+/** On a fatal signal the program does not handle, record the stack of
+ * the task with the parameters and local variables of each frame */
+class CrashReport : public TraceListener
+{
+public:
+  CrashReport() : crashes(0) {}
+
+  void OnSignal(pid_t pid, int signal) override;
+  void Report(std::ostream &os) override;
+
+private:
+  /** Does process 'pid' catch 'signal'? */
+  static bool caught(pid_t pid, int signal);
+
+  /** Write the state of task 'pid' stopped with 'signal' */
+  void record(pid_t pid, int signal);
+
+  int crashes;
+  std::string text;
+};
+
+#endif // CRASH_REPORT_H
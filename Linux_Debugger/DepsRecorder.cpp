@@ -0,0 +1,554 @@
+/*
+NAME
+    DepsRecorder
+
+DESCRIPTION
+    File dependency manifest recorder for ProcessTracer.
+
+    Uses the file descriptors returned from open/openat and removed
+    by close, together with the path based calls, to record for each
+    exec'd command the files it read, wrote, stat'ed or probed for
+    and failed to find. Relative paths are resolved against the
+    working directory, or the directory file descriptor, of the
+    calling task at the time of the call.
+
+    The manifests are suitable for use as cache keys: a command whose
+    inputs have not changed, and whose missing probes still fail,
+    does not need to be rerun.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "DepsRecorder.h"
+#include "TraceUtils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <asm/unistd.h>
+#include <sys/ptrace.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+  /** Lexically remove "." and ".." components and repeated slashes */
+  std::string normalise(std::string const &path)
+  {
+    std::vector<std::string> parts;
+    std::string::size_type pos = 0;
+    while (pos < path.size())
+    {
+      std::string::size_type next = path.find('/', pos);
+      if (next == std::string::npos)
+        next = path.size();
+      std::string const part(path, pos, next - pos);
+      if (part == "..")
+      {
+        if (!parts.empty())
+          parts.pop_back();
+      }
+      else if (!part.empty() && part != ".")
+      {
+        parts.push_back(part);
+      }
+      pos = next + 1;
+    }
+    std::string result;
+    for (size_t idx = 0; idx != parts.size(); ++idx)
+    {
+      result += '/';
+      result += parts[idx];
+    }
+    return result.empty() ? "/" : result;
+  }
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+DepsRecorder::DepsRecorder(std::string const &fileName)
+: fileName(fileName)
+{
+  if (!fileName.empty())
+  {
+    ofs.open(fileName.c_str());
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+size_t DepsRecorder::newManifest(pid_t pid)
+{
+  Manifest manifest;
+  manifest.pid = pid;
+  manifest.command = readCommand(pid);
+  manifest.cwd = readLink(procName(pid, "cwd"));
+  std::string const exe = readLink(procName(pid, "exe"));
+  if (!exe.empty())
+  {
+    manifest.files[exe] |= Read;
+  }
+  manifests.push_back(manifest);
+  return manifests.size() - 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void DepsRecorder::OnStart(pid_t pid)
+{
+  processes[pid].manifest = newManifest(pid);
+  threads[pid] = pid;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// A forked child shares the manifest of its parent until it execs,
+// so the work a shell does between fork and exec (such as setting up
+// redirections) is charged to the command that asked for it.
+void DepsRecorder::OnFork(pid_t parent, pid_t child, int event)
+{
+  pid_t const tgid = (event == PTRACE_EVENT_CLONE) ? cloneTgid(parent, child) : child;
+  if (tgid != child)
+  {
+    threads[child] = tgid;
+    return;
+  }
+  threads[child] = child;
+  if (Process *pproc = findProcess(parent))
+  {
+    processes[child] = *pproc;
+  }
+  else
+  {
+    processes[child].manifest = newManifest(child);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void DepsRecorder::OnExec(pid_t pid)
+{
+  Process *proc = findProcess(pid);
+  if (!proc)
+  {
+    return;
+  }
+  std::map<int, FileDesc>::iterator it = proc->fds.begin();
+  while (it != proc->fds.end())
+  {
+    int const fd = it->first;
+    ++it;
+    if (proc->fds[fd].cloexec)
+    {
+      close(*proc, fd);
+    }
+  }
+  proc->manifest = newManifest(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void DepsRecorder::OnExit(pid_t pid, int status)
+{
+  std::map<pid_t, Process>::iterator it = processes.find(pid);
+  if (it != processes.end())
+  {
+    while (!it->second.fds.empty())
+    {
+      close(it->second, it->second.fds.begin()->first);
+    }
+    processes.erase(it);
+  }
+  threads.erase(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool DepsRecorder::SelectedCall(int func)
+{
+  switch (func)
+  {
+  case __NR_open:
+  case __NR_openat:
+  case __NR_creat:
+  case __NR_close:
+  case __NR_read:
+  case __NR_pread64:
+  case __NR_readv:
+  case __NR_preadv:
+  case __NR_write:
+  case __NR_pwrite64:
+  case __NR_writev:
+  case __NR_pwritev:
+  case __NR_stat:
+  case __NR_lstat:
+  case __NR_access:
+  case __NR_faccessat:
+  case __NR_readlink:
+  case __NR_readlinkat:
+  case __NR_execve:
+  case __NR_unlink:
+  case __NR_unlinkat:
+  case __NR_rename:
+  case __NR_renameat:
+  case __NR_mkdir:
+  case __NR_mkdirat:
+  case __NR_dup:
+  case __NR_dup2:
+  case __NR_dup3:
+  case __NR_fcntl:
+  case __NR_sendfile:
+  case __NR_splice:
+#ifdef __NR_copy_file_range
+  case __NR_copy_file_range:
+#endif
+#ifdef __NR_newfstatat
+  case __NR_newfstatat:
+#endif
+#ifdef __NR_statx
+  case __NR_statx:
+#endif
+#ifdef __NR_faccessat2
+  case __NR_faccessat2:
+#endif
+#ifdef __NR_openat2
+  case __NR_openat2:
+#endif
+#ifdef __NR_execveat
+  case __NR_execveat:
+#endif
+#ifdef __NR_renameat2
+  case __NR_renameat2:
+#endif
+    return true;
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void DepsRecorder::OnCallExit(pid_t pid, int func, long const args[], long rc)
+{
+  Process *proc = findProcess(pid);
+  if (!proc)
+  {
+    return;
+  }
+  switch (func)
+  {
+  case __NR_open:
+    open(pid, *proc, AT_FDCWD, args[0], args[1], rc);
+    break;
+  case __NR_creat:
+    open(pid, *proc, AT_FDCWD, args[0], O_CREAT | O_WRONLY | O_TRUNC, rc);
+    break;
+  case __NR_openat:
+    open(pid, *proc, args[0], args[1], args[2], rc);
+    break;
+#ifdef __NR_openat2
+  case __NR_openat2:
+    {
+      // The flags are the first member of struct open_how
+      unsigned long long how(0);
+      readRemote(pid, args[2], &how, sizeof(how));
+      open(pid, *proc, args[0], args[1], how, rc);
+    }
+    break;
+#endif
+  case __NR_close:
+    if (rc == 0)
+      close(*proc, args[0]);
+    break;
+  case __NR_read:
+  case __NR_pread64:
+  case __NR_readv:
+  case __NR_preadv:
+    if (rc >= 0)
+      use(*proc, args[0], Read);
+    break;
+  case __NR_write:
+  case __NR_pwrite64:
+  case __NR_writev:
+  case __NR_pwritev:
+    if (rc >= 0)
+      use(*proc, args[0], Write);
+    break;
+  case __NR_sendfile:
+    if (rc >= 0)
+    {
+      use(*proc, args[1], Read);
+      use(*proc, args[0], Write);
+    }
+    break;
+  case __NR_splice:
+#ifdef __NR_copy_file_range
+  case __NR_copy_file_range:
+#endif
+    if (rc >= 0)
+    {
+      use(*proc, args[0], Read);
+      use(*proc, args[2], Write);
+    }
+    break;
+  case __NR_stat:
+  case __NR_lstat:
+  case __NR_access:
+  case __NR_readlink:
+  case __NR_execve:
+    probe(pid, *proc, AT_FDCWD, args[0], rc);
+    break;
+  case __NR_faccessat:
+  case __NR_readlinkat:
+#ifdef __NR_newfstatat
+  case __NR_newfstatat:
+#endif
+#ifdef __NR_statx
+  case __NR_statx:
+#endif
+#ifdef __NR_faccessat2
+  case __NR_faccessat2:
+#endif
+#ifdef __NR_execveat
+  case __NR_execveat:
+#endif
+    probe(pid, *proc, args[0], args[1], rc);
+    break;
+  case __NR_unlink:
+  case __NR_mkdir:
+    if (rc == 0)
+      record(pid, *proc, AT_FDCWD, args[0], Write);
+    break;
+  case __NR_unlinkat:
+  case __NR_mkdirat:
+    if (rc == 0)
+      record(pid, *proc, args[0], args[1], Write);
+    break;
+  case __NR_rename:
+    if (rc == 0)
+    {
+      record(pid, *proc, AT_FDCWD, args[0], Write);
+      record(pid, *proc, AT_FDCWD, args[1], Write);
+    }
+    break;
+  case __NR_renameat:
+#ifdef __NR_renameat2
+  case __NR_renameat2:
+#endif
+    if (rc == 0)
+    {
+      record(pid, *proc, args[0], args[1], Write);
+      record(pid, *proc, args[2], args[3], Write);
+    }
+    break;
+  case __NR_dup:
+    if (rc >= 0)
+      dup(*proc, args[0], rc, false);
+    break;
+  case __NR_dup2:
+  case __NR_dup3:
+    if (rc >= 0)
+      dup(*proc, args[0], rc, func == __NR_dup3 && (args[2] & O_CLOEXEC));
+    break;
+  case __NR_fcntl:
+    if (rc >= 0 && (args[1] == F_DUPFD || args[1] == F_DUPFD_CLOEXEC))
+      dup(*proc, args[0], rc, args[1] == F_DUPFD_CLOEXEC);
+    break;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+DepsRecorder::Process *DepsRecorder::findProcess(pid_t tid)
+{
+  std::map<pid_t, pid_t>::const_iterator thread = threads.find(tid);
+  if (thread != threads.end())
+  {
+    std::map<pid_t, Process>::iterator it = processes.find(thread->second);
+    if (it != processes.end())
+    {
+      return &it->second;
+    }
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+std::string DepsRecorder::resolve(pid_t tid, Process &proc, int dirfd, std::string const &path)
+{
+  if (path.empty() || path[0] == '/')
+  {
+    return path.empty() ? path : normalise(path);
+  }
+  std::string base;
+  if (dirfd == AT_FDCWD)
+  {
+    base = readLink(procName(tid, "cwd"));
+  }
+  else
+  {
+    std::map<int, FileDesc>::const_iterator it = proc.fds.find(dirfd);
+    if (it != proc.fds.end())
+    {
+      base = it->second.path;
+    }
+    else
+    {
+      std::ostringstream oss;
+      oss << "fd/" << dirfd;
+      base = readLink(procName(tid, oss.str()));
+    }
+  }
+  return normalise(base + '/' + path);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void DepsRecorder::record(pid_t tid, Process &proc, int dirfd, long addr, unsigned access)
+{
+  std::string const path = resolve(tid, proc, dirfd, readRemoteString(tid, addr));
+  if (!path.empty())
+  {
+    manifests[proc.manifest].files[path] |= access;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void DepsRecorder::probe(pid_t tid, Process &proc, int dirfd, long addr, long rc)
+{
+  if (rc >= 0)
+  {
+    record(tid, proc, dirfd, addr, Stat);
+  }
+  else if (rc == -ENOENT || rc == -ENOTDIR)
+  {
+    record(tid, proc, dirfd, addr, Missing);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// A file opened read only or write only is recorded immediately; one
+// opened for both is recorded when it is read or written, or as read
+// if it is closed unused.
+void DepsRecorder::open(pid_t tid, Process &proc, int dirfd, long addr, long flags, long rc)
+{
+  if (rc < 0)
+  {
+    if (rc == -ENOENT || rc == -ENOTDIR)
+    {
+      record(tid, proc, dirfd, addr, Missing);
+    }
+    return;
+  }
+  std::string const path = resolve(tid, proc, dirfd, readRemoteString(tid, addr));
+  close(proc, rc);
+  FileDesc &fd = proc.fds[rc];
+  fd.path = path;
+  fd.pending = false;
+  fd.cloexec = (flags & O_CLOEXEC) != 0;
+
+  unsigned &access = manifests[proc.manifest].files[path];
+  if (flags & O_TRUNC)
+  {
+    access |= Write;
+  }
+  switch (flags & O_ACCMODE)
+  {
+  case O_RDONLY:
+    access |= Read;
+    break;
+  case O_WRONLY:
+    access |= Write;
+    break;
+  default:
+    fd.pending = (access & Write) == 0;
+    break;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void DepsRecorder::use(Process &proc, int fd, unsigned access)
+{
+  std::map<int, FileDesc>::iterator it = proc.fds.find(fd);
+  if (it != proc.fds.end())
+  {
+    it->second.pending = false;
+    manifests[proc.manifest].files[it->second.path] |= access;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void DepsRecorder::close(Process &proc, int fd)
+{
+  std::map<int, FileDesc>::iterator it = proc.fds.find(fd);
+  if (it != proc.fds.end())
+  {
+    if (it->second.pending)
+    {
+      manifests[proc.manifest].files[it->second.path] |= Read;
+    }
+    proc.fds.erase(it);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void DepsRecorder::dup(Process &proc, int oldfd, int newfd, bool cloexec)
+{
+  if (oldfd == newfd)
+  {
+    return;
+  }
+  close(proc, newfd);
+  std::map<int, FileDesc>::const_iterator it = proc.fds.find(oldfd);
+  if (it != proc.fds.end())
+  {
+    FileDesc &fd = proc.fds[newfd];
+    fd = it->second;
+    fd.cloexec = cloexec;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// Each manifest is a header giving the pid, working directory and
+// command line followed by one line per distinct file, in the form
+// "RWSM path" with '-' for each kind of access which did not occur.
+void DepsRecorder::Report(std::ostream &os)
+{
+  for (std::map<pid_t, Process>::iterator it = processes.begin(); it != processes.end(); ++it)
+  {
+    while (!it->second.fds.empty())
+    {
+      close(it->second, it->second.fds.begin()->first);
+    }
+  }
+
+  std::ostream &out = fileName.empty() ? os : ofs;
+
+  for (size_t idx = 0; idx != manifests.size(); ++idx)
+  {
+    Manifest const &manifest = manifests[idx];
+    out << "# pid " << manifest.pid << '\n'
+        << "# cwd " << manifest.cwd << '\n'
+        << "# command " << manifest.command << '\n';
+    for (std::map<std::string, unsigned>::const_iterator it = manifest.files.begin();
+         it != manifest.files.end(); ++it)
+    {
+      unsigned const access = it->second;
+      out << (access & Read ? 'R' : '-')
+          << (access & Write ? 'W' : '-')
+          << (access & Stat ? 'S' : '-')
+          << (access & Missing ? 'M' : '-')
+          << ' ' << it->first << '\n';
+    }
+    out << '\n';
+  }
+  out.flush();
+  if (!fileName.empty() && !ofs)
+  {
+    os << "Unable to write dependency manifests to " << fileName << std::endl;
+  }
+}
@@ -0,0 +1,125 @@
+#ifndef DEPS_RECORDER_H
+#define DEPS_RECORDER_H
+
+/**@file
+
+  File dependency manifest recorder for ProcessTracer
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "TraceListener.h"
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+/** Record the files each exec'd command reads, writes,
+ * stats or probes for and fails to find */
+class DepsRecorder : public TraceListener
+{
+public:
+  /** Write the manifests to 'fileName', or to the
+   * report stream if the name is empty; the file is
+   * opened at once, so it can be checked before tracing */
+  explicit DepsRecorder(std::string const &fileName);
+
+  /** Can the manifests be written? */
+  bool writable() const { return fileName.empty() || ofs.is_open(); }
+
+  void OnStart(pid_t pid) override;
+  void OnFork(pid_t parent, pid_t child, int event) override;
+  void OnExec(pid_t pid) override;
+  void OnExit(pid_t pid, int status) override;
+  bool SelectedCall(int func) override;
+  void OnCallExit(pid_t pid, int func, long const args[], long rc) override;
+  void Report(std::ostream &os) override;
+
+private:
+  /** How a file was used */
+  enum Access
+  {
+    Read = 1,
+    Write = 2,
+    Stat = 4,
+    Missing = 8
+  };
+
+  /** Files used by one exec'd command */
+  struct Manifest
+  {
+    pid_t pid;
+    std::string command;
+    std::string cwd;
+    std::map<std::string, unsigned> files;
+  };
+
+  /** An open file descriptor */
+  struct FileDesc
+  {
+    std::string path;
+    bool pending;     // opened read/write but not yet used
+    bool cloexec;
+  };
+
+  /** State shared by all the threads in a process */
+  struct Process
+  {
+    size_t manifest;  // index into manifests
+    std::map<int, FileDesc> fds;
+  };
+
+  /** Start a new manifest for process 'pid' */
+  size_t newManifest(pid_t pid);
+
+  /** The process containing task 'tid' (or 0 if unknown) */
+  Process *findProcess(pid_t tid);
+
+  /** Make 'path', relative to 'dirfd' in task 'tid', absolute */
+  std::string resolve(pid_t tid, Process &proc, int dirfd, std::string const &path);
+
+  /** Record 'access' to the path at 'addr' relative to 'dirfd' */
+  void record(pid_t tid, Process &proc, int dirfd, long addr, unsigned access);
+
+  /** Record a probe of a path, which succeeded unless 'rc' is an error */
+  void probe(pid_t tid, Process &proc, int dirfd, long addr, long rc);
+
+  /** Record the result of an open call */
+  void open(pid_t tid, Process &proc, int dirfd, long addr, long flags, long rc);
+
+  /** Record a read or write on file descriptor 'fd' */
+  void use(Process &proc, int fd, unsigned access);
+
+  /** Remove file descriptor 'fd' */
+  void close(Process &proc, int fd);
+
+  /** Duplicate file descriptor 'oldfd' as 'newfd' */
+  void dup(Process &proc, int oldfd, int newfd, bool cloexec);
+
+  std::string fileName;
+  std::ofstream ofs;
+  std::vector<Manifest> manifests;
+  std::map<pid_t, Process> processes;
+  std::map<pid_t, pid_t> threads;    // thread id => process id
+};
+
+#endif // DEPS_RECORDER_H
@@ -0,0 +1,2017 @@
+/*
+NAME
+    ElfDebugInfo
+
+DESCRIPTION
+    Parameters and local variables from the DWARF debug information of
+    ELF files, for the frames of a crashed task.
+
+    The file is mapped, so only the pages of the sections actually used
+    are read. The compilation unit covering an address is found from
+    .debug_aranges, or for units it does not list (clang does not emit
+    it by default) from the address range of the unit's own DIE. Only
+    that unit is then parsed, keeping the few attributes needed, and
+    cached; a reference into another unit parses that one too.
+
+    The innermost subprogram containing the address supplies the frame
+    base, and its parameters and variables are those in lexical blocks
+    which contain the address. Variables of inlined subroutines are
+    left out. Names and types of the out-of-line copy of an inlined or
+    optimised function come from its abstract origin.
+
+    Location expressions and lists (DWARF 2 to 5) are evaluated against
+    the registers recovered by the stack unwinder and the memory of the
+    task, read a page at a time through the unwinder's cache. Only the
+    callee-saved registers are known beyond the innermost frame, so an
+    optimised caller's variables held in other registers are shown as
+    unavailable, as are entry values and thread local variables.
+
+    The inlined subroutines of a unit are put in an interval tree the
+    first time an address in the unit is expanded into its inlined
+    calls; the call sites name a file from the header of the unit's
+    line table, which is read then too, but the line program is not.
+
+    Compressed debug sections are not supported.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "ElfDebugInfo.h"
+#include "ElfSymbols.h"
+#include "StackUnwinder.h"
+
+#include <ctype.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+  /** Constants from the DWARF 5 standard (as in libdwarf's dwarf.h) */
+  enum
+  {
+    DW_TAG_array_type = 0x01, DW_TAG_class_type = 0x02, DW_TAG_enumeration_type = 0x04,
+    DW_TAG_formal_parameter = 0x05, DW_TAG_lexical_block = 0x0b, DW_TAG_pointer_type = 0x0f,
+    DW_TAG_reference_type = 0x10, DW_TAG_compile_unit = 0x11, DW_TAG_structure_type = 0x13,
+    DW_TAG_subroutine_type = 0x15, DW_TAG_typedef = 0x16, DW_TAG_union_type = 0x17,
+    DW_TAG_inlined_subroutine = 0x1d,
+    DW_TAG_ptr_to_member_type = 0x1f, DW_TAG_subrange_type = 0x21, DW_TAG_base_type = 0x24,
+    DW_TAG_const_type = 0x26, DW_TAG_enumerator = 0x28, DW_TAG_subprogram = 0x2e,
+    DW_TAG_variable = 0x34, DW_TAG_volatile_type = 0x35, DW_TAG_restrict_type = 0x37,
+    DW_TAG_namespace = 0x39, DW_TAG_unspecified_type = 0x3b, DW_TAG_rvalue_reference_type = 0x42, DW_TAG_atomic_type = 0x47
+  };
+
+  enum
+  {
+    DW_AT_location = 0x02, DW_AT_name = 0x03, DW_AT_byte_size = 0x0b, DW_AT_stmt_list = 0x10,
+    DW_AT_low_pc = 0x11,
+    DW_AT_high_pc = 0x12, DW_AT_const_value = 0x1c, DW_AT_upper_bound = 0x2f,
+    DW_AT_abstract_origin = 0x31, DW_AT_count = 0x37, DW_AT_encoding = 0x3e,
+    DW_AT_frame_base = 0x40, DW_AT_specification = 0x47, DW_AT_type = 0x49, DW_AT_ranges = 0x55,
+    DW_AT_call_file = 0x58, DW_AT_call_line = 0x59,
+    DW_AT_str_offsets_base = 0x72, DW_AT_addr_base = 0x73, DW_AT_rnglists_base = 0x74,
+    DW_AT_loclists_base = 0x8c, DW_AT_GNU_addr_base = 0x2133
+  };
+
+  enum
+  {
+    DW_FORM_addr = 0x01, DW_FORM_block2 = 0x03, DW_FORM_block4 = 0x04, DW_FORM_data2 = 0x05,
+    DW_FORM_data4 = 0x06, DW_FORM_data8 = 0x07, DW_FORM_string = 0x08, DW_FORM_block = 0x09,
+    DW_FORM_block1 = 0x0a, DW_FORM_data1 = 0x0b, DW_FORM_flag = 0x0c, DW_FORM_sdata = 0x0d,
+    DW_FORM_strp = 0x0e, DW_FORM_udata = 0x0f, DW_FORM_ref_addr = 0x10, DW_FORM_ref1 = 0x11,
+    DW_FORM_ref2 = 0x12, DW_FORM_ref4 = 0x13, DW_FORM_ref8 = 0x14, DW_FORM_ref_udata = 0x15,
+    DW_FORM_indirect = 0x16, DW_FORM_sec_offset = 0x17, DW_FORM_exprloc = 0x18,
+    DW_FORM_flag_present = 0x19, DW_FORM_strx = 0x1a, DW_FORM_addrx = 0x1b,
+    DW_FORM_ref_sup4 = 0x1c, DW_FORM_strp_sup = 0x1d, DW_FORM_data16 = 0x1e,
+    DW_FORM_line_strp = 0x1f, DW_FORM_ref_sig8 = 0x20, DW_FORM_implicit_const = 0x21,
+    DW_FORM_loclistx = 0x22, DW_FORM_rnglistx = 0x23, DW_FORM_ref_sup8 = 0x24,
+    DW_FORM_strx1 = 0x25, DW_FORM_strx2 = 0x26, DW_FORM_strx3 = 0x27, DW_FORM_strx4 = 0x28,
+    DW_FORM_addrx1 = 0x29, DW_FORM_addrx2 = 0x2a, DW_FORM_addrx3 = 0x2b, DW_FORM_addrx4 = 0x2c,
+    DW_FORM_GNU_addr_index = 0x1f01, DW_FORM_GNU_str_index = 0x1f02,
+    DW_FORM_GNU_ref_alt = 0x1f20, DW_FORM_GNU_strp_alt = 0x1f21
+  };
+
+  enum
+  {
+    DW_OP_addr = 0x03, DW_OP_deref = 0x06, DW_OP_const1u = 0x08, DW_OP_const1s = 0x09,
+    DW_OP_const2u = 0x0a, DW_OP_const2s = 0x0b, DW_OP_const4u = 0x0c, DW_OP_const4s = 0x0d,
+    DW_OP_const8u = 0x0e, DW_OP_const8s = 0x0f, DW_OP_constu = 0x10, DW_OP_consts = 0x11,
+    DW_OP_dup = 0x12, DW_OP_drop = 0x13, DW_OP_over = 0x14, DW_OP_pick = 0x15, DW_OP_swap = 0x16,
+    DW_OP_rot = 0x17, DW_OP_abs = 0x19, DW_OP_and = 0x1a, DW_OP_div = 0x1b, DW_OP_minus = 0x1c,
+    DW_OP_mod = 0x1d, DW_OP_mul = 0x1e, DW_OP_neg = 0x1f, DW_OP_not = 0x20, DW_OP_or = 0x21,
+    DW_OP_plus = 0x22, DW_OP_plus_uconst = 0x23, DW_OP_shl = 0x24, DW_OP_shr = 0x25,
+    DW_OP_shra = 0x26, DW_OP_xor = 0x27, DW_OP_bra = 0x28, DW_OP_eq = 0x29, DW_OP_ge = 0x2a,
+    DW_OP_gt = 0x2b, DW_OP_le = 0x2c, DW_OP_lt = 0x2d, DW_OP_ne = 0x2e, DW_OP_skip = 0x2f,
+    DW_OP_lit0 = 0x30, DW_OP_lit31 = 0x4f, DW_OP_reg0 = 0x50, DW_OP_reg31 = 0x6f,
+    DW_OP_breg0 = 0x70, DW_OP_breg31 = 0x8f, DW_OP_regx = 0x90, DW_OP_fbreg = 0x91,
+    DW_OP_bregx = 0x92, DW_OP_piece = 0x93, DW_OP_deref_size = 0x94, DW_OP_nop = 0x96,
+    DW_OP_call_frame_cfa = 0x9c, DW_OP_implicit_value = 0x9e, DW_OP_stack_value = 0x9f,
+    DW_OP_implicit_pointer = 0xa0, DW_OP_addrx = 0xa1, DW_OP_constx = 0xa2,
+    DW_OP_entry_value = 0xa3, DW_OP_form_tls_address = 0x9b, DW_OP_GNU_push_tls_address = 0xe0,
+    DW_OP_GNU_implicit_pointer = 0xf2, DW_OP_GNU_entry_value = 0xf3,
+    DW_OP_GNU_addr_index = 0xfb, DW_OP_GNU_const_index = 0xfc
+  };
+
+  enum
+  {
+    DW_ATE_boolean = 0x02, DW_ATE_float = 0x04, DW_ATE_signed = 0x05, DW_ATE_signed_char = 0x06,
+    DW_ATE_unsigned = 0x07, DW_ATE_unsigned_char = 0x08, DW_ATE_UTF = 0x10
+  };
+
+  enum
+  {
+    DW_LNCT_path = 0x1, DW_LNCT_directory_index = 0x2
+  };
+
+  enum
+  {
+    DW_UT_type = 0x02, DW_UT_skeleton = 0x04, DW_UT_split_compile = 0x05, DW_UT_split_type = 0x06
+  };
+
+  enum
+  {
+    DW_LLE_end_of_list = 0x00, DW_LLE_base_addressx = 0x01, DW_LLE_startx_endx = 0x02,
+    DW_LLE_startx_length = 0x03, DW_LLE_offset_pair = 0x04, DW_LLE_default_location = 0x05,
+    DW_LLE_base_address = 0x06, DW_LLE_start_end = 0x07, DW_LLE_start_length = 0x08
+  };
+
+  enum
+  {
+    DW_RLE_end_of_list = 0x00, DW_RLE_base_addressx = 0x01, DW_RLE_startx_endx = 0x02,
+    DW_RLE_startx_length = 0x03, DW_RLE_offset_pair = 0x04, DW_RLE_base_address = 0x05,
+    DW_RLE_start_end = 0x06, DW_RLE_start_length = 0x07
+  };
+
+  /** Longest string shown for a char pointer */
+  size_t const MaxString = 64;
+
+  /** Reads the values in a section; reads past the end give 0 */
+  class Reader
+  {
+  public:
+    Reader(unsigned char const *data, size_t size, size_t pos = 0)
+    : pos(pos), data(data), size(size) {}
+
+    bool atEnd() const { return pos >= size; }
+
+    unsigned char const *here() const { return data + std::min(pos, size); }
+
+    template <typename T>
+    T fixed()
+    {
+      T value(0);
+      if (pos <= size && sizeof(T) <= size - pos)
+      {
+        memcpy(&value, data + pos, sizeof(T));
+      }
+      pos += sizeof(T);
+      return value;
+    }
+
+    /** An unsigned value of 'bytes' bytes */
+    unsigned long sized(int bytes)
+    {
+      switch (bytes)
+      {
+      case 1: return fixed<uint8_t>();
+      case 2: return fixed<uint16_t>();
+      case 4: return fixed<uint32_t>();
+      default: return fixed<uint64_t>();
+      }
+    }
+
+    unsigned long uleb()
+    {
+      unsigned long result(0);
+      int shift(0);
+      while (pos < size)
+      {
+        unsigned char const byte = data[pos++];
+        if (shift < 64)
+          result |= (unsigned long)(byte & 0x7f) << shift;
+        shift += 7;
+        if (!(byte & 0x80))
+          break;
+      }
+      return result;
+    }
+
+    long sleb()
+    {
+      long result(0);
+      int shift(0);
+      unsigned char byte(0);
+      while (pos < size)
+      {
+        byte = data[pos++];
+        if (shift < 64)
+          result |= (long)(byte & 0x7f) << shift;
+        shift += 7;
+        if (!(byte & 0x80))
+          break;
+      }
+      if (shift < 64 && (byte & 0x40))
+      {
+        result |= -(1L << shift);
+      }
+      return result;
+    }
+
+    size_t pos;
+
+  private:
+    unsigned char const *data;
+    size_t size;
+  };
+
+  /** An abbreviation: the tag and attribute forms of some DIEs */
+  struct Abbrev
+  {
+    unsigned long tag;
+    bool children;
+    std::vector<unsigned long> names;
+    std::vector<unsigned long> forms;
+    std::vector<long> implicit;      // values of DW_FORM_implicit_const
+  };
+
+  /** The operand stack of a DWARF expression */
+  class ValueStack
+  {
+  public:
+    void push(unsigned long value) { values.push_back(value); }
+
+    unsigned long pop()
+    {
+      unsigned long const value = top();
+      values.pop_back();
+      return value;
+    }
+
+    unsigned long &top() { return pick(0); }
+
+    /** The value 'depth' entries below the top */
+    unsigned long &pick(size_t depth)
+    {
+      if (depth >= values.size())
+      {
+        throw std::runtime_error("DWARF expression stack underflow");
+      }
+      return values[values.size() - 1 - depth];
+    }
+
+    bool empty() const { return values.empty(); }
+    void clear() { values.clear(); }
+
+  private:
+    std::vector<unsigned long> values;
+  };
+
+  char const *const registerNames[] = {
+    "rax", "rdx", "rcx", "rbx", "rsi", "rdi", "rbp", "rsp",
+    "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15", "rip" };
+
+  /** The name of DWARF register 'reg' */
+  std::string registerName(unsigned long reg)
+  {
+    std::ostringstream oss;
+    if (reg < sizeof(registerNames) / sizeof(registerNames[0]))
+      oss << registerNames[reg];
+    else if (reg >= 17 && reg <= 32)
+      oss << "xmm" << reg - 17;
+    else
+      oss << "reg" << reg;
+    return oss.str();
+  }
+
+  /** Describe 'base' plus 'offset' as [base+0x10] */
+  std::string relative(std::string const &base, long offset)
+  {
+    std::ostringstream oss;
+    oss << '[' << base;
+    if (offset < 0)
+      oss << "-0x" << std::hex << -offset;
+    else if (offset > 0)
+      oss << "+0x" << std::hex << offset;
+    oss << ']';
+    return oss.str();
+  }
+
+  /** Read the value of register 'reg' in 'frame' */
+  unsigned long registerValue(StackFrame const &frame, unsigned long reg)
+  {
+    if (reg >= ElfUnwind::Registers)
+    {
+      throw std::runtime_error("register " + registerName(reg) + " is not available");
+    }
+    if (!frame.valid[reg])
+    {
+      throw std::runtime_error("register " + registerName(reg) + " is not known in this frame");
+    }
+    return frame.regs[reg];
+  }
+} // namespace
+
+/** How a variable's value was located */
+struct ElfDebugInfo::Location
+{
+  enum Kind
+  {
+    OptimizedOut,
+    Memory,        // at address 'value'
+    Register,      // in register 'value'
+    Value,         // the value is 'value'
+    Bytes          // the value is 'bytes': implicit, or assembled from pieces
+  } kind;
+  unsigned long value;
+  std::vector<unsigned char> bytes;
+  std::string where;     // eg [cfa-0x14] or (rdi), if known
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+ElfDebugInfo::ElfDebugInfo(std::string const &path)
+: map(0), mapSize(0), indexed(false)
+{
+  if (!open(path))
+  {
+    close();
+    // Distributions ship the debug information in a separate file
+    std::string const &build = ElfSymbols::get(path)->buildId();
+    if (build.size() > 2 &&
+        !open("/usr/lib/debug/.build-id/" + build.substr(0, 2) + "/" + build.substr(2) + ".debug"))
+    {
+      close();
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+ElfDebugInfo::~ElfDebugInfo()
+{
+  close();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool ElfDebugInfo::open(std::string const &path)
+{
+  int const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+  {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(Elf64_Ehdr))
+  {
+    void *const addr = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr != MAP_FAILED)
+    {
+      map = addr;
+      mapSize = st.st_size;
+    }
+  }
+  ::close(fd);
+  if (!map)
+  {
+    return false;
+  }
+
+  unsigned char const *const base = static_cast<unsigned char const *>(map);
+  Elf64_Ehdr const *ehdr = reinterpret_cast<Elf64_Ehdr const *>(base);
+  if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 || ehdr->e_ident[EI_CLASS] != ELFCLASS64 ||
+      ehdr->e_shentsize != sizeof(Elf64_Shdr) || ehdr->e_shoff > mapSize ||
+      ehdr->e_shnum * sizeof(Elf64_Shdr) > mapSize - ehdr->e_shoff || ehdr->e_shstrndx >= ehdr->e_shnum)
+  {
+    return false;
+  }
+  Elf64_Shdr const *shdr = reinterpret_cast<Elf64_Shdr const *>(base + ehdr->e_shoff);
+  Elf64_Shdr const &names = shdr[ehdr->e_shstrndx];
+  if (names.sh_offset > mapSize || names.sh_size > mapSize - names.sh_offset)
+  {
+    return false;
+  }
+  struct
+  {
+    char const *name;
+    Section *section;
+  } const wanted[] = {
+    { ".debug_info", &info }, { ".debug_abbrev", &abbrev }, { ".debug_str", &str },
+    { ".debug_line_str", &lineStr }, { ".debug_str_offsets", &strOffsets }, { ".debug_addr", &addr },
+    { ".debug_loc", &loc }, { ".debug_loclists", &loclists }, { ".debug_ranges", &debugRanges },
+    { ".debug_rnglists", &rnglists }, { ".debug_aranges", &aranges }, { ".debug_line", &line } };
+  for (int idx = 0; idx != ehdr->e_shnum; ++idx)
+  {
+    if (shdr[idx].sh_type == SHT_NOBITS || (shdr[idx].sh_flags & SHF_COMPRESSED) ||
+        shdr[idx].sh_name >= names.sh_size || shdr[idx].sh_offset > mapSize ||
+        shdr[idx].sh_size > mapSize - shdr[idx].sh_offset)
+      continue;
+    char const *const name = reinterpret_cast<char const *>(base + names.sh_offset + shdr[idx].sh_name);
+    size_t const maxLen = names.sh_size - shdr[idx].sh_name;
+    for (size_t sect = 0; sect != sizeof(wanted) / sizeof(wanted[0]); ++sect)
+    {
+      if (strnlen(name, maxLen) < maxLen && strcmp(name, wanted[sect].name) == 0)
+      {
+        wanted[sect].section->data = base + shdr[idx].sh_offset;
+        wanted[sect].section->size = shdr[idx].sh_size;
+      }
+    }
+  }
+  return info.size != 0 && abbrev.size != 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ElfDebugInfo::close()
+{
+  if (map)
+  {
+    munmap(map, mapSize);
+  }
+  map = 0;
+  mapSize = 0;
+  info = abbrev = str = lineStr = strOffsets = addr = loc = loclists = debugRanges = rnglists = aranges = line = Section();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+std::shared_ptr<ElfDebugInfo const> ElfDebugInfo::get(std::string const &path)
+{
+  static std::mutex lock;
+  static std::map<std::string, std::shared_ptr<ElfDebugInfo const> > cache;
+  std::lock_guard<std::mutex> guard(lock);
+  std::shared_ptr<ElfDebugInfo const> &entry = cache[path];
+  if (!entry)
+  {
+    entry.reset(new ElfDebugInfo(path));
+  }
+  return entry;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ElfDebugInfo::buildIndex() const
+{
+  if (indexed)
+  {
+    return;
+  }
+  indexed = true;
+
+  // The start of every unit, skipping from header to header
+  Reader reader(info.data, info.size);
+  while (reader.pos + 4 <= info.size)
+  {
+    size_t const start = reader.pos;
+    unsigned long length = reader.fixed<uint32_t>();
+    if (length == 0xffffffff)
+      length = reader.fixed<uint64_t>();
+    else if (length >= 0xfffffff0)
+      break;
+    if (length == 0 || reader.pos > info.size || length > info.size - reader.pos)
+      break;
+    unitOffsets.push_back(start);
+    reader.pos += length;
+  }
+
+  std::set<size_t> covered;
+  Reader ranges(aranges.data, aranges.size);
+  while (ranges.pos + 4 <= aranges.size)
+  {
+    size_t const start = ranges.pos;
+    unsigned long length = ranges.fixed<uint32_t>();
+    int offsetSize(4);
+    if (length == 0xffffffff)
+    {
+      length = ranges.fixed<uint64_t>();
+      offsetSize = 8;
+    }
+    if (length == 0 || ranges.pos > aranges.size || length > aranges.size - ranges.pos)
+      break;
+    size_t const end = ranges.pos + length;
+    ranges.fixed<uint16_t>();  // version
+    size_t const unitOffset = ranges.sized(offsetSize);
+    int const addressSize = ranges.fixed<uint8_t>();
+    ranges.fixed<uint8_t>();   // segment selector size
+    size_t const tuple = 2 * addressSize;
+    if (addressSize == 0)
+      break;
+    // The tuples are aligned to their size from the start of the set
+    ranges.pos = start + (ranges.pos - start + tuple - 1) / tuple * tuple;
+    while (ranges.pos + tuple <= end)
+    {
+      unsigned long const begin = ranges.sized(addressSize);
+      unsigned long const len = ranges.sized(addressSize);
+      if (begin == 0 && len == 0)
+        break;
+      Range const range = { begin, begin + len, unitOffset };
+      index.push_back(range);
+    }
+    covered.insert(unitOffset);
+    ranges.pos = end;
+  }
+
+  // Units not listed are described by the ranges of their own DIE
+  for (size_t idx = 0; idx != unitOffsets.size(); ++idx)
+  {
+    Unit top;
+    if (covered.count(unitOffsets[idx]) || !parse(unitOffsets[idx], true, top) || top.dies.empty())
+      continue;
+    std::vector<std::pair<unsigned long, unsigned long> > pcs;
+    this->ranges(top, top.dies[0], pcs);
+    for (size_t pc = 0; pc != pcs.size(); ++pc)
+    {
+      Range const range = { pcs[pc].first, pcs[pc].second, unitOffsets[idx] };
+      index.push_back(range);
+    }
+  }
+  std::sort(index.begin(), index.end(),
+            [](Range const &lhs, Range const &rhs) { return lhs.begin < rhs.begin; });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+ElfDebugInfo::Unit const *ElfDebugInfo::unitAt(unsigned long vaddr) const
+{
+  if (empty())
+  {
+    return 0;
+  }
+  buildIndex();
+  std::vector<Range>::const_iterator it = std::upper_bound(
+    index.begin(), index.end(), vaddr, [](unsigned long vaddr, Range const &range) { return vaddr < range.begin; });
+  if (it == index.begin() || vaddr >= (--it)->end)
+  {
+    return 0;
+  }
+  return unit(it->unit);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+ElfDebugInfo::Unit const *ElfDebugInfo::unit(size_t offset) const
+{
+  std::shared_ptr<Unit> &entry = units[offset];
+  if (!entry)
+  {
+    entry.reset(new Unit);
+    if (!parse(offset, false, *entry))
+    {
+      entry->dies.clear();
+    }
+  }
+  return entry->dies.empty() ? 0 : entry.get();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool ElfDebugInfo::parse(size_t offset, bool topOnly, Unit &unit) const
+{
+  Reader reader(info.data, info.size, offset);
+  unsigned long length = reader.fixed<uint32_t>();
+  unit.offsetSize = 4;
+  if (length == 0xffffffff)
+  {
+    length = reader.fixed<uint64_t>();
+    unit.offsetSize = 8;
+  }
+  if (reader.pos > info.size || length > info.size - reader.pos)
+  {
+    return false;
+  }
+  unit.offset = offset;
+  unit.end = reader.pos + length;
+  unit.version = reader.fixed<uint16_t>();
+  unit.base = unit.addrBase = unit.strOffsetsBase = unit.loclistsBase = unit.rnglistsBase = 0;
+  unit.lineOffset = -1;
+  unit.inlinesIndexed = false;
+  unsigned long abbrevOffset(0);
+  if (unit.version >= 5)
+  {
+    int const unitType = reader.fixed<uint8_t>();
+    unit.addressSize = reader.fixed<uint8_t>();
+    abbrevOffset = reader.sized(unit.offsetSize);
+    if (unitType == DW_UT_skeleton || unitType == DW_UT_split_compile)
+      reader.pos += 8;
+    else if (unitType == DW_UT_type || unitType == DW_UT_split_type)
+      reader.pos += 8 + unit.offsetSize;
+  }
+  else if (unit.version >= 2)
+  {
+    abbrevOffset = reader.sized(unit.offsetSize);
+    unit.addressSize = reader.fixed<uint8_t>();
+  }
+  if (unit.version < 2 || unit.version > 5 || (unit.addressSize != 4 && unit.addressSize != 8))
+  {
+    return false;
+  }
+
+  // The abbreviations, indexed by code
+  std::vector<Abbrev> abbrevs;
+  Reader table(abbrev.data, abbrev.size, abbrevOffset);
+  while (!table.atEnd())
+  {
+    unsigned long const code = table.uleb();
+    if (code == 0 || code > 0x100000)
+      break;
+    if (code >= abbrevs.size())
+      abbrevs.resize(code + 1);
+    Abbrev &entry = abbrevs[code];
+    entry.tag = table.uleb();
+    entry.children = table.fixed<uint8_t>() != 0;
+    while (!table.atEnd())
+    {
+      unsigned long const name = table.uleb();
+      unsigned long const form = table.uleb();
+      if (name == 0 && form == 0)
+        break;
+      entry.names.push_back(name);
+      entry.forms.push_back(form);
+      entry.implicit.push_back(form == DW_FORM_implicit_const ? table.sleb() : 0);
+    }
+  }
+
+  std::vector<int> parents;
+  while (reader.pos < unit.end)
+  {
+    size_t const dieOffset = reader.pos;
+    unsigned long const code = reader.uleb();
+    if (code == 0)
+    {
+      if (!parents.empty())
+        parents.pop_back();
+      continue;
+    }
+    if (code >= abbrevs.size() || abbrevs[code].tag == 0)
+    {
+      break;    // corrupt, or a form we could not skip
+    }
+    Abbrev const &entry = abbrevs[code];
+    Die die = Die();
+    die.offset = dieOffset;
+    die.tag = entry.tag;
+    die.parent = parents.empty() ? -1 : parents.back();
+    die.depth = parents.size();
+    for (size_t idx = 0; idx != entry.names.size() && reader.pos < unit.end; ++idx)
+    {
+      Attribute value = { (unsigned int)entry.forms[idx], 0, 0 };
+      unsigned long form = entry.forms[idx];
+      if (form == DW_FORM_indirect)
+      {
+        form = value.form = reader.uleb();
+      }
+      switch (form)
+      {
+      case DW_FORM_addr:
+        value.value = reader.sized(unit.addressSize);
+        break;
+      case DW_FORM_data1: case DW_FORM_ref1: case DW_FORM_flag: case DW_FORM_strx1: case DW_FORM_addrx1:
+        value.value = reader.fixed<uint8_t>();
+        break;
+      case DW_FORM_data2: case DW_FORM_ref2: case DW_FORM_strx2: case DW_FORM_addrx2:
+        value.value = reader.fixed<uint16_t>();
+        break;
+      case DW_FORM_strx3: case DW_FORM_addrx3:
+        value.value = reader.fixed<uint16_t>();
+        value.value |= (unsigned long)reader.fixed<uint8_t>() << 16;
+        break;
+      case DW_FORM_data4: case DW_FORM_ref4: case DW_FORM_ref_sup4: case DW_FORM_strx4: case DW_FORM_addrx4:
+        value.value = reader.fixed<uint32_t>();
+        break;
+      case DW_FORM_data8: case DW_FORM_ref8: case DW_FORM_ref_sig8: case DW_FORM_ref_sup8:
+        value.value = reader.fixed<uint64_t>();
+        break;
+      case DW_FORM_data16:
+        value.block = reader.here();
+        value.value = 16;
+        reader.pos += 16;
+        break;
+      case DW_FORM_sdata:
+        value.value = reader.sleb();
+        break;
+      case DW_FORM_udata: case DW_FORM_ref_udata: case DW_FORM_strx: case DW_FORM_addrx:
+      case DW_FORM_loclistx: case DW_FORM_rnglistx: case DW_FORM_GNU_addr_index: case DW_FORM_GNU_str_index:
+        value.value = reader.uleb();
+        break;
+      case DW_FORM_ref_addr:
+        value.value = reader.sized(unit.version == 2 ? unit.addressSize : unit.offsetSize);
+        break;
+      case DW_FORM_strp: case DW_FORM_line_strp: case DW_FORM_sec_offset: case DW_FORM_strp_sup:
+      case DW_FORM_GNU_ref_alt: case DW_FORM_GNU_strp_alt:
+        value.value = reader.sized(unit.offsetSize);
+        break;
+      case DW_FORM_string:
+        value.block = reader.here();
+        value.value = strnlen(reinterpret_cast<char const *>(value.block), unit.end - reader.pos);
+        reader.pos += value.value + 1;
+        break;
+      case DW_FORM_block1:
+        value.value = reader.fixed<uint8_t>();
+        value.block = reader.here();
+        reader.pos += value.value;
+        break;
+      case DW_FORM_block2:
+        value.value = reader.fixed<uint16_t>();
+        value.block = reader.here();
+        reader.pos += value.value;
+        break;
+      case DW_FORM_block4:
+        value.value = reader.fixed<uint32_t>();
+        value.block = reader.here();
+        reader.pos += value.value;
+        break;
+      case DW_FORM_block: case DW_FORM_exprloc:
+        value.value = reader.uleb();
+        value.block = reader.here();
+        reader.pos += value.value;
+        break;
+      case DW_FORM_flag_present:
+        value.value = 1;
+        break;
+      case DW_FORM_implicit_const:
+        value.value = entry.implicit[idx];
+        break;
+      default:
+        // We cannot know the size of an unknown form
+        reader.pos = unit.end;
+        value.form = 0;
+        break;
+      }
+      if (form == DW_FORM_ref1 || form == DW_FORM_ref2 || form == DW_FORM_ref4 ||
+          form == DW_FORM_ref8 || form == DW_FORM_ref_udata)
+      {
+        value.value += offset;
+      }
+
+      switch (entry.names[idx])
+      {
+      case DW_AT_name: die.name = value; break;
+      case DW_AT_type: die.type = value; break;
+      case DW_AT_abstract_origin: die.origin = value; break;
+      case DW_AT_specification: if (!die.origin.form) die.origin = value; break;
+      case DW_AT_location: die.location = value; break;
+      case DW_AT_frame_base: die.frameBase = value; break;
+      case DW_AT_low_pc: die.lowPc = value; break;
+      case DW_AT_high_pc: die.highPc = value; break;
+      case DW_AT_ranges: die.ranges = value; break;
+      case DW_AT_byte_size: die.byteSize = value; break;
+      case DW_AT_encoding: die.encoding = value; break;
+      case DW_AT_const_value: die.constValue = value; break;
+      case DW_AT_call_file: die.callFile = value; break;
+      case DW_AT_call_line: die.callLine = value; break;
+      case DW_AT_stmt_list: if (die.depth == 0) unit.lineOffset = value.value; break;
+      case DW_AT_count: die.count = value; break;
+      case DW_AT_upper_bound:
+        if (!die.count.form && value.form != DW_FORM_exprloc && reference(value) == (size_t)-1)
+        {
+          die.count = value;
+          ++die.count.value;
+        }
+        break;
+      case DW_AT_str_offsets_base: unit.strOffsetsBase = value.value; break;
+      case DW_AT_addr_base: case DW_AT_GNU_addr_base: unit.addrBase = value.value; break;
+      case DW_AT_rnglists_base: unit.rnglistsBase = value.value; break;
+      case DW_AT_loclists_base: unit.loclistsBase = value.value; break;
+      }
+    }
+    unit.dies.push_back(die);
+    if (topOnly)
+      break;
+    if (entry.children)
+      parents.push_back(unit.dies.size() - 1);
+  }
+  if (unit.dies.empty())
+  {
+    return false;
+  }
+  if (unit.dies[0].lowPc.form)
+  {
+    unit.base = address(unit, unit.dies[0].lowPc);
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+ElfDebugInfo::Die const *ElfDebugInfo::die(size_t offset, Unit const *&where) const
+{
+  buildIndex();
+  std::vector<size_t>::const_iterator it = std::upper_bound(unitOffsets.begin(), unitOffsets.end(), offset);
+  if (offset == (size_t)-1 || it == unitOffsets.begin())
+  {
+    return 0;
+  }
+  Unit const *const owner = unit(*--it);
+  if (!owner)
+  {
+    return 0;
+  }
+  std::vector<Die>::const_iterator const found = std::lower_bound(
+    owner->dies.begin(), owner->dies.end(), offset,
+    [](Die const &die, size_t offset) { return die.offset < offset; });
+  if (found == owner->dies.end() || found->offset != offset)
+  {
+    return 0;
+  }
+  where = owner;
+  return &*found;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+ElfDebugInfo::Die const *ElfDebugInfo::withAttribute(Unit const *&where, Die const *die,
+                                                     Attribute Die::*member) const
+{
+  for (int hops = 0; die && hops != 8; ++hops)
+  {
+    if ((die->*member).form)
+      return die;
+    if (!die->origin.form)
+      return 0;
+    die = this->die(reference(die->origin), where);
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+size_t ElfDebugInfo::reference(Attribute const &attr)
+{
+  switch (attr.form)
+  {
+  case DW_FORM_ref1: case DW_FORM_ref2: case DW_FORM_ref4: case DW_FORM_ref8:
+  case DW_FORM_ref_udata: case DW_FORM_ref_addr:
+    return attr.value;
+  }
+  return -1;   // eg a type unit signature, or a supplementary file
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+std::string ElfDebugInfo::string(Unit const &unit, Attribute const &attr) const
+{
+  Section const *section(0);
+  unsigned long offset(attr.value);
+  switch (attr.form)
+  {
+  case DW_FORM_string:
+    return std::string(reinterpret_cast<char const *>(attr.block), attr.value);
+  case DW_FORM_strp:
+    section = &str;
+    break;
+  case DW_FORM_line_strp:
+    section = &lineStr;
+    break;
+  case DW_FORM_strx: case DW_FORM_strx1: case DW_FORM_strx2: case DW_FORM_strx3: case DW_FORM_strx4:
+  case DW_FORM_GNU_str_index:
+  {
+    Reader reader(strOffsets.data, strOffsets.size, unit.strOffsetsBase + attr.value * unit.offsetSize);
+    offset = reader.sized(unit.offsetSize);
+    section = &str;
+    break;
+  }
+  default:
+    return std::string();
+  }
+  if (offset >= section->size)
+  {
+    return std::string();
+  }
+  char const *const text = reinterpret_cast<char const *>(section->data + offset);
+  return std::string(text, strnlen(text, section->size - offset));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+unsigned long ElfDebugInfo::indexedAddress(Unit const &unit, unsigned long index) const
+{
+  Reader reader(addr.data, addr.size, unit.addrBase + index * unit.addressSize);
+  return reader.sized(unit.addressSize);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+unsigned long ElfDebugInfo::address(Unit const &unit, Attribute const &attr) const
+{
+  switch (attr.form)
+  {
+  case DW_FORM_addrx: case DW_FORM_addrx1: case DW_FORM_addrx2: case DW_FORM_addrx3: case DW_FORM_addrx4:
+  case DW_FORM_GNU_addr_index:
+    return indexedAddress(unit, attr.value);
+  }
+  return attr.value;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ElfDebugInfo::ranges(Unit const &unit, Die const &die,
+                          std::vector<std::pair<unsigned long, unsigned long> > &out) const
+{
+  if (die.lowPc.form)
+  {
+    unsigned long const low = address(unit, die.lowPc);
+    unsigned long high = address(unit, die.highPc);
+    // DWARF 4 and later give the high pc as a length unless it is an address
+    if (die.highPc.form != DW_FORM_addr && address(unit, die.highPc) == die.highPc.value)
+      high += low;
+    if (die.highPc.form)
+      out.push_back(std::make_pair(low, high));
+    return;
+  }
+  if (!die.ranges.form)
+  {
+    return;
+  }
+  unsigned long base = unit.base;
+  if (unit.version < 5)
+  {
+    Reader reader(debugRanges.data, debugRanges.size, die.ranges.value);
+    unsigned long const select = (unit.addressSize == 4) ? 0xffffffffUL : ~0UL;
+    while (!reader.atEnd())
+    {
+      unsigned long const begin = reader.sized(unit.addressSize);
+      unsigned long const end = reader.sized(unit.addressSize);
+      if (begin == 0 && end == 0)
+        break;
+      if (begin == select)
+        base = end;
+      else
+        out.push_back(std::make_pair(base + begin, base + end));
+    }
+    return;
+  }
+
+  unsigned long offset = die.ranges.value;
+  if (die.ranges.form == DW_FORM_rnglistx)
+  {
+    Reader table(rnglists.data, rnglists.size, unit.rnglistsBase + offset * unit.offsetSize);
+    offset = unit.rnglistsBase + table.sized(unit.offsetSize);
+  }
+  Reader reader(rnglists.data, rnglists.size, offset);
+  while (!reader.atEnd())
+  {
+    unsigned long begin(0), end(0);
+    switch (reader.fixed<uint8_t>())
+    {
+    case DW_RLE_end_of_list:
+      return;
+    case DW_RLE_base_addressx:
+      base = indexedAddress(unit, reader.uleb());
+      continue;
+    case DW_RLE_startx_endx:
+      begin = indexedAddress(unit, reader.uleb());
+      end = indexedAddress(unit, reader.uleb());
+      break;
+    case DW_RLE_startx_length:
+      begin = indexedAddress(unit, reader.uleb());
+      end = begin + reader.uleb();
+      break;
+    case DW_RLE_offset_pair:
+      begin = base + reader.uleb();
+      end = base + reader.uleb();
+      break;
+    case DW_RLE_base_address:
+      base = reader.sized(unit.addressSize);
+      continue;
+    case DW_RLE_start_end:
+      begin = reader.sized(unit.addressSize);
+      end = reader.sized(unit.addressSize);
+      break;
+    case DW_RLE_start_length:
+      begin = reader.sized(unit.addressSize);
+      end = begin + reader.uleb();
+      break;
+    default:
+      return;
+    }
+    out.push_back(std::make_pair(begin, end));
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool ElfDebugInfo::contains(Unit const &unit, Die const &die, unsigned long vaddr) const
+{
+  std::vector<std::pair<unsigned long, unsigned long> > pcs;
+  ranges(unit, die, pcs);
+  for (size_t idx = 0; idx != pcs.size(); ++idx)
+  {
+    if (pcs[idx].first <= vaddr && vaddr < pcs[idx].second)
+      return true;
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool ElfDebugInfo::expression(Unit const &unit, Attribute const &attr, unsigned long vaddr,
+                              unsigned char const *&expr, size_t &len) const
+{
+  switch (attr.form)
+  {
+  case DW_FORM_exprloc: case DW_FORM_block: case DW_FORM_block1: case DW_FORM_block2: case DW_FORM_block4:
+    expr = attr.block;
+    len = attr.value;
+    return true;
+  case DW_FORM_sec_offset: case DW_FORM_loclistx:
+    break;
+  case DW_FORM_data4: case DW_FORM_data8:
+    if (unit.version < 4)
+      break;      // a location list offset before DWARF 4
+    return false;
+  default:
+    return false;
+  }
+
+  unsigned long base = unit.base;
+  if (unit.version < 5)
+  {
+    Reader reader(loc.data, loc.size, attr.value);
+    unsigned long const select = (unit.addressSize == 4) ? 0xffffffffUL : ~0UL;
+    while (!reader.atEnd())
+    {
+      unsigned long const begin = reader.sized(unit.addressSize);
+      unsigned long const end = reader.sized(unit.addressSize);
+      if (begin == 0 && end == 0)
+        break;
+      if (begin == select)
+      {
+        base = end;
+        continue;
+      }
+      size_t const size = reader.fixed<uint16_t>();
+      if (base + begin <= vaddr && vaddr < base + end)
+      {
+        expr = reader.here();
+        len = size;
+        return true;
+      }
+      reader.pos += size;
+    }
+    return false;
+  }
+
+  unsigned long offset = attr.value;
+  if (attr.form == DW_FORM_loclistx)
+  {
+    Reader table(loclists.data, loclists.size, unit.loclistsBase + offset * unit.offsetSize);
+    offset = unit.loclistsBase + table.sized(unit.offsetSize);
+  }
+  Reader reader(loclists.data, loclists.size, offset);
+  bool found(false);
+  while (!reader.atEnd())
+  {
+    unsigned long begin(0), end(0);
+    bool isDefault(false);
+    switch (reader.fixed<uint8_t>())
+    {
+    case DW_LLE_end_of_list:
+      return found;
+    case DW_LLE_base_addressx:
+      base = indexedAddress(unit, reader.uleb());
+      continue;
+    case DW_LLE_startx_endx:
+      begin = indexedAddress(unit, reader.uleb());
+      end = indexedAddress(unit, reader.uleb());
+      break;
+    case DW_LLE_startx_length:
+      begin = indexedAddress(unit, reader.uleb());
+      end = begin + reader.uleb();
+      break;
+    case DW_LLE_offset_pair:
+      begin = base + reader.uleb();
+      end = base + reader.uleb();
+      break;
+    case DW_LLE_default_location:
+      isDefault = true;
+      break;
+    case DW_LLE_base_address:
+      base = reader.sized(unit.addressSize);
+      continue;
+    case DW_LLE_start_end:
+      begin = reader.sized(unit.addressSize);
+      end = reader.sized(unit.addressSize);
+      break;
+    case DW_LLE_start_length:
+      begin = reader.sized(unit.addressSize);
+      end = begin + reader.uleb();
+      break;
+    default:
+      return found;
+    }
+    size_t const size = reader.uleb();
+    if ((begin <= vaddr && vaddr < end) || (isDefault && !found))
+    {
+      expr = reader.here();
+      len = size;
+      found = true;
+      if (!isDefault)
+        return true;
+    }
+    reader.pos += size;
+  }
+  return found;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ElfDebugInfo::evaluate(Unit const &unit, unsigned char const *expr, size_t len, StackFrame const &frame,
+                            RemoteMemory &memory, unsigned long bias, Location const *frameBase,
+                            Location &result) const
+{
+  result.kind = Location::Memory;
+  result.value = 0;
+  result.bytes.clear();
+  result.where.clear();
+
+  ValueStack stack;
+  Location piece;
+  piece.kind = Location::Memory;
+  bool pieces(false);
+  int ops(0);
+  Reader reader(expr, len);
+  while (!reader.atEnd())
+  {
+    unsigned char const op = reader.fixed<uint8_t>();
+    ++ops;
+    if (op >= DW_OP_lit0 && op <= DW_OP_lit31)
+    {
+      stack.push(op - DW_OP_lit0);
+      continue;
+    }
+    if (op >= DW_OP_reg0 && op <= DW_OP_reg31)
+    {
+      piece.kind = Location::Register;
+      piece.value = op - DW_OP_reg0;
+      continue;
+    }
+    if (op >= DW_OP_breg0 && op <= DW_OP_breg31)
+    {
+      long const offset = reader.sleb();
+      stack.push(registerValue(frame, op - DW_OP_breg0) + offset);
+      piece.where = relative(registerName(op - DW_OP_breg0), offset);
+      continue;
+    }
+    unsigned long value(0);
+    switch (op)
+    {
+    case DW_OP_addr:
+      stack.push(reader.sized(unit.addressSize) + bias);
+      break;
+    case DW_OP_addrx: case DW_OP_GNU_addr_index:
+      stack.push(indexedAddress(unit, reader.uleb()) + bias);
+      break;
+    case DW_OP_constx: case DW_OP_GNU_const_index:
+      stack.push(indexedAddress(unit, reader.uleb()));
+      break;
+    case DW_OP_deref:
+    case DW_OP_deref_size:
+    {
+      size_t const size = (op == DW_OP_deref) ? sizeof(value) : reader.fixed<uint8_t>();
+      unsigned long const where = stack.pop();
+      if (size > sizeof(value) || !memory.read(where, &value, size))
+      {
+        std::ostringstream oss;
+        oss << "cannot read memory at 0x" << std::hex << where;
+        throw std::runtime_error(oss.str());
+      }
+      stack.push(value);
+      break;
+    }
+    case DW_OP_const1u: stack.push(reader.fixed<uint8_t>()); break;
+    case DW_OP_const1s: stack.push(reader.fixed<int8_t>()); break;
+    case DW_OP_const2u: stack.push(reader.fixed<uint16_t>()); break;
+    case DW_OP_const2s: stack.push(reader.fixed<int16_t>()); break;
+    case DW_OP_const4u: stack.push(reader.fixed<uint32_t>()); break;
+    case DW_OP_const4s: stack.push(reader.fixed<int32_t>()); break;
+    case DW_OP_const8u: stack.push(reader.fixed<uint64_t>()); break;
+    case DW_OP_const8s: stack.push(reader.fixed<int64_t>()); break;
+    case DW_OP_constu: stack.push(reader.uleb()); break;
+    case DW_OP_consts: stack.push(reader.sleb()); break;
+    case DW_OP_dup: stack.push(stack.top()); break;
+    case DW_OP_drop: stack.pop(); break;
+    case DW_OP_over: stack.push(stack.pick(1)); break;
+    case DW_OP_pick: stack.push(stack.pick(reader.fixed<uint8_t>())); break;
+    case DW_OP_swap: std::swap(stack.pick(0), stack.pick(1)); break;
+    case DW_OP_rot:
+      value = stack.pick(0);
+      stack.pick(0) = stack.pick(1);
+      stack.pick(1) = stack.pick(2);
+      stack.pick(2) = value;
+      break;
+    case DW_OP_abs: if ((long)stack.top() < 0) stack.top() = -stack.top(); break;
+    case DW_OP_neg: stack.top() = -stack.top(); break;
+    case DW_OP_not: stack.top() = ~stack.top(); break;
+    case DW_OP_plus_uconst: stack.top() += reader.uleb(); break;
+    case DW_OP_and: value = stack.pop(); stack.top() &= value; break;
+    case DW_OP_or: value = stack.pop(); stack.top() |= value; break;
+    case DW_OP_xor: value = stack.pop(); stack.top() ^= value; break;
+    case DW_OP_plus: value = stack.pop(); stack.top() += value; break;
+    case DW_OP_minus: value = stack.pop(); stack.top() -= value; break;
+    case DW_OP_mul: value = stack.pop(); stack.top() *= value; break;
+    case DW_OP_shl: value = stack.pop(); stack.top() <<= value; break;
+    case DW_OP_shr: value = stack.pop(); stack.top() >>= value; break;
+    case DW_OP_shra: value = stack.pop(); stack.top() = (long)stack.top() >> value; break;
+    case DW_OP_div:
+    case DW_OP_mod:
+      value = stack.pop();
+      if (value == 0)
+        throw std::runtime_error("division by zero in DWARF expression");
+      if (op == DW_OP_div)
+        stack.top() = (long)stack.top() / (long)value;
+      else
+        stack.top() %= value;
+      break;
+    case DW_OP_eq: value = stack.pop(); stack.top() = (long)stack.top() == (long)value; break;
+    case DW_OP_ge: value = stack.pop(); stack.top() = (long)stack.top() >= (long)value; break;
+    case DW_OP_gt: value = stack.pop(); stack.top() = (long)stack.top() > (long)value; break;
+    case DW_OP_le: value = stack.pop(); stack.top() = (long)stack.top() <= (long)value; break;
+    case DW_OP_lt: value = stack.pop(); stack.top() = (long)stack.top() < (long)value; break;
+    case DW_OP_ne: value = stack.pop(); stack.top() = (long)stack.top() != (long)value; break;
+    case DW_OP_skip:
+      reader.pos += reader.fixed<int16_t>();
+      break;
+    case DW_OP_bra:
+    {
+      int16_t const offset = reader.fixed<int16_t>();
+      if (stack.pop() != 0)
+        reader.pos += offset;
+      break;
+    }
+    case DW_OP_regx:
+      piece.kind = Location::Register;
+      piece.value = reader.uleb();
+      break;
+    case DW_OP_bregx:
+    {
+      unsigned long const reg = reader.uleb();
+      long const offset = reader.sleb();
+      stack.push(registerValue(frame, reg) + offset);
+      piece.where = relative(registerName(reg), offset);
+      break;
+    }
+    case DW_OP_fbreg:
+    {
+      long const offset = reader.sleb();
+      if (!frameBase)
+        throw std::runtime_error("the frame base is not known");
+      stack.push(frameBase->value + offset);
+      piece.where = relative(frameBase->where, offset);
+      break;
+    }
+    case DW_OP_call_frame_cfa:
+      if (!frame.cfa)
+        throw std::runtime_error("the frame address is not known");
+      stack.push(frame.cfa);
+      piece.where = "cfa";
+      break;
+    case DW_OP_implicit_value:
+      value = reader.uleb();
+      piece.kind = Location::Bytes;
+      piece.bytes.assign(reader.here(), reader.here() + std::min<size_t>(value, len - std::min(reader.pos, len)));
+      reader.pos += value;
+      break;
+    case DW_OP_stack_value:
+      piece.kind = Location::Value;
+      break;
+    case DW_OP_nop:
+      break;
+    case DW_OP_piece:
+    {
+      size_t const size = reader.uleb();
+      if (piece.kind == Location::Memory && stack.empty())
+      {
+        // An empty piece: that part of the variable is optimized out
+        throw std::runtime_error("partly optimized out");
+      }
+      if (piece.kind == Location::Memory || piece.kind == Location::Value)
+        piece.value = stack.top();
+      read(piece, size, frame, memory, result.bytes);
+      piece = Location();
+      piece.kind = Location::Memory;
+      stack.clear();
+      pieces = true;
+      break;
+    }
+    case DW_OP_entry_value: case DW_OP_GNU_entry_value:
+      throw std::runtime_error("value on entry");
+    case DW_OP_implicit_pointer: case DW_OP_GNU_implicit_pointer:
+      throw std::runtime_error("implicit pointer");
+    case DW_OP_form_tls_address: case DW_OP_GNU_push_tls_address:
+      throw std::runtime_error("thread local");
+    default:
+    {
+      std::ostringstream oss;
+      oss << "unsupported DWARF operation 0x" << std::hex << (int)op;
+      throw std::runtime_error(oss.str());
+    }
+    }
+  }
+
+  if (pieces)
+  {
+    result.kind = Location::Bytes;
+    return;
+  }
+  result.kind = piece.kind;
+  switch (piece.kind)
+  {
+  case Location::Memory:
+    if (stack.empty())
+    {
+      result.kind = Location::OptimizedOut;
+      return;
+    }
+    result.value = stack.top();
+    if (ops == 1 && !piece.where.empty())
+    {
+      result.where = piece.where;
+    }
+    else
+    {
+      std::ostringstream oss;
+      oss << "[0x" << std::hex << result.value << ']';
+      result.where = oss.str();
+    }
+    break;
+  case Location::Register:
+    result.value = piece.value;
+    result.where = "(" + registerName(piece.value) + ")";
+    break;
+  case Location::Value:
+    result.value = stack.top();
+    break;
+  case Location::Bytes:
+    result.bytes = piece.bytes;
+    break;
+  default:
+    break;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ElfDebugInfo::read(Location const &location, size_t len, StackFrame const &frame, RemoteMemory &memory,
+                        std::vector<unsigned char> &out) const
+{
+  size_t const start = out.size();
+  out.resize(start + len);
+  unsigned long value(0);
+  switch (location.kind)
+  {
+  case Location::Memory:
+    if (!memory.read(location.value, &out[start], len))
+    {
+      std::ostringstream oss;
+      oss << "cannot read memory at 0x" << std::hex << location.value;
+      throw std::runtime_error(oss.str());
+    }
+    return;
+  case Location::Register:
+    value = registerValue(frame, location.value);
+    break;
+  case Location::Value:
+    value = location.value;
+    break;
+  case Location::Bytes:
+    memcpy(&out[start], location.bytes.data(), std::min(len, location.bytes.size()));
+    return;
+  default:
+    throw std::runtime_error("optimized out");
+  }
+  memcpy(&out[start], &value, std::min(len, sizeof(value)));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+ElfDebugInfo::Die const *ElfDebugInfo::resolve(size_t offset, Unit const *&where) const
+{
+  Die const *type = die(offset, where);
+  for (int hops = 0; type && hops != 16; ++hops)
+  {
+    switch (type->tag)
+    {
+    case DW_TAG_typedef: case DW_TAG_const_type: case DW_TAG_volatile_type:
+    case DW_TAG_restrict_type: case DW_TAG_atomic_type:
+      if (!type->type.form)
+        return 0;    // eg const void
+      type = die(reference(type->type), where);
+      break;
+    default:
+      return type;
+    }
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+std::string ElfDebugInfo::typeName(size_t offset, int depth) const
+{
+  Unit const *where(0);
+  Die const *type = die(offset, where);
+  if (!type || depth > 16)
+  {
+    return "?";
+  }
+  std::string const target = type->type.form ? typeName(reference(type->type), depth + 1) : "void";
+  switch (type->tag)
+  {
+  case DW_TAG_base_type: case DW_TAG_structure_type: case DW_TAG_class_type: case DW_TAG_union_type:
+  case DW_TAG_enumeration_type: case DW_TAG_typedef: case DW_TAG_unspecified_type:
+  {
+    std::string const name = string(*where, type->name);
+    return name.empty() ? "<anonymous>" : name;
+  }
+  case DW_TAG_pointer_type:
+    return target + (target[target.size() - 1] == '*' ? "*" : " *");
+  case DW_TAG_reference_type:
+    return target + " &";
+  case DW_TAG_rvalue_reference_type:
+    return target + " &&";
+  case DW_TAG_ptr_to_member_type:
+    return target + " ::*";
+  case DW_TAG_const_type:
+    return target + " const";
+  case DW_TAG_volatile_type:
+    return target + " volatile";
+  case DW_TAG_restrict_type:
+  case DW_TAG_atomic_type:
+    return target;
+  case DW_TAG_subroutine_type:
+    return "<function>";
+  case DW_TAG_array_type:
+  {
+    std::ostringstream oss;
+    oss << target << ' ';
+    int const self = type - &where->dies[0];
+    for (size_t idx = self + 1; idx < where->dies.size() && where->dies[idx].depth > type->depth; ++idx)
+    {
+      Die const &dim = where->dies[idx];
+      if (dim.parent != self || dim.tag != DW_TAG_subrange_type)
+        continue;
+      oss << '[';
+      if (dim.count.form)
+        oss << dim.count.value;
+      oss << ']';
+    }
+    return oss.str();
+  }
+  }
+  return "?";
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+unsigned long ElfDebugInfo::typeSize(size_t offset) const
+{
+  Unit const *where(0);
+  Die const *type = resolve(offset, where);
+  if (!type)
+  {
+    return 0;
+  }
+  if (type->byteSize.form)
+  {
+    return type->byteSize.value;
+  }
+  switch (type->tag)
+  {
+  case DW_TAG_pointer_type: case DW_TAG_reference_type: case DW_TAG_rvalue_reference_type:
+  case DW_TAG_ptr_to_member_type:
+    return where->addressSize;
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+std::string ElfDebugInfo::format(size_t offset, std::vector<unsigned char> const &bytes, RemoteMemory &memory) const
+{
+  std::ostringstream oss;
+  unsigned long raw(0);
+  memcpy(&raw, bytes.data(), std::min(bytes.size(), sizeof(raw)));
+  size_t const size = bytes.size();
+  // Sign extend a value of fewer than eight bytes
+  long const value = (size != 0 && size < sizeof(raw)) ? (long)(raw << (64 - 8 * size)) >> (64 - 8 * size) : (long)raw;
+
+  Unit const *where(0);
+  Die const *type = resolve(offset, where);
+  if (!type)
+  {
+    oss << "0x" << std::hex << raw;
+    return oss.str();
+  }
+  switch (type->tag)
+  {
+  case DW_TAG_base_type:
+    switch (type->encoding.value)
+    {
+    case DW_ATE_boolean:
+      oss << (raw ? "true" : "false");
+      break;
+    case DW_ATE_float:
+      if (size == sizeof(float))
+      {
+        float data;
+        memcpy(&data, bytes.data(), sizeof(data));
+        oss << data;
+      }
+      else if (size == sizeof(double))
+      {
+        double data;
+        memcpy(&data, bytes.data(), sizeof(data));
+        oss << data;
+      }
+      else if (size == sizeof(long double))
+      {
+        long double data;
+        memcpy(&data, bytes.data(), sizeof(data));
+        oss << data;
+      }
+      else
+      {
+        oss << "0x" << std::hex << raw;
+      }
+      break;
+    case DW_ATE_signed:
+      oss << value;
+      break;
+    case DW_ATE_signed_char:
+    case DW_ATE_unsigned_char:
+    {
+      long const number = (type->encoding.value == DW_ATE_signed_char) ? value : (long)raw;
+      oss << number;
+      if (size == 1 && isprint((unsigned char)raw))
+        oss << " '" << (char)raw << '\'';
+      break;
+    }
+    case DW_ATE_unsigned:
+    case DW_ATE_UTF:
+      oss << raw;
+      break;
+    default:
+      oss << "0x" << std::hex << raw;
+      break;
+    }
+    break;
+
+  case DW_TAG_enumeration_type:
+  {
+    int const self = type - &where->dies[0];
+    for (size_t idx = self + 1; idx < where->dies.size() && where->dies[idx].depth > type->depth; ++idx)
+    {
+      Die const &item = where->dies[idx];
+      if (item.parent == self && item.tag == DW_TAG_enumerator && (long)item.constValue.value == value)
+      {
+        return string(*where, item.name);
+      }
+    }
+    oss << value;
+    break;
+  }
+
+  case DW_TAG_pointer_type:
+  {
+    oss << "0x" << std::hex << raw;
+    Unit const *targetUnit(0);
+    Die const *target = type->type.form ? resolve(reference(type->type), targetUnit) : 0;
+    if (raw && target && target->tag == DW_TAG_base_type && target->byteSize.value == 1 &&
+        (target->encoding.value == DW_ATE_signed_char || target->encoding.value == DW_ATE_unsigned_char))
+    {
+      std::string text;
+      char ch;
+      while (text.size() != MaxString && memory.read(raw + text.size(), ch) && ch)
+      {
+        text += ch;
+      }
+      oss << " \"";
+      for (size_t idx = 0; idx != text.size(); ++idx)
+      {
+        unsigned char const uch = text[idx];
+        if (uch == '"' || uch == '\\')
+          oss << '\\' << uch;
+        else if (isprint(uch))
+          oss << uch;
+        else
+          oss << "\\x" << std::setw(2) << std::setfill('0') << (int)uch;
+      }
+      oss << (text.size() == MaxString ? "\"..." : "\"");
+    }
+    break;
+  }
+
+  default:
+    oss << "0x" << std::hex << raw;
+    break;
+  }
+  return oss.str();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool ElfDebugInfo::inScope(Unit const &unit, int idx, int function, unsigned long vaddr) const
+{
+  for (int parent = unit.dies[idx].parent; parent != function; parent = unit.dies[parent].parent)
+  {
+    Die const &scope = unit.dies[parent];
+    if (parent == -1 || scope.tag != DW_TAG_lexical_block)
+      return false;   // eg an inlined subroutine, or a parameter of a function type
+    if ((scope.lowPc.form || scope.ranges.form) && !contains(unit, scope, vaddr))
+      return false;
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ElfDebugInfo::showVariable(std::ostream &os, Unit const &unit, int idx, unsigned long vaddr,
+                                StackFrame const &frame, RemoteMemory &memory, unsigned long bias,
+                                Location const *frameBase) const
+{
+  Die const &variable = unit.dies[idx];
+  Unit const *nameUnit(&unit), *typeUnit(&unit), *constUnit(&unit);
+  Die const *named = withAttribute(nameUnit, &variable, &Die::name);
+  Die const *typed = withAttribute(typeUnit, &variable, &Die::type);
+  Die const *constant = withAttribute(constUnit, &variable, &Die::constValue);
+  size_t const type = typed ? reference(typed->type) : (size_t)-1;
+
+  os << "    " << typeName(type) << ' ' << (named ? string(*nameUnit, named->name) : std::string("?"));
+  try
+  {
+    unsigned char const *expr(0);
+    size_t len(0);
+    std::vector<unsigned char> bytes;
+    if (!variable.location.form && constant)
+    {
+      Attribute const &value = constant->constValue;
+      if (value.block)
+        bytes.assign(value.block, value.block + value.value);
+      else
+        bytes.assign((unsigned char const *)&value.value, (unsigned char const *)&value.value + sizeof(value.value));
+      bytes.resize(std::min<size_t>(bytes.size(), std::max<unsigned long>(typeSize(type), 1)));
+      os << " = " << format(type, bytes, memory) << '\n';
+      return;
+    }
+    if (!variable.location.form || !expression(unit, variable.location, vaddr, expr, len))
+    {
+      os << " = <optimized out>\n";
+      return;
+    }
+
+    Location location;
+    evaluate(unit, expr, len, frame, memory, bias, frameBase, location);
+    if (location.kind == Location::OptimizedOut)
+    {
+      os << " = <optimized out>\n";
+      return;
+    }
+    if (!location.where.empty())
+    {
+      os << ' ' << location.where;
+    }
+    Unit const *where(0);
+    Die const *resolved = resolve(type, where);
+    unsigned long const size = typeSize(type);
+    if (resolved && (resolved->tag == DW_TAG_structure_type || resolved->tag == DW_TAG_class_type ||
+                     resolved->tag == DW_TAG_union_type || resolved->tag == DW_TAG_array_type))
+    {
+      os << " = {...}\n";
+      return;
+    }
+    read(location, (size == 0 || size > 16) ? sizeof(long) : size, frame, memory, bytes);
+    os << " = " << format(type, bytes, memory) << '\n';
+  }
+  catch (std::exception &ex)
+  {
+    os << " = <" << ex.what() << ">\n";
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool ElfDebugInfo::showVariables(std::ostream &os, unsigned long vaddr, StackFrame const &frame,
+                                 RemoteMemory &memory, unsigned long bias) const
+{
+  Unit const *const unit = unitAt(vaddr);
+  if (!unit)
+  {
+    return false;
+  }
+
+  // The innermost function: nested ones follow their parent
+  int function(-1);
+  for (size_t idx = 0; idx != unit->dies.size(); ++idx)
+  {
+    Die const &die = unit->dies[idx];
+    if (die.tag == DW_TAG_subprogram && (die.lowPc.form || die.ranges.form) && contains(*unit, die, vaddr))
+      function = idx;
+  }
+  if (function == -1)
+  {
+    return false;
+  }
+  Die const &subprogram = unit->dies[function];
+
+  Location base;
+  Location const *frameBase(0);
+  unsigned char const *expr(0);
+  size_t len(0);
+  if (subprogram.frameBase.form && expression(*unit, subprogram.frameBase, vaddr, expr, len))
+  {
+    try
+    {
+      evaluate(*unit, expr, len, frame, memory, 0, 0, base);
+      if (base.kind == Location::Register)
+      {
+        base.where = registerName(base.value);
+        base.value = registerValue(frame, base.value);
+        base.kind = Location::Memory;
+      }
+      else if (base.where != "cfa")
+      {
+        base.where = "frame";
+      }
+      if (base.kind == Location::Memory)
+        frameBase = &base;
+    }
+    catch (std::exception &)
+    {
+      // Variables relative to the frame base will be unavailable
+    }
+  }
+
+  // Inlined code has the frame base of the function it is inlined
+  // into, and its variables are below its DW_TAG_inlined_subroutine
+  std::vector<int> scopes;
+  inlineChain(*unit, vaddr, scopes);
+  scopes.push_back(function);
+  for (size_t scope = 0; scope != scopes.size(); ++scope)
+  {
+    int const owner = scopes[scope];
+    if (owner != function)
+    {
+      InlineFrame const call = inlineFrame(*unit, owner);
+      os << "  -- inline frame --  " << call.function;
+      if (!call.file.empty())
+        os << "  called at " << call.file << ':' << call.line;
+      os << '\n';
+    }
+    else if (scopes.size() != 1)
+    {
+      os << "  -- inlined into --  " << qualifiedName(unit, &subprogram) << '\n';
+    }
+    for (size_t idx = owner + 1; idx < unit->dies.size() && unit->dies[idx].depth > unit->dies[owner].depth; ++idx)
+    {
+      Die const &die = unit->dies[idx];
+      if ((die.tag == DW_TAG_formal_parameter || die.tag == DW_TAG_variable) && inScope(*unit, idx, owner, vaddr))
+      {
+        showVariable(os, *unit, idx, vaddr, frame, memory, bias, frameBase);
+      }
+    }
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// The tree is implicit in the sorted array: the root of the subtree of
+// elements 'begin' to 'end' is the middle one, and maxEnd of the root
+// is the largest end of any range in its subtree
+void ElfDebugInfo::indexInlines(Unit const &unit) const
+{
+  if (unit.inlinesIndexed)
+  {
+    return;
+  }
+  unit.inlinesIndexed = true;
+  std::vector<std::pair<unsigned long, unsigned long> > pcs;
+  for (size_t idx = 0; idx != unit.dies.size(); ++idx)
+  {
+    if (unit.dies[idx].tag != DW_TAG_inlined_subroutine)
+      continue;
+    pcs.clear();
+    ranges(unit, unit.dies[idx], pcs);
+    for (size_t pc = 0; pc != pcs.size(); ++pc)
+    {
+      if (pcs[pc].first < pcs[pc].second)
+      {
+        Inline const range = { pcs[pc].first, pcs[pc].second, (int)idx };
+        unit.inlines.push_back(range);
+      }
+    }
+  }
+  std::sort(unit.inlines.begin(), unit.inlines.end(),
+            [](Inline const &lhs, Inline const &rhs) { return lhs.begin < rhs.begin; });
+  unit.maxEnd.resize(unit.inlines.size());
+
+  struct Build
+  {
+    static unsigned long subtree(Unit const &unit, size_t begin, size_t end)
+    {
+      if (begin == end)
+        return 0;
+      size_t const mid = begin + (end - begin) / 2;
+      unit.maxEnd[mid] = std::max(unit.inlines[mid].end,
+                                  std::max(subtree(unit, begin, mid), subtree(unit, mid + 1, end)));
+      return unit.maxEnd[mid];
+    }
+  };
+  Build::subtree(unit, 0, unit.inlines.size());
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ElfDebugInfo::findInlines(Unit const &unit, size_t begin, size_t end, unsigned long vaddr,
+                               std::vector<int> &out) const
+{
+  while (begin != end)
+  {
+    size_t const mid = begin + (end - begin) / 2;
+    if (unit.maxEnd[mid] <= vaddr)
+      return;   // nothing in this subtree reaches 'vaddr'
+    findInlines(unit, begin, mid, vaddr, out);
+    if (vaddr < unit.inlines[mid].begin)
+      return;   // nor does anything to the right start early enough
+    if (vaddr < unit.inlines[mid].end)
+      out.push_back(unit.inlines[mid].die);
+    begin = mid + 1;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// DWARF 2 to 4 list the directories and files as strings, numbering the
+// files from 1; DWARF 5 describes the fields of each entry, with the
+// primary source file as number 0
+void ElfDebugInfo::readFiles(Unit const &unit) const
+{
+  if (unit.lineOffset >= line.size)
+  {
+    return;
+  }
+  Reader reader(line.data, line.size, unit.lineOffset);
+  unsigned long length = reader.fixed<uint32_t>();
+  int offsetSize(4);
+  if (length == 0xffffffff)
+  {
+    length = reader.fixed<uint64_t>();
+    offsetSize = 8;
+  }
+  if (reader.pos > line.size || length > line.size - reader.pos)
+  {
+    return;
+  }
+  Reader header(line.data, reader.pos + length, reader.pos);
+  int const version = header.fixed<uint16_t>();
+  if (version < 2 || version > 5)
+  {
+    return;
+  }
+  if (version >= 5)
+  {
+    header.pos += 2;     // address and segment selector sizes
+  }
+  header.sized(offsetSize);   // header length
+  header.pos += (version >= 4) ? 5 : 4;
+  int const opcodeBase = header.fixed<uint8_t>();
+  header.pos += opcodeBase - 1;
+
+  std::vector<std::string> directories;
+  if (version < 5)
+  {
+    directories.push_back(std::string());
+    while (!header.atEnd() && *header.here())
+    {
+      char const *const text = reinterpret_cast<char const *>(header.here());
+      directories.push_back(text);
+      header.pos += directories.back().size() + 1;
+    }
+    ++header.pos;
+    unit.files.push_back(std::string());
+    while (!header.atEnd() && *header.here())
+    {
+      std::string const name = reinterpret_cast<char const *>(header.here());
+      header.pos += name.size() + 1;
+      unsigned long const dir = header.uleb();
+      header.uleb();   // modification time
+      header.uleb();   // length
+      unit.files.push_back((name[0] == '/' || dir == 0 || dir >= directories.size())
+                           ? name : directories[dir] + '/' + name);
+    }
+    return;
+  }
+
+  for (int table = 0; table != 2; ++table)
+  {
+    std::vector<std::pair<unsigned long, unsigned long> > formats;
+    for (int count = header.fixed<uint8_t>(); count > 0; --count)
+    {
+      unsigned long const type = header.uleb();
+      formats.push_back(std::make_pair(type, header.uleb()));
+    }
+    for (unsigned long count = header.uleb(); count != 0 && !header.atEnd(); --count)
+    {
+      std::string name;
+      unsigned long dir(0);
+      for (size_t field = 0; field != formats.size(); ++field)
+      {
+        Attribute value = { (unsigned int)formats[field].second, 0, 0 };
+        switch (formats[field].second)
+        {
+        case DW_FORM_string:
+          value.block = header.here();
+          value.value = strnlen(reinterpret_cast<char const *>(value.block), line.size - header.pos);
+          header.pos += value.value + 1;
+          break;
+        case DW_FORM_line_strp: case DW_FORM_strp:
+          value.value = header.sized(offsetSize);
+          break;
+        case DW_FORM_strx: case DW_FORM_udata:
+          value.value = header.uleb();
+          break;
+        case DW_FORM_data1: case DW_FORM_strx1: value.value = header.fixed<uint8_t>(); break;
+        case DW_FORM_data2: case DW_FORM_strx2: value.value = header.fixed<uint16_t>(); break;
+        case DW_FORM_data4: case DW_FORM_strx4: value.value = header.fixed<uint32_t>(); break;
+        case DW_FORM_data8: value.value = header.fixed<uint64_t>(); break;
+        case DW_FORM_data16: header.pos += 16; break;
+        case DW_FORM_block: header.pos += header.uleb(); break;
+        default:
+          return;   // cannot skip an unknown form
+        }
+        if (formats[field].first == DW_LNCT_path)
+          name = string(unit, value);
+        else if (formats[field].first == DW_LNCT_directory_index)
+          dir = value.value;
+      }
+      if (table == 0)
+        directories.push_back(name);
+      else
+        unit.files.push_back((name.empty() || name[0] == '/' || dir >= directories.size())
+                             ? name : directories[dir] + '/' + name);
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+std::string ElfDebugInfo::qualifiedName(Unit const *where, Die const *die) const
+{
+  Die const *named = withAttribute(where, die, &Die::name);
+  if (!named)
+  {
+    return "?";
+  }
+  std::string name = string(*where, named->name);
+  // The declaration, not the out-of-line definition, is within its scopes
+  for (int parent = named->parent; parent != -1; parent = where->dies[parent].parent)
+  {
+    Die const &scope = where->dies[parent];
+    if (scope.tag != DW_TAG_namespace && scope.tag != DW_TAG_structure_type &&
+        scope.tag != DW_TAG_class_type && scope.tag != DW_TAG_union_type)
+      break;
+    std::string const outer = string(*where, scope.name);
+    name = (outer.empty() ? std::string("(anonymous namespace)") : outer) + "::" + name;
+  }
+  return name;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool ElfDebugInfo::inlinedAt(unsigned long vaddr, std::vector<InlineFrame> &frames) const
+{
+  frames.clear();
+  Unit const *const unit = unitAt(vaddr);
+  if (!unit)
+  {
+    return false;
+  }
+  std::vector<int> found;
+  inlineChain(*unit, vaddr, found);
+  for (size_t idx = 0; idx != found.size(); ++idx)
+  {
+    frames.push_back(inlineFrame(*unit, found[idx]));
+  }
+  return !frames.empty();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ElfDebugInfo::inlineChain(Unit const &unit, unsigned long vaddr, std::vector<int> &out) const
+{
+  indexInlines(unit);
+  findInlines(unit, 0, unit.inlines.size(), vaddr, out);
+  // Nested calls are deeper in the tree of DIEs
+  std::sort(out.begin(), out.end(),
+            [&unit](int lhs, int rhs) { return unit.dies[lhs].depth > unit.dies[rhs].depth; });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+ElfDebugInfo::InlineFrame ElfDebugInfo::inlineFrame(Unit const &unit, int die) const
+{
+  if (unit.files.empty())
+  {
+    readFiles(unit);
+    if (unit.files.empty())
+      unit.files.push_back(std::string());   // so it is only tried once
+  }
+  Die const &call = unit.dies[die];
+  InlineFrame frame;
+  frame.function = qualifiedName(&unit, &call);
+  frame.file = (call.callFile.value < unit.files.size()) ? unit.files[call.callFile.value] : std::string();
+  frame.line = call.callLine.value;
+  return frame;
+}
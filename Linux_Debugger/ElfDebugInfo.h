@@ -0,0 +1,267 @@
+#ifndef ELF_DEBUG_INFO_H
+#define ELF_DEBUG_INFO_H
+
+/**@file
+
+  Parameters and local variables from the DWARF debug information of ELF files
+
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include <stddef.h>
+
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class RemoteMemory;
+struct StackFrame;
+
+/** The DWARF debug information (.debug_info and friends) of one ELF file.
+ * The file is mapped rather than read, and a compilation unit is only
+ * parsed when an address in it is looked up, so a large file costs
+ * little more than a small one. */
+class ElfDebugInfo
+{
+public:
+  /** Map 'path', or the separate debug file under /usr/lib/debug found
+   * by its build id if 'path' itself has no .debug_info */
+  explicit ElfDebugInfo(std::string const &path);
+
+  ~ElfDebugInfo();
+
+  /** A call inlined at an address */
+  struct InlineFrame
+  {
+    std::string function;      // the function inlined
+    std::string file;          // the source of the call, if known
+    unsigned long line;
+  };
+
+  /** Is there any debug information? */
+  bool empty() const { return info.size == 0; }
+
+  /** Write the parameters and local variables in scope at link-time
+   * address 'vaddr' in 'frame', one per line, as type, name, location
+   * and value. If 'vaddr' is in inlined calls, each of these is named,
+   * innermost first, followed by its own variables, and the function
+   * they were inlined into comes last. 'bias' is the run-time address
+   * of link-time address 0, for static variables. Returns false if
+   * 'vaddr' is not described */
+  bool showVariables(std::ostream &os, unsigned long vaddr, StackFrame const &frame,
+                     RemoteMemory &memory, unsigned long bias) const;
+
+  /** The chain of inlined calls containing link-time address 'vaddr',
+   * innermost first, in 'frames'; false if it is not in an inlined call.
+   * Each unit's inlined calls are indexed when it is first used, so
+   * this is cheap enough to call for every frame of every sample */
+  bool inlinedAt(unsigned long vaddr, std::vector<InlineFrame> &frames) const;
+
+  /** The cached debug information for 'path' */
+  static std::shared_ptr<ElfDebugInfo const> get(std::string const &path);
+
+private:
+  ElfDebugInfo(ElfDebugInfo const &);
+  ElfDebugInfo &operator=(ElfDebugInfo const &);
+
+  /** A section of the mapped file */
+  struct Section
+  {
+    Section() : data(0), size(0) {}
+
+    unsigned char const *data;
+    size_t size;
+  };
+
+  /** The value of one attribute of a DIE, as read: a constant, an
+   * offset or index, or a block of bytes. 'form' is 0 if absent */
+  struct Attribute
+  {
+    unsigned int form;
+    unsigned long value;
+    unsigned char const *block;
+  };
+
+  /** The attributes of a debugging information entry we use */
+  struct Die
+  {
+    size_t offset;             // in .debug_info
+    unsigned int tag;
+    int parent;                // index in the unit, or -1
+    int depth;
+    Attribute name;
+    Attribute type;
+    Attribute origin;          // abstract origin or specification
+    Attribute location;
+    Attribute frameBase;
+    Attribute lowPc;
+    Attribute highPc;
+    Attribute ranges;
+    Attribute byteSize;
+    Attribute encoding;
+    Attribute count;           // count or upper bound + 1 of a subrange
+    Attribute constValue;
+    Attribute callFile;        // of an inlined subroutine
+    Attribute callLine;
+  };
+
+  /** The address range of an inlined subroutine */
+  struct Inline
+  {
+    unsigned long begin;
+    unsigned long end;
+    int die;                   // index in the unit
+  };
+
+  /** A compilation unit */
+  struct Unit
+  {
+    size_t offset;             // of the header in .debug_info
+    size_t end;
+    int version;
+    int addressSize;
+    int offsetSize;            // 4 or 8 for 64-bit DWARF
+    unsigned long base;        // low pc, for location and range lists
+    unsigned long addrBase;
+    unsigned long strOffsetsBase;
+    unsigned long loclistsBase;
+    unsigned long rnglistsBase;
+    unsigned long lineOffset;  // of the line table header, or -1
+    std::vector<Die> dies;     // in .debug_info order
+
+    // Built on first use by inlinedAt
+    mutable bool inlinesIndexed;
+    mutable std::vector<Inline> inlines;       // an interval tree: sorted by begin...
+    mutable std::vector<unsigned long> maxEnd; // ...with the largest end in each subtree
+    mutable std::vector<std::string> files;    // from the line table header
+  };
+
+  /** The address range of (part of) a compilation unit */
+  struct Range
+  {
+    unsigned long begin;
+    unsigned long end;
+    size_t unit;               // offset in .debug_info
+  };
+
+  /** How a variable's value was located */
+  struct Location;
+
+  /** Map the file and find the sections; false if there is no .debug_info */
+  bool open(std::string const &path);
+
+  /** Unmap the file */
+  void close();
+
+  /** Build the index of address ranges, if not yet done */
+  void buildIndex() const;
+
+  /** The parsed unit containing link-time address 'vaddr' (or 0) */
+  Unit const *unitAt(unsigned long vaddr) const;
+
+  /** The parsed unit at 'offset' in .debug_info (or 0) */
+  Unit const *unit(size_t offset) const;
+
+  /** Parse the unit at 'offset'; 'topOnly' to read just its own DIE */
+  bool parse(size_t offset, bool topOnly, Unit &unit) const;
+
+  /** The DIE at 'offset' in .debug_info (or 0), setting 'where' to its unit */
+  Die const *die(size_t offset, Unit const *&where) const;
+
+  /** Follow the abstract origin or specification of 'die' in 'where'
+   * to one with the attribute 'member' (or 0), updating 'where' */
+  Die const *withAttribute(Unit const *&where, Die const *die, Attribute Die::*member) const;
+
+  // Attribute values
+  static size_t reference(Attribute const &attr);
+  std::string string(Unit const &unit, Attribute const &attr) const;
+  unsigned long address(Unit const &unit, Attribute const &attr) const;
+  unsigned long indexedAddress(Unit const &unit, unsigned long index) const;
+  bool contains(Unit const &unit, Die const &die, unsigned long vaddr) const;
+  void ranges(Unit const &unit, Die const &die, std::vector<std::pair<unsigned long, unsigned long> > &out) const;
+
+  /** Index the inlined subroutines of 'unit', if not yet done */
+  void indexInlines(Unit const &unit) const;
+
+  /** Append the inlined subroutines of 'unit' in the subtree 'begin' to 'end'
+   * of its interval tree that contain 'vaddr' */
+  void findInlines(Unit const &unit, size_t begin, size_t end, unsigned long vaddr, std::vector<int> &out) const;
+
+  /** The inlined subroutines of 'unit' containing 'vaddr', innermost first */
+  void inlineChain(Unit const &unit, unsigned long vaddr, std::vector<int> &out) const;
+
+  /** The inlined call at 'die' in 'unit' */
+  InlineFrame inlineFrame(Unit const &unit, int die) const;
+
+  /** Read the file names from the line table header of 'unit' */
+  void readFiles(Unit const &unit) const;
+
+  /** The name of the function of 'die', qualified by its namespaces and classes */
+  std::string qualifiedName(Unit const *where, Die const *die) const;
+
+  /** Is the variable at 'idx' in 'unit' in scope at 'vaddr' in the
+   * function or inlined subroutine at 'function'? */
+  bool inScope(Unit const &unit, int idx, int function, unsigned long vaddr) const;
+
+  /** Write the variable at 'idx' in 'unit' */
+  void showVariable(std::ostream &os, Unit const &unit, int idx, unsigned long vaddr, StackFrame const &frame,
+                    RemoteMemory &memory, unsigned long bias, Location const *frameBase) const;
+
+  /** The location expression of 'attr' in force at 'vaddr'; false if none */
+  bool expression(Unit const &unit, Attribute const &attr, unsigned long vaddr,
+                  unsigned char const *&expr, size_t &len) const;
+
+  /** Evaluate location expression 'expr', throwing std::runtime_error
+   * if it cannot be */
+  void evaluate(Unit const &unit, unsigned char const *expr, size_t len, StackFrame const &frame,
+                RemoteMemory &memory, unsigned long bias, Location const *frameBase,
+                Location &result) const;
+
+  /** Append the first 'len' bytes of the value at 'location' to 'out' */
+  void read(Location const &location, size_t len, StackFrame const &frame, RemoteMemory &memory,
+            std::vector<unsigned char> &out) const;
+
+  /** Describe the type at 'offset' as in a declaration */
+  std::string typeName(size_t offset, int depth = 0) const;
+
+  /** The type at 'offset' without typedefs and qualifiers (or 0) */
+  Die const *resolve(size_t offset, Unit const *&where) const;
+
+  /** The size in bytes of the type at 'offset' */
+  unsigned long typeSize(size_t offset) const;
+
+  /** Format 'bytes' as a value of the type at 'offset' */
+  std::string format(size_t offset, std::vector<unsigned char> const &bytes, RemoteMemory &memory) const;
+
+  void *map;
+  size_t mapSize;
+  Section info, abbrev, str, lineStr, strOffsets, addr, loc, loclists, debugRanges, rnglists, aranges, line;
+
+  mutable bool indexed;
+  mutable std::vector<Range> index;            // sorted by address
+  mutable std::vector<size_t> unitOffsets;     // every unit, in order
+  mutable std::map<size_t, std::shared_ptr<Unit> > units;
+};
+
+#endif // ELF_DEBUG_INFO_H
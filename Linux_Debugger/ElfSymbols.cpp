@@ -0,0 +1,460 @@
+/*
+NAME
+    ElfSymbols
+
+DESCRIPTION
+    Symbols of ELF files, and the modules mapped by a traced process.
+
+    Only the ELF headers, program headers and symbol tables are used:
+    enough to name functions and global data. An address in a
+    position independent module is converted back to its link-time
+    address through the PT_LOAD segment covering its file offset.
+    Only the headers are needed for that, so the symbol tables are not
+    read (or demangled) until a symbol is first looked up.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "ElfSymbols.h"
+#include "TraceUtils.h"
+
+#include <cxxabi.h>
+#include <elf.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+
+namespace
+{
+  /** Demangle a C++ symbol name, leaving others as they are */
+  std::string demangle(char const *name)
+  {
+    int status(0);
+    char *const result = abi::__cxa_demangle(name, 0, 0, &status);
+    if (!result)
+    {
+      return name;
+    }
+    std::string const demangled(result);
+    free(result);
+    return demangled;
+  }
+
+  bool byValue(ElfSymbols::Symbol const &lhs, ElfSymbols::Symbol const &rhs)
+  {
+    return lhs.value < rhs.value;
+  }
+
+  /** Read 'len' bytes at 'offset' in 'ifs' */
+  bool readPart(std::ifstream &ifs, unsigned long offset, unsigned long len, std::vector<char> &data)
+  {
+    data.resize(len);
+    return ifs.seekg(offset) && (len == 0 || ifs.read(&data[0], len));
+  }
+
+  /** Read the whole of file 'path' */
+  bool readFile(std::string const &path, std::vector<char> &data)
+  {
+    std::ifstream ifs(path.c_str(), std::ios::binary);
+    if (!ifs)
+    {
+      return false;
+    }
+    ifs.seekg(0, std::ios::end);
+    data.resize(ifs.tellg());
+    ifs.seekg(0);
+    return ifs.read(&data[0], data.size()).good();
+  }
+
+  template <typename T>
+  T const *at(std::vector<char> const &data, unsigned long offset, unsigned long count = 1)
+  {
+    if (offset > data.size() || count * sizeof(T) > data.size() - offset)
+    {
+      return 0;
+    }
+    return reinterpret_cast<T const *>(&data[offset]);
+  }
+
+  /** Append the functions and objects in the symbol tables of 'type' */
+  void readTable(std::vector<char> const &data, int shnum, Elf64_Shdr const *shdr,
+                 unsigned int type, std::vector<ElfSymbols::Symbol> &table)
+  {
+    for (int idx = 0; idx != shnum; ++idx)
+    {
+      if (shdr[idx].sh_type != type || shdr[idx].sh_link >= (unsigned int)shnum)
+        continue;
+      Elf64_Shdr const &strtab = shdr[shdr[idx].sh_link];
+      unsigned long const count = shdr[idx].sh_size / sizeof(Elf64_Sym);
+      Elf64_Sym const *sym = at<Elf64_Sym>(data, shdr[idx].sh_offset, count);
+      if (!sym || !at<char>(data, strtab.sh_offset, strtab.sh_size))
+        continue;
+      for (unsigned long num = 0; num != count; ++num)
+      {
+        int const symtype = ELF64_ST_TYPE(sym[num].st_info);
+        if ((symtype != STT_FUNC && symtype != STT_OBJECT) ||
+            sym[num].st_shndx == SHN_UNDEF || sym[num].st_value == 0 ||
+            sym[num].st_name >= strtab.sh_size)
+          continue;
+        char const *name = &data[strtab.sh_offset + sym[num].st_name];
+        ElfSymbols::Symbol const symbol = { sym[num].st_value, sym[num].st_size,
+                                            symtype == STT_FUNC, demangle(name) };
+        table.push_back(symbol);
+      }
+    }
+  }
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+ElfSymbols::ElfSymbols(std::string const &path)
+: path(path), loaded(false), dynamic(false)
+{
+  std::ifstream ifs(path.c_str(), std::ios::binary);
+  std::vector<char> header;
+  if (!readPart(ifs, 0, sizeof(Elf64_Ehdr), header))
+  {
+    return;
+  }
+  Elf64_Ehdr const *ehdr = at<Elf64_Ehdr>(header, 0);
+  if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 || ehdr->e_ident[EI_CLASS] != ELFCLASS64)
+  {
+    return;
+  }
+  dynamic = (ehdr->e_type == ET_DYN);
+
+  std::vector<char> data;
+  if (!readPart(ifs, ehdr->e_phoff, ehdr->e_phnum * sizeof(Elf64_Phdr), data))
+  {
+    return;
+  }
+  Elf64_Phdr const *phdr = at<Elf64_Phdr>(data, 0, ehdr->e_phnum);
+  for (int idx = 0; idx != ehdr->e_phnum; ++idx)
+  {
+    if (phdr[idx].p_type == PT_LOAD)
+    {
+      Segment const segment = { phdr[idx].p_offset, phdr[idx].p_vaddr, phdr[idx].p_filesz };
+      segments.push_back(segment);
+    }
+    else if (phdr[idx].p_type == PT_NOTE)
+    {
+      // Look for the NT_GNU_BUILD_ID note
+      std::vector<char> notes;
+      if (!readPart(ifs, phdr[idx].p_offset, phdr[idx].p_filesz, notes))
+        continue;
+      unsigned long offset = 0;
+      while (Elf64_Nhdr const *note = at<Elf64_Nhdr>(notes, offset))
+      {
+        unsigned long const name = offset + sizeof(Elf64_Nhdr);
+        unsigned long const desc = name + ((note->n_namesz + 3) & ~3);
+        unsigned long const next = desc + ((note->n_descsz + 3) & ~3);
+        if (next > notes.size())
+          break;
+        if (note->n_type == NT_GNU_BUILD_ID && note->n_namesz == 4 &&
+            memcmp(&notes[name], "GNU", 4) == 0)
+        {
+          std::ostringstream oss;
+          for (unsigned int byte = 0; byte != note->n_descsz; ++byte)
+          {
+            oss << std::hex << std::setw(2) << std::setfill('0')
+                << (unsigned int)(unsigned char)notes[desc + byte];
+          }
+          build = oss.str();
+        }
+        offset = next;
+      }
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ElfSymbols::load() const
+{
+  if (loaded)
+  {
+    return;
+  }
+  loaded = true;
+  std::vector<char> data;
+  if (!readFile(path, data))
+  {
+    return;
+  }
+  Elf64_Ehdr const *ehdr = at<Elf64_Ehdr>(data, 0);
+  if (!ehdr || memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 ||
+      ehdr->e_ident[EI_CLASS] != ELFCLASS64)
+  {
+    return;
+  }
+  Elf64_Shdr const *shdr = at<Elf64_Shdr>(data, ehdr->e_shoff, ehdr->e_shnum);
+  if (!shdr)
+  {
+    return;
+  }
+  // Prefer the full symbol table; stripped files only have .dynsym
+  readTable(data, ehdr->e_shnum, shdr, SHT_SYMTAB, table);
+  if (table.empty())
+  {
+    readTable(data, ehdr->e_shnum, shdr, SHT_DYNSYM, table);
+  }
+  std::sort(table.begin(), table.end(), byValue);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+std::vector<ElfSymbols::Symbol> const &ElfSymbols::symbols() const
+{
+  load();
+  return table;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// Symbols with no size (eg from assembler) cover up to the next symbol
+ElfSymbols::Symbol const *ElfSymbols::find(unsigned long vaddr) const
+{
+  load();
+  Symbol const key = { vaddr, 0, false, std::string() };
+  std::vector<Symbol>::const_iterator it =
+    std::upper_bound(table.begin(), table.end(), key, byValue);
+  if (it == table.begin())
+  {
+    return 0;
+  }
+  --it;
+  if (vaddr < it->value + it->size)
+  {
+    return &*it;
+  }
+  // Look back through any aliases at the same address for a sized one
+  for (std::vector<Symbol>::const_iterator prev = it; ; --prev)
+  {
+    if (prev->value != it->value)
+      break;
+    if (vaddr < prev->value + prev->size)
+      return &*prev;
+    if (prev == table.begin())
+      break;
+  }
+  return it->size == 0 ? &*it : 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+ElfSymbols::Symbol const *ElfSymbols::find(std::string const &name) const
+{
+  load();
+  // A C++ function also matches its name without the parameter list
+  Symbol const *partial(0);
+  for (std::vector<Symbol>::const_iterator it = table.begin(); it != table.end(); ++it)
+  {
+    if (it->name == name)
+    {
+      return &*it;
+    }
+    if (!partial && it->name.size() > name.size() && it->name[name.size()] == '(' &&
+        it->name.compare(0, name.size(), name) == 0)
+    {
+      partial = &*it;
+    }
+  }
+  return partial;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+long ElfSymbols::fileToVaddr(unsigned long offset) const
+{
+  // Use the last segment starting at or before the page holding 'offset':
+  // bytes past its file size are the zero-filled data (.bss) mapped with it
+  long result(-1);
+  for (size_t idx = 0; idx != segments.size(); ++idx)
+  {
+    Segment const &segment = segments[idx];
+    if ((segment.offset & ~0xfffUL) <= offset)
+    {
+      result = segment.vaddr + (offset - segment.offset);
+    }
+  }
+  return result;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+std::shared_ptr<ElfSymbols const> ElfSymbols::get(std::string const &path)
+{
+  static std::mutex lock;
+  static std::map<std::string, std::shared_ptr<ElfSymbols const> > cache;
+  std::lock_guard<std::mutex> guard(lock);
+  std::shared_ptr<ElfSymbols const> &entry = cache[path];
+  if (!entry)
+  {
+    entry.reset(new ElfSymbols(path));
+  }
+  return entry;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+ProcessModules::ProcessModules(pid_t pid)
+: pid(pid), reads(0)
+{
+  refresh();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ProcessModules::refresh()
+{
+  std::ifstream ifs(procName(pid, "maps").c_str());
+  if (!ifs)
+  {
+    // The process has gone: keep what we had
+    return;
+  }
+  ++reads;
+  mappings.clear();
+  std::string line;
+  while (std::getline(ifs, line))
+  {
+    // start-end perms offset dev inode path
+    std::istringstream iss(line);
+    Module module;
+    char dash;
+    std::string perms, dev;
+    unsigned long inode;
+    iss >> std::hex >> module.start >> dash >> module.end >> perms >> module.offset
+        >> dev >> std::dec >> inode;
+    if (!iss)
+      continue;
+    std::getline(iss >> std::ws, module.path);
+    module.exec = perms.size() > 2 && perms[2] == 'x';
+    if (module.path.empty() && !mappings.empty() && mappings.back().end == module.start &&
+        !mappings.back().path.empty() && mappings.back().path[0] == '/')
+    {
+      // Anonymous memory straight after a file is the rest of its .bss
+      Module const &prev = mappings.back();
+      module.path = prev.path;
+      module.offset = prev.offset + (module.start - prev.start);
+    }
+    mappings.push_back(module);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+ProcessModules::Module const *ProcessModules::find(unsigned long addr) const
+{
+  size_t lo = 0, hi = mappings.size();
+  while (lo < hi)
+  {
+    size_t const mid = (lo + hi) / 2;
+    if (addr < mappings[mid].start)
+      hi = mid;
+    else if (addr >= mappings[mid].end)
+      lo = mid + 1;
+    else
+      return &mappings[mid];
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+long ProcessModules::toVaddr(Module const &module, unsigned long addr) const
+{
+  if (module.path.empty() || module.path[0] != '/')
+  {
+    return -1;
+  }
+  std::shared_ptr<ElfSymbols const> const symbols = ElfSymbols::get(module.path);
+  if (!symbols->relocatable())
+  {
+    return addr;
+  }
+  return symbols->fileToVaddr(module.offset + (addr - module.start));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// Each mapping of a file covers a linear range of link-time addresses
+unsigned long ProcessModules::fromVaddr(std::string const &path, unsigned long vaddr) const
+{
+  for (std::vector<Module>::const_iterator it = mappings.begin(); it != mappings.end(); ++it)
+  {
+    if (it->path != path)
+      continue;
+    long const base = toVaddr(*it, it->start);
+    if (base != -1 && vaddr >= static_cast<unsigned long>(base) &&
+        vaddr - base < it->end - it->start)
+    {
+      return it->start + (vaddr - base);
+    }
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+std::string ProcessModules::describe(unsigned long addr) const
+{
+  std::ostringstream oss;
+  Module const *module = find(addr);
+  if (!module)
+  {
+    oss << "0x" << std::hex << addr;
+    return oss.str();
+  }
+  std::string const base = module->path.substr(module->path.rfind('/') + 1);
+  long const vaddr = toVaddr(*module, addr);
+  if (vaddr != -1)
+  {
+    if (ElfSymbols::Symbol const *symbol = ElfSymbols::get(module->path)->find(vaddr))
+    {
+      oss << symbol->name;
+      if (unsigned long const offset = vaddr - symbol->value)
+        oss << "+0x" << std::hex << offset;
+      oss << " (" << base << ")";
+      return oss.str();
+    }
+  }
+  oss << "0x" << std::hex << addr;
+  if (!base.empty())
+  {
+    oss << " (" << base << ")";
+  }
+  return oss.str();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+std::string ProcessModules::function(unsigned long addr) const
+{
+  std::ostringstream oss;
+  Module const *module = find(addr);
+  if (!module)
+  {
+    oss << "0x" << std::hex << addr;
+    return oss.str();
+  }
+  long const vaddr = toVaddr(*module, addr);
+  if (vaddr != -1)
+  {
+    if (ElfSymbols::Symbol const *symbol = ElfSymbols::get(module->path)->find(vaddr))
+    {
+      return symbol->name;
+    }
+  }
+  if (module->path.empty())
+  {
+    oss << "0x" << std::hex << addr;
+    return oss.str();
+  }
+  return "[" + module->path.substr(module->path.rfind('/') + 1) + "]";
+}
@@ -0,0 +1,149 @@
+#ifndef ELF_SYMBOLS_H
+#define ELF_SYMBOLS_H
+
+/**@file
+
+  Symbols of ELF files, and the modules mapped by a traced process
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include <sys/types.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/** The symbol table of one ELF file (.symtab, or .dynsym if stripped).
+ * The headers are read at once, but the symbols only when first needed,
+ * so mapping addresses to the file costs little while tracing */
+class ElfSymbols
+{
+public:
+  struct Symbol
+  {
+    unsigned long value;   // link-time virtual address
+    unsigned long size;
+    bool function;
+    std::string name;      // demangled
+  };
+
+  /** Read the headers of 'path'; an unreadable file has no symbols */
+  explicit ElfSymbols(std::string const &path);
+
+  /** The symbol containing link-time address 'vaddr' (or 0) */
+  Symbol const *find(unsigned long vaddr) const;
+
+  /** The first symbol called 'name' (or 0) */
+  Symbol const *find(std::string const &name) const;
+
+  /** All the symbols, sorted by address */
+  std::vector<Symbol> const &symbols() const;
+
+  /** Link-time address of the byte at file 'offset', or -1 if not loaded.
+   * Offsets past the end of the file in a data mapping are its .bss */
+  long fileToVaddr(unsigned long offset) const;
+
+  /** Is this a position independent file (ET_DYN)? */
+  bool relocatable() const { return dynamic; }
+
+  /** The GNU build id, in hex (empty if none) */
+  std::string const &buildId() const { return build; }
+
+  /** The cached symbols for 'path'; safe to call from several threads,
+   * though each object must only be used by one thread at a time */
+  static std::shared_ptr<ElfSymbols const> get(std::string const &path);
+
+private:
+  /** A loadable segment */
+  struct Segment
+  {
+    unsigned long offset;
+    unsigned long vaddr;
+    unsigned long filesz;
+  };
+
+  /** Read the symbol tables, if not yet done */
+  void load() const;
+
+  std::string path;
+  mutable bool loaded;
+  mutable std::vector<Symbol> table;
+  std::vector<Segment> segments;
+  bool dynamic;
+  std::string build;
+};
+
+/** The modules mapped into one traced process, from /proc/<pid>/maps.
+ * The mappings are copied so addresses can still be described after
+ * the process has exited; the ELF files themselves are read on demand. */
+class ProcessModules
+{
+public:
+  struct Module
+  {
+    unsigned long start;
+    unsigned long end;
+    unsigned long offset;  // file offset of 'start'
+    bool exec;
+    std::string path;      // file name, or [heap], [stack] etc
+  };
+
+  ProcessModules() : pid(0), reads(0) {}
+
+  /** Read the mappings of process 'pid' */
+  explicit ProcessModules(pid_t pid);
+
+  /** Re-read the mappings, eg after a dlopen or exec */
+  void refresh();
+
+  /** Count of the times the mappings have been read */
+  unsigned long generation() const { return reads; }
+
+  /** The mapping containing 'addr' (or 0) */
+  Module const *find(unsigned long addr) const;
+
+  /** All the mappings, sorted by address */
+  std::vector<Module> const &modules() const { return mappings; }
+
+  /** Describe 'addr' as symbol+offset (module), falling back to
+   * the mapping name or the hex address */
+  std::string describe(unsigned long addr) const;
+
+  /** The name of the function containing 'addr', falling back to
+   * [module] or the hex address; for stack traces */
+  std::string function(unsigned long addr) const;
+
+  /** Link-time address in the module's file of 'addr' (or -1) */
+  long toVaddr(Module const &module, unsigned long addr) const;
+
+  /** Run-time address of link-time address 'vaddr' in the file
+   * 'path', or 0 if that part of the file is not mapped */
+  unsigned long fromVaddr(std::string const &path, unsigned long vaddr) const;
+
+private:
+  pid_t pid;
+  unsigned long reads;
+  std::vector<Module> mappings;
+};
+
+#endif // ELF_SYMBOLS_H
@@ -0,0 +1,402 @@
+/*
+NAME
+    FaultInjector
+
+DESCRIPTION
+    System call latency and fault injection for ProcessTracer.
+
+    Each rule matches system calls by number, by the prefix of their
+    path argument and by the kind of file their fd argument refers to.
+    A matching call is injected with the rule's probability, until the
+    rule's count is used up; the first rule to inject wins.
+
+    A delayed call is held at its entry stop for a time drawn from the
+    rule's distribution: the trace loop keeps the thread stopped and
+    carries on with the others, so only the calling thread waits and
+    the call then runs as normal.
+
+    A failed call is skipped by setting its number (orig_rax) to -1 at
+    entry, and its result (rax) is set to the errno at exit. That result
+    replaces the ENOSYS the kernel reports for a skipped call before any
+    listener's OnCallExit, and in the default call trace, which stays on
+    when injecting.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "FaultInjector.h"
+#include "TraceUtils.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <asm/unistd.h>
+#include <sys/ptrace.h>
+#include <sys/stat.h>
+#include <sys/user.h>
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+  /** Errors which can be given by name */
+  struct ErrorName
+  {
+    char const *name;
+    int value;
+  };
+
+  ErrorName const errorNames[] = {
+    { "EPERM", EPERM }, { "ENOENT", ENOENT }, { "EINTR", EINTR }, { "EIO", EIO },
+    { "EBADF", EBADF }, { "EAGAIN", EAGAIN }, { "ENOMEM", ENOMEM }, { "EACCES", EACCES },
+    { "EBUSY", EBUSY }, { "EEXIST", EEXIST }, { "EINVAL", EINVAL }, { "EMFILE", EMFILE },
+    { "ENFILE", ENFILE }, { "ENOSPC", ENOSPC }, { "EROFS", EROFS }, { "EPIPE", EPIPE },
+    { "EDQUOT", EDQUOT }, { "ENETDOWN", ENETDOWN }, { "ENETUNREACH", ENETUNREACH },
+    { "ECONNABORTED", ECONNABORTED }, { "ECONNRESET", ECONNRESET }, { "ENOBUFS", ENOBUFS },
+    { "ETIMEDOUT", ETIMEDOUT }, { "ECONNREFUSED", ECONNREFUSED }, { "EHOSTUNREACH", EHOSTUNREACH },
+  };
+
+  /** Does 'func' take an fd as its first argument? */
+  bool fdArg(int func)
+  {
+    switch (func)
+    {
+    case __NR_read:
+    case __NR_write:
+    case __NR_pread64:
+    case __NR_pwrite64:
+    case __NR_readv:
+    case __NR_writev:
+    case __NR_preadv:
+    case __NR_pwritev:
+    case __NR_preadv2:
+    case __NR_pwritev2:
+    case __NR_sendto:
+    case __NR_recvfrom:
+    case __NR_sendmsg:
+    case __NR_recvmsg:
+    case __NR_sendmmsg:
+    case __NR_recvmmsg:
+    case __NR_connect:
+    case __NR_accept:
+    case __NR_accept4:
+    case __NR_bind:
+    case __NR_listen:
+    case __NR_shutdown:
+    case __NR_fsync:
+    case __NR_fdatasync:
+    case __NR_fstat:
+    case __NR_lseek:
+    case __NR_ftruncate:
+    case __NR_getdents64:
+    case __NR_ioctl:
+    case __NR_fcntl:
+    case __NR_flock:
+    case __NR_close:
+    case __NR_sendfile:
+    case __NR_splice:
+    case __NR_epoll_wait:
+    case __NR_epoll_pwait:
+      return true;
+    }
+    return false;
+  }
+
+  /** The kind of file open as 'fd' in process 'pid' */
+  std::string fdKind(pid_t pid, long fd)
+  {
+    std::ostringstream name;
+    name << "fd/" << fd;
+    struct stat st;
+    if (fd < 0 || stat(procName(pid, name.str()).c_str(), &st) != 0)
+      return std::string();
+    if (S_ISREG(st.st_mode))
+      return "file";
+    if (S_ISDIR(st.st_mode))
+      return "dir";
+    if (S_ISSOCK(st.st_mode))
+      return "socket";
+    if (S_ISFIFO(st.st_mode))
+      return "pipe";
+    if (S_ISCHR(st.st_mode))
+      return "char";
+    if (S_ISBLK(st.st_mode))
+      return "block";
+    return "other";
+  }
+
+  /** Parse a time such as 250us, 20ms or 1.5s */
+  long long parseTime(std::string const &text, std::string const &spec)
+  {
+    char *end(0);
+    double const value = strtod(text.c_str(), &end);
+    double scale(0);
+    if (strcmp(end, "us") == 0)
+      scale = 1e3;
+    else if (strcmp(end, "ms") == 0)
+      scale = 1e6;
+    else if (strcmp(end, "s") == 0)
+      scale = 1e9;
+    if (end == text.c_str() || scale == 0 || value < 0)
+    {
+      throw std::runtime_error("Invalid time '" + text + "' (use us, ms or s) in: " + spec);
+    }
+    return static_cast<long long>(value * scale);
+  }
+
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+FaultInjector::FaultInjector()
+: random(std::random_device()())
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void FaultInjector::add(std::string const &spec)
+{
+  std::vector<std::string> fields;
+  std::istringstream iss(spec);
+  std::string field;
+  while (std::getline(iss, field, ','))
+  {
+    fields.push_back(field);
+  }
+  if (fields.empty() || fields[0].empty())
+  {
+    throw std::runtime_error("Invalid injection rule: " + spec);
+  }
+
+  Rule rule = { spec, -1, std::string(), std::string(), Fixed, 0, 0, 0, 1.0, -1, 0, 0, 0 };
+  bool delayed(false);
+  if (fields[0] != "*")
+  {
+    char *end(0);
+    rule.func = strtol(fields[0].c_str(), &end, 10);
+    if (*end)
+    {
+      rule.func = syscallNumber(fields[0]);
+    }
+    if (rule.func < 0)
+    {
+      throw std::runtime_error("Unknown system call in: " + spec);
+    }
+  }
+  for (size_t idx = 1; idx != fields.size(); ++idx)
+  {
+    std::string::size_type const equals = fields[idx].find('=');
+    std::string const key = fields[idx].substr(0, equals);
+    std::string const value = (equals == std::string::npos) ? std::string() : fields[idx].substr(equals + 1);
+    if (key == "path" && !value.empty())
+    {
+      rule.path = value;
+    }
+    else if (key == "fd" && (value == "file" || value == "dir" || value == "socket" ||
+                             value == "pipe" || value == "char" || value == "block"))
+    {
+      rule.fdKind = value;
+    }
+    else if (key == "delay" && !value.empty())
+    {
+      delayed = true;
+      std::string::size_type const dash = value.find('-');
+      if (value.compare(0, 4, "exp:") == 0)
+      {
+        rule.distribution = Exponential;
+        rule.low = parseTime(value.substr(4), spec);
+      }
+      else if (dash != std::string::npos)
+      {
+        rule.distribution = Uniform;
+        rule.low = parseTime(value.substr(0, dash), spec);
+        rule.high = parseTime(value.substr(dash + 1), spec);
+        if (rule.high < rule.low)
+          throw std::runtime_error("Invalid delay range in: " + spec);
+      }
+      else
+      {
+        rule.low = parseTime(value, spec);
+      }
+    }
+    else if (key == "error" && !value.empty())
+    {
+      for (size_t err = 0; err != sizeof(errorNames) / sizeof(errorNames[0]); ++err)
+      {
+        if (value == errorNames[err].name)
+          rule.error = errorNames[err].value;
+      }
+      if (rule.error == 0)
+        rule.error = atoi(value.c_str());
+      if (rule.error <= 0 || rule.error >= 4096)
+        throw std::runtime_error("Invalid error in: " + spec);
+    }
+    else if (key == "prob" && !value.empty())
+    {
+      char *end(0);
+      rule.probability = strtod(value.c_str(), &end);
+      if (*end || rule.probability < 0 || rule.probability > 1)
+        throw std::runtime_error("Invalid probability in: " + spec);
+    }
+    else if (key == "count" && !value.empty())
+    {
+      char *end(0);
+      rule.limit = strtol(value.c_str(), &end, 10);
+      if (*end || rule.limit < 0)
+        throw std::runtime_error("Invalid count in: " + spec);
+    }
+    else
+    {
+      throw std::runtime_error("Invalid field '" + fields[idx] + "' in: " + spec);
+    }
+  }
+  if (delayed == (rule.error != 0))
+  {
+    throw std::runtime_error("An injection rule needs one of delay or error: " + spec);
+  }
+  rules.push_back(rule);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool FaultInjector::SelectedCall(int func)
+{
+  for (std::vector<Rule>::const_iterator it = rules.begin(); it != rules.end(); ++it)
+  {
+    if (it->func == -1 || it->func == func)
+      return true;
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void FaultInjector::OnCallRegisters(pid_t pid, int func, user_regs_struct const &regs)
+{
+  std::uniform_real_distribution<double> chance(0.0, 1.0);
+  for (std::vector<Rule>::iterator it = rules.begin(); it != rules.end(); ++it)
+  {
+    Rule &rule = *it;
+    if (!matches(rule, pid, func, regs))
+      continue;
+    ++rule.matched;
+    if (rule.injected == rule.limit || (rule.probability < 1 && chance(random) >= rule.probability))
+      continue;
+    ++rule.injected;
+    if (rule.error)
+    {
+      user_regs_struct skip(regs);
+      skip.orig_rax = -1;
+      if (ptrace(PTRACE_SETREGS, pid, 0, &skip) == 0)
+        failures[pid] = rule.error;
+    }
+    else
+    {
+      nsec const time = delay(rule);
+      rule.delayed += time;
+      holds[pid] = time;
+    }
+    return;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool FaultInjector::matches(Rule const &rule, pid_t pid, int func, user_regs_struct const &regs)
+{
+  if (rule.func != -1 && rule.func != func)
+  {
+    return false;
+  }
+  long const args[] = { (long)regs.rdi, (long)regs.rsi, (long)regs.rdx };
+  if (!rule.path.empty())
+  {
+    int const arg = pathArgument(func);
+    if (arg == -1 || readRemoteString(pid, args[arg]).compare(0, rule.path.size(), rule.path) != 0)
+      return false;
+  }
+  if (!rule.fdKind.empty())
+  {
+    if (!fdArg(func) || fdKind(pid, args[0]) != rule.fdKind)
+      return false;
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+FaultInjector::nsec FaultInjector::delay(Rule const &rule)
+{
+  switch (rule.distribution)
+  {
+  case Uniform:
+    return std::uniform_int_distribution<nsec>(rule.low, rule.high)(random);
+  case Exponential:
+    return rule.low ? static_cast<nsec>(std::exponential_distribution<double>(1.0 / rule.low)(random)) : 0;
+  default:
+    return rule.low;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+long FaultInjector::OnCallResult(pid_t pid, int func, long rc)
+{
+  std::map<pid_t, int>::iterator const it = failures.find(pid);
+  if (it == failures.end())
+  {
+    return rc;
+  }
+  user_regs_struct regs;
+  if (ptrace(PTRACE_GETREGS, pid, 0, &regs) == 0)
+  {
+    regs.rax = -it->second;
+    if (ptrace(PTRACE_SETREGS, pid, 0, &regs) == 0)
+      rc = -it->second;
+  }
+  failures.erase(it);
+  return rc;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void FaultInjector::OnExit(pid_t pid, int status)
+{
+  holds.erase(pid);
+  failures.erase(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+long long FaultInjector::OnResume(pid_t pid)
+{
+  std::map<pid_t, nsec>::iterator const it = holds.find(pid);
+  if (it == holds.end())
+  {
+    return 0;
+  }
+  nsec const hold = it->second;
+  holds.erase(it);
+  return hold;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void FaultInjector::Report(std::ostream &os)
+{
+  os << "\nInjected faults\n"
+     << "   matched  injected  delay ms  rule\n";
+  for (std::vector<Rule>::const_iterator it = rules.begin(); it != rules.end(); ++it)
+  {
+    os << std::setw(10) << it->matched << std::setw(10) << it->injected
+       << msecs(it->error ? -1 : it->delayed / 1000, 10) << "  " << it->spec << '\n';
+  }
+}
@@ -0,0 +1,100 @@
+#ifndef FAULT_INJECTOR_H
+#define FAULT_INJECTOR_H
+
+/**@file
+
+  System call latency and fault injection for ProcessTracer
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "TraceListener.h"
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+/** Delay or fail the system calls matching a set of rules */
+class FaultInjector : public TraceListener
+{
+public:
+  FaultInjector();
+
+  /** Add a rule described by 'spec':
+   *   call[,path=prefix][,fd=kind][,delay=time|time-time|exp:time|error=errno][,prob=p][,count=n]
+   * where call is a system call name or number or '*', kind is file,
+   * dir, socket, pipe, char or block and times have a unit of us, ms or s.
+   * Throws std::runtime_error if the spec is invalid */
+  void add(std::string const &spec);
+
+  /** Are there any rules? */
+  bool empty() const { return rules.empty(); }
+
+  bool SelectedCall(int func) override;
+  void OnCallRegisters(pid_t pid, int func, user_regs_struct const &regs) override;
+  long OnCallResult(pid_t pid, int func, long rc) override;
+  void OnExit(pid_t pid, int status) override;
+  long long OnResume(pid_t pid) override;
+  void Report(std::ostream &os) override;
+
+private:
+  /** Times are in nanoseconds */
+  typedef long long nsec;
+
+  /** How a delay is chosen */
+  enum Distribution
+  {
+    Fixed,         // always 'low'
+    Uniform,       // between 'low' and 'high'
+    Exponential    // mean 'low'
+  };
+
+  struct Rule
+  {
+    std::string spec;
+    int func;              // -1 for any call
+    std::string path;      // prefix of the path argument, if not empty
+    std::string fdKind;    // kind of the fd argument, if not empty
+    Distribution distribution;
+    nsec low;
+    nsec high;
+    int error;             // errno to fail with, or 0 to delay
+    double probability;
+    long limit;            // most injections, or -1
+    long matched;
+    long injected;
+    nsec delayed;
+  };
+
+  /** Does the call match 'rule', apart from its probability and limit? */
+  bool matches(Rule const &rule, pid_t pid, int func, user_regs_struct const &regs);
+
+  /** Choose a delay for 'rule' */
+  nsec delay(Rule const &rule);
+
+  std::vector<Rule> rules;
+  std::map<pid_t, nsec> holds;       // thread id => delay before the call runs
+  std::map<pid_t, int> failures;     // thread id => errno for the call being skipped
+  std::mt19937_64 random;
+};
+
+#endif // FAULT_INJECTOR_H
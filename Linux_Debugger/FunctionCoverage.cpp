@@ -0,0 +1,262 @@
+/*
+NAME
+    FunctionCoverage
+
+DESCRIPTION
+    Function coverage with one-shot breakpoints for ProcessTracer.
+
+    An int3 is written over the first byte of every sized function in
+    the symbol tables of each executable mapping: the program and the
+    dynamic loader at the start or exec, and each shared object when
+    the mmap of its code returns. The first time a function is entered
+    the trap is recorded, the original byte restored and the
+    instruction pointer moved back to re-execute it; the breakpoint is
+    never re-armed, so a hot function costs a single trap and the
+    traced program soon runs at full speed.
+
+    Breakpoints live in memory so they belong to an address space, not
+    a task: threads and vfork children share those of their parent,
+    a forked child starts with a copy of them, and an exec starts
+    afresh. Two threads can reach a breakpoint before either stop is
+    handled, so a trap just after a breakpoint that has already been
+    removed is still rewound.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "FunctionCoverage.h"
+
+#include <asm/unistd.h>
+#include <sys/mman.h>
+#include <sys/ptrace.h>
+#include <sys/user.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+  /** Executed and total functions in a module */
+  struct Count
+  {
+    size_t executed;
+    size_t total;
+  };
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+FunctionCoverage::FunctionCoverage(std::string const &fileName)
+: fileName(fileName)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void FunctionCoverage::OnStart(pid_t pid)
+{
+  spaces.push_back(Space());
+  tasks[pid] = spaces.size() - 1;
+  plant(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void FunctionCoverage::OnFork(pid_t parent, pid_t child, int event)
+{
+  std::map<pid_t, size_t>::const_iterator const it = tasks.find(parent);
+  if (it == tasks.end())
+  {
+    return;
+  }
+  if (event == PTRACE_EVENT_FORK)
+  {
+    spaces.push_back(spaces[it->second]);
+    tasks[child] = spaces.size() - 1;
+  }
+  else
+  {
+    tasks[child] = it->second;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void FunctionCoverage::OnExec(pid_t pid)
+{
+  OnExit(pid, 0);
+  OnStart(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// Release the breakpoints of an address space once no task uses it
+void FunctionCoverage::OnExit(pid_t pid, int status)
+{
+  std::map<pid_t, size_t>::iterator const it = tasks.find(pid);
+  if (it == tasks.end())
+  {
+    return;
+  }
+  size_t const space = it->second;
+  tasks.erase(it);
+  for (std::map<pid_t, size_t>::const_iterator task = tasks.begin(); task != tasks.end(); ++task)
+  {
+    if (task->second == space)
+      return;
+  }
+  spaces[space] = Space();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void FunctionCoverage::OnTrap(pid_t pid)
+{
+  std::map<pid_t, size_t>::const_iterator const it = tasks.find(pid);
+  if (it == tasks.end())
+  {
+    return;
+  }
+  user_regs_struct regs;
+  if (ptrace(PTRACE_GETREGS, pid, 0, &regs) == -1)
+  {
+    return;
+  }
+  unsigned long const addr = regs.rip - 1;
+  Space &space = spaces[it->second];
+  std::map<unsigned long, Breakpoint>::iterator const bp = space.breakpoints.find(addr);
+  if (bp == space.breakpoints.end())
+  {
+    return;
+  }
+  if (!bp->second.hit)
+  {
+    bp->second.hit = true;
+    poke(pid, addr, bp->second.original, 0);
+    Function &function = functions[bp->second.function];
+    if (function.firstHit < 0)
+    {
+      function.firstHit = elapsed.usec();
+      function.pid = pid;
+    }
+  }
+  regs.rip = addr;
+  ptrace(PTRACE_SETREGS, pid, 0, &regs);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool FunctionCoverage::SelectedCall(int func)
+{
+  return func == __NR_mmap;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void FunctionCoverage::OnCallExit(pid_t pid, int func, long const args[], long rc)
+{
+  if ((args[2] & PROT_EXEC) && (rc >= 0 || rc < -4095))
+  {
+    plant(pid);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void FunctionCoverage::plant(pid_t tid)
+{
+  std::map<pid_t, size_t>::const_iterator const it = tasks.find(tid);
+  if (it == tasks.end())
+  {
+    return;
+  }
+  Space &space = spaces[it->second];
+  ProcessModules const modules(tid);
+  std::vector<ProcessModules::Module> const &mappings = modules.modules();
+  for (std::vector<ProcessModules::Module>::const_iterator m = mappings.begin(); m != mappings.end(); ++m)
+  {
+    if (!m->exec || m->path.empty() || m->path[0] != '/' ||
+        !space.mapped.insert(std::make_pair(m->path, m->start)).second)
+      continue;
+    long const base = modules.toVaddr(*m, m->start);
+    if (base == -1)
+      continue;
+    std::vector<ElfSymbols::Symbol> const &symbols = ElfSymbols::get(m->path)->symbols();
+    for (std::vector<ElfSymbols::Symbol>::const_iterator sym = symbols.begin(); sym != symbols.end(); ++sym)
+    {
+      if (!sym->function || sym->size == 0 ||
+          sym->value < (unsigned long)base || sym->value - base >= m->end - m->start)
+        continue;
+      unsigned long const addr = m->start + (sym->value - base);
+      if (space.breakpoints.count(addr))
+        continue;   // an alias
+      std::pair<std::map<std::pair<std::string, unsigned long>, size_t>::iterator, bool> const entry =
+        index.insert(std::make_pair(std::make_pair(m->path, sym->value), functions.size()));
+      if (entry.second)
+      {
+        Function const function = { m->path, sym->name, -1, 0 };
+        functions.push_back(function);
+      }
+      Breakpoint bp = { entry.first->second, 0, false };
+      if (poke(tid, addr, Int3, &bp.original))
+      {
+        space.breakpoints[addr] = bp;
+      }
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void FunctionCoverage::Report(std::ostream &os)
+{
+  std::vector<std::pair<usec, size_t> > executed;
+  std::map<std::string, Count> modules;
+  for (size_t idx = 0; idx != functions.size(); ++idx)
+  {
+    Count &count = modules[functions[idx].module];
+    ++count.total;
+    if (functions[idx].firstHit >= 0)
+    {
+      ++count.executed;
+      executed.push_back(std::make_pair(functions[idx].firstHit, idx));
+    }
+  }
+  std::sort(executed.begin(), executed.end());
+
+  os << "\nFunction coverage: " << executed.size() << " of " << functions.size() << " functions executed\n"
+     << "  executed     total  module\n";
+  for (std::map<std::string, Count>::const_iterator it = modules.begin(); it != modules.end(); ++it)
+  {
+    os << std::setw(10) << it->second.executed << std::setw(10) << it->second.total << "  " << it->first << '\n';
+  }
+
+  std::ofstream ofs;
+  if (!fileName.empty())
+  {
+    ofs.open(fileName.c_str());
+  }
+  std::ostream &out = fileName.empty() ? os : ofs;
+  out << (fileName.empty() ? "\nFunctions executed\n" : "")
+      << "     msecs       pid  function (module)\n";
+  for (std::vector<std::pair<usec, size_t> >::const_iterator it = executed.begin(); it != executed.end(); ++it)
+  {
+    Function const &function = functions[it->second];
+    std::string module(function.module);
+    std::string::size_type const slash = module.rfind('/');
+    if (slash != std::string::npos)
+      module.erase(0, slash + 1);
+    out << msecs(it->first, 10) << std::setw(10) << function.pid << "  " << function.name << " (" << module << ")\n";
+  }
+  if (!fileName.empty() && !ofs)
+  {
+    os << "Unable to write function coverage to " << fileName << std::endl;
+  }
+}
@@ -0,0 +1,98 @@
+#ifndef FUNCTION_COVERAGE_H
+#define FUNCTION_COVERAGE_H
+
+/**@file
+
+  Function coverage with one-shot breakpoints for ProcessTracer
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "ElfSymbols.h"
+#include "TraceListener.h"
+#include "TraceUtils.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/** Put a breakpoint on the entry of every function in the program
+ * and its shared objects, removing each one the first time it is hit,
+ * and report the functions executed */
+class FunctionCoverage : public TraceListener
+{
+public:
+  /** Write the functions executed to 'fileName', or to the report
+   * stream if the name is empty */
+  explicit FunctionCoverage(std::string const &fileName);
+
+  void OnStart(pid_t pid) override;
+  void OnFork(pid_t parent, pid_t child, int event) override;
+  void OnExec(pid_t pid) override;
+  void OnExit(pid_t pid, int status) override;
+  void OnTrap(pid_t pid) override;
+  bool SelectedCall(int func) override;
+  void OnCallExit(pid_t pid, int func, long const args[], long rc) override;
+  void Report(std::ostream &os) override;
+
+private:
+  /** Times are in microseconds since the tracer started */
+  typedef long long usec;
+
+  /** A function in a module */
+  struct Function
+  {
+    std::string module;
+    std::string name;
+    usec firstHit;         // -1 if never executed
+    pid_t pid;             // process that first executed it
+  };
+
+  /** A breakpoint planted in an address space */
+  struct Breakpoint
+  {
+    size_t function;
+    unsigned char original;
+    bool hit;
+  };
+
+  /** The breakpoints in one address space, shared by threads and
+   * vfork children, and copied by fork */
+  struct Space
+  {
+    std::map<unsigned long, Breakpoint> breakpoints;
+    std::set<std::pair<std::string, unsigned long> > mapped;  // (module, start) already done
+  };
+
+  /** Plant breakpoints, through stopped task 'tid', in any
+   * executable mappings of its address space not yet done */
+  void plant(pid_t tid);
+
+  std::string fileName;
+  Stopwatch elapsed;                 // since the start of tracing
+  std::vector<Function> functions;
+  std::map<std::pair<std::string, unsigned long>, size_t> index;  // (module, link-time address) => function
+  std::vector<Space> spaces;
+  std::map<pid_t, size_t> tasks;        // thread id => address space
+};
+
+#endif // FUNCTION_COVERAGE_H
@@ -0,0 +1,357 @@
+/*
+NAME
+    FutexProfiler
+
+DESCRIPTION
+    Futex contention profiler for ProcessTracer.
+
+    Lock contention in a threaded program shows up as futex calls:
+    a thread which fails to take a lock waits with FUTEX_WAIT (or
+    FUTEX_LOCK_PI) and the owner releases it with FUTEX_WAKE. The time
+    from entry to exit of each wait is charged to the futex address
+    and to the call site in the program which asked for the lock.
+
+    The call site is found by scanning the stack for the first return
+    address outside the module making the system call (normally the C
+    library) which follows a call instruction. No unwind information is
+    needed, at the price of occasionally picking up a stale address.
+
+    Measured times include the tracer's own overhead for the stops at
+    entry and exit, so they are most useful for comparing locks.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "FutexProfiler.h"
+#include "TraceUtils.h"
+
+#include <errno.h>
+#include <asm/unistd.h>
+#include <linux/futex.h>
+#include <sys/ptrace.h>
+#include <sys/user.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+  /** Number of entries shown in each table */
+  size_t const TopCount = 10;
+
+  /** Bytes of stack searched for the call site */
+  size_t const StackScan = 4096;
+
+  /** Is futex operation 'op' one which wakes waiters? */
+  bool waking(int op)
+  {
+    switch (op & FUTEX_CMD_MASK)
+    {
+    case FUTEX_WAKE:
+    case FUTEX_WAKE_BITSET:
+    case FUTEX_WAKE_OP:
+    case FUTEX_REQUEUE:
+    case FUTEX_CMP_REQUEUE:
+    case FUTEX_CMP_REQUEUE_PI:
+    case FUTEX_UNLOCK_PI:
+      return true;
+    }
+    return false;
+  }
+
+  /** Microseconds in a fixed width column */
+  class usecs
+  {
+    long long const value;
+  public:
+    usecs(long long value) : value(value) {}
+
+    friend std::ostream & operator<<(std::ostream& os, usecs const &rhs)
+    {
+      return os << std::setw(10) << rhs.value;
+    }
+  };
+
+  /** The 'pct' percentile of the sorted values */
+  long long percentile(std::vector<long long> const &sorted, double pct)
+  {
+    if (sorted.empty())
+    {
+      return 0;
+    }
+    size_t const rank = size_t(pct / 100 * (sorted.size() - 1) + 0.5);
+    return sorted[rank];
+  }
+
+  /** Order entries by decreasing total, largest first */
+  template <typename T>
+  bool byTotal(std::pair<long long, T> const &lhs, std::pair<long long, T> const &rhs)
+  {
+    return lhs.first > rhs.first;
+  }
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+FutexProfiler::FutexProfiler()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void FutexProfiler::OnStart(pid_t pid)
+{
+  images.OnStart(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void FutexProfiler::OnFork(pid_t parent, pid_t child, int event)
+{
+  images.OnFork(parent, child, event);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void FutexProfiler::OnExec(pid_t pid)
+{
+  images.OnExec(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void FutexProfiler::OnExit(pid_t pid, int status)
+{
+  // A thread killed while blocked (eg by exit_group) never returns from the call
+  std::map<pid_t, Waiting>::iterator it = waiting.find(pid);
+  if (it != waiting.end())
+  {
+    --futexes[it->second.futex].waiting;
+    waiting.erase(it);
+  }
+  sites.erase(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool FutexProfiler::blocking(int op)
+{
+  switch (op & FUTEX_CMD_MASK)
+  {
+  case FUTEX_WAIT:
+  case FUTEX_WAIT_BITSET:
+  case FUTEX_LOCK_PI:
+  case FUTEX_LOCK_PI2:
+  case FUTEX_WAIT_REQUEUE_PI:
+    return true;
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool FutexProfiler::SelectedCall(int func)
+{
+  return func == __NR_futex;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void FutexProfiler::OnCallRegisters(pid_t pid, int func, user_regs_struct const &regs)
+{
+  if (blocking(regs.rsi))
+  {
+    sites[pid] = callSite(images.imageOf(pid), pid, regs.rip, regs.rsp);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void FutexProfiler::OnCallEntry(pid_t pid, int func, long const args[])
+{
+  if (!blocking(args[1]))
+  {
+    return;
+  }
+  Waiting wait;
+  wait.futex = Key(images.imageOf(pid), args[0]);
+  wait.site = sites[pid];
+  wait.entry = elapsed.usec();
+  waiting[pid] = wait;
+
+  Futex &futex = futexes[wait.futex];
+  futex.waiters.insert(pid);
+  futex.maxWaiting = std::max(futex.maxWaiting, ++futex.waiting);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void FutexProfiler::OnCallExit(pid_t pid, int func, long const args[], long rc)
+{
+  if (waking(args[1]))
+  {
+    Futex &futex = futexes[Key(images.imageOf(pid), args[0])];
+    ++futex.wakes;
+    if (rc > 0)
+    {
+      futex.woken += rc;
+    }
+    return;
+  }
+
+  std::map<pid_t, Waiting>::iterator const it = waiting.find(pid);
+  if (it == waiting.end())
+  {
+    return;
+  }
+  Waiting const wait = it->second;
+  waiting.erase(it);
+
+  Futex &futex = futexes[wait.futex];
+  --futex.waiting;
+  if (rc == -EAGAIN)
+  {
+    // The futex word had already changed: no wait took place
+    ++futex.missed;
+    return;
+  }
+  usec const blocked = elapsed.usec() - wait.entry;
+  futex.blocked.push_back(blocked);
+
+  Site &site = callSites[Key(wait.futex.first, wait.site)];
+  ++site.waits;
+  site.blocked += blocked;
+  site.futexes[wait.futex.second] += blocked;
+
+  std::pair<long, usec> &total = threadTotals[pid];
+  ++total.first;
+  total.second += blocked;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+unsigned long FutexProfiler::callSite(size_t image, pid_t tid, unsigned long rip, unsigned long rsp)
+{
+  ProcessModules &modules = images[image].modules;
+  ProcessModules::Module const *self = modules.find(rip);
+  if (!self)
+  {
+    // Perhaps a library loaded since we last looked
+    modules.refresh();
+    self = modules.find(rip);
+  }
+  unsigned long stack[StackScan / sizeof(unsigned long)];
+  size_t const count = readRemote(tid, rsp, stack, sizeof(stack)) / sizeof(unsigned long);
+  unsigned long fallback(0);
+  for (size_t idx = 0; idx != count; ++idx)
+  {
+    ProcessModules::Module const *module = modules.find(stack[idx]);
+    if (!module || !module->exec || !afterCall(image, tid, stack[idx]))
+      continue;
+    if (!self || module->path != self->path)
+      return stack[idx];
+    if (!fallback)
+      fallback = stack[idx];
+  }
+  // Statically linked, or no frame outside the library was found
+  return fallback ? fallback : rip;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// Recognise the common encodings of call: E8 rel32, and FF /2 with
+// a register, disp8, disp32 or SIB+disp32 operand
+bool FutexProfiler::afterCall(size_t image, pid_t tid, unsigned long addr)
+{
+  std::map<Key, bool>::const_iterator const it = calls.find(Key(image, addr));
+  if (it != calls.end())
+  {
+    return it->second;
+  }
+  unsigned char code[7];
+  bool result(false);
+  if (addr > sizeof(code) && readRemote(tid, addr - sizeof(code), code, sizeof(code)) == sizeof(code))
+  {
+    result = code[2] == 0xe8 ||
+      (code[5] == 0xff && (code[6] & 0x38) == 0x10) ||
+      (code[4] == 0xff && (code[5] & 0x38) == 0x10) ||
+      (code[1] == 0xff && (code[2] & 0x38) == 0x10) ||
+      (code[0] == 0xff && (code[1] & 0x38) == 0x10);
+  }
+  calls[Key(image, addr)] = result;
+  return result;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void FutexProfiler::Report(std::ostream &os)
+{
+  os << "\nMost contended futexes (times in microseconds unless shown)\n"
+     << "  blocked ms     waits   waiters  max wait    missed       p50       p90       p99       max     wakes       pid  futex\n";
+  std::vector<std::pair<long long, Key> > order;
+  for (std::map<Key, Futex>::const_iterator it = futexes.begin(); it != futexes.end(); ++it)
+  {
+    long long total(0);
+    for (size_t idx = 0; idx != it->second.blocked.size(); ++idx)
+      total += it->second.blocked[idx];
+    if (!it->second.blocked.empty() || it->second.missed)
+      order.push_back(std::make_pair(total, it->first));
+  }
+  std::stable_sort(order.begin(), order.end(), byTotal<Key>);
+  for (size_t idx = 0; idx != order.size() && idx != TopCount; ++idx)
+  {
+    Key const &key = order[idx].second;
+    Futex const &futex = futexes[key];
+    std::vector<long long> sorted(futex.blocked);
+    std::sort(sorted.begin(), sorted.end());
+    ProcessImages::Image const &image = images[key.first];
+    os << msecs(order[idx].first) << std::setw(10) << sorted.size()
+       << std::setw(10) << futex.waiters.size() << std::setw(10) << futex.maxWaiting
+       << std::setw(10) << futex.missed
+       << usecs(percentile(sorted, 50)) << usecs(percentile(sorted, 90))
+       << usecs(percentile(sorted, 99)) << usecs(sorted.empty() ? 0 : sorted.back())
+       << std::setw(10) << futex.wakes << std::setw(10) << image.pid
+       << "  " << image.modules.describe(key.second) << '\n';
+  }
+
+  os << "\nCall sites waiting for futexes (return address of the call into the library)\n"
+     << "  blocked ms     waits       pid  call site => busiest futex\n";
+  order.clear();
+  for (std::map<Key, Site>::const_iterator it = callSites.begin(); it != callSites.end(); ++it)
+  {
+    order.push_back(std::make_pair(it->second.blocked, it->first));
+  }
+  std::stable_sort(order.begin(), order.end(), byTotal<Key>);
+  for (size_t idx = 0; idx != order.size() && idx != TopCount; ++idx)
+  {
+    Key const &key = order[idx].second;
+    Site const &site = callSites[key];
+    ProcessImages::Image const &image = images[key.first];
+    std::map<unsigned long, usec>::const_iterator busiest = site.futexes.begin();
+    for (std::map<unsigned long, usec>::const_iterator it = site.futexes.begin(); it != site.futexes.end(); ++it)
+    {
+      if (it->second > busiest->second)
+        busiest = it;
+    }
+    os << msecs(site.blocked) << std::setw(10) << site.waits << std::setw(10) << image.pid
+       << "  " << image.modules.describe(key.second)
+       << " => " << image.modules.describe(busiest->first) << '\n';
+  }
+
+  os << "\nThreads blocked longest\n"
+     << "  blocked ms     waits       tid\n";
+  std::vector<std::pair<long long, pid_t> > byThread;
+  for (std::map<pid_t, std::pair<long, usec> >::const_iterator it = threadTotals.begin(); it != threadTotals.end(); ++it)
+  {
+    byThread.push_back(std::make_pair(it->second.second, it->first));
+  }
+  std::stable_sort(byThread.begin(), byThread.end(), byTotal<pid_t>);
+  for (size_t idx = 0; idx != byThread.size() && idx != TopCount; ++idx)
+  {
+    os << msecs(byThread[idx].first) << std::setw(10) << threadTotals[byThread[idx].second].first
+       << std::setw(10) << byThread[idx].second << '\n';
+  }
+}
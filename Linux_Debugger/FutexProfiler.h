@@ -0,0 +1,111 @@
+#ifndef FUTEX_PROFILER_H
+#define FUTEX_PROFILER_H
+
+/**@file
+
+  Futex contention profiler for ProcessTracer
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "ProcessImages.h"
+#include "TraceListener.h"
+#include "TraceUtils.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** Record the time each thread spends blocked in futex waits,
+ * by futex address and by the call site in the traced program */
+class FutexProfiler : public TraceListener
+{
+public:
+  FutexProfiler();
+
+  void OnStart(pid_t pid) override;
+  void OnFork(pid_t parent, pid_t child, int event) override;
+  void OnExec(pid_t pid) override;
+  void OnExit(pid_t pid, int status) override;
+  bool SelectedCall(int func) override;
+  void OnCallRegisters(pid_t pid, int func, user_regs_struct const &regs) override;
+  void OnCallEntry(pid_t pid, int func, long const args[]) override;
+  void OnCallExit(pid_t pid, int func, long const args[], long rc) override;
+  void Report(std::ostream &os) override;
+
+  /** Is futex operation 'op' one which may block? */
+  static bool blocking(int op);
+
+private:
+  /** Times are in microseconds since the tracer started */
+  typedef long long usec;
+
+  /** An address within an image */
+  typedef std::pair<size_t, unsigned long> Key;
+
+  /** Activity on one futex */
+  struct Futex
+  {
+    std::vector<usec> blocked;   // time of each completed wait
+    std::set<pid_t> waiters;
+    int waiting;                 // threads waiting now
+    int maxWaiting;
+    long missed;                 // waits which returned EAGAIN at once
+    long wakes;
+    long woken;
+  };
+
+  /** Blocking waits from one call site */
+  struct Site
+  {
+    long waits;
+    usec blocked;
+    std::map<unsigned long, usec> futexes;  // futex address => time blocked
+  };
+
+  /** A thread blocked in a futex call */
+  struct Waiting
+  {
+    Key futex;
+    unsigned long site;
+    usec entry;
+  };
+
+  /** Find the first return address on the stack outside the module
+   * holding 'rip', which is the caller of the locking function */
+  unsigned long callSite(size_t image, pid_t tid, unsigned long rip, unsigned long rsp);
+
+  /** Is the instruction before 'addr' a call? */
+  bool afterCall(size_t image, pid_t tid, unsigned long addr);
+
+  Stopwatch elapsed;                 // since the start of tracing
+  ProcessImages images;
+  std::map<Key, bool> calls;             // is there a call before this address?
+  std::map<pid_t, unsigned long> sites;  // thread id => call site of the current call
+  std::map<pid_t, Waiting> waiting;      // thread id => blocking call in progress
+  std::map<Key, Futex> futexes;
+  std::map<Key, Site> callSites;
+  std::map<pid_t, std::pair<long, usec> > threadTotals;  // thread id => waits, time
+};
+
+#endif // FUTEX_PROFILER_H
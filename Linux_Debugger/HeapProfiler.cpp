@@ -0,0 +1,730 @@
+/*
+NAME
+    HeapProfiler
+
+DESCRIPTION
+    Heap allocation profiler for ProcessTracer.
+
+    An int3 is written over the entry of malloc, calloc, realloc, free
+    and the global operators new and delete in each executable mapping,
+    as for FunctionCoverage, but these breakpoints never leave memory:
+    after each hit the instruction under the int3, typically endbr64,
+    a push, or a sub from or a mov or test of registers, is emulated by
+    updating the registers, so no other thread can pass the function
+    unseen. An instruction which cannot be emulated is single-stepped
+    by the trace loop with the original byte put back, and the report
+    then says that the counts are lower bounds, as other threads may
+    have passed meanwhile.
+
+    The size or pointer is read from the argument registers on entry.
+    Calls made from inside another allocation function, such as the
+    malloc in operator new, are ignored, and functions that just jump
+    to another, such as operator delete, are not broken on. Every allocation is counted
+    for the rate over time, but with --heap=N only some are sampled: a
+    countdown of bytes drawn from an exponential distribution with mean
+    N is reduced by the size of each allocation, and the one taking it
+    to zero is sampled and a new countdown drawn. So each byte has the
+    same chance, 1/N, of being sampled and an allocation of size S is
+    sampled with probability 1 - exp(-S/N); dividing by that makes the
+    estimates unbiased whatever the mix of sizes, where sampling every
+    Nth call would give one huge block among many small ones the weight
+    of the small ones. The sampling only saves the return trap and the
+    unwind: every call still traps on entry. A sampled call has its stack
+    unwound, and its return address on the stack replaced by the entry
+    of the function, as a uretprobe does, so its return hits the entry
+    breakpoint with a stack pointer which tells it from a call; the
+    block address is collected there and the task sent on to the real
+    return address. (Something unwinding the stack of the target from
+    inside the allocation function, such as an exception thrown by
+    operator new, would find that entry address instead.) Sampled
+    blocks stay in the live table until freed, with the live and peak
+    bytes kept for each call site, each block standing for its size
+    divided by its chance of being sampled.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "HeapProfiler.h"
+#include "StackUnwinder.h"
+#include "TraceUtils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <asm/unistd.h>
+#include <sys/mman.h>
+#include <sys/ptrace.h>
+#include <sys/user.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+  /** Number of call sites listed */
+  size_t const TopCount = 10;
+
+  /** Number of frames kept for a call site */
+  size_t const SiteDepth = 6;
+
+  /** Most rows in the allocation rate table */
+  size_t const RateRows = 40;
+
+  /** The allocation functions, by demangled name */
+  struct Function
+  {
+    char const *name;
+    int kind;
+  };
+
+  Function const functions[] = {
+    { "malloc", 0 },
+    { "calloc", 1 },
+    { "realloc", 2 },
+    { "free", 3 },
+    { "operator new(unsigned long)", 0 },
+    { "operator new[](unsigned long)", 0 },
+    { "operator new(unsigned long, std::nothrow_t const&)", 0 },
+    { "operator new[](unsigned long, std::nothrow_t const&)", 0 },
+    { "operator new(unsigned long, std::align_val_t)", 0 },
+    { "operator new[](unsigned long, std::align_val_t)", 0 },
+    { "operator delete(void*)", 3 },
+    { "operator delete[](void*)", 3 },
+    { "operator delete(void*, unsigned long)", 3 },
+    { "operator delete[](void*, unsigned long)", 3 },
+    { "operator delete(void*, std::align_val_t)", 3 },
+    { "operator delete[](void*, std::align_val_t)", 3 },
+    { "operator delete(void*, unsigned long, std::align_val_t)", 3 },
+    { "operator delete[](void*, unsigned long, std::align_val_t)", 3 },
+  };
+
+  /** The kind of allocation function 'name' (or -1) */
+  int kindOf(std::string const &name)
+  {
+    for (size_t idx = 0; idx != sizeof(functions) / sizeof(functions[0]); ++idx)
+    {
+      if (name == functions[idx].name)
+        return functions[idx].kind;
+    }
+    return -1;
+  }
+
+  /** Does the function at 'addr' just jump to another, as operator
+   * delete does to free? Then only the target is counted */
+  bool forwarder(pid_t tid, unsigned long addr)
+  {
+    errno = 0;
+    unsigned long const word = ptrace(PTRACE_PEEKTEXT, tid, addr, 0);
+    if (errno != 0)
+    {
+      return false;
+    }
+    int shift(0);
+    if ((word & 0xffffffff) == 0xfa1e0ff3)   // endbr64
+    {
+      shift = 32;
+    }
+    unsigned char const opcode = (word >> shift) & 0xff;
+    return opcode == 0xe9 || opcode == 0xeb;
+  }
+
+  /** Bits of the flags register set by arithmetic */
+  unsigned long long const CarryFlag = 0x1, ParityFlag = 0x4, AdjustFlag = 0x10, ZeroFlag = 0x40,
+    SignFlag = 0x80, OverflowFlag = 0x800;
+
+  /** The register numbered 'reg' in an instruction encoding */
+  unsigned long long &reg64(user_regs_struct &regs, int reg)
+  {
+    switch (reg)
+    {
+    case 0: return regs.rax;
+    case 1: return regs.rcx;
+    case 2: return regs.rdx;
+    case 3: return regs.rbx;
+    case 4: return regs.rsp;
+    case 5: return regs.rbp;
+    case 6: return regs.rsi;
+    case 7: return regs.rdi;
+    case 8: return regs.r8;
+    case 9: return regs.r9;
+    case 10: return regs.r10;
+    case 11: return regs.r11;
+    case 12: return regs.r12;
+    case 13: return regs.r13;
+    case 14: return regs.r14;
+    default: return regs.r15;
+    }
+  }
+
+  /** Set the arithmetic flags for 'result' */
+  void setFlags(user_regs_struct &regs, unsigned long long result, bool carry, bool overflow, bool adjust)
+  {
+    unsigned long long flags =
+      regs.eflags & ~(CarryFlag | ParityFlag | AdjustFlag | ZeroFlag | SignFlag | OverflowFlag);
+    if (carry)
+      flags |= CarryFlag;
+    if (!__builtin_parity(result & 0xff))
+      flags |= ParityFlag;
+    if (adjust)
+      flags |= AdjustFlag;
+    if (result == 0)
+      flags |= ZeroFlag;
+    if (result >> 63)
+      flags |= SignFlag;
+    if (overflow)
+      flags |= OverflowFlag;
+    regs.eflags = flags;
+  }
+
+  /** Execute for task 'tid' the instruction whose first bytes are
+   * 'code' and which starts at regs.rip, if it is one of the few found
+   * at the entry of allocation functions; with 'tid' 0 just check.
+   * Returns false if it cannot be emulated */
+  bool emulate(pid_t tid, user_regs_struct &regs, unsigned long code)
+  {
+    unsigned char b[sizeof(code)];
+    for (size_t idx = 0; idx != sizeof(b); ++idx)
+    {
+      b[idx] = (code >> (8 * idx)) & 0xff;
+    }
+    user_regs_struct next(regs);
+    if (b[0] == 0xf3 && b[1] == 0x0f && b[2] == 0x1e && b[3] == 0xfa)
+    {
+      next.rip += 4;     // endbr64
+    }
+    else if ((b[0] & 0xf8) == 0x50 || (b[0] == 0x41 && (b[1] & 0xf8) == 0x50))
+    {
+      // push r64
+      bool const rex = (b[0] == 0x41);
+      unsigned long long const value = reg64(regs, (rex ? 8 : 0) + (b[rex] & 7));
+      next.rsp -= sizeof(long);
+      next.rip += 1 + rex;
+      if (tid && ptrace(PTRACE_POKEDATA, tid, next.rsp, value) == -1)
+        return false;
+    }
+    else if ((b[0] & 0xf8) == 0x48 && (b[2] & 0xc0) == 0xc0)
+    {
+      // REX.W with a register operand: mov, test, or sub of an immediate
+      int const reg = ((b[2] >> 3) & 7) | ((b[0] & 4) ? 8 : 0);
+      int const rm = (b[2] & 7) | ((b[0] & 1) ? 8 : 0);
+      if (b[1] == 0x89 || b[1] == 0x8b)
+      {
+        if (b[1] == 0x89)
+          reg64(next, rm) = reg64(regs, reg);
+        else
+          reg64(next, reg) = reg64(regs, rm);
+        next.rip += 3;
+      }
+      else if (b[1] == 0x85)
+      {
+        setFlags(next, reg64(regs, rm) & reg64(regs, reg), false, false, false);
+        next.rip += 3;
+      }
+      else if ((b[1] == 0x83 || b[1] == 0x81) && ((b[2] >> 3) & 7) == 5)
+      {
+        unsigned long long const lhs = reg64(regs, rm);
+        unsigned long long const rhs = (b[1] == 0x83) ? (long long)(signed char)b[3]
+          : (long long)(int)(b[3] | b[4] << 8 | b[5] << 16 | (unsigned)b[6] << 24);
+        unsigned long long const result = lhs - rhs;
+        reg64(next, rm) = result;
+        setFlags(next, result, lhs < rhs, ((lhs ^ rhs) & (lhs ^ result)) >> 63, (lhs ^ rhs ^ result) & 0x10);
+        next.rip += (b[1] == 0x83) ? 4 : 7;
+      }
+      else
+      {
+        return false;
+      }
+    }
+    else
+    {
+      return false;
+    }
+    regs = next;
+    return true;
+  }
+
+  /** Bytes column in KiB, with one decimal place */
+  class kib
+  {
+    long long const value;
+  public:
+    explicit kib(long long value) : value(value) {}
+
+    friend std::ostream &operator<<(std::ostream &os, kib const &rhs)
+    {
+      std::ostringstream oss;
+      oss << std::fixed << std::setprecision(1) << rhs.value / 1024.0;
+      return os << std::setw(11) << oss.str();
+    }
+  };
+
+  bool byPeak(std::pair<long long, size_t> const &lhs, std::pair<long long, size_t> const &rhs)
+  {
+    return lhs.first > rhs.first;
+  }
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+HeapProfiler::HeapProfiler(unsigned long sample)
+: sample(sample ? sample : 1), random(std::random_device()()), untilSample(0), allocations(0), frees(0),
+  steps(0), bytes(0), live(0), peak(0)
+{
+  untilSample = std::exponential_distribution<double>(1.0 / this->sample)(random);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void HeapProfiler::OnStart(pid_t pid)
+{
+  images.OnStart(pid);
+  spaces.push_back(Space());
+  tasks[pid] = spaces.size() - 1;
+  plant(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// A forked child has the breakpoints of its parent in its copy of
+// the memory, but none of its live blocks are known
+void HeapProfiler::OnFork(pid_t parent, pid_t child, int event)
+{
+  images.OnFork(parent, child, event);
+  std::map<pid_t, size_t>::const_iterator const it = tasks.find(parent);
+  if (it == tasks.end())
+  {
+    return;
+  }
+  if (event == PTRACE_EVENT_FORK)
+  {
+    Space space(spaces[it->second]);
+    space.blocks.clear();
+    spaces.push_back(space);
+    tasks[child] = spaces.size() - 1;
+  }
+  else
+  {
+    tasks[child] = it->second;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void HeapProfiler::OnExec(pid_t pid)
+{
+  OnExit(pid, 0);
+  images.OnExec(pid);
+  spaces.push_back(Space());
+  tasks[pid] = spaces.size() - 1;
+  plant(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// The blocks still live when the last task using an address space
+// goes are kept for the report; the breakpoints are no longer needed
+void HeapProfiler::OnExit(pid_t pid, int status)
+{
+  calls.erase(pid);
+  std::map<pid_t, size_t>::iterator const it = tasks.find(pid);
+  if (it == tasks.end())
+  {
+    return;
+  }
+  size_t const space = it->second;
+  tasks.erase(it);
+  stepped(pid, space, true);
+  for (std::map<pid_t, size_t>::const_iterator task = tasks.begin(); task != tasks.end(); ++task)
+  {
+    if (task->second == space)
+      return;
+  }
+  spaces[space].entries.clear();
+  spaces[space].internal.clear();
+  spaces[space].mapped.clear();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+HeapProfiler::Space *HeapProfiler::spaceOf(pid_t tid)
+{
+  std::map<pid_t, size_t>::const_iterator const it = tasks.find(tid);
+  return it == tasks.end() ? 0 : &spaces[it->second];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool HeapProfiler::SelectedCall(int func)
+{
+  return func == __NR_mmap;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void HeapProfiler::OnCallExit(pid_t pid, int func, long const args[], long rc)
+{
+  if ((args[2] & PROT_EXEC) && (rc >= 0 || rc < -4095))
+  {
+    plant(pid);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void HeapProfiler::plant(pid_t tid)
+{
+  Space *space = spaceOf(tid);
+  if (!space)
+  {
+    return;
+  }
+  ProcessModules const modules(tid);
+  std::vector<ProcessModules::Module> const &mappings = modules.modules();
+  for (std::vector<ProcessModules::Module>::const_iterator m = mappings.begin(); m != mappings.end(); ++m)
+  {
+    if (!m->exec || m->path.empty() || m->path[0] != '/' ||
+        !space->mapped.insert(std::make_pair(m->path, m->start)).second)
+      continue;
+    long const base = modules.toVaddr(*m, m->start);
+    if (base == -1)
+      continue;
+    std::vector<ElfSymbols::Symbol> const &symbols = ElfSymbols::get(m->path)->symbols();
+    for (std::vector<ElfSymbols::Symbol>::const_iterator sym = symbols.begin(); sym != symbols.end(); ++sym)
+    {
+      if (!sym->function || sym->value < (unsigned long)base || sym->value - base >= m->end - m->start)
+        continue;
+      int const kind = kindOf(sym->name);
+      unsigned long const addr = m->start + (sym->value - base);
+      if (kind == -1 || space->entries.count(addr) || forwarder(tid, addr))
+        continue;
+      errno = 0;
+      Entry const entry = { static_cast<Kind>(kind), (unsigned long)ptrace(PTRACE_PEEKDATA, tid, addr, 0) };
+      if (errno == 0 && poke(tid, addr, Int3, 0))
+      {
+        space->entries[addr] = entry;
+      }
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void HeapProfiler::OnTrap(pid_t pid)
+{
+  Space *space = spaceOf(pid);
+  user_regs_struct regs;
+  if (!space || ptrace(PTRACE_GETREGS, pid, 0, &regs) == -1)
+  {
+    return;
+  }
+  if (stepping.count(pid))
+  {
+    stepped(pid, tasks[pid], false);
+    return;
+  }
+  unsigned long const addr = regs.rip - 1;
+  std::map<unsigned long, Entry>::const_iterator const entry = space->entries.find(addr);
+  if (entry == space->entries.end())
+  {
+    return;
+  }
+  if (onReturn(pid, *space, addr, regs))
+  {
+    ptrace(PTRACE_SETREGS, pid, 0, &regs);
+    return;
+  }
+  regs.rip = addr;
+  onEntry(pid, *space, entry->second.kind, regs);
+  if (emulate(pid, regs, entry->second.code))
+  {
+    ptrace(PTRACE_SETREGS, pid, 0, &regs);
+  }
+  else
+  {
+    ++steps;
+    stepOver(pid, *space, regs, addr, entry->second.code & 0xff);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void HeapProfiler::onEntry(pid_t tid, Space &space, Kind kind, user_regs_struct const &regs)
+{
+  errno = 0;
+  unsigned long const returnAddr = ptrace(PTRACE_PEEKDATA, tid, regs.rsp, 0);
+  if (errno != 0 || space.entries.count(returnAddr) || internalCall(tid, space, returnAddr))
+  {
+    return;
+  }
+
+  unsigned long size(0);
+  switch (kind)
+  {
+  case Malloc:
+    size = regs.rdi;
+    break;
+  case Calloc:
+    size = regs.rdi * regs.rsi;
+    break;
+  case Realloc:
+    frees += (regs.rdi != 0);
+    release(space, regs.rdi);
+    if (regs.rdi != 0 && regs.rsi == 0)
+      return;    // just a free
+    size = regs.rsi;
+    break;
+  case Free:
+    frees += (regs.rdi != 0);
+    release(space, regs.rdi);
+    return;
+  }
+
+  ++allocations;
+  bytes += size;
+  std::pair<long, unsigned long long> &bucket = rate[elapsed.usec() / Bucket];
+  ++bucket.first;
+  bucket.second += size;
+  double weight(1);
+  if (sample != 1)
+  {
+    untilSample -= size;
+    if (untilSample > 0)
+      return;
+    untilSample = std::exponential_distribution<double>(1.0 / sample)(random);
+    weight = 1 / -std::expm1(-static_cast<double>(size) / sample);
+  }
+
+  size_t const image = images.imageOf(tid);
+  std::vector<unsigned long> pcs;
+  unwindStack(tid, images[image].modules, regs, pcs, SiteDepth + 1);
+  pcs.erase(pcs.begin());    // the allocation function itself
+  std::pair<std::map<std::pair<size_t, std::vector<unsigned long> >, size_t>::iterator, bool> const it =
+    siteIndex.insert(std::make_pair(std::make_pair(image, pcs), sites.size()));
+  if (it.second)
+  {
+    Site const site = { image, pcs, 0, 0, 0, 0 };
+    sites.push_back(site);
+  }
+
+  if (ptrace(PTRACE_POKEDATA, tid, regs.rsp, regs.rip) == -1)
+  {
+    return;
+  }
+  Call const call = { regs.rip, returnAddr, regs.rsp + sizeof(long), size, weight, it.first->second };
+  calls[tid].push_back(call);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// A return reaches the entry with the stack pointer just above the
+// slot that held the entry address, which a new call cannot have while
+// the sampled call is pending, unless the stack was unwound past it;
+// the slot is checked too so a stale record is not taken for a return.
+bool HeapProfiler::onReturn(pid_t tid, Space &space, unsigned long addr, user_regs_struct &regs)
+{
+  std::map<pid_t, std::vector<Call> >::iterator const it = calls.find(tid);
+  if (it == calls.end())
+  {
+    return false;
+  }
+  std::vector<Call> &pending = it->second;
+  for (size_t idx = pending.size(); idx-- != 0;)
+  {
+    Call const call = pending[idx];
+    if (call.entry != addr || call.sp != regs.rsp)
+      continue;
+    errno = 0;
+    unsigned long const slot = ptrace(PTRACE_PEEKDATA, tid, regs.rsp - sizeof(long), 0);
+    if (errno != 0 || slot != addr)
+      return false;
+    pending.erase(pending.begin() + idx);
+    regs.rip = call.returnAddr;
+    if (regs.rax != 0)
+    {
+      Block const block = { std::llround(call.size * call.weight), call.site };
+      space.blocks[regs.rax] = block;
+      Site &site = sites[call.site];
+      site.count += call.weight;
+      site.bytes += call.size * call.weight;
+      site.live += block.estimate;
+      site.peak = std::max(site.peak, site.live);
+      live += block.estimate;
+      peak = std::max(peak, live);
+    }
+    return true;
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool HeapProfiler::internalCall(pid_t tid, Space &space, unsigned long pc)
+{
+  std::map<unsigned long, bool>::const_iterator const it = space.internal.find(pc);
+  if (it != space.internal.end())
+  {
+    return it->second;
+  }
+  ProcessModules &modules = images[images.imageOf(tid)].modules;
+  ProcessModules::Module const *module = modules.find(pc - 1);
+  if (!module)
+  {
+    modules.refresh();
+    module = modules.find(pc - 1);
+  }
+  bool internal(false);
+  long const vaddr = module ? modules.toVaddr(*module, pc - 1) : -1;
+  if (vaddr != -1)
+  {
+    ElfSymbols::Symbol const *symbol = ElfSymbols::get(module->path)->find(vaddr);
+    internal = symbol && kindOf(symbol->name) != -1;
+  }
+  space.internal[pc] = internal;
+  return internal;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void HeapProfiler::release(Space &space, unsigned long addr)
+{
+  std::map<unsigned long, Block>::iterator const it = space.blocks.find(addr);
+  if (it == space.blocks.end())
+  {
+    return;
+  }
+  sites[it->second.site].live -= it->second.estimate;
+  live -= it->second.estimate;
+  space.blocks.erase(it);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// The trace loop makes the step, and handles whatever ends it before
+// any other stop, so the int3 is normally missing for one instruction.
+// A step can still be overtaken, eg by a signal whose handler hits the
+// same breakpoint, so the int3 waits for the last task stepping over it.
+void HeapProfiler::stepOver(pid_t tid, Space &space, user_regs_struct const &regs, unsigned long addr,
+                            unsigned char original)
+{
+  if (!poke(tid, addr, original, 0) || ptrace(PTRACE_SETREGS, tid, 0, &regs) == -1)
+  {
+    return;
+  }
+  stepping[tid] = addr;
+  ++space.steps[addr];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool HeapProfiler::SingleStep(pid_t pid)
+{
+  return stepping.count(pid) != 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// A thread cannot die alone during a step: exit_group, exec and fatal
+// signals take the whole process, so after an exit the int3 is only
+// needed by a vfork parent sharing the memory. That may be running,
+// so it is written through /proc rather than with ptrace.
+void HeapProfiler::stepped(pid_t tid, size_t space, bool exited)
+{
+  std::map<pid_t, unsigned long>::iterator const it = stepping.find(tid);
+  if (it == stepping.end())
+  {
+    return;
+  }
+  unsigned long const addr = it->second;
+  stepping.erase(it);
+  Space &current = spaces[space];
+  if (--current.steps[addr] != 0)
+  {
+    return;
+  }
+  current.steps.erase(addr);
+  if (!current.entries.count(addr))
+  {
+    return;
+  }
+  if (!exited)
+  {
+    poke(tid, addr, Int3, 0);
+    return;
+  }
+  for (std::map<pid_t, size_t>::const_iterator task = tasks.begin(); task != tasks.end(); ++task)
+  {
+    if (task->second != space || images.processOf(task->first) == images.processOf(tid))
+      continue;
+    int const fd = open(procName(task->first, "mem").c_str(), O_WRONLY);
+    if (fd != -1)
+    {
+      bool const written = pwrite(fd, &Int3, 1, addr) == 1;
+      close(fd);
+      if (written)
+        return;
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void HeapProfiler::Report(std::ostream &os)
+{
+  os << "\nHeap allocations: " << allocations << " calls for " << bytes << " bytes, " << frees << " frees";
+  if (sample != 1)
+  {
+    os << "\nSampled on average once in " << sample << " allocated bytes, so the live and peak bytes"
+       << " are estimates;\nevery call still paid for a breakpoint on entry";
+  }
+  os << "\nLive at exit: " << live << " bytes, peak " << peak << " bytes\n";
+  if (steps != 0)
+  {
+    os << "Note: " << steps << " calls had their entry instruction single-stepped with the breakpoint"
+       << " lifted, so calls by other threads meanwhile were missed: counts are lower bounds\n";
+  }
+
+  std::vector<std::pair<long long, size_t> > byPeakBytes;
+  for (size_t idx = 0; idx != sites.size(); ++idx)
+  {
+    byPeakBytes.push_back(std::make_pair(sites[idx].peak, idx));
+  }
+  std::stable_sort(byPeakBytes.begin(), byPeakBytes.end(), byPeak);
+  if (!byPeakBytes.empty())
+  {
+    os << "\nAllocation sites by peak bytes\n"
+       << "   peak KiB   live KiB    allocs  call site\n";
+  }
+  for (size_t idx = 0; idx != byPeakBytes.size() && idx != TopCount; ++idx)
+  {
+    Site const &site = sites[byPeakBytes[idx].second];
+    ProcessModules const &modules = images[site.image].modules;
+    os << kib(site.peak) << kib(site.live) << std::setw(10) << std::llround(site.count) << "  "
+       << (site.pcs.empty() ? std::string("?") : modules.describe(site.pcs[0])) << '\n';
+    for (size_t frame = 1; frame < site.pcs.size(); ++frame)
+    {
+      os << std::setw(45) << "" << modules.function(site.pcs[frame]) << '\n';
+    }
+  }
+
+  if (!rate.empty())
+  {
+    // Merge the buckets so the table has at most RateRows rows
+    usec const first = rate.begin()->first;
+    usec const span = rate.rbegin()->first - first + 1;
+    usec const width = (span + RateRows - 1) / RateRows;
+    std::map<usec, std::pair<long, unsigned long long> > rows;
+    for (std::map<usec, std::pair<long, unsigned long long> >::const_iterator it = rate.begin(); it != rate.end(); ++it)
+    {
+      std::pair<long, unsigned long long> &row = rows[first + (it->first - first) / width * width];
+      row.first += it->second.first;
+      row.second += it->second.second;
+    }
+    os << "\nAllocation rate (" << width * Bucket / 1000 << " msec intervals)\n"
+       << "     msecs    allocs        bytes\n";
+    for (std::map<usec, std::pair<long, unsigned long long> >::const_iterator it = rows.begin(); it != rows.end(); ++it)
+    {
+      os << std::setw(10) << it->first * Bucket / 1000 << std::setw(10) << it->second.first
+         << std::setw(13) << it->second.second << '\n';
+    }
+  }
+}
@@ -0,0 +1,175 @@
+#ifndef HEAP_PROFILER_H
+#define HEAP_PROFILER_H
+
+/**@file
+
+  Heap allocation profiler for ProcessTracer
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "ProcessImages.h"
+#include "TraceListener.h"
+#include "TraceUtils.h"
+
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+struct user_regs_struct;
+
+/** Break on entry to malloc, calloc, realloc, free and the global
+ * operators new and delete, and on return from sampled allocations,
+ * to keep a table of live blocks by call site */
+class HeapProfiler : public TraceListener
+{
+public:
+  /** Record the call site and result of allocations sampled on
+   * average once in every 'sample' bytes; 1 records every allocation */
+  explicit HeapProfiler(unsigned long sample);
+
+  void OnStart(pid_t pid) override;
+  void OnFork(pid_t parent, pid_t child, int event) override;
+  void OnExec(pid_t pid) override;
+  void OnExit(pid_t pid, int status) override;
+  void OnTrap(pid_t pid) override;
+  bool SingleStep(pid_t pid) override;
+  bool SelectedCall(int func) override;
+  void OnCallExit(pid_t pid, int func, long const args[], long rc) override;
+  void Report(std::ostream &os) override;
+
+private:
+  /** Times are in microseconds since the tracer started */
+  typedef long long usec;
+
+  /** Width of the buckets in which allocations are counted */
+  static usec const Bucket = 10000;
+
+  /** The allocation functions, by where their arguments are */
+  enum Kind
+  {
+    Malloc,      // size in rdi, as for operator new
+    Calloc,      // count in rdi, size in rsi
+    Realloc,     // pointer in rdi, size in rsi
+    Free         // pointer in rdi, as for operator delete
+  };
+
+  /** A breakpoint on the entry of an allocation function, which is
+   * also where its sampled calls return to */
+  struct Entry
+  {
+    Kind kind;
+    unsigned long code;    // the original bytes at the entry
+  };
+
+  /** A live block */
+  struct Block
+  {
+    long long estimate;    // the bytes it stands for
+    size_t site;
+  };
+
+  /** The breakpoints and live blocks in one address space, shared by
+   * threads and vfork children */
+  struct Space
+  {
+    std::map<unsigned long, Entry> entries;
+    std::map<unsigned long, bool> internal;     // return address => inside an allocation function
+    std::map<unsigned long, Block> blocks;      // address => live block
+    std::map<unsigned long, int> steps;         // breakpoint => tasks stepping over it
+    std::set<std::pair<std::string, unsigned long> > mapped;  // (module, start) already done
+  };
+
+  /** A sampled allocation waiting for its function to return */
+  struct Call
+  {
+    unsigned long entry;   // the breakpoint put in place of the return address
+    unsigned long returnAddr;
+    unsigned long sp;      // stack pointer after the return
+    unsigned long size;
+    double weight;         // the allocations it stands for
+    size_t site;
+  };
+
+  /** The call stack of a set of allocations */
+  struct Site
+  {
+    size_t image;
+    std::vector<unsigned long> pcs;
+    double count;
+    double bytes;
+    long long live;
+    long long peak;
+  };
+
+  /** The address space of task 'tid', or 0 */
+  Space *spaceOf(pid_t tid);
+
+  /** Plant entry breakpoints, through stopped task 'tid', in any
+   * executable mappings of its address space not yet done */
+  void plant(pid_t tid);
+
+  /** An allocation function has been entered */
+  void onEntry(pid_t tid, Space &space, Kind kind, user_regs_struct const &regs);
+
+  /** Is the entry breakpoint at 'addr' reached by the return of a
+   * sampled call? If so, record it and set regs.rip to the real
+   * return address */
+  bool onReturn(pid_t tid, Space &space, unsigned long addr, user_regs_struct &regs);
+
+  /** Is the function containing return address 'pc' an allocation function? */
+  bool internalCall(pid_t tid, Space &space, unsigned long pc);
+
+  /** A block has been freed */
+  void release(Space &space, unsigned long addr);
+
+  /** Put back 'original' under the breakpoint at 'addr' and have the
+   * trace loop step the instruction there */
+  void stepOver(pid_t tid, Space &space, user_regs_struct const &regs, unsigned long addr,
+                unsigned char original);
+
+  /** Task 'tid' in address space 'space' has finished its step, or
+   * 'exited' during it; write the int3 back if no other task is stepping */
+  void stepped(pid_t tid, size_t space, bool exited);
+
+  unsigned long sample;
+  std::mt19937_64 random;
+  double untilSample;                // bytes to allocate before the next sample
+  Stopwatch elapsed;                 // since the start of tracing
+  ProcessImages images;
+  std::vector<Space> spaces;
+  std::map<pid_t, size_t> tasks;                      // thread id => address space
+  std::map<pid_t, std::vector<Call> > calls;          // thread id => pending sampled calls
+  std::map<pid_t, unsigned long> stepping;            // thread id => breakpoint being stepped
+  std::vector<Site> sites;
+  std::map<std::pair<size_t, std::vector<unsigned long> >, size_t> siteIndex;
+  std::map<usec, std::pair<long, unsigned long long> > rate;  // bucket => allocations, bytes
+  unsigned long long allocations;
+  unsigned long long frees;
+  unsigned long long steps;          // calls whose entry instruction was stepped
+  unsigned long long bytes;
+  long long live;
+  long long peak;
+};
+
+#endif // HEAP_PROFILER_H
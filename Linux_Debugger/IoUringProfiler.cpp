@@ -0,0 +1,449 @@
+/*
+NAME
+    IoUringProfiler
+
+DESCRIPTION
+    io_uring submission and completion decoder for ProcessTracer.
+
+    With io_uring the I/O itself makes no system calls: requests are
+    written to a submission queue (SQ) shared with the kernel and
+    results read from a completion queue (CQ). The only call seen is
+    io_uring_enter, which submits and waits.
+
+    The parameters returned by io_uring_setup give the layout of the
+    rings and the following mmap calls (or, with IORING_SETUP_NO_MMAP,
+    the addresses supplied to setup) give their location in the
+    tracee. At each io_uring_enter entry the SQ entries published
+    since the last look are decoded, reading the SQ array and entries
+    in bulk with process_vm_readv, and at both entry and exit the CQ
+    entries posted since the last look. Each completion is paired
+    with its submission by user_data.
+
+    Latency runs from the io_uring_enter which submitted an operation
+    to the stop at which its completion was first seen, so it is an
+    upper bound. Completions reaped and overwritten between stops
+    (more than the CQ size) are counted as lost. Rings polled by a
+    kernel thread (IORING_SETUP_SQPOLL) are decoded at the next
+    io_uring_enter, if any.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "IoUringProfiler.h"
+#include "TraceUtils.h"
+
+#include <string.h>
+#include <asm/unistd.h>
+#include <sys/ptrace.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// Definitions from kernel headers newer than some build hosts
+#ifndef IORING_SETUP_NO_MMAP
+#define IORING_SETUP_NO_MMAP (1U << 14)
+#endif
+#ifndef IORING_SETUP_NO_SQARRAY
+#define IORING_SETUP_NO_SQARRAY (1U << 16)
+#endif
+#ifndef IORING_CQE_F_NOTIF
+#define IORING_CQE_F_NOTIF (1U << 3)
+#endif
+
+namespace
+{
+  char const *const OpNames[] =
+  {
+    "NOP", "READV", "WRITEV", "FSYNC", "READ_FIXED", "WRITE_FIXED", "POLL_ADD", "POLL_REMOVE",
+    "SYNC_FILE_RANGE", "SENDMSG", "RECVMSG", "TIMEOUT", "TIMEOUT_REMOVE", "ACCEPT", "ASYNC_CANCEL",
+    "LINK_TIMEOUT", "CONNECT", "FALLOCATE", "OPENAT", "CLOSE", "FILES_UPDATE", "STATX", "READ",
+    "WRITE", "FADVISE", "MADVISE", "SEND", "RECV", "OPENAT2", "EPOLL_CTL", "SPLICE",
+    "PROVIDE_BUFFERS", "REMOVE_BUFFERS", "TEE", "SHUTDOWN", "RENAMEAT", "UNLINKAT", "MKDIRAT",
+    "SYMLINKAT", "LINKAT", "MSG_RING", "FSETXATTR", "SETXATTR", "FGETXATTR", "GETXATTR", "SOCKET",
+    "URING_CMD", "SEND_ZC", "SENDMSG_ZC", "READ_MULTISHOT", "WAITID", "FUTEX_WAIT", "FUTEX_WAKE",
+    "FUTEX_WAITV", "FIXED_FD_INSTALL", "FTRUNCATE", "BIND", "LISTEN",
+  };
+
+  std::string opName(int opcode)
+  {
+    if (opcode >= 0 && static_cast<size_t>(opcode) < sizeof(OpNames) / sizeof(OpNames[0]))
+    {
+      return OpNames[opcode];
+    }
+    std::ostringstream oss;
+    oss << "OP_" << opcode;
+    return oss.str();
+  }
+
+  /** Does a successful result of 'opcode' count bytes transferred? */
+  bool transfers(int opcode)
+  {
+    switch (opcode)
+    {
+    case IORING_OP_READV:
+    case IORING_OP_WRITEV:
+    case IORING_OP_READ_FIXED:
+    case IORING_OP_WRITE_FIXED:
+    case IORING_OP_SENDMSG:
+    case IORING_OP_RECVMSG:
+    case IORING_OP_READ:
+    case IORING_OP_WRITE:
+    case IORING_OP_SEND:
+    case IORING_OP_RECV:
+    case IORING_OP_SPLICE:
+    case IORING_OP_TEE:
+      return true;
+    }
+    return false;
+  }
+
+  /** The user_addr member which newer headers have in place of resv2 */
+  template <typename Offsets>
+  unsigned long userAddr(Offsets const &offsets)
+  {
+    unsigned long long addr;
+    memcpy(&addr, reinterpret_cast<char const *>(&offsets) + sizeof(offsets) - sizeof(addr), sizeof(addr));
+    return addr;
+  }
+
+  /** Read 'count' entries of 'size' bytes from the ring of 'entries'
+   * at 'base', starting from 'first' (which may wrap), into 'buffer' */
+  bool readRing(pid_t tid, unsigned long base, unsigned first, unsigned count,
+                unsigned entries, size_t size, std::vector<char> &buffer)
+  {
+    buffer.resize(count * size);
+    unsigned const slot = first & (entries - 1);
+    unsigned const before = std::min(count, entries - slot);
+    if (readRemote(tid, base + slot * size, &buffer[0], before * size) != before * size)
+    {
+      return false;
+    }
+    unsigned const after = count - before;
+    return after == 0 ||
+      readRemote(tid, base, &buffer[before * size], after * size) == after * size;
+  }
+
+  /** Read a 32-bit ring index at 'addr' */
+  bool readIndex(pid_t tid, unsigned long addr, unsigned &value)
+  {
+    return addr != 0 && readRemote(tid, addr, &value, sizeof(value)) == sizeof(value);
+  }
+
+  /** Percentile 'pct' of sorted values */
+  long long percentile(std::vector<long long> const &sorted, double pct)
+  {
+    if (sorted.empty())
+      return 0;
+    size_t const idx = static_cast<size_t>(pct / 100 * (sorted.size() - 1) + 0.5);
+    return sorted[idx];
+  }
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+IoUringProfiler::IoUringProfiler(std::string const &fileName)
+: fileName(fileName), lostSubmissions(0), lostCompletions(0), unmatched(0)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void IoUringProfiler::OnStart(pid_t pid)
+{
+  images.OnStart(pid);
+  if (!fileName.empty())
+  {
+    log.open(fileName.c_str());
+    log << "usecs,tid,event,op,fd,offset,len,user_data,res,latency_us\n";
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void IoUringProfiler::OnFork(pid_t parent, pid_t child, int event)
+{
+  images.OnFork(parent, child, event);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// io_uring descriptors are always close-on-exec
+void IoUringProfiler::OnExec(pid_t pid)
+{
+  images.OnExec(pid);
+  std::map<Key, Ring>::iterator it = rings.lower_bound(Key(pid, 0));
+  while (it != rings.end() && it->first.first == pid)
+  {
+    rings.erase(it++);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool IoUringProfiler::SelectedCall(int func)
+{
+  switch (func)
+  {
+  case __NR_io_uring_setup:
+  case __NR_io_uring_enter:
+  case __NR_mmap:
+  case __NR_close:
+    return true;
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void IoUringProfiler::OnCallEntry(pid_t pid, int func, long const args[])
+{
+  if (func == __NR_io_uring_enter)
+  {
+    if (Ring *ring = find(pid, args[0], args[3]))
+    {
+      completed(pid, *ring);
+      submitted(pid, *ring);
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void IoUringProfiler::OnCallExit(pid_t pid, int func, long const args[], long rc)
+{
+  pid_t const process = images.processOf(pid);
+  switch (func)
+  {
+  case __NR_io_uring_setup:
+    if (rc >= 0)
+    {
+      Ring ring = Ring();
+      if (readRemote(pid, args[1], &ring.params, sizeof(ring.params)) != sizeof(ring.params))
+        break;
+      if (ring.params.flags & IORING_SETUP_NO_MMAP)
+      {
+        // The application supplied the memory: SQ entries, then both rings
+        ring.sqes = userAddr(ring.params.sq_off);
+        ring.sqRing = ring.cqRing = userAddr(ring.params.cq_off);
+      }
+      rings[Key(process, rc)] = ring;
+    }
+    break;
+  case __NR_mmap:
+    if (rc >= 0 || rc < -4095)
+    {
+      std::map<Key, Ring>::iterator const it = rings.find(Key(process, args[4]));
+      if (it == rings.end())
+        break;
+      Ring &ring = it->second;
+      switch (static_cast<unsigned long long>(args[5]) & IORING_OFF_MMAP_MASK)
+      {
+      case IORING_OFF_SQ_RING:
+        ring.sqRing = rc;
+        if (ring.params.features & IORING_FEAT_SINGLE_MMAP)
+          ring.cqRing = rc;
+        break;
+      case IORING_OFF_CQ_RING:
+        ring.cqRing = rc;
+        break;
+      case IORING_OFF_SQES:
+        ring.sqes = rc;
+        break;
+      }
+    }
+    break;
+  case __NR_io_uring_enter:
+    if (Ring *ring = find(pid, args[0], args[3]))
+    {
+      completed(pid, *ring);
+    }
+    break;
+  case __NR_close:
+    if (rc == 0)
+      rings.erase(Key(process, args[0]));
+    break;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// A registered ring is entered by its index rather than a descriptor:
+// assume it is the only ring in the process
+IoUringProfiler::Ring *IoUringProfiler::find(pid_t tid, int fd, long flags)
+{
+  pid_t const process = images.processOf(tid);
+  std::map<Key, Ring>::iterator it = rings.find(Key(process, fd));
+  if (it == rings.end() && (flags & IORING_ENTER_REGISTERED_RING))
+  {
+    it = rings.lower_bound(Key(process, 0));
+    if (it == rings.end() || it->first.first != process)
+      return 0;
+    std::map<Key, Ring>::iterator next = it;
+    if (++next != rings.end() && next->first.first == process)
+      return 0;
+  }
+  return (it == rings.end()) ? 0 : &it->second;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void IoUringProfiler::submitted(pid_t tid, Ring &ring)
+{
+  io_uring_params const &params = ring.params;
+  unsigned tail(0);
+  if (!ring.sqes || !readIndex(tid, ring.sqRing + params.sq_off.tail, tail))
+  {
+    return;
+  }
+  unsigned count = tail - ring.sqSeen;
+  if (count > params.sq_entries)
+  {
+    lostSubmissions += count - params.sq_entries;
+    ring.sqSeen = tail - params.sq_entries;
+    count = params.sq_entries;
+  }
+  if (count == 0)
+  {
+    return;
+  }
+
+  // The SQ array maps ring positions to entries, unless it was disabled
+  std::vector<char> indexes;
+  bool const indirect = !(params.flags & IORING_SETUP_NO_SQARRAY);
+  if (indirect &&
+      !readRing(tid, ring.sqRing + params.sq_off.array, ring.sqSeen, count, params.sq_entries, sizeof(unsigned), indexes))
+  {
+    return;
+  }
+  size_t const sqeSize = (params.flags & IORING_SETUP_SQE128) ? 2 * sizeof(io_uring_sqe) : sizeof(io_uring_sqe);
+  std::vector<char> sqes;
+  if (!readRing(tid, ring.sqes, 0, params.sq_entries, params.sq_entries, sqeSize, sqes))
+  {
+    return;
+  }
+
+  usec const time = elapsed.usec();
+  for (unsigned idx = 0; idx != count; ++idx)
+  {
+    unsigned slot = (ring.sqSeen + idx) & (params.sq_entries - 1);
+    if (indirect)
+    {
+      memcpy(&slot, &indexes[idx * sizeof(unsigned)], sizeof(slot));
+      if (slot >= params.sq_entries)
+        continue;
+    }
+    io_uring_sqe sqe;
+    memcpy(&sqe, &sqes[slot * sqeSize], sizeof(sqe));
+    Operation &op = ring.inflight[sqe.user_data];
+    op.opcode = sqe.opcode;
+    op.submitted = time;
+    if (log.is_open())
+    {
+      log << time << ',' << tid << ",submit," << opName(sqe.opcode) << ',' << sqe.fd << ','
+          << sqe.off << ',' << sqe.len << ',' << sqe.user_data << ",,\n";
+    }
+  }
+  ring.sqSeen = tail;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void IoUringProfiler::completed(pid_t tid, Ring &ring)
+{
+  io_uring_params const &params = ring.params;
+  unsigned tail(0);
+  if (!readIndex(tid, ring.cqRing + params.cq_off.tail, tail))
+  {
+    return;
+  }
+  unsigned count = tail - ring.cqSeen;
+  if (count > params.cq_entries)
+  {
+    lostCompletions += count - params.cq_entries;
+    ring.cqSeen = tail - params.cq_entries;
+    count = params.cq_entries;
+  }
+  if (count == 0)
+  {
+    return;
+  }
+  size_t const cqeSize = (params.flags & IORING_SETUP_CQE32) ? 2 * sizeof(io_uring_cqe) : sizeof(io_uring_cqe);
+  std::vector<char> cqes;
+  if (!readRing(tid, ring.cqRing + params.cq_off.cqes, ring.cqSeen, count, params.cq_entries, cqeSize, cqes))
+  {
+    return;
+  }
+
+  usec const time = elapsed.usec();
+  for (unsigned idx = 0; idx != count; ++idx)
+  {
+    io_uring_cqe cqe;
+    memcpy(&cqe, &cqes[idx * cqeSize], sizeof(cqe));
+    if (cqe.flags & IORING_CQE_F_NOTIF)
+    {
+      continue;   // zero copy buffer release, not a result
+    }
+    std::map<unsigned long long, Operation>::iterator const it = ring.inflight.find(cqe.user_data);
+    if (it == ring.inflight.end())
+    {
+      ++unmatched;
+      continue;
+    }
+    usec const latency = time - it->second.submitted;
+    Total &total = totals[it->second.opcode];
+    total.latencies.push_back(latency);
+    if (cqe.res < 0)
+      ++total.errors;
+    else if (transfers(it->second.opcode))
+      total.bytes += cqe.res;
+    if (log.is_open())
+    {
+      log << time << ',' << tid << ",complete," << opName(it->second.opcode) << ",,,,"
+          << cqe.user_data << ',' << cqe.res << ',' << latency << '\n';
+    }
+    // Multishot requests stay armed while more completions are to come
+    if (!(cqe.flags & IORING_CQE_F_MORE))
+    {
+      ring.inflight.erase(it);
+    }
+  }
+  ring.cqSeen = tail;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void IoUringProfiler::Report(std::ostream &os)
+{
+  if (!fileName.empty() && !log)
+  {
+    os << "Unable to write io_uring operations to " << fileName << std::endl;
+  }
+  os << "\nio_uring operations\n"
+     << "  op                  count    errors         bytes    p50 us    p99 us    max us\n";
+  for (std::map<int, Total>::iterator it = totals.begin(); it != totals.end(); ++it)
+  {
+    std::vector<usec> &latencies = it->second.latencies;
+    std::sort(latencies.begin(), latencies.end());
+    os << "  " << std::left << std::setw(16) << opName(it->first) << std::right
+       << std::setw(9) << latencies.size() << std::setw(10) << it->second.errors
+       << std::setw(14) << it->second.bytes
+       << std::setw(10) << percentile(latencies, 50) << std::setw(10) << percentile(latencies, 99)
+       << std::setw(10) << latencies.back() << '\n';
+  }
+
+  size_t pending(0);
+  for (std::map<Key, Ring>::const_iterator it = rings.begin(); it != rings.end(); ++it)
+  {
+    pending += it->second.inflight.size();
+  }
+  if (pending || unmatched || lostSubmissions || lostCompletions)
+  {
+    os << pending << " operations still in flight, " << unmatched << " completions not matched, "
+       << lostSubmissions << " submissions and " << lostCompletions << " completions overwritten unseen\n";
+  }
+}
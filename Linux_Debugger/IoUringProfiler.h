@@ -0,0 +1,112 @@
+#ifndef IO_URING_PROFILER_H
+#define IO_URING_PROFILER_H
+
+/**@file
+
+  io_uring submission and completion decoder for ProcessTracer
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "ProcessImages.h"
+#include "TraceListener.h"
+#include "TraceUtils.h"
+
+#include <linux/io_uring.h>
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** Decode the operations submitted to and completed by each io_uring
+ * in the traced processes, by reading the shared rings at each
+ * io_uring_enter, and report their latency */
+class IoUringProfiler : public TraceListener
+{
+public:
+  /** Log each operation to 'fileName', if not empty */
+  explicit IoUringProfiler(std::string const &fileName);
+
+  void OnStart(pid_t pid) override;
+  void OnFork(pid_t parent, pid_t child, int event) override;
+  void OnExec(pid_t pid) override;
+  bool SelectedCall(int func) override;
+  void OnCallEntry(pid_t pid, int func, long const args[]) override;
+  void OnCallExit(pid_t pid, int func, long const args[], long rc) override;
+  void Report(std::ostream &os) override;
+
+private:
+  /** Times are in microseconds since the tracer started */
+  typedef long long usec;
+
+  /** A submitted operation awaiting completion */
+  struct Operation
+  {
+    int opcode;
+    usec submitted;
+  };
+
+  /** One io_uring and what has been decoded from it */
+  struct Ring
+  {
+    io_uring_params params;
+    unsigned long sqRing;   // addresses of the mappings in the tracee
+    unsigned long cqRing;
+    unsigned long sqes;
+    unsigned sqSeen;        // ring positions decoded so far
+    unsigned cqSeen;
+    std::map<unsigned long long, Operation> inflight;  // by user_data
+  };
+
+  /** Results for one opcode */
+  struct Total
+  {
+    long errors;
+    long long bytes;
+    std::vector<usec> latencies;
+  };
+
+  /** A ring is identified by process and file descriptor */
+  typedef std::pair<pid_t, int> Key;
+
+  /** The ring used by task 'tid' with io_uring_enter 'fd' and 'flags', or 0 */
+  Ring *find(pid_t tid, int fd, long flags);
+
+  /** Decode the entries added to the submission queue since last time */
+  void submitted(pid_t tid, Ring &ring);
+
+  /** Decode the entries added to the completion queue since last time */
+  void completed(pid_t tid, Ring &ring);
+
+  std::string fileName;
+  std::ofstream log;
+  Stopwatch elapsed;                 // since the start of tracing
+  ProcessImages images;
+  std::map<Key, Ring> rings;
+  std::map<int, Total> totals;       // by opcode
+  long lostSubmissions;              // overwritten before they were seen
+  long lostCompletions;
+  long unmatched;                    // completions with no known submission
+};
+
+#endif // IO_URING_PROFILER_H
@@ -0,0 +1,448 @@
+/*
+NAME
+    MemoryTimeline
+
+DESCRIPTION
+    Memory footprint timeline for ProcessTracer.
+
+    Each image (a process between execs) starts from a snapshot of
+    /proc/<pid>/maps, taken when it first makes a call of interest,
+    and the successful mmap, munmap, mremap and brk calls are then
+    applied to an interval map of its address space.
+
+    The series is CSV with one row per change, limited to one row
+    per process every Interval and a last row when the image ends:
+      msecs,pid,anon_kb,file_kb,heap_kb,released_kb
+    where heap is the brk area (not included in anon) and released
+    is the running total given back with madvise. When statm is
+    sampled each row adds size_kb,resident_kb,shared_kb from
+    /proc/<pid>/statm.
+
+    Mappings of LargeMapping bytes or more made during the trace are
+    attributed to the first return address outside the module making
+    the call (so the caller of malloc, rather than malloc itself).
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "MemoryTimeline.h"
+#include "StackUnwinder.h"
+#include "TraceUtils.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <asm/unistd.h>
+#include <sys/mman.h>
+#include <sys/user.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+  /** Number of entries shown in the list of live mappings */
+  size_t const TopCount = 10;
+
+  unsigned long const PageSize = sysconf(_SC_PAGESIZE);
+
+  /** Round 'len' up to a whole number of pages */
+  unsigned long pages(unsigned long len)
+  {
+    return (len + PageSize - 1) & ~(PageSize - 1);
+  }
+
+  /** A large mapping for the report */
+  struct Live
+  {
+    unsigned long size;
+    size_t image;
+    unsigned long start;
+  };
+
+  bool bySize(Live const &lhs, Live const &rhs)
+  {
+    return lhs.size > rhs.size;
+  }
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+MemoryTimeline::MemoryTimeline(std::string const &fileName, bool statm)
+: fileName(fileName), statm(statm)
+{
+  series << "msecs,pid,anon_kb,file_kb,heap_kb,released_kb";
+  if (statm)
+  {
+    series << ",size_kb,resident_kb,shared_kb";
+  }
+  series << '\n';
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void MemoryTimeline::OnStart(pid_t pid)
+{
+  images.OnStart(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void MemoryTimeline::OnFork(pid_t parent, pid_t child, int event)
+{
+  images.OnFork(parent, child, event);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void MemoryTimeline::OnExec(pid_t pid)
+{
+  finish(images.processOf(pid));
+  images.OnExec(pid);
+  sites.erase(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void MemoryTimeline::OnExit(pid_t pid, int status)
+{
+  if (images.processOf(pid) == pid)
+  {
+    finish(pid);
+  }
+  sites.erase(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool MemoryTimeline::SelectedCall(int func)
+{
+  switch (func)
+  {
+  case __NR_mmap:
+  case __NR_munmap:
+  case __NR_mremap:
+  case __NR_brk:
+  case __NR_madvise:
+  case __NR_exit_group:
+    return true;
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// Write any pending row while /proc/<pid>/statm can still be read
+void MemoryTimeline::OnCallEntry(pid_t pid, int func, long const args[])
+{
+  if (func == __NR_exit_group)
+  {
+    size_t image;
+    Memory &memory = memoryOf(pid, image);
+    row(image, memory, true);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// The stack is only unwound for large mappings, whose length is known at entry
+void MemoryTimeline::OnCallRegisters(pid_t pid, int func, user_regs_struct const &regs)
+{
+  unsigned long const len = (func == __NR_mmap) ? regs.rsi : (func == __NR_mremap) ? regs.rdx : 0;
+  if (len < LargeMapping)
+  {
+    return;
+  }
+  ProcessModules &modules = images[images.imageOf(pid)].modules;
+  std::vector<unsigned long> pcs;
+  unwindStack(pid, modules, regs, pcs);
+  ProcessModules::Module const *inner = modules.find(regs.rip);
+  unsigned long site = pcs.size() > 1 ? pcs[1] : 0;
+  for (size_t idx = 1; idx != pcs.size(); ++idx)
+  {
+    if (modules.find(pcs[idx] - 1) != inner)
+    {
+      site = pcs[idx];
+      break;
+    }
+  }
+  sites[pid] = site;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void MemoryTimeline::OnCallExit(pid_t pid, int func, long const args[], long rc)
+{
+  unsigned long site(0);
+  std::map<pid_t, unsigned long>::iterator const it = sites.find(pid);
+  if (it != sites.end())
+  {
+    site = it->second;
+    sites.erase(it);
+  }
+  // All these calls return an error in the range -4095 to -1
+  if (rc < 0 && rc >= -4095)
+  {
+    return;
+  }
+
+  size_t image;
+  Memory &memory = memoryOf(pid, image);
+  switch (func)
+  {
+  case __NR_mmap:
+    {
+      Region region;
+      region.end = rc + pages(args[1]);
+      region.anon = (args[3] & MAP_ANONYMOUS) != 0;
+      region.traced = true;
+      region.site = site;
+      if (!region.anon)
+      {
+        std::ostringstream oss;
+        oss << "fd/" << args[4];
+        region.name = readLink(procName(pid, oss.str()));
+      }
+      map(memory, rc, region);
+    }
+    break;
+  case __NR_munmap:
+    unmap(memory, args[0], args[0] + pages(args[1]));
+    break;
+  case __NR_mremap:
+    {
+      // The moved mapping keeps its origin
+      Region region;
+      region.anon = true;
+      region.traced = true;
+      region.site = site;
+      std::map<unsigned long, Region>::const_iterator old = memory.regions.upper_bound(args[0]);
+      if (old != memory.regions.begin() && (--old)->second.end > static_cast<unsigned long>(args[0]))
+      {
+        region = old->second;
+        if (!region.site)
+          region.site = site;
+      }
+      unmap(memory, args[0], args[0] + pages(args[1]));
+      region.end = rc + pages(args[2]);
+      map(memory, rc, region);
+    }
+    break;
+  case __NR_brk:
+    if (memory.heapStart == 0)
+    {
+      memory.heapStart = rc;
+    }
+    if (memory.heapEnd != static_cast<unsigned long>(rc))
+    {
+      memory.heapEnd = rc;
+      memory.dirty = true;
+    }
+    break;
+  case __NR_madvise:
+    if (args[2] == MADV_DONTNEED || args[2] == MADV_FREE || args[2] == MADV_REMOVE)
+    {
+      memory.released += pages(args[1]);
+      memory.dirty = true;
+    }
+    break;
+  }
+  row(image, memory, false);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+MemoryTimeline::Memory &MemoryTimeline::memoryOf(pid_t tid, size_t &image)
+{
+  image = images.imageOf(tid);
+  std::map<size_t, Memory>::iterator const it = memories.find(image);
+  if (it != memories.end())
+  {
+    return it->second;
+  }
+
+  Memory &memory = memories[image];
+  memory.anon = memory.file = 0;
+  memory.heapStart = memory.heapEnd = 0;
+  memory.released = 0;
+  memory.lastRow = -Interval;
+  memory.dirty = true;
+  memory.finished = false;
+
+  // Lines are: start-end perms offset dev inode [path]
+  std::ifstream ifs(procName(images[image].pid, "maps").c_str());
+  std::string line;
+  while (std::getline(ifs, line))
+  {
+    std::istringstream iss(line);
+    std::string range, perms, offset, dev, path;
+    unsigned long inode(0);
+    if (!(iss >> range >> perms >> offset >> dev >> inode))
+      continue;
+    std::getline(iss >> std::ws, path);
+    char *end(0);
+    unsigned long const low = strtoul(range.c_str(), &end, 16);
+    unsigned long const high = strtoul(end + 1, 0, 16);
+    if (path == "[heap]")
+    {
+      memory.heapStart = low;
+      memory.heapEnd = high;
+    }
+    else if (path != "[vvar]" && path != "[vdso]" && path != "[vsyscall]")
+    {
+      Region region;
+      region.end = high;
+      region.anon = (inode == 0);
+      region.traced = false;
+      region.site = 0;
+      region.name = path;
+      map(memory, low, region);
+    }
+  }
+  return memory;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void MemoryTimeline::map(Memory &memory, unsigned long start, Region const &region)
+{
+  unmap(memory, start, region.end);
+  memory.regions[start] = region;
+  (region.anon ? memory.anon : memory.file) += region.end - start;
+  memory.dirty = true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// Regions overlapping the ends of the range are split
+void MemoryTimeline::unmap(Memory &memory, unsigned long start, unsigned long end)
+{
+  std::map<unsigned long, Region>::iterator it = memory.regions.upper_bound(start);
+  if (it != memory.regions.begin())
+  {
+    --it;
+    if (it->second.end <= start)
+      ++it;
+  }
+  while (it != memory.regions.end() && it->first < end)
+  {
+    unsigned long const low = it->first;
+    Region const region = it->second;
+    memory.regions.erase(it++);
+    unsigned long &total = region.anon ? memory.anon : memory.file;
+    total -= region.end - low;
+    if (low < start)
+    {
+      Region &left = memory.regions[low];
+      left = region;
+      left.end = start;
+      total += start - low;
+    }
+    if (region.end > end)
+    {
+      memory.regions[end] = region;
+      total += region.end - end;
+    }
+    memory.dirty = true;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void MemoryTimeline::row(size_t image, Memory &memory, bool force)
+{
+  usec const time = elapsed.usec();
+  if (!memory.dirty || (!force && time - memory.lastRow < Interval))
+  {
+    return;
+  }
+  memory.dirty = false;
+  memory.lastRow = time;
+  series << time / 1000 << ',' << images[image].pid << ','
+         << memory.anon / 1024 << ',' << memory.file / 1024 << ','
+         << (memory.heapEnd - memory.heapStart) / 1024 << ',' << memory.released / 1024;
+  if (statm)
+  {
+    // Values are in pages: size resident shared text lib data dt
+    std::ifstream ifs(procName(images[image].pid, "statm").c_str());
+    unsigned long size(0), resident(0), shared(0);
+    series << ',';
+    if (ifs >> size >> resident >> shared)
+      series << size * PageSize / 1024 << ',' << resident * PageSize / 1024 << ',' << shared * PageSize / 1024;
+    else
+      series << ",,";
+  }
+  series << '\n';
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void MemoryTimeline::finish(pid_t pid)
+{
+  for (std::map<size_t, Memory>::iterator it = memories.begin(); it != memories.end(); ++it)
+  {
+    if (!it->second.finished && images[it->first].pid == pid)
+    {
+      row(it->first, it->second, true);
+      it->second.finished = true;
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void MemoryTimeline::Report(std::ostream &os)
+{
+  for (std::map<size_t, Memory>::iterator it = memories.begin(); it != memories.end(); ++it)
+  {
+    if (!it->second.finished)
+      row(it->first, it->second, true);
+  }
+  if (fileName.empty())
+  {
+    os << "\nMemory timeline\n" << series.str();
+  }
+  else
+  {
+    std::ofstream ofs(fileName.c_str());
+    ofs << series.str();
+    if (!ofs)
+    {
+      os << "Unable to write memory timeline to " << fileName << std::endl;
+    }
+  }
+
+  std::vector<Live> live;
+  for (std::map<size_t, Memory>::const_iterator mem = memories.begin(); mem != memories.end(); ++mem)
+  {
+    std::map<unsigned long, Region> const &regions = mem->second.regions;
+    for (std::map<unsigned long, Region>::const_iterator it = regions.begin(); it != regions.end(); ++it)
+    {
+      if (it->second.traced && it->second.end - it->first >= LargeMapping)
+      {
+        Live const entry = { it->second.end - it->first, mem->first, it->first };
+        live.push_back(entry);
+      }
+    }
+  }
+  if (live.empty())
+  {
+    return;
+  }
+  std::stable_sort(live.begin(), live.end(), bySize);
+  os << "\nLargest mappings live at exit\n"
+     << "      size kB       pid  type  address             call site\n";
+  for (size_t idx = 0; idx != live.size() && idx != TopCount; ++idx)
+  {
+    ProcessImages::Image const &image = images[live[idx].image];
+    Region const &region = memories[live[idx].image].regions[live[idx].start];
+    os << std::setw(13) << live[idx].size / 1024 << std::setw(10) << image.pid
+       << (region.anon ? "  anon" : "  file")
+       << "  0x" << std::hex << std::left << std::setw(16) << live[idx].start << std::right << std::dec
+       << "  " << (region.site ? image.modules.describe(region.site) : "?");
+    if (!region.name.empty())
+      os << "  " << region.name;
+    os << '\n';
+  }
+}
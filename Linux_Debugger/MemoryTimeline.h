@@ -0,0 +1,115 @@
+#ifndef MEMORY_TIMELINE_H
+#define MEMORY_TIMELINE_H
+
+/**@file
+
+  Memory footprint timeline for ProcessTracer
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "ProcessImages.h"
+#include "TraceListener.h"
+#include "TraceUtils.h"
+
+#include <map>
+#include <sstream>
+#include <string>
+
+/** Follow the address space of each process through mmap, munmap,
+ * mremap, brk and madvise and record a time series of its size */
+class MemoryTimeline : public TraceListener
+{
+public:
+  /** Write the time series to 'fileName', or to the report stream
+   * if the name is empty; also sample /proc/<pid>/statm if 'statm' */
+  MemoryTimeline(std::string const &fileName, bool statm);
+
+  void OnStart(pid_t pid) override;
+  void OnFork(pid_t parent, pid_t child, int event) override;
+  void OnExec(pid_t pid) override;
+  void OnExit(pid_t pid, int status) override;
+  bool SelectedCall(int func) override;
+  void OnCallRegisters(pid_t pid, int func, user_regs_struct const &regs) override;
+  void OnCallEntry(pid_t pid, int func, long const args[]) override;
+  void OnCallExit(pid_t pid, int func, long const args[], long rc) override;
+  void Report(std::ostream &os) override;
+
+private:
+  /** Times are in microseconds since the tracer started */
+  typedef long long usec;
+
+  /** Mappings of at least this size are attributed to a call site */
+  static unsigned long const LargeMapping = 128 * 1024;
+
+  /** Minimum time between rows of the series for one process */
+  static usec const Interval = 10000;
+
+  /** A mapped range of addresses, keyed by its start address */
+  struct Region
+  {
+    unsigned long end;
+    bool anon;
+    bool traced;           // mapped during the trace
+    unsigned long site;    // return address of the call site, if large
+    std::string name;      // mapped file, if any
+  };
+
+  /** The address space of one image (a process between execs) */
+  struct Memory
+  {
+    std::map<unsigned long, Region> regions;
+    unsigned long anon;    // bytes
+    unsigned long file;
+    unsigned long heapStart;
+    unsigned long heapEnd;
+    unsigned long long released;   // bytes given back by madvise
+    usec lastRow;
+    bool dirty;            // changed since the last row
+    bool finished;
+  };
+
+  /** The memory of the image task 'tid' is running, read from /proc on first use */
+  Memory &memoryOf(pid_t tid, size_t &image);
+
+  /** Add [start, end) to the address space, replacing anything there */
+  void map(Memory &memory, unsigned long start, Region const &region);
+
+  /** Remove [start, end) from the address space */
+  void unmap(Memory &memory, unsigned long start, unsigned long end);
+
+  /** Add a row to the series for 'image' if it has changed since the
+   * last one and 'force' is set or the interval has passed */
+  void row(size_t image, Memory &memory, bool force);
+
+  /** The image of process 'pid' is ending */
+  void finish(pid_t pid);
+
+  std::string fileName;
+  bool statm;
+  Stopwatch elapsed;                 // since the start of tracing
+  ProcessImages images;
+  std::map<size_t, Memory> memories;     // image => memory
+  std::map<pid_t, unsigned long> sites;  // thread id => call site of a large mapping
+  std::ostringstream series;
+};
+
+#endif // MEMORY_TIMELINE_H
@@ -24,141 +24,57 @@ COPYRIGHT
 
 static char const szRCSID[] = "$Id: MultiPtrace.cpp 256 2020-04-09 21:35:25Z Roger $";
 
-#include <errno.h>
-#include <string.h>
-#include <unistd.h>
-#include <wait.h>
-#include <sys/ptrace.h>
+#include "TraceLoop.h"
 
 #include <iostream>
-#include <stdexcept>
-#include <string>
 
-namespace
-{
-  std::runtime_error make_error(std::string const &action)
-  {
-    std::string const what(action + " failed: " + strerror(errno));
-    return std::runtime_error(what);
-  }
-} // namespace
-
-/** Multi thread/process ptrace user */
+/** Multi thread/process ptrace user: a handler for TraceLoop::EventLoop */
 class MultiPtrace
 {
 private:
-  pid_t pid;
   std::ostream &os;
-  bool initialised;
 
 public:
   /** Create */
-  MultiPtrace(pid_t pid, std::ostream &os)
-  : pid(pid), os(os), initialised(false) {}
+  explicit MultiPtrace(std::ostream &os)
+  : os(os) {}
 
-  /** Run the debug loop */
-  void run();
+  /** The first stop when starting debugging */
+  void OnStart(pid_t pid) {}
 
-private:
-  /** Stop received */
-  int OnStop(int signal, int event);
+  /** Extension events from fork/vfork/clone */
+  void OnFork(pid_t pid, pid_t child, int event);
+
+  /** Signals */
+  int OnSignal(pid_t pid, int signal);
+
+  /** Task exited or was terminated */
+  void OnExit(pid_t pid, int status);
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
-void MultiPtrace::run()
+void MultiPtrace::OnFork(pid_t pid, pid_t child, int event)
 {
-  int status(0); // Status of the stopped child process
-
-  // This is the main tracing loop. When the child stops,
-  // we examine the system call and its arguments
-  while ((pid = waitpid(-1, &status, __WALL)) != -1)
-  {
-    int send_signal(0);
-    if (WIFSTOPPED(status))
-    {
-      send_signal = OnStop(WSTOPSIG(status), status >> 16);
-    }
-    else if (WIFEXITED(status))
-    {
-      os << "Exit(" << WEXITSTATUS(status) << ")" << std::endl;
-    }
-    else if (WIFSIGNALED(status))
-    {
-      os << "Terminated: signal " << WTERMSIG(status) << std::endl;
-    }
-    else if (WIFCONTINUED(status))
-    {
-      os << "Continued" << std::endl;
-    }
-    else
-    {
-      os << "Unexpected status: " << status << std::endl;
-    }
-
-    ptrace(PTRACE_CONT, pid, 0, send_signal);
-  }
-  if (errno != ECHILD)
-  {
-    throw make_error("waitpid");
-  }
+  os << "Event: " << event << std::endl;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
-// Handle the various types of ptrace 'stop' events 
-// 1) the first stop when starting debugging
-// 2) extension events from fork/vfork/clone
-// 3) signals
-//
-int MultiPtrace::OnStop(int signal, int event)
+int MultiPtrace::OnSignal(pid_t pid, int signal)
 {
-  if (!initialised)
-  {
-    initialised = true;
-    long const options =
-      PTRACE_O_TRACEFORK |
-      PTRACE_O_TRACEVFORK |
-      PTRACE_O_TRACECLONE;
-    if (ptrace(PTRACE_SETOPTIONS, pid, 0, options) == -1)
-    {
-      throw make_error("PTRACE_SETOPTIONS");
-    }
-    return 0;
-  }
-
-  if (event) 
-  {
-    os << "Event: " << event << std::endl;
-  }
-  else
-  {
-    os << "Signal: " << signal << std::endl;
-  }
+  os << "Signal: " << signal << std::endl;
   return (signal == SIGTRAP || signal == SIGSTOP) ? 0 : signal;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
-// Fork a child process, running under ptrace, and return its pid
-pid_t CreateProcess(int argc, char **argv)
+void MultiPtrace::OnExit(pid_t pid, int status)
 {
-  pid_t const cpid = fork();
-  if (cpid > 0)
-  {
-    // In the parent
-    return cpid; 
-  }
-  else if (cpid == 0)
+  if (WIFEXITED(status))
   {
-    // In the new child
-    if (ptrace(PTRACE_TRACEME, 0, 0, 0) == -1)
-    {
-      throw make_error("ptrace(PTRACE_TRACEME)");
-    }
-    execv( argv[0], argv );
-    throw make_error("execv");
+    os << "Exit(" << WEXITSTATUS(status) << ")" << std::endl;
   }
   else
   {
-    throw make_error("fork");
+    os << "Terminated: signal " << WTERMSIG(status) << std::endl;
   }
 }
 
@@ -176,8 +92,9 @@ int main(int argc, char **argv)
 
   try
   {
-    pid_t pid = CreateProcess(argc, argv);
-    MultiPtrace(pid, std::cerr).run();
+    pid_t pid = TraceLoop::CreateProcess(argc, argv);
+    MultiPtrace handler(std::cerr);
+    TraceLoop::EventLoop<MultiPtrace>(handler, pid).run();
     rc = 0;
   }
   catch ( std::exception &ex)
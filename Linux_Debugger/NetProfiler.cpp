@@ -0,0 +1,667 @@
+/*
+NAME
+    NetProfiler
+
+DESCRIPTION
+    Socket and network I/O profiler for ProcessTracer.
+
+    Sockets are followed from creation (socket, socketpair, accept)
+    through dup, fork and exec to close. The local and peer addresses
+    come from the addresses passed to bind, connect, accept and the
+    message calls, with the kernel's own tables in /proc/<pid>/net
+    filling in ephemeral ports.
+
+    Each connection counts transfers and bytes in each direction,
+    whether they use send/recv or plain read/write, and the time to
+    connect. Writes of up to SmallWrite bytes are counted, as are
+    those which directly follow another write on the same socket with
+    no read in between: a run of these could usually have been sent
+    as one.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "NetProfiler.h"
+#include "TraceUtils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <asm/unistd.h>
+#include <netinet/in.h>
+#include <sys/ptrace.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+  /** Short name for the protocol of a socket */
+  std::string protocol(int family, int type)
+  {
+    switch (family)
+    {
+    case AF_INET:
+    case AF_INET6:
+      {
+        std::string name = (type == SOCK_STREAM) ? "tcp" : (type == SOCK_DGRAM) ? "udp" : "ip";
+        return (family == AF_INET6) ? name + '6' : name;
+      }
+    case AF_UNIX:
+      return (type == SOCK_STREAM) ? "unix" : (type == SOCK_DGRAM) ? "unix-dgram" : "unix-seqpkt";
+    case AF_NETLINK:
+      return "netlink";
+    }
+    std::ostringstream oss;
+    oss << "af" << family;
+    return oss.str();
+  }
+
+  /** Readable form of the socket address 'addr', 'len' bytes long */
+  std::string formatAddress(sockaddr_storage const &addr, size_t len)
+  {
+    std::ostringstream oss;
+    char buffer[INET6_ADDRSTRLEN] = "";
+    switch (addr.ss_family)
+    {
+    case AF_INET:
+      {
+        sockaddr_in const &in = reinterpret_cast<sockaddr_in const &>(addr);
+        inet_ntop(AF_INET, &in.sin_addr, buffer, sizeof(buffer));
+        oss << buffer << ':' << ntohs(in.sin_port);
+      }
+      break;
+    case AF_INET6:
+      {
+        sockaddr_in6 const &in6 = reinterpret_cast<sockaddr_in6 const &>(addr);
+        inet_ntop(AF_INET6, &in6.sin6_addr, buffer, sizeof(buffer));
+        oss << '[' << buffer << "]:" << ntohs(in6.sin6_port);
+      }
+      break;
+    case AF_UNIX:
+      {
+        sockaddr_un const &un = reinterpret_cast<sockaddr_un const &>(addr);
+        size_t const pathLen = std::min(len, sizeof(un)) - offsetof(sockaddr_un, sun_path);
+        if (len <= offsetof(sockaddr_un, sun_path))
+          oss << "(unnamed)";
+        else if (un.sun_path[0] == '\0')
+          oss << '@' << std::string(un.sun_path + 1, pathLen - 1);   // abstract
+        else
+          oss << std::string(un.sun_path, strnlen(un.sun_path, pathLen));
+      }
+      break;
+    default:
+      oss << "(family " << addr.ss_family << ")";
+      break;
+    }
+    return oss.str();
+  }
+
+  /** Read and format the socket address at 'addr' in task 'tid' */
+  std::string readAddress(pid_t tid, long addr, long len)
+  {
+    if (addr == 0 || len <= 0)
+    {
+      return std::string();
+    }
+    sockaddr_storage storage;
+    memset(&storage, 0, sizeof(storage));
+    size_t const size = std::min(static_cast<size_t>(len), sizeof(storage));
+    if (readRemote(tid, addr, &storage, size) < offsetof(sockaddr_storage, ss_family) + sizeof(storage.ss_family))
+    {
+      return std::string();
+    }
+    return formatAddress(storage, size);
+  }
+
+  /** Parse an address from /proc/net/tcp and friends:
+   * hex words in host order, a colon, and the port in hex */
+  std::string procAddress(int family, std::string const &text)
+  {
+    std::string::size_type const colon = text.find(':');
+    if (colon == std::string::npos)
+    {
+      return std::string();
+    }
+    sockaddr_storage storage;
+    memset(&storage, 0, sizeof(storage));
+    storage.ss_family = family;
+    unsigned short const port = htons(strtoul(text.c_str() + colon + 1, 0, 16));
+    if (family == AF_INET && colon == 8)
+    {
+      sockaddr_in &in = reinterpret_cast<sockaddr_in &>(storage);
+      in.sin_addr.s_addr = strtoul(text.substr(0, 8).c_str(), 0, 16);
+      in.sin_port = port;
+    }
+    else if (family == AF_INET6 && colon == 32)
+    {
+      sockaddr_in6 &in6 = reinterpret_cast<sockaddr_in6 &>(storage);
+      for (int word = 0; word != 4; ++word)
+      {
+        uint32_t const value = strtoul(text.substr(word * 8, 8).c_str(), 0, 16);
+        memcpy(&in6.sin6_addr.s6_addr[word * 4], &value, sizeof(value));
+      }
+      in6.sin6_port = port;
+    }
+    else
+    {
+      return std::string();
+    }
+    return formatAddress(storage, sizeof(storage));
+  }
+
+  /** Inode of the socket 'fd' in task 'tid', or 0 */
+  unsigned long socketInode(pid_t tid, int fd)
+  {
+    std::ostringstream oss;
+    oss << "fd/" << fd;
+    std::string const target = readLink(procName(tid, oss.str()));
+    if (target.compare(0, 8, "socket:[") != 0)
+    {
+      return 0;
+    }
+    return strtoul(target.c_str() + 8, 0, 10);
+  }
+
+  /** Bucket in the write size distribution for 'bytes' */
+  size_t sizeBucket(long bytes, size_t buckets)
+  {
+    size_t bucket = 0;
+    while (bytes > 0 && bucket != buckets - 1)
+    {
+      bytes >>= 1;
+      ++bucket;
+    }
+    return bucket;
+  }
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+NetProfiler::NetProfiler()
+{
+  std::fill(sizes, sizes + SizeBuckets, 0);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void NetProfiler::OnStart(pid_t pid)
+{
+  images.OnStart(pid);
+  processes[pid];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// A forked child inherits (and so shares) the sockets of its parent
+void NetProfiler::OnFork(pid_t parent, pid_t child, int event)
+{
+  images.OnFork(parent, child, event);
+  if (images.processOf(child) == child)
+  {
+    Process *pproc = findProcess(parent);
+    processes[child] = pproc ? *pproc : Process();
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void NetProfiler::OnExec(pid_t pid)
+{
+  images.OnExec(pid);
+  Process *proc = findProcess(pid);
+  if (!proc)
+  {
+    return;
+  }
+  std::map<int, Socket>::iterator it = proc->fds.begin();
+  while (it != proc->fds.end())
+  {
+    if (it->second.cloexec)
+      proc->fds.erase(it++);
+    else
+      ++it;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void NetProfiler::OnExit(pid_t pid, int status)
+{
+  processes.erase(pid);
+  entries.erase(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool NetProfiler::SelectedCall(int func)
+{
+  switch (func)
+  {
+  case __NR_socket:
+  case __NR_socketpair:
+  case __NR_bind:
+  case __NR_listen:
+  case __NR_connect:
+  case __NR_accept:
+  case __NR_accept4:
+  case __NR_getsockopt:
+  case __NR_sendto:
+  case __NR_recvfrom:
+  case __NR_sendmsg:
+  case __NR_recvmsg:
+  case __NR_sendmmsg:
+  case __NR_recvmmsg:
+  case __NR_read:
+  case __NR_readv:
+  case __NR_write:
+  case __NR_writev:
+  case __NR_sendfile:
+  case __NR_close:
+  case __NR_dup:
+  case __NR_dup2:
+  case __NR_dup3:
+  case __NR_fcntl:
+    return true;
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void NetProfiler::OnCallEntry(pid_t pid, int func, long const args[])
+{
+  if (func == __NR_connect)
+  {
+    entries[pid] = elapsed.usec();
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void NetProfiler::OnCallExit(pid_t pid, int func, long const args[], long rc)
+{
+  Process *proc = findProcess(pid);
+  if (!proc)
+  {
+    return;
+  }
+  switch (func)
+  {
+  case __NR_socket:
+    if (rc >= 0)
+      add(pid, *proc, rc, args[0], args[1] & 0xf, (args[1] & SOCK_CLOEXEC) != 0);
+    break;
+  case __NR_socketpair:
+    if (rc == 0)
+    {
+      int fds[2];
+      if (readRemote(pid, args[3], fds, sizeof(fds)) == sizeof(fds))
+      {
+        for (int idx = 0; idx != 2; ++idx)
+        {
+          Connection &conn = add(pid, *proc, fds[idx], args[0], args[1] & 0xf, (args[1] & SOCK_CLOEXEC) != 0);
+          conn.local = conn.peer = "(socketpair)";
+        }
+      }
+    }
+    break;
+  case __NR_bind:
+    if (rc == 0)
+    {
+      if (Connection *conn = find(*proc, args[0]))
+      {
+        conn->local = readAddress(pid, args[1], args[2]);
+        if (conn->family != AF_UNIX)
+          lookup(pid, args[0], *conn);   // the kernel may have chosen the port
+      }
+    }
+    break;
+  case __NR_listen:
+    if (rc == 0)
+    {
+      if (Connection *conn = find(*proc, args[0]))
+      {
+        conn->listening = true;
+        lookup(pid, args[0], *conn);   // listen may have chosen the port
+      }
+    }
+    break;
+  case __NR_connect:
+    if (Connection *conn = find(*proc, args[0]))
+    {
+      if (rc == 0 || rc == -EINPROGRESS)
+      {
+        conn->peer = readAddress(pid, args[1], args[2]);
+        conn->connectStart = entries[pid];
+        if (rc == 0)
+          connected(pid, args[0], *conn);
+      }
+    }
+    entries.erase(pid);
+    break;
+  case __NR_accept:
+  case __NR_accept4:
+    if (rc >= 0)
+    {
+      Connection *listener = find(*proc, args[0]);
+      if (!listener)
+        break;
+      ++listener->accepted;
+      // Copy what is needed before adding to the vector
+      int const family = listener->family;
+      int const type = listener->type;
+      std::string const local = listener->local;
+      bool const cloexec = func == __NR_accept4 && (args[3] & SOCK_CLOEXEC);
+      Connection &conn = add(pid, *proc, rc, family, type, cloexec);
+      conn.local = local;
+      int len(0);
+      if (args[1] && args[2] && readRemote(pid, args[2], &len, sizeof(len)) == sizeof(len))
+        conn.peer = readAddress(pid, args[1], len);
+      lookup(pid, rc, conn);
+    }
+    break;
+  case __NR_getsockopt:
+    if (rc == 0 && args[1] == SOL_SOCKET && args[2] == SO_ERROR)
+    {
+      if (Connection *conn = find(*proc, args[0]))
+        connected(pid, args[0], *conn);
+    }
+    break;
+  case __NR_sendto:
+    if (rc >= 0)
+    {
+      if (Connection *conn = find(*proc, args[0]))
+        setPeer(pid, *conn, args[4], args[5]);
+      transfer(pid, *proc, args[0], Out, rc);
+    }
+    break;
+  case __NR_recvfrom:
+    if (rc >= 0)
+    {
+      Connection *conn = find(*proc, args[0]);
+      int len(0);
+      if (conn && args[4] && args[5] && readRemote(pid, args[5], &len, sizeof(len)) == sizeof(len))
+        setPeer(pid, *conn, args[4], len);
+      transfer(pid, *proc, args[0], In, rc);
+    }
+    break;
+  case __NR_sendmsg:
+  case __NR_recvmsg:
+    if (rc >= 0)
+    {
+      Connection *conn = find(*proc, args[0]);
+      msghdr msg;
+      if (conn && readRemote(pid, args[1], &msg, sizeof(msg)) == sizeof(msg))
+        setPeer(pid, *conn, reinterpret_cast<long>(msg.msg_name), msg.msg_namelen);
+      transfer(pid, *proc, args[0], func == __NR_sendmsg ? Out : In, rc);
+    }
+    break;
+  case __NR_sendmmsg:
+  case __NR_recvmmsg:
+    if (rc > 0)
+      transferMessages(pid, *proc, args[0], func == __NR_sendmmsg ? Out : In, args[1], rc);
+    break;
+  case __NR_read:
+  case __NR_readv:
+    if (rc >= 0)
+      transfer(pid, *proc, args[0], In, rc);
+    break;
+  case __NR_write:
+  case __NR_writev:
+    if (rc >= 0)
+      transfer(pid, *proc, args[0], Out, rc);
+    break;
+  case __NR_sendfile:
+    if (rc >= 0)
+      transfer(pid, *proc, args[0], Out, rc);
+    break;
+  case __NR_close:
+    if (rc == 0)
+      proc->fds.erase(args[0]);
+    break;
+  case __NR_dup:
+  case __NR_dup2:
+  case __NR_dup3:
+  case __NR_fcntl:
+    if (rc >= 0 && rc != args[0])
+    {
+      bool cloexec(false);
+      if (func == __NR_fcntl)
+      {
+        if (args[1] != F_DUPFD && args[1] != F_DUPFD_CLOEXEC)
+          break;
+        cloexec = args[1] == F_DUPFD_CLOEXEC;
+      }
+      else if (func == __NR_dup3)
+      {
+        cloexec = (args[2] & O_CLOEXEC) != 0;
+      }
+      proc->fds.erase(rc);
+      std::map<int, Socket>::const_iterator it = proc->fds.find(args[0]);
+      if (it != proc->fds.end())
+      {
+        Socket &socket = proc->fds[rc];
+        socket.connection = it->second.connection;
+        socket.cloexec = cloexec;
+      }
+    }
+    break;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+NetProfiler::Process *NetProfiler::findProcess(pid_t tid)
+{
+  std::map<pid_t, Process>::iterator it = processes.find(images.processOf(tid));
+  return (it == processes.end()) ? 0 : &it->second;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+NetProfiler::Connection *NetProfiler::find(Process &proc, int fd)
+{
+  std::map<int, Socket>::const_iterator it = proc.fds.find(fd);
+  return (it == proc.fds.end()) ? 0 : &connections[it->second.connection];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+NetProfiler::Connection &NetProfiler::add(pid_t tid, Process &proc, int fd, int family, int type, bool cloexec)
+{
+  Connection conn = Connection();
+  conn.pid = images.processOf(tid);
+  conn.fd = fd;
+  conn.family = family;
+  conn.type = type;
+  conn.connectStart = -1;
+  conn.connectTime = -1;
+  connections.push_back(conn);
+
+  Socket &socket = proc.fds[fd];
+  socket.connection = connections.size() - 1;
+  socket.cloexec = cloexec;
+  return connections.back();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// The kernel lists inet sockets by inode in /proc/<pid>/net/<protocol>
+// with both addresses, which gives the ephemeral port chosen by connect
+// and the actual local address of a socket bound to a wildcard.
+void NetProfiler::lookup(pid_t tid, int fd, Connection &conn)
+{
+  if (conn.family == AF_UNIX)
+  {
+    // Unix sockets which were never bound have no name
+    if (conn.local.empty())
+      conn.local = "(unnamed)";
+    if (conn.peer.empty())
+      conn.peer = "(unnamed)";
+    return;
+  }
+  if (conn.family != AF_INET && conn.family != AF_INET6)
+  {
+    return;
+  }
+  unsigned long const inode = socketInode(tid, fd);
+  if (inode == 0)
+  {
+    return;
+  }
+  std::ifstream ifs(procName(tid, "net/" + protocol(conn.family, conn.type)).c_str());
+  std::string line;
+  std::getline(ifs, line); // headings
+  while (std::getline(ifs, line))
+  {
+    std::istringstream iss(line);
+    std::string slot, local, peer, state, queues, timer, retransmits, uid, timeout;
+    unsigned long node(0);
+    if ((iss >> slot >> local >> peer >> state >> queues >> timer >> retransmits >> uid >> timeout >> node) &&
+        node == inode)
+    {
+      conn.local = procAddress(conn.family, local);
+      if (peer.size() > 5 && peer.compare(peer.size() - 5, 5, ":0000") != 0)
+        conn.peer = procAddress(conn.family, peer);
+      return;
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void NetProfiler::connected(pid_t tid, int fd, Connection &conn)
+{
+  if (conn.connectStart != -1)
+  {
+    conn.connectTime = elapsed.usec() - conn.connectStart;
+    conn.connectStart = -1;
+    lookup(tid, fd, conn);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void NetProfiler::transfer(pid_t tid, Process &proc, int fd, Direction dir, long bytes)
+{
+  Connection *conn = find(proc, fd);
+  if (!conn)
+  {
+    return;
+  }
+  connected(tid, fd, *conn);
+  ++conn->calls[dir];
+  conn->bytes[dir] += bytes;
+  if (dir == Out)
+  {
+    ++sizes[sizeBucket(bytes, SizeBuckets)];
+    if (static_cast<size_t>(bytes) <= SmallWrite)
+    {
+      ++conn->smallWrites;
+      if (conn->lastWrite)
+        ++conn->batchable;
+    }
+  }
+  conn->lastWrite = (dir == Out);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void NetProfiler::transferMessages(pid_t tid, Process &proc, int fd, Direction dir, long addr, long count)
+{
+  std::vector<mmsghdr> messages(count);
+  size_t const size = count * sizeof(mmsghdr);
+  if (readRemote(tid, addr, &messages[0], size) != size)
+  {
+    return;
+  }
+  for (long idx = 0; idx != count; ++idx)
+  {
+    transfer(tid, proc, fd, dir, messages[idx].msg_len);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void NetProfiler::setPeer(pid_t tid, Connection &conn, long addr, long len)
+{
+  std::string const peer = readAddress(tid, addr, len);
+  if (peer.empty() || peer == conn.peer)
+  {
+    return;
+  }
+  conn.peer = conn.peer.empty() ? peer : "(various)";
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void NetProfiler::Report(std::ostream &os)
+{
+  os << "\nSocket connections\n"
+     << "     pid    fd  proto        connect ms   sends      bytes out   recvs       bytes in   small  batchable  local -> peer\n";
+  for (std::vector<Connection>::const_iterator it = connections.begin(); it != connections.end(); ++it)
+  {
+    if (it->listening)
+      continue;
+    os << std::setw(8) << it->pid << std::setw(6) << it->fd << "  "
+       << std::left << std::setw(11) << protocol(it->family, it->type) << std::right
+       << msecs(it->connectTime)
+       << std::setw(8) << it->calls[Out] << std::setw(15) << it->bytes[Out]
+       << std::setw(8) << it->calls[In] << std::setw(15) << it->bytes[In]
+       << std::setw(8) << it->smallWrites << std::setw(11) << it->batchable << "  "
+       << (it->local.empty() ? "?" : it->local) << " -> " << (it->peer.empty() ? "?" : it->peer) << '\n';
+  }
+
+  bool heading(true);
+  for (std::vector<Connection>::const_iterator it = connections.begin(); it != connections.end(); ++it)
+  {
+    if (!it->listening)
+      continue;
+    if (heading)
+    {
+      os << "\nListening sockets\n"
+         << "     pid    fd  proto        accepted  local\n";
+      heading = false;
+    }
+    os << std::setw(8) << it->pid << std::setw(6) << it->fd << "  "
+       << std::left << std::setw(11) << protocol(it->family, it->type) << std::right
+       << std::setw(10) << it->accepted << "  " << (it->local.empty() ? "?" : it->local) << '\n';
+  }
+
+  long long writes(0), small(0), batchable(0);
+  for (std::vector<Connection>::const_iterator it = connections.begin(); it != connections.end(); ++it)
+  {
+    writes += it->calls[Out];
+    small += it->smallWrites;
+    batchable += it->batchable;
+  }
+  if (writes == 0)
+  {
+    return;
+  }
+  os << "\nSocket write sizes\n"
+     << "           bytes      writes\n";
+  for (size_t bucket = 0; bucket != SizeBuckets; ++bucket)
+  {
+    if (sizes[bucket] == 0)
+      continue;
+    std::ostringstream range;
+    if (bucket == 0)
+      range << 0;
+    else if (bucket == SizeBuckets - 1)
+      range << ">= " << (1L << (bucket - 1));
+    else if (bucket == 1)
+      range << 1;
+    else
+      range << (1L << (bucket - 1)) << '-' << (1L << bucket) - 1;
+    os << std::setw(16) << range.str() << std::setw(12) << sizes[bucket] << '\n';
+  }
+  os << small << " of " << writes << " socket writes were of " << SmallWrite << " bytes or less; "
+     << batchable << " of them directly followed another write\n";
+}
@@ -0,0 +1,137 @@
+#ifndef NET_PROFILER_H
+#define NET_PROFILER_H
+
+/**@file
+
+  Socket and network I/O profiler for ProcessTracer
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "ProcessImages.h"
+#include "TraceListener.h"
+#include "TraceUtils.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+/** Follow the sockets each process uses and count the calls
+ * and bytes in each direction, the time taken to connect and
+ * the small writes which suggest missing batching */
+class NetProfiler : public TraceListener
+{
+public:
+  NetProfiler();
+
+  void OnStart(pid_t pid) override;
+  void OnFork(pid_t parent, pid_t child, int event) override;
+  void OnExec(pid_t pid) override;
+  void OnExit(pid_t pid, int status) override;
+  bool SelectedCall(int func) override;
+  void OnCallEntry(pid_t pid, int func, long const args[]) override;
+  void OnCallExit(pid_t pid, int func, long const args[], long rc) override;
+  void Report(std::ostream &os) override;
+
+private:
+  /** Times are in microseconds since the tracer started */
+  typedef long long usec;
+
+  /** Direction of transfer */
+  enum Direction
+  {
+    Out,
+    In,
+    Directions
+  };
+
+  /** Writes of up to this many bytes are small */
+  static size_t const SmallWrite = 512;
+
+  /** Buckets in the write size distribution, by power of two */
+  static size_t const SizeBuckets = 18;
+
+  /** One socket, shared by all the descriptors which refer to it */
+  struct Connection
+  {
+    pid_t pid;              // process which created it
+    int fd;                 // and its first descriptor
+    int family;
+    int type;
+    std::string local;
+    std::string peer;
+    bool listening;
+    long accepted;          // connections accepted, if listening
+    usec connectStart;      // when a non-blocking connect began, or -1
+    usec connectTime;       // connect latency, or -1
+    long calls[Directions];
+    long long bytes[Directions];
+    long smallWrites;
+    long batchable;         // small writes following another write
+    bool lastWrite;         // most recent transfer was a write
+  };
+
+  /** A descriptor referring to a connection */
+  struct Socket
+  {
+    size_t connection;      // index into connections
+    bool cloexec;
+  };
+
+  /** State shared by all the threads in a process */
+  struct Process
+  {
+    std::map<int, Socket> fds;
+  };
+
+  /** The process containing task 'tid' (or 0 if unknown) */
+  Process *findProcess(pid_t tid);
+
+  /** The connection for 'fd', or 0 if it is not a socket */
+  Connection *find(Process &proc, int fd);
+
+  /** Add a new connection as 'fd' */
+  Connection &add(pid_t tid, Process &proc, int fd, int family, int type, bool cloexec);
+
+  /** Fill in the addresses of a connected inet socket from /proc */
+  void lookup(pid_t tid, int fd, Connection &conn);
+
+  /** Complete a non-blocking connect on its first use */
+  void connected(pid_t tid, int fd, Connection &conn);
+
+  /** Record a transfer of 'bytes' on 'fd' (if a socket) */
+  void transfer(pid_t tid, Process &proc, int fd, Direction dir, long bytes);
+
+  /** Record a transfer for each of the 'count' messages of a sendmmsg or recvmmsg */
+  void transferMessages(pid_t tid, Process &proc, int fd, Direction dir, long addr, long count);
+
+  /** Set the peer of an unconnected socket from the message address */
+  void setPeer(pid_t tid, Connection &conn, long addr, long len);
+
+  Stopwatch elapsed;                 // since the start of tracing
+  ProcessImages images;
+  std::vector<Connection> connections;
+  std::map<pid_t, Process> processes;
+  std::map<pid_t, usec> entries;     // thread id => time of blocking call entry
+  long long sizes[SizeBuckets];      // socket write sizes
+};
+
+#endif // NET_PROFILER_H
@@ -0,0 +1,374 @@
+/*
+NAME
+    OffCpuProfiler
+
+DESCRIPTION
+    Off-CPU (blocked time) profiler for ProcessTracer.
+
+    A sampling CPU profiler cannot see a thread which is waiting, but
+    a tracer sees every entry to and exit from the calls in which
+    threads wait. The user stack is unwound at entry and the time to
+    exit is charged to that stack, so the result explains where the
+    wall-clock time of a thread went when it was not running.
+
+    Only futex operations which can block are timed, as FutexProfiler
+    does, so the wakes and requeues which balance every wait are not.
+    The stack is unwound at the exit, where it is the same as at the
+    entry, and only for calls blocked for StackThreshold or more, as
+    unwinding costs more than most short calls take; the rest, and the
+    calls of threads which exit while blocked, are charged to the call
+    alone and fold without any frames.
+
+    The folded output has one line per distinct stack:
+      command;outermost;...;innermost;call microseconds
+    which can be fed straight to flamegraph.pl. A frame in inlined code
+    is followed by the functions inlined there, outermost first, each
+    with the _[i] suffix that flamegraph.pl shows as an inlined frame.
+
+    Naming the frames means reading the symbol tables of every module,
+    which can take longer than the trace itself for large programs.
+    With deferred symbols the frames are written as @image:address,
+    after "@module image start end bias build-id path" records of the
+    executable mappings of each image, taken whenever the tracer reads
+    the mappings, and TraceSymbolize resolves them afterwards.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "OffCpuProfiler.h"
+#include "ElfDebugInfo.h"
+#include "FutexProfiler.h"
+#include "StackUnwinder.h"
+#include "TraceUtils.h"
+
+#include <asm/unistd.h>
+#include <sys/ptrace.h>
+#include <sys/user.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+  /** Number of entries shown in each table */
+  size_t const TopCount = 10;
+
+  /** Microseconds a call must block for its stack to be unwound */
+  long long const StackThreshold = 100;
+
+  /** Order entries by decreasing total, largest first */
+  template <typename T>
+  bool byTotal(std::pair<long long, T> const &lhs, std::pair<long long, T> const &rhs)
+  {
+    return lhs.first > rhs.first;
+  }
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool OffCpuProfiler::StackKey::operator<(StackKey const &rhs) const
+{
+  if (image != rhs.image)
+    return image < rhs.image;
+  if (func != rhs.func)
+    return func < rhs.func;
+  return pcs < rhs.pcs;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+OffCpuProfiler::OffCpuProfiler(std::string const &fileName, bool deferred)
+: fileName(fileName), deferred(deferred)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void OffCpuProfiler::OnStart(pid_t pid)
+{
+  images.OnStart(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void OffCpuProfiler::OnFork(pid_t parent, pid_t child, int event)
+{
+  images.OnFork(parent, child, event);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void OffCpuProfiler::OnExec(pid_t pid)
+{
+  images.OnExec(pid);
+  // A successful execve does not return to the stack it was called from
+  blocked.erase(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// A thread which exits while blocked (eg killed by another thread's
+// exit_group) was blocked until then
+void OffCpuProfiler::OnExit(pid_t pid, int status)
+{
+  charge(pid, false);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool OffCpuProfiler::SelectedCall(int func)
+{
+  switch (func)
+  {
+  case __NR_read:
+  case __NR_readv:
+  case __NR_pread64:
+  case __NR_preadv:
+  case __NR_preadv2:
+  case __NR_recvfrom:
+  case __NR_recvmsg:
+  case __NR_recvmmsg:
+  case __NR_accept:
+  case __NR_accept4:
+  case __NR_connect:
+  case __NR_poll:
+  case __NR_ppoll:
+  case __NR_select:
+  case __NR_pselect6:
+  case __NR_epoll_wait:
+  case __NR_epoll_pwait:
+  case __NR_epoll_pwait2:
+  case __NR_nanosleep:
+  case __NR_clock_nanosleep:
+  case __NR_futex:
+  case __NR_wait4:
+  case __NR_waitid:
+  case __NR_pause:
+  case __NR_rt_sigsuspend:
+  case __NR_rt_sigtimedwait:
+  case __NR_flock:
+  case __NR_fsync:
+  case __NR_fdatasync:
+    return true;
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void OffCpuProfiler::OnCallEntry(pid_t pid, int func, long const args[])
+{
+  if (func == __NR_futex && !FutexProfiler::blocking(args[1]))
+  {
+    return;
+  }
+  Blocked &entry = blocked[pid];
+  entry.key.image = images.imageOf(pid);
+  entry.key.func = func;
+  entry.key.pcs.clear();
+  entry.entry = elapsed.usec();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void OffCpuProfiler::OnCallExit(pid_t pid, int func, long const args[], long rc)
+{
+  charge(pid, true);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// Only rax, rcx and r11 differ from the entry, and none is needed to unwind
+void OffCpuProfiler::charge(pid_t pid, bool alive)
+{
+  std::map<pid_t, Blocked>::iterator const it = blocked.find(pid);
+  if (it == blocked.end())
+  {
+    return;
+  }
+  usec const time = elapsed.usec() - it->second.entry;
+  user_regs_struct regs;
+  if (alive && time >= StackThreshold && ptrace(PTRACE_GETREGS, pid, 0, &regs) == 0)
+  {
+    unwindStack(pid, images[it->second.key.image].modules, regs, it->second.key.pcs);
+    if (deferred)
+    {
+      snapshot(it->second.key.image);
+    }
+  }
+  Total &stack = stacks[it->second.key];
+  ++stack.first;
+  stack.second += time;
+  Total &thread = threads[pid];
+  ++thread.first;
+  thread.second += time;
+  Total &call = calls[it->second.key.func];
+  ++call.first;
+  call.second += time;
+  blocked.erase(it);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void OffCpuProfiler::Report(std::ostream &os)
+{
+  os << "\nBlocked time by system call\n"
+     << "  blocked ms     calls  call\n";
+  std::vector<std::pair<long long, int> > byCall;
+  for (std::map<int, Total>::const_iterator it = calls.begin(); it != calls.end(); ++it)
+  {
+    byCall.push_back(std::make_pair(it->second.second, it->first));
+  }
+  std::stable_sort(byCall.begin(), byCall.end(), byTotal<int>);
+  for (size_t idx = 0; idx != byCall.size(); ++idx)
+  {
+    os << msecs(byCall[idx].first) << std::setw(10) << calls[byCall[idx].second].first
+       << "  " << syscallName(byCall[idx].second) << '\n';
+  }
+
+  os << "\nThreads blocked longest\n"
+     << "  blocked ms     calls       tid\n";
+  std::vector<std::pair<long long, pid_t> > byThread;
+  for (std::map<pid_t, Total>::const_iterator it = threads.begin(); it != threads.end(); ++it)
+  {
+    byThread.push_back(std::make_pair(it->second.second, it->first));
+  }
+  std::stable_sort(byThread.begin(), byThread.end(), byTotal<pid_t>);
+  for (size_t idx = 0; idx != byThread.size() && idx != TopCount; ++idx)
+  {
+    os << msecs(byThread[idx].first) << std::setw(10) << threads[byThread[idx].second].first
+       << std::setw(10) << byThread[idx].second << '\n';
+  }
+
+  os << "\nStacks are unwound for calls blocked " << StackThreshold << " microseconds or more;"
+     << " the rest fold to the call alone\n";
+  if (fileName.empty())
+  {
+    os << "\nFolded stacks (blocked microseconds)\n";
+    deferred ? writeRaw(os) : writeFolded(os);
+  }
+  else
+  {
+    std::ofstream ofs(fileName.c_str());
+    deferred ? writeRaw(ofs) : writeFolded(ofs);
+    if (!ofs)
+    {
+      os << "Unable to write folded stacks to " << fileName << std::endl;
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// Different return addresses in one function fold to the same frame name,
+// so merge the stacks again after naming them
+void OffCpuProfiler::writeFolded(std::ostream &os) const
+{
+  std::map<std::string, usec> folded;
+  for (std::map<StackKey, Total>::const_iterator it = stacks.begin(); it != stacks.end(); ++it)
+  {
+    StackKey const &key = it->first;
+    ProcessImages::Image const &image = images[key.image];
+    std::string name = image.command.substr(0, image.command.find(' '));
+    name = name.substr(name.rfind('/') + 1);
+    if (name.empty())
+    {
+      std::ostringstream oss;
+      oss << image.pid;
+      name = oss.str();
+    }
+    for (size_t idx = key.pcs.size(); idx-- != 0; )
+    {
+      unsigned long const pc = idx == 0 ? key.pcs[idx] : key.pcs[idx] - 1;
+      name += ';';
+      name += image.modules.function(pc);
+      appendInlines(name, image.modules, pc);
+    }
+    name += ';';
+    name += syscallName(key.func);
+    folded[name] += it->second.second;
+  }
+  for (std::map<std::string, usec>::const_iterator it = folded.begin(); it != folded.end(); ++it)
+  {
+    os << it->first << ' ' << it->second << '\n';
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// Inlined frames are marked with the _[i] suffix flamegraph.pl colours
+void OffCpuProfiler::appendInlines(std::string &name, ProcessModules const &modules, unsigned long pc)
+{
+  ProcessModules::Module const *module = modules.find(pc);
+  long const vaddr = module ? modules.toVaddr(*module, pc) : -1;
+  std::vector<ElfDebugInfo::InlineFrame> inlines;
+  if (vaddr == -1 || !ElfDebugInfo::get(module->path)->inlinedAt(vaddr, inlines))
+  {
+    return;
+  }
+  for (size_t idx = inlines.size(); idx-- != 0; )
+  {
+    name += ';';
+    name += inlines[idx].function;
+    name += "_[i]";
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// Only the headers of the files are read, for the bias and build id
+void OffCpuProfiler::snapshot(size_t image)
+{
+  ProcessModules const &current = images[image].modules;
+  unsigned long &generation = generations[image];
+  if (generation == current.generation())
+  {
+    return;
+  }
+  generation = current.generation();
+  std::vector<ProcessModules::Module> const &mappings = current.modules();
+  for (std::vector<ProcessModules::Module>::const_iterator it = mappings.begin(); it != mappings.end(); ++it)
+  {
+    long const vaddr = it->exec ? current.toVaddr(*it, it->start) : -1;
+    if (vaddr == -1)
+      continue;
+    std::string const build = ElfSymbols::get(it->path)->buildId();
+    std::ostringstream oss;
+    oss << "@module " << image << std::hex << ' ' << it->start << ' ' << it->end << ' ' << it->start - vaddr
+        << ' ' << (build.empty() ? "-" : build) << ' ' << it->path;
+    modules[image].insert(oss.str());
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// Return addresses are written less one, to lie in the calling function
+void OffCpuProfiler::writeRaw(std::ostream &os) const
+{
+  for (std::map<size_t, std::set<std::string> >::const_iterator it = modules.begin(); it != modules.end(); ++it)
+  {
+    for (std::set<std::string>::const_iterator line = it->second.begin(); line != it->second.end(); ++line)
+    {
+      os << *line << '\n';
+    }
+  }
+  for (std::map<StackKey, Total>::const_iterator it = stacks.begin(); it != stacks.end(); ++it)
+  {
+    StackKey const &key = it->first;
+    ProcessImages::Image const &image = images[key.image];
+    std::string name = image.command.substr(0, image.command.find(' '));
+    name = name.substr(name.rfind('/') + 1);
+    if (name.empty())
+    {
+      os << image.pid;
+    }
+    os << name;
+    for (size_t idx = key.pcs.size(); idx-- != 0; )
+    {
+      os << ";@" << key.image << ':' << std::hex << (idx == 0 ? key.pcs[idx] : key.pcs[idx] - 1) << std::dec;
+    }
+    os << ';' << syscallName(key.func) << ' ' << it->second.second << '\n';
+  }
+}
@@ -0,0 +1,111 @@
+#ifndef OFF_CPU_PROFILER_H
+#define OFF_CPU_PROFILER_H
+
+/**@file
+
+  Off-CPU (blocked time) profiler for ProcessTracer
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "ProcessImages.h"
+#include "TraceListener.h"
+#include "TraceUtils.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** Sum the time threads spend in blocking system calls by thread,
+ * by call and by the user stack at entry, and write the stacks in
+ * the folded format used by flame graph tools */
+class OffCpuProfiler : public TraceListener
+{
+public:
+  /** Write the folded stacks to 'fileName', or to the
+   * report stream if the name is empty. If 'deferred' write raw
+   * addresses and module lists to be resolved by TraceSymbolize */
+  OffCpuProfiler(std::string const &fileName, bool deferred);
+
+  void OnStart(pid_t pid) override;
+  void OnFork(pid_t parent, pid_t child, int event) override;
+  void OnExec(pid_t pid) override;
+  void OnExit(pid_t pid, int status) override;
+  bool SelectedCall(int func) override;
+  void OnCallEntry(pid_t pid, int func, long const args[]) override;
+  void OnCallExit(pid_t pid, int func, long const args[], long rc) override;
+  void Report(std::ostream &os) override;
+
+private:
+  /** Times are in microseconds since the tracer started */
+  typedef long long usec;
+
+  /** A blocking call from one stack */
+  struct StackKey
+  {
+    size_t image;
+    int func;
+    std::vector<unsigned long> pcs;   // innermost first
+
+    bool operator<(StackKey const &rhs) const;
+  };
+
+  /** Count and total blocked time */
+  typedef std::pair<long, usec> Total;
+
+  /** A thread in a blocking call */
+  struct Blocked
+  {
+    StackKey key;
+    usec entry;
+  };
+
+  /** Charge the blocking call of task 'pid' which has ended, with its
+   * stack if it was long and the task is still 'alive' */
+  void charge(pid_t pid, bool alive);
+
+  /** Write the folded stacks */
+  void writeFolded(std::ostream &os) const;
+
+  /** Append the functions inlined at 'pc' in 'modules' to the folded stack 'name' */
+  static void appendInlines(std::string &name, ProcessModules const &modules, unsigned long pc);
+
+  /** Record any new modules of 'image' for the deferred output */
+  void snapshot(size_t image);
+
+  /** Write the module lists and the folded stacks with raw addresses */
+  void writeRaw(std::ostream &os) const;
+
+  std::string fileName;
+  bool deferred;
+  Stopwatch elapsed;                 // since the start of tracing
+  ProcessImages images;
+  std::map<pid_t, Blocked> blocked;
+  std::map<StackKey, Total> stacks;
+  std::map<pid_t, Total> threads;
+  std::map<int, Total> calls;
+  std::map<size_t, unsigned long> generations;     // image => modules last recorded
+  std::map<size_t, std::set<std::string> > modules; // image => module records
+};
+
+#endif // OFF_CPU_PROFILER_H
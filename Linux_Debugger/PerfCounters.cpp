@@ -0,0 +1,327 @@
+/*
+NAME
+    PerfCounters
+
+DESCRIPTION
+    Per-thread software performance counters for ProcessTracer.
+
+    A group of software counters (context switches, minor and major
+    page faults, cpu-clock and task-clock) is opened with
+    perf_event_open on each traced thread as it is created, and read
+    at each system call entry and exit stop. The difference is what
+    happened during the call, so a slow read which took major faults
+    can be told from one which was waiting: the first shows faults
+    and on-CPU time, the second context switches and little time.
+
+    Where perf events cannot be used (perf_event_paranoid, seccomp in
+    a container, or running out of descriptors) the thread falls back
+    to minflt and majflt from /proc/<tid>/stat and the run time and
+    timeslice count from /proc/<tid>/schedstat.
+
+    Every call includes the switch out of the thread into its syscall
+    exit stop, so one context switch per call is not counted.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "PerfCounters.h"
+#include "TraceUtils.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+  /** perf_event_open configuration of each counter, in Counter order */
+  unsigned long long const Configs[] =
+  {
+    PERF_COUNT_SW_CONTEXT_SWITCHES,
+    PERF_COUNT_SW_PAGE_FAULTS_MIN,
+    PERF_COUNT_SW_PAGE_FAULTS_MAJ,
+    PERF_COUNT_SW_CPU_CLOCK,
+    PERF_COUNT_SW_TASK_CLOCK,
+  };
+
+  int perfEventOpen(pid_t tid, int group, unsigned long long config, bool excludeKernel)
+  {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = excludeKernel;
+    attr.exclude_hv = 1;
+    return syscall(__NR_perf_event_open, &attr, tid, -1, group, PERF_FLAG_FD_CLOEXEC);
+  }
+
+  bool byWall(std::pair<long long, int> const &lhs, std::pair<long long, int> const &rhs)
+  {
+    return lhs.first > rhs.first;
+  }
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+PerfCounters::PerfCounters(std::string const &fileName)
+: fileName(fileName), perf(true)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+PerfCounters::~PerfCounters()
+{
+  while (!threads.empty())
+  {
+    close(threads.begin()->first);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void PerfCounters::OnStart(pid_t pid)
+{
+  if (!fileName.empty())
+  {
+    log.open(fileName.c_str());
+    log << "tid,call,rc,wall_us,task_us,cpu_us,switches,minflt,majflt\n";
+  }
+  open(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void PerfCounters::OnFork(pid_t parent, pid_t child, int event)
+{
+  open(child);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// A thread other than the leader which calls exec takes over the
+// process id, so the counters for that id may belong to a task which
+// has gone: open them again.
+void PerfCounters::OnExec(pid_t pid)
+{
+  close(pid);
+  open(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void PerfCounters::OnExit(pid_t pid, int status)
+{
+  close(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool PerfCounters::SelectedCall(int func)
+{
+  return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void PerfCounters::OnCallEntry(pid_t pid, int func, long const args[])
+{
+  std::map<pid_t, Thread>::iterator const it = threads.find(pid);
+  if (it != threads.end())
+  {
+    it->second.inCall = sample(pid, it->second, it->second.entry);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void PerfCounters::OnCallExit(pid_t pid, int func, long const args[], long rc)
+{
+  std::map<pid_t, Thread>::iterator const it = threads.find(pid);
+  if (it == threads.end() || !it->second.inCall)
+  {
+    return;
+  }
+  Thread &thread = it->second;
+  thread.inCall = false;
+  Sample exit;
+  if (!sample(pid, thread, exit))
+  {
+    return;
+  }
+  unsigned long long delta[Counters];
+  for (int idx = 0; idx != Counters; ++idx)
+  {
+    delta[idx] = exit.values[idx] - thread.entry.values[idx];
+  }
+  if (delta[ContextSwitches] != 0)
+  {
+    --delta[ContextSwitches];    // the exit stop itself
+  }
+  long long const wall = exit.wall - thread.entry.wall;
+
+  Total &total = totals[func];
+  ++total.calls;
+  total.wall += wall;
+  for (int idx = 0; idx != Counters; ++idx)
+  {
+    total.values[idx] += delta[idx];
+  }
+
+  if (log.is_open())
+  {
+    log << pid << ',' << syscallName(func) << ',' << rc << ','
+        << wall / 1000 << ',' << delta[TaskClock] / 1000 << ',' << delta[CpuClock] / 1000 << ','
+        << delta[ContextSwitches] << ',' << delta[MinorFaults] << ',' << delta[MajorFaults] << '\n';
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void PerfCounters::Report(std::ostream &os)
+{
+  if (!fileName.empty() && !log)
+  {
+    os << "Unable to write call counters to " << fileName << std::endl;
+  }
+  if (!perf)
+  {
+    os << "\nperf events unavailable: counters read from /proc (task and cpu clock are the same)\n";
+  }
+  std::vector<std::pair<long long, int> > byCall;
+  for (std::map<int, Total>::const_iterator it = totals.begin(); it != totals.end(); ++it)
+  {
+    byCall.push_back(std::make_pair(it->second.wall, it->first));
+  }
+  std::stable_sort(byCall.begin(), byCall.end(), byWall);
+
+  os << "\nSystem call counters\n"
+     << "     wall ms   on-cpu ms     calls  switches    minflt    majflt  call\n";
+  for (size_t idx = 0; idx != byCall.size(); ++idx)
+  {
+    Total const &total = totals[byCall[idx].second];
+    os << msecs(total.wall / 1000) << msecs(total.values[TaskClock] / 1000)
+       << std::setw(10) << total.calls << std::setw(10) << total.values[ContextSwitches]
+       << std::setw(10) << total.values[MinorFaults] << std::setw(10) << total.values[MajorFaults]
+       << "  " << syscallName(byCall[idx].second) << '\n';
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// Kernel events may be hidden from an unprivileged tracer: then count
+// only those in user mode (and so miss faults taken inside the kernel,
+// such as a read into an untouched buffer) rather than nothing.
+void PerfCounters::open(pid_t tid)
+{
+  Thread &thread = threads[tid];
+  thread.group = -1;
+  std::fill(thread.fds, thread.fds + Counters, -1);
+  thread.inCall = false;
+  if (!perf)
+  {
+    return;
+  }
+  bool excludeKernel(false);
+  thread.group = perfEventOpen(tid, -1, Configs[0], excludeKernel);
+  if (thread.group == -1 && (errno == EACCES || errno == EPERM))
+  {
+    excludeKernel = true;
+    thread.group = perfEventOpen(tid, -1, Configs[0], excludeKernel);
+  }
+  thread.fds[0] = thread.group;
+  for (int idx = 1; thread.group != -1 && idx != Counters; ++idx)
+  {
+    thread.fds[idx] = perfEventOpen(tid, thread.group, Configs[idx], excludeKernel);
+    if (thread.fds[idx] == -1)
+    {
+      int const error = errno;
+      while (idx-- != 0)
+      {
+        ::close(thread.fds[idx]);
+        thread.fds[idx] = -1;
+      }
+      thread.group = -1;
+      errno = error;
+    }
+  }
+  if (thread.group == -1 && (errno == ENOSYS || errno == EACCES || errno == EPERM))
+  {
+    // Not just this thread: don't keep trying
+    perf = false;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void PerfCounters::close(pid_t tid)
+{
+  std::map<pid_t, Thread>::iterator const it = threads.find(tid);
+  if (it == threads.end())
+  {
+    return;
+  }
+  for (int idx = Counters; idx-- != 0; )
+  {
+    if (it->second.fds[idx] != -1)
+    {
+      ::close(it->second.fds[idx]);
+    }
+  }
+  threads.erase(it);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool PerfCounters::sample(pid_t tid, Thread const &thread, Sample &sample)
+{
+  sample.wall = monotonicNsec();
+  if (thread.group != -1)
+  {
+    // PERF_FORMAT_GROUP: the number of counters then their values
+    unsigned long long buffer[1 + Counters];
+    if (read(thread.group, buffer, sizeof(buffer)) != sizeof(buffer) || buffer[0] != Counters)
+    {
+      return false;
+    }
+    std::copy(buffer + 1, buffer + 1 + Counters, sample.values);
+    return true;
+  }
+
+  // The fields after the command name in parentheses (which may contain
+  // spaces) start with state; minflt and majflt are the 8th and 10th
+  std::ifstream stat(procName(tid, "stat").c_str());
+  std::string line;
+  if (!std::getline(stat, line) || line.rfind(')') == std::string::npos)
+  {
+    return false;
+  }
+  std::istringstream iss(line.substr(line.rfind(')') + 1));
+  std::string field;
+  for (int idx = 0; idx != 7; ++idx)
+  {
+    iss >> field;
+  }
+  unsigned long long cminflt(0);
+  iss >> sample.values[MinorFaults] >> cminflt >> sample.values[MajorFaults];
+
+  // schedstat: time on the cpu, time waiting to run, timeslices run
+  std::ifstream schedstat(procName(tid, "schedstat").c_str());
+  unsigned long long wait(0);
+  if (!(schedstat >> sample.values[TaskClock] >> wait >> sample.values[ContextSwitches]))
+  {
+    return false;
+  }
+  sample.values[CpuClock] = sample.values[TaskClock];
+  return true;
+}
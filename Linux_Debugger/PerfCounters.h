@@ -0,0 +1,105 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+/**@file
+
+  Per-thread software performance counters for ProcessTracer
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "TraceListener.h"
+
+#include <fstream>
+#include <map>
+#include <string>
+
+/** Count the context switches, page faults and CPU time of each
+ * system call, using perf_event_open software counters on each
+ * traced thread or, where those are unavailable, /proc */
+class PerfCounters : public TraceListener
+{
+public:
+  /** Log each call to 'fileName', if not empty */
+  explicit PerfCounters(std::string const &fileName);
+  ~PerfCounters();
+
+  void OnStart(pid_t pid) override;
+  void OnFork(pid_t parent, pid_t child, int event) override;
+  void OnExec(pid_t pid) override;
+  void OnExit(pid_t pid, int status) override;
+  bool SelectedCall(int func) override;
+  void OnCallEntry(pid_t pid, int func, long const args[]) override;
+  void OnCallExit(pid_t pid, int func, long const args[], long rc) override;
+  void Report(std::ostream &os) override;
+
+private:
+  enum Counter
+  {
+    ContextSwitches,
+    MinorFaults,
+    MajorFaults,
+    CpuClock,         // nanoseconds
+    TaskClock,        // nanoseconds
+    Counters
+  };
+
+  /** Counter values at one moment */
+  struct Sample
+  {
+    long long wall;   // nanoseconds
+    unsigned long long values[Counters];
+  };
+
+  /** A traced thread */
+  struct Thread
+  {
+    int group;        // perf event group leader, or -1 to use /proc
+    int fds[Counters];
+    bool inCall;
+    Sample entry;
+  };
+
+  /** Totals for one system call */
+  struct Total
+  {
+    long calls;
+    long long wall;
+    unsigned long long values[Counters];
+  };
+
+  /** Start counting for task 'tid' */
+  void open(pid_t tid);
+
+  /** Stop counting for task 'tid' */
+  void close(pid_t tid);
+
+  /** Read the counters of task 'tid' */
+  bool sample(pid_t tid, Thread const &thread, Sample &sample);
+
+  std::string fileName;
+  std::ofstream log;
+  bool perf;          // perf events are usable
+  std::map<pid_t, Thread> threads;
+  std::map<int, Total> totals;
+};
+
+#endif // PERF_COUNTERS_H
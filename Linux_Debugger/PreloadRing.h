@@ -0,0 +1,86 @@
+#ifndef PRELOAD_RING_H
+#define PRELOAD_RING_H
+
+/**@file
+
+  Layout of the shared memory used to pass call records
+  from the TracePreload library to ProcessTracer.
+
+  The tracer creates the region and passes its file descriptor
+  to the target in the environment variable named by
+  PreloadRing::EnvVar. Each thread in the target claims a ring
+  of its own on first use so the producer side needs no locks:
+  each ring has exactly one writer and one reader.
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include <stdint.h>
+
+#include <atomic>
+
+namespace PreloadRing
+{
+  /** Environment variable holding the shared memory file descriptor */
+  char const EnvVar[] = "TRACE_PRELOAD_FD";
+
+  enum
+  {
+    Magic = 0x50524c44,  // "PRLD"
+    Rings = 128,         // maximum number of concurrently tracing threads
+    Slots = 1024,        // records per ring (a power of 2)
+    PathSize = 216       // bytes of path held in each record
+  };
+
+  /** One traced call, written after the call returns */
+  struct Record
+  {
+    int32_t tid;
+    int32_t func;              // system call number, eg __NR_openat
+    int64_t args[3];           // in system call order
+    int64_t rc;                // return value or -errno
+    char path[PathSize];       // nul terminated, possibly truncated
+  };
+
+  /** Single producer, single consumer ring of records */
+  struct Ring
+  {
+    std::atomic<int32_t> owner;       // tid of the producer, or 0 if free
+    std::atomic<int32_t> released;    // producer has exited
+    std::atomic<uint64_t> dropped;    // records lost because the ring was full
+    alignas(64) std::atomic<uint64_t> head;  // next slot to write
+    alignas(64) std::atomic<uint64_t> tail;  // next slot to read
+    Record records[Slots];
+  };
+
+  struct Header
+  {
+    uint32_t magic;
+    std::atomic<uint32_t> overflow;   // threads which found no free ring
+    Ring rings[Rings];
+  };
+
+  static_assert(sizeof(Record) == 256, "Record should be compact");
+  static_assert(std::atomic<uint64_t>::is_always_lock_free,
+                "shared memory atomics must be lock free");
+} // namespace PreloadRing
+
+#endif // PRELOAD_RING_H
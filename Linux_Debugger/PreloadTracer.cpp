@@ -0,0 +1,254 @@
+/*
+NAME
+    PreloadTracer
+
+DESCRIPTION
+    The LD_PRELOAD backend for ProcessTracer.
+
+    Creates a shared memory region, starts the target with the
+    TracePreload library loaded, and then polls the per-thread rings
+    in the region, printing each record in the same format used by
+    ProcessTracer's ptrace engine. The target is never stopped.
+
+    The tracer is a child subreaper, so descendants which outlive the
+    target are adopted by it, and it keeps polling the rings until it
+    has no children left.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "PreloadTracer.h"
+#include "TraceLoop.h"
+#include "TraceUtils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <wait.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace PreloadRing;
+
+namespace
+{
+  using TraceLoop::make_error;
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+PreloadTracer::PreloadTracer(std::string const &library, std::ostream &os)
+: library(library), os(os), fd(-1), shared(0), pid(0)
+{
+  // Not close-on-exec: the target inherits the descriptor
+  fd = memfd_create("TracePreload", 0);
+  if (fd == -1)
+  {
+    throw make_error("memfd_create");
+  }
+  if (ftruncate(fd, sizeof(Header)) == -1)
+  {
+    throw make_error("ftruncate");
+  }
+  void *const addr = mmap(0, sizeof(Header), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED)
+  {
+    throw make_error("mmap");
+  }
+  shared = static_cast<Header *>(addr);
+  shared->magic = Magic;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+PreloadTracer::~PreloadTracer()
+{
+  munmap(shared, sizeof(Header));
+  close(fd);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void PreloadTracer::CreateProcess(int argc, char **argv)
+{
+  if (prctl(PR_SET_CHILD_SUBREAPER, 1) == -1)
+  {
+    throw make_error("prctl(PR_SET_CHILD_SUBREAPER)");
+  }
+  pid_t const cpid = fork();
+  if (cpid > 0)
+  {
+    // In the parent
+    pid = cpid;
+  }
+  else if (cpid == 0)
+  {
+    // In the child
+    std::string preload(library);
+    if (char const *existing = getenv("LD_PRELOAD"))
+    {
+      preload = preload + ":" + existing;
+    }
+    // Move the descriptor out of the way of those the target uses
+    int const shmfd = fcntl(fd, F_DUPFD, 1000);
+    if (shmfd != -1)
+    {
+      close(fd);
+      fd = shmfd;
+    }
+    std::ostringstream oss;
+    oss << fd;
+    setenv("LD_PRELOAD", preload.c_str(), 1);
+    setenv(EnvVar, oss.str().c_str(), 1);
+    execv(argv[0], argv);
+    throw make_error("execv");
+  }
+  else
+  {
+    throw make_error("fork");
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void PreloadTracer::run()
+{
+  unsigned idle(0);
+  while (reap())
+  {
+    size_t const count = drain();
+    if (count == 0)
+    {
+      // Nothing to do: back off briefly rather than spin
+      struct timespec const delay = { 0, 200000 };
+      nanosleep(&delay, 0);
+      if (++idle % 1000 == 0)
+      {
+        reclaim();
+      }
+    }
+  }
+  drain();
+  reclaim();
+  drain();
+
+  uint64_t dropped(0);
+  for (int idx = 0; idx != Rings; ++idx)
+  {
+    dropped += shared->rings[idx].dropped.load();
+  }
+  if (dropped || shared->overflow.load())
+  {
+    os << "Warning: " << dropped << " records dropped (ring full), "
+       << shared->overflow.load() << " threads not traced (no free ring)" << std::endl;
+  }
+  os << "Note: the preload backend only sees calls made through the libc wrappers;\n"
+        "system calls made directly or from inside libc are not traced" << std::endl;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// Orphaned descendants are reparented to the tracer, as a subreaper,
+// so once it has no children no task is left to write a record
+bool PreloadTracer::reap()
+{
+  for (;;)
+  {
+    int status(0);
+    pid_t const rc = waitpid(-1, &status, WNOHANG);
+    if (rc == -1)
+    {
+      if (errno == ECHILD)
+        return false;
+      throw make_error("waitpid");
+    }
+    if (rc == 0)
+    {
+      return true;
+    }
+    if (rc != pid)
+    {
+      continue;
+    }
+    drain();
+    if (WIFEXITED(status))
+    {
+      os << "Exit(" << WEXITSTATUS(status) << ")" << std::endl;
+    }
+    else if (WIFSIGNALED(status))
+    {
+      os << "Terminated: " << sigstrm(WTERMSIG(status)) << std::endl;
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+size_t PreloadTracer::drain()
+{
+  size_t count(0);
+  for (int idx = 0; idx != Rings; ++idx)
+  {
+    Ring &ring = shared->rings[idx];
+    if (!ring.owner.load(std::memory_order_relaxed))
+    {
+      continue;
+    }
+    bool const released = ring.released.load(std::memory_order_acquire);
+    uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+    uint64_t const head = ring.head.load(std::memory_order_acquire);
+    for (; tail != head; ++tail)
+    {
+      Record const &rec = ring.records[tail & (Slots - 1)];
+      long const args[] = { (long)rec.args[0], (long)rec.args[1], (long)rec.args[2], 0, 0, 0 };
+      writeCallEntry(os, rec.func, args, rec.path);
+      writeCallExit(os, rec.rc);
+      os << '\n';
+      ++count;
+    }
+    ring.tail.store(tail, std::memory_order_release);
+    if (released)
+    {
+      // All the owner's records were written before it set released
+      ring.released.store(0, std::memory_order_relaxed);
+      ring.owner.store(0, std::memory_order_release);
+    }
+  }
+  if (count)
+  {
+    os.flush();
+  }
+  return count;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// A thread killed by a signal, or replaced by exec, never releases
+// its ring; check now and then whether each owner still exists.
+void PreloadTracer::reclaim()
+{
+  for (int idx = 0; idx != Rings; ++idx)
+  {
+    Ring &ring = shared->rings[idx];
+    int32_t const owner = ring.owner.load(std::memory_order_relaxed);
+    if (owner && kill(owner, 0) == -1 && errno == ESRCH)
+    {
+      ring.released.store(1, std::memory_order_release);
+    }
+  }
+}
@@ -0,0 +1,76 @@
+#ifndef PRELOAD_TRACER_H
+#define PRELOAD_TRACER_H
+
+/**@file
+
+  Consumer for the call records written by the TracePreload
+  library: the LD_PRELOAD backend of ProcessTracer.
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "PreloadRing.h"
+
+#include <sys/types.h>
+
+#include <iosfwd>
+#include <string>
+
+/** Run a child process with TracePreload loaded and print
+ * the calls it records in the ProcessTracer format */
+class PreloadTracer
+{
+public:
+  /** Create the shared memory; 'library' is the path to TracePreload */
+  PreloadTracer(std::string const &library, std::ostream &os);
+
+  ~PreloadTracer();
+
+  /** Start the target process */
+  void CreateProcess(int argc, char **argv);
+
+  /** Print records until the target process, and every descendant
+   * which outlives it, has exited */
+  void run();
+
+private:
+  /* don't copy or assign */
+  PreloadTracer(PreloadTracer const &) = delete;
+  PreloadTracer &operator=(PreloadTracer const &) = delete;
+
+  /** Reap any exited children, reporting the exit of the target;
+   * returns false once there are none left */
+  bool reap();
+
+  /** Print all available records; returns the number printed */
+  size_t drain();
+
+  /** Free rings whose owners have exited */
+  void reclaim();
+
+  std::string library;
+  std::ostream &os;
+  int fd;
+  PreloadRing::Header *shared;
+  pid_t pid;
+};
+
+#endif // PRELOAD_TRACER_H
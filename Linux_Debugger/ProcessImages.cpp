@@ -0,0 +1,75 @@
+/*
+NAME
+    ProcessImages
+
+DESCRIPTION
+    The program image each traced task is running.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "ProcessImages.h"
+#include "TraceUtils.h"
+
+#include <sys/ptrace.h>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ProcessImages::OnStart(pid_t pid)
+{
+  threads[pid] = pid;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// A forked child shares its parent's addresses until it writes to them,
+// but it is a different process and so gets an image of its own
+void ProcessImages::OnFork(pid_t parent, pid_t child, int event)
+{
+  threads[child] = (event == PTRACE_EVENT_CLONE) ? cloneTgid(parent, child) : child;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ProcessImages::OnExec(pid_t pid)
+{
+  // The exec'ing thread takes over the process id; start a new image
+  threads[pid] = pid;
+  processes.erase(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+pid_t ProcessImages::processOf(pid_t tid) const
+{
+  std::map<pid_t, pid_t>::const_iterator const it = threads.find(tid);
+  return (it == threads.end() || it->second == 0) ? tid : it->second;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+size_t ProcessImages::imageOf(pid_t tid)
+{
+  pid_t const pid = processOf(tid);
+  std::map<pid_t, size_t>::const_iterator const it = processes.find(pid);
+  if (it != processes.end())
+  {
+    return it->second;
+  }
+  Image image;
+  image.pid = pid;
+  image.command = readCommand(pid);
+  image.modules = ProcessModules(pid);
+  images.push_back(image);
+  processes[pid] = images.size() - 1;
+  return images.size() - 1;
+}
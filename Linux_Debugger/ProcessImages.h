@@ -0,0 +1,70 @@
+#ifndef PROCESS_IMAGES_H
+#define PROCESS_IMAGES_H
+
+/**@file
+
+  The program image each traced task is running
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "ElfSymbols.h"
+
+#include <sys/types.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+/** Track the image (a process between execs) each task is running,
+ * with a snapshot of its mappings so that addresses recorded during
+ * the trace can still be described once the process has gone.
+ * Listeners forward their OnStart, OnFork and OnExec events. */
+class ProcessImages
+{
+public:
+  struct Image
+  {
+    pid_t pid;
+    std::string command;
+    ProcessModules modules;
+  };
+
+  void OnStart(pid_t pid);
+  void OnFork(pid_t parent, pid_t child, int event);
+  void OnExec(pid_t pid);
+
+  /** The process containing task 'tid' */
+  pid_t processOf(pid_t tid) const;
+
+  /** Index of the image task 'tid' is running, created on first use */
+  size_t imageOf(pid_t tid);
+
+  Image &operator[](size_t idx) { return images[idx]; }
+  Image const &operator[](size_t idx) const { return images[idx]; }
+
+private:
+  std::vector<Image> images;
+  std::map<pid_t, pid_t> threads;        // thread id => process id
+  std::map<pid_t, size_t> processes;     // process id => current image
+};
+
+#endif // PROCESS_IMAGES_H
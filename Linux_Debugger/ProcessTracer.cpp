@@ -24,281 +24,440 @@ COPYRIGHT
 
 static char const szRCSID[] = "$Id: ProcessTracer.cpp 256 2020-04-09 21:35:25Z Roger $";
 
+#include "CallFilter.h"
+#include "CrashReport.h"
+#include "DepsRecorder.h"
+#include "FaultInjector.h"
+#include "FunctionCoverage.h"
+#include "FutexProfiler.h"
+#include "HeapProfiler.h"
+#include "IoUringProfiler.h"
+#include "MemoryTimeline.h"
+#include "NetProfiler.h"
+#include "OffCpuProfiler.h"
+#include "PerfCounters.h"
+#include "PreloadTracer.h"
+#include "ProcessTree.h"
+#include "SeccompTracer.h"
+#include "SelfStats.h"
+#include "TraceListener.h"
+#include "TraceLoop.h"
+#include "TraceTimeline.h"
+#include "TraceUtils.h"
+#include "Watchpoints.h"
+
 #include <errno.h>
+#include <getopt.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <wait.h>
 #include <asm/unistd.h>
 #include <sys/ptrace.h>
-#include <sys/user.h>
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <vector>
+
+/** Does 'Listener' override TraceListener::NAME? A member pointer
+ * named through a derived class has the type of the class declaring
+ * the member, so this is known at compile time */
+#define TRACE_LISTENER_OVERRIDES(Listener, NAME) \
+  (!std::is_same<decltype(&Listener::NAME), decltype(&TraceListener::NAME)>::value)
 
 namespace
 {
-  std::runtime_error make_error(std::string const &action)
-  {
-    std::string const what(action + " failed: " + strerror(errno));
-    return std::runtime_error(what);
-  }
-
-  static struct
-  {
-    int code;
-    char const *name;
-  } signals[] = {
-  { SIGHUP,    "hangup" },
-  { SIGINT,    "interrupt" },
-  { SIGQUIT,   "quit" },
-  { SIGILL,    "illegal instruction" },
-  { SIGTRAP,   "trap" },
-  { SIGABRT,   "abort" },
-  { SIGBUS,    "bus error" },
-  { SIGFPE,    "floating point exception" },
-  { SIGKILL,   "kill" },
-  { SIGUSR1,   "user 1" },
-  { SIGSEGV,   "segmentation violation" },
-  { SIGUSR2,   "user 2" },
-  { SIGPIPE,   "broken pipe" },
-  { SIGALRM,   "alarm" },
-  { SIGTERM,   "terminate" },
-  { SIGSTKFLT, "stack fault" },
-  { SIGCHLD,   "child" },
-  { SIGCONT,   "continue" },
-  { SIGSTOP,   "stop" },
-  { SIGTSTP,   "tty stop" },
-  { SIGTTIN,   "tty in" },
-  { SIGTTOU,   "tty out" },
-  { SIGURG,    "urgent" },
-  { SIGXCPU,   "exceeded CPU" },
-  { SIGXFSZ,   "exceeded file size"},
-  { SIGVTALRM, "virtual alarm" },
-  { SIGPROF,   "profiling" },
-  { SIGWINCH,  "window size change" },
-  { SIGPOLL,   "poll" },
-  };
+  using TraceLoop::make_error;
 
-  /** Strema helper for signals */
-  class sigstrm
-  {
-    int const signal;
-  public:
-    sigstrm(int signal) : signal(signal) {}
+  /** System call numbers considered when narrowing the stops; the x32
+   * calls above them are never selected */
+  int const PossibleCalls = 512;
 
-    friend std::ostream & operator<<(std::ostream& os, sigstrm const &rhs)
-    {
-      int idx = 0;
-      for (; idx != sizeof(signals)/sizeof(signals[0]); ++idx)
-      {
-        if (signals[idx].code == rhs.signal)
-        {
-          os << signals[idx].name;
-          break;
-        }
-      }
-      if (idx == sizeof(signals)/sizeof(signals[0]))
-      {
-        os << "signal " << rhs.signal;
-      }
-      return os;
-    }
-  };
+  /** The TracePreload library is expected alongside this program */
+  std::string preloadLibrary()
+  {
+    std::string path = readLink("/proc/self/exe");
+    path.erase(path.rfind('/') + 1);
+    return path + "libTracePreload.so";
+  }
 } // namespace
 
-/** Simple ptrace user */
+/** Simple ptrace user: a handler for TraceLoop::EventLoop.
+ * The listeners are chosen at run time, so each hook reaches them
+ * through TraceListener's virtual functions, but only those which
+ * override it: see TraceLoop.h */
 class ProcessTracer
 {
 private:
-  pid_t pid;
+  /** The TraceListener hooks */
+  enum Hook
+  {
+    StartHook, ExitHook, ForkHook, ExecHook, TrapHook, SignalHook, ResumeHook, StepHook, ReportHook,
+    CallRegistersHook, CallEntryHook, CallResultHook, CallExitHook, Hooks
+  };
+
   std::ostream &os;
-  bool initialised;
+  std::vector<TraceListener *> hooked[Hooks];   // the listeners overriding each hook
+  std::vector<std::vector<TraceListener *> > byCall[Hooks];  // ...and for the call hooks
+                                                             // selecting each call number
+  size_t analyses;                 // listeners which replace the default call trace
+  CallFilter const *filter;
+
+  /** A call passed by the filter at entry, or waiting for its result */
+  struct Pending
+  {
+    CallFilter::Event event;
+    bool shown;
+  };
+  std::map<pid_t, Pending> pending;
 
 public:
+  typedef SelfStats::Policy Stats;
+
   /** Create */
-  ProcessTracer(pid_t pid, std::ostream &os)
-  : pid(pid), os(os), initialised(false) {}
+  explicit ProcessTracer(std::ostream &os)
+  : os(os), analyses(0), filter(0) {}
 
-  /** Run the debug loop */
-  void run();
+  /** Add an analysis to be driven by the trace.
+   * When any analysis is present the default call trace is not shown */
+  template <typename Listener>
+  void addListener(Listener &listener) { addModifier(listener); ++analyses; }
 
-private:
-  /** Stop received */
-  int OnStop(int signal, int event);
+  /** Add a listener which changes what the traced program sees, such
+   * as the fault injector, and leaves the default call trace shown */
+  template <typename Listener>
+  void addModifier(Listener &listener);
+
+  /** Show the calls passed by 'filter' in the default call trace,
+   * rather than open, openat and close */
+  void setFilter(CallFilter const &filter) { this->filter = &filter; }
 
-  /** PTrace event received */
-  void OnEvent(int event);
+  /** Show the default call trace? */
+  bool verbose() const { return analyses == 0; }
+
+  /** The system calls wanted by the default call trace or any listener,
+   * out of the first 'possible' numbers */
+  std::vector<int> wantedCalls(int possible);
+
+  /** Report the results of each listener */
+  void Report();
+
+  /** First stop of the initial task */
+  void OnStart(pid_t pid);
+
+  /** Task exited or was terminated */
+  void OnExit(pid_t pid, int status);
+
+  /** New process or thread created */
+  void OnFork(pid_t pid, pid_t child, int event);
+
+  /** Program executed */
+  void OnExec(pid_t pid);
 
   /** System trap received */
-  void OnTrap();
+  void OnTrap(pid_t pid);
+
+  /** System call being entered */
+  void OnSysCallEntry(pid_t pid, TraceLoop::SysCall const &call);
 
-  /** System call received */
-  void OnSysCall();
+  /** Sytem call being exited */
+  void OnSysCallExit(pid_t pid, TraceLoop::SysCall const &call);
 
+  /** Signal received */
+  int OnSignal(pid_t pid, int signal);
+
+  /** Time to hold the task before resuming it */
+  long long OnResume(pid_t pid);
+
+  /** Resume the task for one instruction? */
+  bool SingleStep(pid_t pid);
+
+private:
   /** Check if specified system call is of interest */
   bool SelectedCall(int func);
 
-  /** System call 'func' being entered */
-  void OnCallEntry(int func, long int args[]);
+  /** The listeners overriding call 'hook' which select call 'func' */
+  std::vector<TraceListener *> const &selecting(Hook hook, int func);
 
-  /** Sytem call 'func' being exited */
-  void OnCallExit(int func, int rc);
+  /** Read a string from the taget process */
+  std::string readString(pid_t pid, long addr);
 
-  /** Signal received */
-  bool OnSignal(int signal);
+  /** Trace the entry of a call passed by the filter */
+  void filterEntry(pid_t pid, TraceLoop::SysCall const &call);
 
-  /** Read a string from the taget process */
-  std::string readString(long addr);
+  /** Trace the exit of a call passed by the filter */
+  void filterExit(pid_t pid, TraceLoop::SysCall const &call, long rc);
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
-void ProcessTracer::run()
+template <typename Listener>
+void ProcessTracer::addModifier(Listener &listener)
 {
-  int status(0); // Status of the stopped child process
+  bool const overrides[Hooks] = {
+    TRACE_LISTENER_OVERRIDES(Listener, OnStart),
+    TRACE_LISTENER_OVERRIDES(Listener, OnExit),
+    TRACE_LISTENER_OVERRIDES(Listener, OnFork),
+    TRACE_LISTENER_OVERRIDES(Listener, OnExec),
+    TRACE_LISTENER_OVERRIDES(Listener, OnTrap),
+    TRACE_LISTENER_OVERRIDES(Listener, OnSignal),
+    TRACE_LISTENER_OVERRIDES(Listener, OnResume),
+    TRACE_LISTENER_OVERRIDES(Listener, SingleStep),
+    TRACE_LISTENER_OVERRIDES(Listener, Report),
+    TRACE_LISTENER_OVERRIDES(Listener, OnCallRegisters),
+    TRACE_LISTENER_OVERRIDES(Listener, OnCallEntry),
+    TRACE_LISTENER_OVERRIDES(Listener, OnCallResult),
+    TRACE_LISTENER_OVERRIDES(Listener, OnCallExit),
+  };
+  for (int hook = 0; hook != Hooks; ++hook)
+  {
+    if (overrides[hook])
+      hooked[hook].push_back(&listener);
+    byCall[hook].clear();
+  }
+}
 
-  // This is the main tracing loop. When the child stops,
-  // we examine the system call and its arguments
-  while ((pid = waitpid(-1, &status, __WALL)) != -1)
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// SelectedCall is fixed for each listener, so it is asked once per call number
+std::vector<TraceListener *> const &ProcessTracer::selecting(Hook hook, int func)
+{
+  static std::vector<TraceListener *> const none;
+  if (func < 0 || hooked[hook].empty())
   {
-    int send_signal(0);
-    if (WIFSTOPPED(status))
+    return none;
+  }
+  std::vector<std::vector<TraceListener *> > &table = byCall[hook];
+  while (table.size() <= (size_t)func)
+  {
+    int const next = table.size();
+    table.push_back(std::vector<TraceListener *>());
+    for (size_t idx = 0; idx != hooked[hook].size(); ++idx)
     {
-      send_signal = OnStop(WSTOPSIG(status), status >> 16);
+      if (hooked[hook][idx]->SelectedCall(next))
+        table.back().push_back(hooked[hook][idx]);
     }
-    else if (WIFEXITED(status))
-    {
+  }
+  return table[func];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ProcessTracer::Report()
+{
+  std::vector<TraceListener *> const &listeners = hooked[ReportHook];
+  for (size_t idx = 0; idx != listeners.size(); ++idx)
+  {
+    listeners[idx]->Report(os);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ProcessTracer::OnStart(pid_t pid)
+{
+  std::vector<TraceListener *> const &listeners = hooked[StartHook];
+  for (size_t idx = 0; idx != listeners.size(); ++idx)
+  {
+    listeners[idx]->OnStart(pid);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ProcessTracer::OnExit(pid_t pid, int status)
+{
+  if (verbose())
+  {
+    if (WIFEXITED(status))
       os << "Exit(" << WEXITSTATUS(status) << ")" << std::endl;
-    }
-    else if (WIFSIGNALED(status))
-    {
-      os << "Terminated: " << sigstrm(WTERMSIG(status)) << std::endl;
-    }
-    else if (WIFCONTINUED(status))
-    {
-      os << "Continued" << std::endl;
-    }
     else
-    {
-      os << "Unexpected status: " << status << std::endl;
-    }
+      os << "Terminated: " << sigstrm(WTERMSIG(status)) << std::endl;
+  }
+  pending.erase(pid);
+  SelfStats::Timer timer(SelfStats::Listeners);
+  std::vector<TraceListener *> const &listeners = hooked[ExitHook];
+  for (size_t idx = 0; idx != listeners.size(); ++idx)
+  {
+    listeners[idx]->OnExit(pid, status);
+  }
+}
 
-    ptrace(PTRACE_SYSCALL, pid, 0, send_signal);
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ProcessTracer::OnFork(pid_t pid, pid_t child, int event)
+{
+  if (verbose())
+    os << "New pid: " << child << std::endl;
+  SelfStats::Timer timer(SelfStats::Listeners);
+  std::vector<TraceListener *> const &listeners = hooked[ForkHook];
+  for (size_t idx = 0; idx != listeners.size(); ++idx)
+  {
+    listeners[idx]->OnFork(pid, child, event);
   }
-  if (errno != ECHILD)
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ProcessTracer::OnExec(pid_t pid)
+{
+  SelfStats::Timer timer(SelfStats::Listeners);
+  std::vector<TraceListener *> const &listeners = hooked[ExecHook];
+  for (size_t idx = 0; idx != listeners.size(); ++idx)
   {
-    throw make_error("wait");
+    listeners[idx]->OnExec(pid);
   }
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
-int ProcessTracer::OnStop(int signal, int event)
+void ProcessTracer::OnTrap(pid_t pid)
 {
-  if (!initialised)
+  if (verbose())
   {
-    initialised = true;
-    long const options = PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACEFORK |
-                         PTRACE_O_TRACEVFORK | PTRACE_O_TRACECLONE |
-                         PTRACE_O_TRACEEXEC;
-    if (ptrace(PTRACE_SETOPTIONS, pid, 0, options) == -1)
-    {
-      throw make_error("PTRACE_SETOPTIONS");
-    }
+    os << "Breakpoint" << std::endl;
+  }
+  SelfStats::Timer timer(SelfStats::Listeners);
+  std::vector<TraceListener *> const &listeners = hooked[TrapHook];
+  for (size_t idx = 0; idx != listeners.size(); ++idx)
+  {
+    listeners[idx]->OnTrap(pid);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ProcessTracer::OnSysCallEntry(pid_t pid, TraceLoop::SysCall const &call)
+{
+  if (filter)
+  {
+    if (verbose() && filter->selected(call.func))
+      filterEntry(pid, call);
   }
-  else if (signal == SIGTRAP)
+  else if (verbose() && SelectedCall(call.func))
   {
-    if (event)
+    std::string path;
+    if (call.func == __NR_open)
     {
-      OnEvent(event);
+      path = readString(pid, call.args[0]);
     }
-    else
+    else if (call.func == __NR_openat)
     {
-      OnTrap();
+      path = readString(pid, call.args[1]);
     }
+    SelfStats::Timer timer(SelfStats::Output);
+    writeCallEntry(os, call.func, call.args, path);
+    os << std::flush;
   }
-  else if (signal == (SIGTRAP | 0x80))
+  SelfStats::Timer timer(SelfStats::Listeners);
+  std::vector<TraceListener *> const &registers = selecting(CallRegistersHook, call.func);
+  for (size_t idx = 0; idx != registers.size(); ++idx)
   {
-    OnSysCall();
+    registers[idx]->OnCallRegisters(pid, call.func, call.regs);
   }
-  else
+  std::vector<TraceListener *> const &listeners = selecting(CallEntryHook, call.func);
+  for (size_t idx = 0; idx != listeners.size(); ++idx)
   {
-    if (OnSignal(signal))
-    {
-      return signal;
-    }
+    listeners[idx]->OnCallEntry(pid, call.func, call.args);
   }
-  return 0;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
-void ProcessTracer::OnEvent(int event)
+void ProcessTracer::OnSysCallExit(pid_t pid, TraceLoop::SysCall const &call)
 {
-  unsigned long message(0);
-  switch (event)
+  long rc(call.rc);
   {
-  case PTRACE_EVENT_CLONE:
-  case PTRACE_EVENT_FORK:
-  case PTRACE_EVENT_VFORK:
-    if (ptrace(PTRACE_GETEVENTMSG, pid, 0, &message) == 0)
+    SelfStats::Timer timer(SelfStats::Listeners);
+    std::vector<TraceListener *> const &modifiers = selecting(CallResultHook, call.func);
+    for (size_t idx = 0; idx != modifiers.size(); ++idx)
     {
-      os << "New pid: " << message << std::endl;
+      rc = modifiers[idx]->OnCallResult(pid, call.func, rc);
     }
-    break;
   }
-}
-  
-/////////////////////////////////////////////////////////////////////////////////////////////////
-void ProcessTracer::OnTrap()
-{
-  siginfo_t siginfo;
-  if (ptrace(PTRACE_GETSIGINFO, pid, 0, &siginfo) == -1)
+  if (filter)
   {
-     throw make_error("ptrace(PTRACE_GETSIGINFO)");
+    if (verbose() && filter->selected(call.func))
+      filterExit(pid, call, rc);
   }
-  if (siginfo.si_code == SIGTRAP)
+  else if (verbose() && SelectedCall(call.func))
   {
-    OnSysCall();
+    SelfStats::Timer timer(SelfStats::Output);
+    writeCallExit(os, rc);
+    os << std::endl;
   }
-  else
+  SelfStats::Timer timer(SelfStats::Listeners);
+  std::vector<TraceListener *> const &listeners = selecting(CallExitHook, call.func);
+  for (size_t idx = 0; idx != listeners.size(); ++idx)
   {
-    os << "Breakpoint" << std::endl;
+    listeners[idx]->OnCallExit(pid, call.func, call.args, rc);
   }
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
-void ProcessTracer::OnSysCall()
+void ProcessTracer::filterEntry(pid_t pid, TraceLoop::SysCall const &call)
 {
-  struct user_regs_struct regs;
-  if (ptrace(PTRACE_GETREGS, pid, 0, &regs) == -1)
+  CallFilter::Event event(pid, call.func, call.args);
+  CallFilter::Result const result = filter->evaluate(event);
+  if (result == CallFilter::Fail)
   {
-     throw make_error("ptrace(PTRACE_GETREGS)");
+    return;
   }
+  Pending &entry = pending[pid];
+  entry.event = event;
+  entry.shown = (result == CallFilter::Pass);
+  if (entry.shown)
+  {
+    std::string const &path = entry.event.path();
+    SelfStats::Timer timer(SelfStats::Output);
+    writeCallEntry(os, call.func, call.args, path);
+    os << std::flush;
+  }
+}
 
-#if __x86_64__
-  int const rc = regs.rax;
-  int const func = regs.orig_rax;
-  long int args[] = { regs.rdi, regs.rsi, regs.rdx, regs.r10, regs.r8, regs.r9 };
-#elif __i386__
-  int const rc = regs.eax;
-  int const func = regs.orig_eax;
-  long int args[] = { regs.ebx, regs.ecx, regs.edx, regs.esi, regs.edi, regs.ebp };
-#else
-#error Unknown target architecture
-#endif // __x86_64__
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ProcessTracer::filterExit(pid_t pid, TraceLoop::SysCall const &call, long rc)
+{
+  std::map<pid_t, Pending>::iterator const it = pending.find(pid);
+  if (it == pending.end())
+  {
+    return;
+  }
+  Pending &entry = it->second;
+  if (!entry.shown)
+  {
+    entry.event.exit(rc);
+    if (filter->evaluate(entry.event) == CallFilter::Pass)
+    {
+      std::string const &path = entry.event.path();
+      SelfStats::Timer timer(SelfStats::Output);
+      writeCallEntry(os, call.func, call.args, path);
+      entry.shown = true;
+    }
+  }
+  if (entry.shown)
+  {
+    SelfStats::Timer timer(SelfStats::Output);
+    writeCallExit(os, rc);
+    os << std::endl;
+  }
+  pending.erase(it);
+}
 
-  if (SelectedCall(func))
+/////////////////////////////////////////////////////////////////////////////////////////////////
+std::vector<int> ProcessTracer::wantedCalls(int possible)
+{
+  std::vector<int> calls;
+  for (int func = 0; func != possible; ++func)
   {
-    if (rc == -ENOSYS)
+    bool wanted = verbose() && (filter ? filter->selected(func) : SelectedCall(func));
+    for (int hook = CallRegistersHook; !wanted && hook != Hooks; ++hook)
     {
-      OnCallEntry(func, args);
+      wanted = !selecting(static_cast<Hook>(hook), func).empty();
     }
-    else
+    if (wanted)
     {
-      OnCallExit(func, rc);
+      calls.push_back(func);
     }
   }
+  return calls;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -307,6 +466,7 @@ bool ProcessTracer::SelectedCall(int func)
   switch (func)
   {
   case __NR_open:
+  case __NR_openat:
   case __NR_close:
     return true;
   }
@@ -314,39 +474,42 @@ bool ProcessTracer::SelectedCall(int func)
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
-void ProcessTracer::OnCallEntry(int func, long int args[])
+long long ProcessTracer::OnResume(pid_t pid)
 {
-  if (func == __NR_open)
-  {
-    os << "open(\"" << readString(args[0]) << "\") = " << std::flush;
-  }
-  else if (func == __NR_close)
+  long long hold(0);
+  std::vector<TraceListener *> const &listeners = hooked[ResumeHook];
+  for (size_t idx = 0; idx != listeners.size(); ++idx)
   {
-    os << "close(" << args[0] << ") = " << std::flush;
-  }
-  else
-  {
-    os << '#' << func << "(" << args[0] << ") = " << std::flush;
+    hold = std::max(hold, listeners[idx]->OnResume(pid));
   }
+  return hold;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
-void ProcessTracer::OnCallExit(int func, int rc)
+bool ProcessTracer::SingleStep(pid_t pid)
 {
-  if (rc < 0)
-  {
-    os << rc << "(" << strerror(-rc) << ")" << std::endl;
-  }
-  else
+  std::vector<TraceListener *> const &listeners = hooked[StepHook];
+  for (size_t idx = 0; idx != listeners.size(); ++idx)
   {
-    os << std::hex << rc << std::dec << std::endl;
+    if (listeners[idx]->SingleStep(pid))
+      return true;
   }
+  return false;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
-bool ProcessTracer::OnSignal(int signal)
+int ProcessTracer::OnSignal(pid_t pid, int signal)
 {
-  os << "Signal: " << sigstrm(signal) << std::endl;
+  if (verbose())
+    os << "Signal: " << sigstrm(signal) << std::endl;
+  {
+    SelfStats::Timer timer(SelfStats::Listeners);
+    std::vector<TraceListener *> const &listeners = hooked[SignalHook];
+    for (size_t idx = 0; idx != listeners.size(); ++idx)
+    {
+      listeners[idx]->OnSignal(pid, signal);
+    }
+  }
   bool bDeliver(true);
   switch (signal)
   {
@@ -355,12 +518,13 @@ bool ProcessTracer::OnSignal(int signal)
       bDeliver = false;
       break;
   }
-  return bDeliver;
+  return bDeliver ? signal : 0;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
-std::string ProcessTracer::readString(long addr)
+std::string ProcessTracer::readString(pid_t pid, long addr)
 {
+  SelfStats::Timer timer(SelfStats::ReadString);
   std::string result;
 #if 1
 
@@ -372,7 +536,7 @@ std::string ProcessTracer::readString(long addr)
   do
   {
     long const peekWord =
-      ptrace( PTRACE_PEEKDATA, pid, peekAddr, NULL );
+      SelfStats::ptrace( PTRACE_PEEKDATA, pid, peekAddr, NULL );
     if ( -1 == peekWord )
     {
        throw make_error("ptrace(PTRACE_PEEKDATA)");
@@ -391,9 +555,7 @@ std::string ProcessTracer::readString(long addr)
     offset = 0;
   } while ( !stringFound );
 #else
-  std::ostringstream os;
-  os << "/proc/" << pid << "/mem";
-  std::ifstream mem(os.str().c_str(), std::ios::binary);
+  std::ifstream mem(procName(pid, "mem").c_str(), std::ios::binary);
   mem.exceptions(std::ios::failbit);
   mem.seekg((std::streampos)addr);
   std::getline(mem, result, '\0');
@@ -401,48 +563,374 @@ std::string ProcessTracer::readString(long addr)
   return result;
 }
 
-/////////////////////////////////////////////////////////////////////////////////////////////////
-// Fork a child process, running under ptrace, and return its pid
-pid_t CreateProcess(int argc, char **argv)
+int main(int argc, char **argv)
 {
-  pid_t const cpid = fork();
-  if (cpid > 0)
-  {
-    // In the parent
-    return cpid; 
-  }
-  else if (cpid == 0)
+  int rc(1);
+  bool tree(false);
+  bool deps(false);
+  bool futex(false);
+  bool ioUring(false);
+  std::string ioUringFile;
+  bool memory(false);
+  bool statm(false);
+  std::string memoryFile;
+  bool net(false);
+  bool offCpu(false);
+  bool counters(false);
+  std::string countersFile;
+  bool coverage(false);
+  std::string coverageFile;
+  unsigned long heap(0);
+  std::string timelineFile;
+  std::string offCpuFile;
+  bool deferred(false);
+  bool selfStats(false);
+  std::string depsFile;
+  std::vector<std::string> watches;
+  std::vector<std::string> injections;
+  std::string filterText;
+  bool crash(false);
+  std::string backend("ptrace");
+  TraceLoop::ResumePolicy policy(TraceLoop::Fifo);
+
+  static struct option const longopts[] = {
+    { "tree", no_argument, 0, 't' },
+    { "deps", optional_argument, 0, 'd' },
+    { "futex", no_argument, 0, 'f' },
+    { "io-uring", optional_argument, 0, 'i' },
+    { "memory", optional_argument, 0, 'm' },
+    { "statm", no_argument, 0, 'M' },
+    { "net", no_argument, 0, 'n' },
+    { "offcpu", optional_argument, 0, 'o' },
+    { "deferred-symbols", no_argument, 0, 'D' },
+    { "counters", optional_argument, 0, 'c' },
+    { "coverage", optional_argument, 0, 'C' },
+    { "heap", optional_argument, 0, 'H' },
+    { "timeline", required_argument, 0, 'T' },
+    { "watch", required_argument, 0, 'w' },
+    { "inject", required_argument, 0, 'j' },
+    { "filter", required_argument, 0, 'F' },
+    { "crash", no_argument, 0, 'K' },
+    { "backend", required_argument, 0, 'b' },
+    { "self-stats", no_argument, 0, 's' },
+    { "resume", required_argument, 0, 'r' },
+    { 0, 0, 0, 0 }
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "+t", longopts, 0)) != -1)
   {
-    // In the child
-    if (ptrace(PTRACE_TRACEME, 0, 0, 0) == -1)
+    switch (opt)
     {
-      throw make_error("ptrace(PTRACE_TRACEME)");
+    case 't':
+      tree = true;
+      break;
+    case 'd':
+      deps = true;
+      if (optarg)
+        depsFile = optarg;
+      break;
+    case 'f':
+      futex = true;
+      break;
+    case 'i':
+      ioUring = true;
+      if (optarg)
+        ioUringFile = optarg;
+      break;
+    case 'm':
+      memory = true;
+      if (optarg)
+        memoryFile = optarg;
+      break;
+    case 'M':
+      statm = true;
+      break;
+    case 'n':
+      net = true;
+      break;
+    case 'o':
+      offCpu = true;
+      if (optarg)
+        offCpuFile = optarg;
+      break;
+    case 'D':
+      deferred = true;
+      break;
+    case 'c':
+      counters = true;
+      if (optarg)
+        countersFile = optarg;
+      break;
+    case 'C':
+      coverage = true;
+      if (optarg)
+        coverageFile = optarg;
+      break;
+    case 'H':
+      heap = optarg ? strtoul(optarg, 0, 10) : 1;
+      if (heap == 0)
+      {
+        std::cerr << "Invalid heap sample interval: " << optarg << std::endl;
+        argc = 0;
+      }
+      break;
+    case 'T':
+      timelineFile = optarg;
+      break;
+    case 'w':
+      watches.push_back(optarg);
+      break;
+    case 'j':
+      injections.push_back(optarg);
+      break;
+    case 'F':
+      filterText = optarg;
+      break;
+    case 'K':
+      crash = true;
+      break;
+    case 'b':
+      backend = optarg;
+      break;
+    case 's':
+      selfStats = true;
+      break;
+    case 'r':
+      if (strcmp(optarg, "fifo") == 0)
+        policy = TraceLoop::Fifo;
+      else if (strcmp(optarg, "rr") == 0)
+        policy = TraceLoop::RoundRobin;
+      else if (strcmp(optarg, "spf") == 0)
+        policy = TraceLoop::ShortestFirst;
+      else
+      {
+        std::cerr << "Unknown resume policy: " << optarg << std::endl;
+        argc = 0;
+      }
+      break;
+    default:
+      argc = 0;
+      break;
     }
-    execv(argv[0], argv);
-    throw make_error("execv");
   }
-  else
+
+  if (backend != "ptrace" && backend != "preload" && backend != "seccomp")
   {
-    throw make_error("fork");
+    std::cerr << "Unknown backend: " << backend << std::endl;
+    argc = 0;
+  }
+  else if (backend != "ptrace" && (tree || deps || futex || ioUring || memory || net || offCpu || counters ||
+                                    coverage || heap || !timelineFile.empty() || !watches.empty() ||
+                                    !injections.empty() || !filterText.empty() || crash || selfStats))
+  {
+    std::cerr << "--tree, --deps, --futex, --io-uring, --memory, --net, --offcpu, --counters, --coverage,"
+                 " --heap, --timeline, --watch, --inject, --filter, --crash and --self-stats need the"
+                 " ptrace backend"
+              << std::endl;
+    argc = 0;
+  }
+  else if (!filterText.empty() && (tree || deps || futex || ioUring || memory || net || offCpu || counters ||
+                                   coverage || heap || !timelineFile.empty() || !watches.empty() ||
+                                   !injections.empty() || crash))
+  {
+    std::cerr << "--filter selects the default call trace, which is not shown with other options" << std::endl;
+    argc = 0;
+  }
+  else if (coverage && heap)
+  {
+    std::cerr << "--coverage and --heap cannot be used together" << std::endl;
+    argc = 0;
   }
-}
-
-int main(int argc, char **argv)
-{
-  int rc(1);
 
-  if (argc <= 1)
+  if (argc <= optind)
   {
-    std::cout << "Syntax: ProcessTracer command_line" << std::endl;
+    std::cout << "Syntax: ProcessTracer [options] command_line\n"
+                 "  --tree         report the process tree with wall times and the critical path\n"
+                 "  --deps[=file]  write the files used by each exec'd command\n"
+                 "  --futex        report the most contended futexes and who waited for them\n"
+                 "  --io-uring[=file]\n"
+                 "                 decode io_uring submissions and completions and report their\n"
+                 "                 latency, logging every operation to the file\n"
+                 "  --memory[=file]\n"
+                 "                 write a CSV time series of mapped memory and list large live mappings\n"
+                 "  --statm        with --memory, also sample /proc/<pid>/statm\n"
+                 "  --net          report socket connections, transfers and small writes\n"
+                 "  --offcpu[=file]\n"
+                 "                 report time blocked in system calls, writing folded stacks\n"
+                 "                 for the calls blocked 0.1 ms or more\n"
+                 "  --deferred-symbols\n"
+                 "                 with --offcpu, write raw addresses and module lists to be\n"
+                 "                 resolved after the run by TraceSymbolize\n"
+                 "  --counters[=file]\n"
+                 "                 count context switches, page faults and cpu time in each\n"
+                 "                 system call, logging every call to the file\n"
+                 "  --coverage[=file]\n"
+                 "                 report the functions executed, with a one-shot breakpoint\n"
+                 "                 on each function entry, writing first-hit times to the file\n"
+                 "  --heap[=N]     profile malloc, free, new and delete with breakpoints, recording\n"
+                 "                 the call site and result of allocations sampled on average\n"
+                 "                 once in N bytes; every call still stops on entry\n"
+                 "  --timeline=file\n"
+                 "                 write every system call as a Chrome Trace Event JSON timeline\n"
+                 "                 for Perfetto or chrome://tracing\n"
+                 "  --watch=target[:len][:w|rw|x]\n"
+                 "                 watch a hex address or program symbol with a hardware\n"
+                 "                 watchpoint in every thread (up to four)\n"
+                 "  --inject=call[,path=prefix][,fd=kind][,delay=time|time-time|exp:time|error=errno]\n"
+                 "          [,prob=p][,count=n]\n"
+                 "                 delay matching system calls before they run, or fail them;\n"
+                 "                 call is a name, number or *, kind is file, dir, socket, pipe,\n"
+                 "                 char or block, and times are in us, ms or s\n"
+                 "  --filter=expression\n"
+                 "                 show the calls passed by the expression in the default call\n"
+                 "                 trace, eg 'open && path ~ \"/var/lib/*\" && rc < 0'; terms are\n"
+                 "                 call names, rc, arg0-arg5 or pid compared with a number, and\n"
+                 "                 path compared with a string (== !=) or pattern (~ !~),\n"
+                 "                 combined with !, && and ||\n"
+                 "  --crash        on a fatal signal, report the stack of the task with the\n"
+                 "                 parameters and local variables of each frame\n"
+                 "  --self-stats   report where the tracer itself spent its time\n"
+                 "  --resume=fifo|rr|spf\n"
+                 "                 order in which a batch of stopped tasks is resumed: as\n"
+                 "                 reported, round-robin by process, or shortest expected\n"
+                 "                 handling time first\n"
+                 "  --backend=ptrace|preload|seccomp\n"
+                 "                 trace with ptrace stops (the default), with the\n"
+                 "                 LD_PRELOAD library, which only sees libc wrappers,\n"
+                 "                 or with seccomp notifications, which only see call entry"
+              << std::endl;
     return 1;
   }
-  ++argv;
-  --argc;
+  argv += optind;
+  argc -= optind;
 
   try
   {
-    pid_t pid = CreateProcess(argc, argv);
-    ProcessTracer(pid, std::cerr).run();
+    if (backend == "preload")
+    {
+      PreloadTracer tracer(preloadLibrary(), std::cerr);
+      tracer.CreateProcess(argc, argv);
+      tracer.run();
+      return 0;
+    }
+    if (backend == "seccomp")
+    {
+      SeccompTracer tracer(std::cerr);
+      tracer.CreateProcess(argc, argv);
+      tracer.run();
+      return 0;
+    }
+
+    TraceTimeline timeline(timelineFile);
+    Watchpoints watchpoints;
+    for (size_t idx = 0; idx != watches.size(); ++idx)
+    {
+      watchpoints.add(watches[idx]);
+    }
+    FaultInjector faultInjector;
+    for (size_t idx = 0; idx != injections.size(); ++idx)
+    {
+      faultInjector.add(injections[idx]);
+    }
+    std::unique_ptr<CallFilter> filter;
+    if (!filterText.empty())
+    {
+      filter.reset(new CallFilter(filterText));
+    }
+    // Fail before running what may be a long command, not after it
+    DepsRecorder depsRecorder(depsFile);
+    if (deps && !depsRecorder.writable())
+    {
+      std::cerr << "Unable to write dependency manifests to " << depsFile << std::endl;
+      return 1;
+    }
+
+    ProcessTracer tracer(std::cerr);
+    if (filter)
+    {
+      tracer.setFilter(*filter);
+    }
+    if (!faultInjector.empty())
+    {
+      tracer.addModifier(faultInjector);
+    }
+    ProcessTree processTree;
+    if (tree)
+    {
+      tracer.addListener(processTree);
+    }
+    if (deps)
+    {
+      tracer.addListener(depsRecorder);
+    }
+    FutexProfiler futexProfiler;
+    if (futex)
+    {
+      tracer.addListener(futexProfiler);
+    }
+    IoUringProfiler ioUringProfiler(ioUringFile);
+    if (ioUring)
+    {
+      tracer.addListener(ioUringProfiler);
+    }
+    MemoryTimeline memoryTimeline(memoryFile, statm);
+    if (memory)
+    {
+      tracer.addListener(memoryTimeline);
+    }
+    NetProfiler netProfiler;
+    if (net)
+    {
+      tracer.addListener(netProfiler);
+    }
+    OffCpuProfiler offCpuProfiler(offCpuFile, deferred);
+    if (offCpu)
+    {
+      tracer.addListener(offCpuProfiler);
+    }
+    PerfCounters perfCounters(countersFile);
+    if (counters)
+    {
+      tracer.addListener(perfCounters);
+    }
+    FunctionCoverage functionCoverage(coverageFile);
+    if (coverage)
+    {
+      tracer.addListener(functionCoverage);
+    }
+    HeapProfiler heapProfiler(heap);
+    if (heap)
+    {
+      tracer.addListener(heapProfiler);
+    }
+    if (!timelineFile.empty())
+    {
+      tracer.addListener(timeline);
+    }
+    if (!watchpoints.empty())
+    {
+      tracer.addListener(watchpoints);
+    }
+    CrashReport crashReport;
+    if (crash)
+    {
+      tracer.addListener(crashReport);
+    }
+    if (selfStats)
+    {
+      SelfStats::enable();
+    }
+    // Only the calls something wants stop the target: none at all
+    // for --watch or --crash alone, and mmap for --coverage or --heap
+    std::vector<int> const calls = tracer.wantedCalls(PossibleCalls);
+    TraceLoop::SysCallStops const stops = TraceLoop::stopsFor(calls, PossibleCalls);
+    pid_t pid = TraceLoop::CreateProcess(argc, argv, stops == TraceLoop::FilteredCalls ? calls : std::vector<int>());
+    TraceLoop::EventLoop<ProcessTracer> loop(tracer, pid);
+    loop.setSysCallStops(stops);
+    loop.setResumePolicy(policy);
+    loop.run();
+    tracer.Report();
+    SelfStats::report(std::cerr);
     rc = 0;
   }
   catch ( std::exception &ex)
@@ -0,0 +1,302 @@
+/*
+NAME
+    ProcessTree
+
+DESCRIPTION
+    Process-tree wall-time profiler for ProcessTracer.
+
+    Records the fork, exec, exit and wait times of each process in
+    the traced tree. The time a parent spends blocked in wait4 is
+    attributed to the child it reaped, which lets us find the
+    critical path: the chain of processes that the whole run was
+    actually waiting for.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "ProcessTree.h"
+#include "TraceUtils.h"
+
+#include <wait.h>
+#include <asm/unistd.h>
+#include <sys/ptrace.h>
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+  /** Stream helper for printing microseconds as seconds */
+  class secs
+  {
+    long long const value;
+  public:
+    secs(long long value) : value(value) {}
+
+    friend std::ostream & operator<<(std::ostream& os, secs const &rhs)
+    {
+      std::ostringstream oss;
+      oss << std::fixed << std::setprecision(3) << rhs.value / 1000000.0;
+      return os << std::setw(10) << oss.str();
+    }
+  };
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+ProcessTree::ProcessTree()
+: root(0)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ProcessTree::OnStart(pid_t pid)
+{
+  root = pid;
+  Process &proc = processes[pid];
+  proc.pid = pid;
+  proc.parent = 0;
+  proc.forked = 0;
+  proc.exec = elapsed.usec();
+  proc.exited = -1;
+  proc.waited = 0;
+  proc.waiting = 0;
+  proc.status = 0;
+  proc.command = readCommand(pid);
+  threads[pid] = pid;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ProcessTree::OnFork(pid_t parent, pid_t child, int event)
+{
+  pid_t const tgid = (event == PTRACE_EVENT_CLONE) ? cloneTgid(parent, child) : child;
+  if (tgid != child)
+  {
+    // A new thread in an existing process
+    threads[child] = tgid;
+    return;
+  }
+
+  Process *pproc = findProcess(parent);
+  Process &proc = processes[child];
+  proc.pid = child;
+  proc.parent = pproc ? pproc->pid : 0;
+  proc.forked = elapsed.usec();
+  proc.exec = -1;
+  proc.exited = -1;
+  proc.waited = 0;
+  proc.waiting = 0;
+  proc.status = 0;
+  if (pproc)
+  {
+    // Until it execs the child is running the parent's program
+    proc.command = pproc->command;
+    pproc->children.push_back(child);
+  }
+  threads[child] = child;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ProcessTree::OnExec(pid_t pid)
+{
+  if (Process *proc = findProcess(pid))
+  {
+    proc->exec = elapsed.usec();
+    proc->command = readCommand(proc->pid);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ProcessTree::OnExit(pid_t pid, int status)
+{
+  std::map<pid_t, Process>::iterator it = processes.find(pid);
+  if (it != processes.end())
+  {
+    it->second.exited = elapsed.usec();
+    it->second.status = status;
+  }
+  waitEntry.erase(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool ProcessTree::SelectedCall(int func)
+{
+  return func == __NR_wait4;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ProcessTree::OnCallEntry(pid_t pid, int func, long const args[])
+{
+  waitEntry[pid] = elapsed.usec();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ProcessTree::OnCallExit(pid_t pid, int func, long const args[], long rc)
+{
+  std::map<pid_t, usec>::iterator it = waitEntry.find(pid);
+  if (it == waitEntry.end())
+  {
+    return;
+  }
+  usec const blocked = elapsed.usec() - it->second;
+  waitEntry.erase(it);
+
+  // rc is the pid reaped, or 0 for WNOHANG, or -errno
+  if (rc <= 0)
+  {
+    return;
+  }
+  std::map<pid_t, Process>::iterator child = processes.find(rc);
+  if (child != processes.end())
+  {
+    child->second.waited += blocked;
+  }
+  if (Process *proc = findProcess(pid))
+  {
+    proc->waiting += blocked;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+ProcessTree::Process *ProcessTree::findProcess(pid_t tid)
+{
+  std::map<pid_t, pid_t>::const_iterator thread = threads.find(tid);
+  if (thread != threads.end())
+  {
+    std::map<pid_t, Process>::iterator it = processes.find(thread->second);
+    if (it != processes.end())
+    {
+      return &it->second;
+    }
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+ProcessTree::usec ProcessTree::wallTime(Process const &proc, usec end) const
+{
+  return (proc.exited < 0 ? end : proc.exited) - proc.forked;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ProcessTree::Report(std::ostream &os)
+{
+  usec const end = elapsed.usec();
+  os << "\nProcess tree (times in seconds; self = wall - time waiting for children)\n"
+     << "      wall      self    waited       pid  command\n";
+  printTree(os, root, 0, end);
+  printCriticalPath(os, end);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ProcessTree::printTree(std::ostream &os, pid_t pid, int depth, usec end) const
+{
+  std::map<pid_t, Process>::const_iterator it = processes.find(pid);
+  if (it == processes.end())
+  {
+    return;
+  }
+  Process const &proc = it->second;
+  usec const wall = wallTime(proc, end);
+  os << secs(wall) << secs(wall - proc.waiting) << secs(proc.waited)
+     << std::setw(10) << proc.pid << "  "
+     << std::string(depth * 2, ' ') << proc.command;
+  if (proc.exited < 0)
+  {
+    os << " (still running)";
+  }
+  else if (WIFSIGNALED(proc.status))
+  {
+    os << " (signal " << WTERMSIG(proc.status) << ")";
+  }
+  else if (WEXITSTATUS(proc.status) != 0)
+  {
+    os << " (exit " << WEXITSTATUS(proc.status) << ")";
+  }
+  os << '\n';
+  for (size_t idx = 0; idx != proc.children.size(); ++idx)
+  {
+    printTree(os, proc.children[idx], depth + 1, end);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// Walk backwards through the lifetime of 'proc' from time 'end'.
+// The child it reaped that exited most recently before 'end' is what
+// the process was waiting for, so the path continues into that child
+// and then resumes in the parent from the time the child was forked.
+// Anything not explained by a child is the process's own time.
+void ProcessTree::criticalPath(Process const &proc, usec end,
+                               std::vector<Segment> &path) const
+{
+  while (end > proc.forked)
+  {
+    Process const *next = 0;
+    for (size_t idx = 0; idx != proc.children.size(); ++idx)
+    {
+      std::map<pid_t, Process>::const_iterator it = processes.find(proc.children[idx]);
+      if (it == processes.end())
+        continue;
+      Process const &child = it->second;
+      if (child.waited && child.exited >= 0 && child.exited <= end &&
+          child.forked >= proc.forked &&
+          (!next || child.exited > next->exited))
+      {
+        next = &child;
+      }
+    }
+    usec const begin = next ? next->exited : proc.forked;
+    if (end > begin)
+    {
+      Segment const segment = { proc.pid, begin, end };
+      path.push_back(segment);
+    }
+    if (!next)
+    {
+      break;
+    }
+    criticalPath(*next, next->exited, path);
+    end = next->forked;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ProcessTree::printCriticalPath(std::ostream &os, usec end) const
+{
+  std::map<pid_t, Process>::const_iterator it = processes.find(root);
+  if (it == processes.end())
+  {
+    return;
+  }
+  Process const &proc = it->second;
+  usec const finish = proc.exited < 0 ? end : proc.exited;
+  usec const total = finish - proc.forked;
+  std::vector<Segment> path;
+  criticalPath(proc, finish, path);
+
+  os << "\nCritical path (start, time and share of total wall time)\n"
+     << "     start      time   share       pid  command\n";
+  for (std::vector<Segment>::const_reverse_iterator seg = path.rbegin(); seg != path.rend(); ++seg)
+  {
+    usec const time = seg->end - seg->begin;
+    std::ostringstream share;
+    share << std::fixed << std::setprecision(1)
+          << (total ? 100.0 * time / total : 0.0) << '%';
+    os << secs(seg->begin) << secs(time) << std::setw(8) << share.str()
+       << std::setw(10) << seg->pid << "  " << processes.find(seg->pid)->second.command << '\n';
+  }
+}
@@ -0,0 +1,100 @@
+#ifndef PROCESS_TREE_H
+#define PROCESS_TREE_H
+
+/**@file
+
+  Process-tree wall-time profiler for ProcessTracer
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "TraceListener.h"
+#include "TraceUtils.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+/** Build the tree of processes with fork, exec, exit and
+ * wait times and report where the wall-clock time went */
+class ProcessTree : public TraceListener
+{
+public:
+  ProcessTree();
+
+  void OnStart(pid_t pid) override;
+  void OnFork(pid_t parent, pid_t child, int event) override;
+  void OnExec(pid_t pid) override;
+  void OnExit(pid_t pid, int status) override;
+  bool SelectedCall(int func) override;
+  void OnCallEntry(pid_t pid, int func, long const args[]) override;
+  void OnCallExit(pid_t pid, int func, long const args[], long rc) override;
+  void Report(std::ostream &os) override;
+
+private:
+  /** Times are in microseconds since the tracer started */
+  typedef long long usec;
+
+  struct Process
+  {
+    pid_t pid;
+    pid_t parent;
+    usec forked;
+    usec exec;        // time of the most recent exec (or -1)
+    usec exited;      // time of exit (or -1 if still running)
+    usec waited;      // time the parent spent in wait4 for this process
+    usec waiting;     // time this process spent in wait4 for its children
+    int status;
+    std::string command;
+    std::vector<pid_t> children;
+  };
+
+  /** The process containing task 'tid' (or 0 if unknown) */
+  Process *findProcess(pid_t tid);
+
+  /** Wall time of the process, using 'end' if it has not exited */
+  usec wallTime(Process const &proc, usec end) const;
+
+  /** Print the tree rooted at 'pid' */
+  void printTree(std::ostream &os, pid_t pid, int depth, usec end) const;
+
+  /** Part of the critical path: 'pid' running from 'begin' to 'end' */
+  struct Segment
+  {
+    pid_t pid;
+    usec begin;
+    usec end;
+  };
+
+  /** Append the critical path through 'proc' up to 'end', latest first */
+  void criticalPath(Process const &proc, usec end, std::vector<Segment> &path) const;
+
+  /** Print the critical path from the root */
+  void printCriticalPath(std::ostream &os, usec end) const;
+
+  Stopwatch elapsed;                 // since the start of tracing
+  pid_t root;
+  std::map<pid_t, Process> processes;
+  std::map<pid_t, pid_t> threads;    // thread id => process id
+  std::map<pid_t, usec> waitEntry;   // thread id => entry to wait4
+};
+
+#endif // PROCESS_TREE_H
@@ -0,0 +1,294 @@
+/*
+NAME
+    SeccompTracer
+
+DESCRIPTION
+    seccomp user-notification backend for ProcessTracer.
+
+    The child created in CreateProcess installs a seccomp filter which
+    returns SECCOMP_RET_USER_NOTIF for the selected system calls and
+    passes the listener file descriptor back over a Unix socket before
+    calling exec. The tracer receives a notification for each selected
+    call, reads the arguments with process_vm_readv, and lets the call
+    proceed with SECCOMP_USER_NOTIF_FLAG_CONTINUE.
+
+    Unlike ptrace, unselected calls never leave the kernel and the
+    target need not be stopped and rescheduled by waitpid/PTRACE_SYSCALL;
+    nor does it use the (single) ptrace slot, so the target can still
+    be run under a debugger. The notification arrives before the call
+    executes, so the return value is not available.
+
+    The listener stays open until it reports POLLHUP, when no task is
+    left using the filter: a descendant outliving the target would
+    otherwise see each selected call fail with ENOSYS.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "SeccompTracer.h"
+#include "TraceLoop.h"
+#include "TraceUtils.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <wait.h>
+#include <asm/unistd.h>
+#include <linux/seccomp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+  using TraceLoop::make_error;
+
+  /** The calls ProcessTracer traces by default */
+  int const selected[] = { __NR_open, __NR_openat, __NR_close };
+
+  /** Install the filter in the calling process and return the listener */
+  int installFilter()
+  {
+    std::vector<int> const calls(selected, selected + sizeof(selected) / sizeof(selected[0]));
+    return TraceLoop::installFilter(calls, SECCOMP_RET_USER_NOTIF, SECCOMP_FILTER_FLAG_NEW_LISTENER);
+  }
+
+  /** Send file descriptor 'fd' over the Unix socket 'sock' */
+  void sendFd(int sock, int fd)
+  {
+    char data = 0;
+    struct iovec iov = { &data, 1 };
+    union
+    {
+      char buf[CMSG_SPACE(sizeof(int))];
+      struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    if (sendmsg(sock, &msg, 0) == -1)
+    {
+      throw make_error("sendmsg");
+    }
+  }
+
+  /** Receive a file descriptor over the Unix socket 'sock' */
+  int receiveFd(int sock)
+  {
+    char data = 0;
+    struct iovec iov = { &data, 1 };
+    union
+    {
+      char buf[CMSG_SPACE(sizeof(int))];
+      struct cmsghdr align;
+    } control;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    ssize_t const rc = recvmsg(sock, &msg, 0);
+    if (rc == -1)
+    {
+      throw make_error("recvmsg");
+    }
+    if (rc == 0)
+    {
+      // The child closes its end without sending if the filter is refused
+      throw std::runtime_error("child failed to install seccomp filter");
+    }
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS)
+    {
+      errno = EPROTO;
+      throw make_error("recvmsg(SCM_RIGHTS)");
+    }
+    int fd;
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    return fd;
+  }
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+SeccompTracer::SeccompTracer(std::ostream &os)
+: os(os), listener(-1), pid(0)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+SeccompTracer::~SeccompTracer()
+{
+  if (listener != -1)
+  {
+    close(listener);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void SeccompTracer::CreateProcess(int argc, char **argv)
+{
+  int sockets[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) == -1)
+  {
+    throw make_error("socketpair");
+  }
+  pid_t const cpid = fork();
+  if (cpid > 0)
+  {
+    // In the parent
+    pid = cpid;
+    close(sockets[1]);
+    listener = receiveFd(sockets[0]);
+    close(sockets[0]);
+  }
+  else if (cpid == 0)
+  {
+    // In the child: from here on the selected calls wait for the tracer,
+    // which is fine as it will be listening once the descriptor arrives
+    close(sockets[0]);
+    // The listener is close-on-exec, so there is no need to close it
+    // (which would itself be traced)
+    sendFd(sockets[1], installFilter());
+    execv(argv[0], argv);
+    throw make_error("execv");
+  }
+  else
+  {
+    throw make_error("fork");
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void SeccompTracer::run()
+{
+  // Descendants which outlive the child still have the filter, and
+  // every call it selects fails with ENOSYS once the listener is
+  // closed, so serve notifications until no task is left using it
+  bool reaped(false);
+  for (;;)
+  {
+    struct pollfd pfd = { listener, POLLIN, 0 };
+    int const rc = poll(&pfd, 1, reaped ? -1 : 100);
+    if (rc == -1 && errno != EINTR)
+    {
+      throw make_error("poll");
+    }
+    if (rc > 0 && (pfd.revents & POLLIN))
+    {
+      OnNotify();
+      continue;
+    }
+    if (rc > 0 && (pfd.revents & (POLLHUP | POLLERR)))
+    {
+      break;
+    }
+    if (!reaped)
+    {
+      reaped = reap(WNOHANG);
+    }
+  }
+  if (!reaped)
+  {
+    reap(0);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool SeccompTracer::reap(int options)
+{
+  int status(0);
+  pid_t const wpid = waitpid(pid, &status, options);
+  if (wpid == -1)
+  {
+    throw make_error("waitpid");
+  }
+  if (wpid != pid)
+  {
+    return false;
+  }
+  if (WIFEXITED(status))
+  {
+    os << "Exit(" << WEXITSTATUS(status) << ")" << std::endl;
+  }
+  else if (WIFSIGNALED(status))
+  {
+    os << "Terminated: " << sigstrm(WTERMSIG(status)) << std::endl;
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void SeccompTracer::OnNotify()
+{
+  struct seccomp_notif req;
+  memset(&req, 0, sizeof(req));
+  if (ioctl(listener, SECCOMP_IOCTL_NOTIF_RECV, &req) == -1)
+  {
+    if (errno == ENOENT || errno == EINTR)
+    {
+      return; // the target was interrupted before we received it
+    }
+    throw make_error("ioctl(SECCOMP_IOCTL_NOTIF_RECV)");
+  }
+
+  long args[6];
+  for (int idx = 0; idx != 6; ++idx)
+  {
+    args[idx] = req.data.args[idx];
+  }
+  std::string path;
+  if (req.data.nr == __NR_open)
+  {
+    path = readRemoteString(req.pid, args[0]);
+  }
+  else if (req.data.nr == __NR_openat)
+  {
+    path = readRemoteString(req.pid, args[1]);
+  }
+
+  // Only trust what we read if the call is still waiting: the
+  // task might have been killed and its pid reused meanwhile
+  if (ioctl(listener, SECCOMP_IOCTL_NOTIF_ID_VALID, &req.id) == 0)
+  {
+    writeCallEntry(os, req.data.nr, args, path);
+    os << '?' << std::endl;
+  }
+
+  struct seccomp_notif_resp resp;
+  memset(&resp, 0, sizeof(resp));
+  resp.id = req.id;
+  resp.flags = SECCOMP_USER_NOTIF_FLAG_CONTINUE;
+  if (ioctl(listener, SECCOMP_IOCTL_NOTIF_SEND, &resp) == -1 && errno != ENOENT)
+  {
+    throw make_error("ioctl(SECCOMP_IOCTL_NOTIF_SEND)");
+  }
+}
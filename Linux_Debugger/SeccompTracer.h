@@ -0,0 +1,66 @@
+#ifndef SECCOMP_TRACER_H
+#define SECCOMP_TRACER_H
+
+/**@file
+
+  seccomp user-notification backend for ProcessTracer
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include <sys/types.h>
+
+#include <iosfwd>
+
+/** Trace the selected system calls using a seccomp filter
+ * which returns SECCOMP_RET_USER_NOTIF to this process */
+class SeccompTracer
+{
+public:
+  explicit SeccompTracer(std::ostream &os);
+
+  ~SeccompTracer();
+
+  /** Start the target process with the filter installed */
+  void CreateProcess(int argc, char **argv);
+
+  /** Handle notifications until the target process, and every
+   * descendant sharing its filter, has exited */
+  void run();
+
+private:
+  /* don't copy or assign */
+  SeccompTracer(SeccompTracer const &) = delete;
+  SeccompTracer &operator=(SeccompTracer const &) = delete;
+
+  /** Receive, print and continue one notification */
+  void OnNotify();
+
+  /** Wait for the target process with waitpid 'options', reporting
+   * how it ended; returns false if it has not yet */
+  bool reap(int options);
+
+  std::ostream &os;
+  int listener;
+  pid_t pid;
+};
+
+#endif // SECCOMP_TRACER_H
@@ -0,0 +1,279 @@
+/*
+NAME
+    SelfStats
+
+DESCRIPTION
+    Counters and cycle timers for the tracer itself.
+
+    Times are taken with the time stamp counter, which is cheap
+    enough to read around every stop, and converted to nanoseconds
+    using the elapsed wall time between enable() and report().
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "SelfStats.h"
+#include "TraceUtils.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+  // The counters of every thread which has recorded anything.
+  // Blocks are pushed on the front and never removed, so the
+  // report can walk the list without any locking.
+  std::atomic<SelfStats::Counters *> allCounters(0);
+
+  uint64_t startCycles;
+  double startTime;
+
+  char const *const stageNames[] = {
+    "wait", "stop", "syscall", "readString", "listeners", "output", "resume"
+  };
+
+  char const *const stopNames[] = {
+    "start", "syscall", "event", "trap", "signal", "exit", "other"
+  };
+
+  /** Histogram bucket for 'value': four buckets per power of two */
+  size_t bucket(uint64_t value)
+  {
+    if (value < 4)
+    {
+      return value;
+    }
+    int const msb = 63 - __builtin_clzll(value);
+    return msb * 4 + ((value >> (msb - 2)) & 3);
+  }
+
+  /** Largest value held in bucket 'idx' */
+  uint64_t bucketLimit(size_t idx)
+  {
+    if (idx < 4)
+    {
+      return idx;
+    }
+    int const msb = idx / 4;
+    return ((uint64_t(4 + idx % 4 + 1)) << (msb - 2)) - 1;
+  }
+
+  char const *const requestNames[] = {
+    "SYSCALL", "GETREGS", "PEEKDATA", "SETOPTIONS", "GETEVENTMSG", "GETSIGINFO", "other"
+  };
+} // namespace
+
+bool SelfStats::enabled = false;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void SelfStats::enable()
+{
+  startTime = monotonicNsec() / 1e9;
+  startCycles = __rdtsc();
+  enabled = true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// The block is deliberately leaked: it must outlive its thread for the report
+SelfStats::Counters &SelfStats::counters()
+{
+  static thread_local Counters *local = 0;
+  if (!local)
+  {
+    local = new Counters();
+    local->current = OtherStop;
+    local->next = allCounters.load();
+    while (!allCounters.compare_exchange_weak(local->next, local))
+    {
+    }
+  }
+  return *local;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void SelfStats::onBatch(size_t depth)
+{
+  if (enabled)
+  {
+    Counters &c = counters();
+    ++c.batches;
+    c.batchStops += depth;
+    c.largestBatch = std::max<uint64_t>(c.largestBatch, depth);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void SelfStats::onResume(pid_t tid, long long ns)
+{
+  if (enabled)
+  {
+    Counters &c = counters();
+    uint64_t const value = ns > 0 ? ns : 0;
+    ++c.latency[bucket(value)];
+    TaskLatency &task = c.tasks[tid];
+    ++task.count;
+    task.total += value;
+    task.worst = std::max(task.worst, value);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void SelfStats::count(__ptrace_request request)
+{
+  Request idx(OtherRequest);
+  switch (request)
+  {
+  case PTRACE_SYSCALL: idx = Syscall; break;
+  case PTRACE_GETREGS: idx = GetRegs; break;
+  case PTRACE_PEEKDATA: idx = PeekData; break;
+  case PTRACE_SETOPTIONS: idx = SetOptions; break;
+  case PTRACE_GETEVENTMSG: idx = GetEventMsg; break;
+  case PTRACE_GETSIGINFO: idx = GetSigInfo; break;
+  default: break;
+  }
+  Counters &c = counters();
+  ++c.requests[c.current][idx];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void SelfStats::report(std::ostream &os)
+{
+  if (!enabled)
+  {
+    return;
+  }
+  double const elapsed = monotonicNsec() / 1e9 - startTime;
+  uint64_t const cycles = __rdtsc() - startCycles;
+  double const nsPerCycle = cycles ? elapsed * 1e9 / cycles : 0;
+
+  Counters total = Counters();
+  for (Counters const *c = allCounters.load(); c; c = c->next)
+  {
+    total.batches += c->batches;
+    total.batchStops += c->batchStops;
+    total.largestBatch = std::max(total.largestBatch, c->largestBatch);
+    for (size_t idx = 0; idx != LatencyBuckets; ++idx)
+    {
+      total.latency[idx] += c->latency[idx];
+    }
+    for (std::map<pid_t, TaskLatency>::const_iterator it = c->tasks.begin(); it != c->tasks.end(); ++it)
+    {
+      TaskLatency &task = total.tasks[it->first];
+      task.count += it->second.count;
+      task.total += it->second.total;
+      task.worst = std::max(task.worst, it->second.worst);
+    }
+    for (int stage = 0; stage != Stages; ++stage)
+    {
+      total.stageCount[stage] += c->stageCount[stage];
+      total.stageCycles[stage] += c->stageCycles[stage];
+    }
+    for (int kind = 0; kind != StopKinds; ++kind)
+    {
+      total.stops[kind] += c->stops[kind];
+      for (int request = 0; request != Requests; ++request)
+      {
+        total.requests[kind][request] += c->requests[kind][request];
+      }
+    }
+  }
+
+  std::ios_base::fmtflags const flags(os.flags());
+  os << std::fixed << std::setprecision(3)
+     << "\nTracer self statistics over " << elapsed << "s (stage times include nested stages)\n"
+     << std::setw(12) << "stage" << std::setw(12) << "count"
+     << std::setw(12) << "total ms" << std::setw(12) << "avg us" << std::setw(8) << "share" << '\n';
+  for (int stage = 0; stage != Stages; ++stage)
+  {
+    double const ms = total.stageCycles[stage] * nsPerCycle / 1e6;
+    uint64_t const count = total.stageCount[stage];
+    os << std::setw(12) << stageNames[stage] << std::setw(12) << count
+       << std::setw(12) << ms
+       << std::setw(12) << (count ? ms * 1e3 / count : 0)
+       << std::setw(7) << std::setprecision(1) << (elapsed ? ms / 10 / elapsed : 0) << "%"
+       << std::setprecision(3) << '\n';
+  }
+
+  os << "\nptrace requests by stop\n" << std::setw(12) << "stop" << std::setw(10) << "stops";
+  for (int request = 0; request != Requests; ++request)
+  {
+    os << std::setw(12) << requestNames[request];
+  }
+  os << '\n';
+  for (int kind = 0; kind != StopKinds; ++kind)
+  {
+    os << std::setw(12) << stopNames[kind] << std::setw(10) << total.stops[kind];
+    for (int request = 0; request != Requests; ++request)
+    {
+      os << std::setw(12) << total.requests[kind][request];
+    }
+    os << '\n';
+  }
+
+  if (total.batches)
+  {
+    os << "\nwaitpid batches " << total.batches
+       << ", stops per batch " << std::setprecision(2) << double(total.batchStops) / total.batches
+       << " (largest " << total.largestBatch << ")\n";
+
+    // Percentiles are the upper limit of the histogram bucket (within 25%)
+    uint64_t samples(0);
+    for (size_t idx = 0; idx != LatencyBuckets; ++idx)
+    {
+      samples += total.latency[idx];
+    }
+    static double const percentiles[] = { 50, 90, 99, 99.9, 100 };
+    static char const *const labels[] = { "p50", "p90", "p99", "p99.9", "max" };
+    os << "wait-to-resume us:";
+    size_t idx = 0;
+    uint64_t seen = total.latency[0];
+    for (size_t p = 0; p != sizeof(percentiles) / sizeof(percentiles[0]); ++p)
+    {
+      uint64_t const rank = std::max<uint64_t>(1, uint64_t(samples * percentiles[p] / 100 + 0.5));
+      while (seen < rank && idx + 1 != LatencyBuckets)
+      {
+        seen += total.latency[++idx];
+      }
+      os << "  " << labels[p] << " " << std::setprecision(1) << bucketLimit(idx) / 1e3;
+    }
+    os << '\n';
+
+    // The tasks which waited longest
+    std::vector<std::pair<uint64_t, pid_t> > worst;
+    for (std::map<pid_t, TaskLatency>::const_iterator it = total.tasks.begin(); it != total.tasks.end(); ++it)
+    {
+      worst.push_back(std::make_pair(it->second.worst, it->first));
+    }
+    std::sort(worst.rbegin(), worst.rend());
+    worst.resize(std::min<size_t>(worst.size(), 5));
+    os << std::setw(12) << "tid" << std::setw(10) << "stops"
+       << std::setw(12) << "mean us" << std::setw(12) << "worst us" << '\n';
+    for (size_t idx = 0; idx != worst.size(); ++idx)
+    {
+      TaskLatency const &task = total.tasks[worst[idx].second];
+      os << std::setw(12) << worst[idx].second << std::setw(10) << task.count
+         << std::setw(12) << std::setprecision(1) << task.total / 1e3 / task.count
+         << std::setw(12) << task.worst / 1e3 << '\n';
+    }
+  }
+  os.flags(flags);
+}
@@ -0,0 +1,209 @@
+#ifndef SELF_STATS_H
+#define SELF_STATS_H
+
+/**@file
+
+  Counters and cycle timers for the tracer itself
+
+  Each thread of the tracer keeps its own counters, so recording
+  needs no locking; the blocks are only combined for the report.
+  Nothing is recorded until enable() is called.
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include <stdint.h>
+#include <sys/ptrace.h>
+#include <sys/types.h>
+#include <x86intrin.h>
+
+#include <iosfwd>
+#include <map>
+
+namespace SelfStats
+{
+  /** Timed stages of the tracer; times are inclusive of nested stages */
+  enum Stage
+  {
+    Wait,         // waitpid
+    Stop,         // handling one stop
+    SysCall,      // handling a system call stop
+    ReadString,   // reading a string from the target
+    Listeners,    // running the TraceListeners
+    Output,       // formatting and writing the call trace
+    Resume,       // restarting the task with PTRACE_SYSCALL
+    Stages
+  };
+
+  /** The kind of stop being handled, to which ptrace requests are charged */
+  enum StopKind
+  {
+    Start,
+    SysCallStop,
+    EventStop,
+    TrapStop,
+    SignalStop,
+    ExitStop,
+    OtherStop,
+    StopKinds
+  };
+
+  /** The ptrace requests counted separately */
+  enum Request
+  {
+    Syscall,
+    GetRegs,
+    PeekData,
+    SetOptions,
+    GetEventMsg,
+    GetSigInfo,
+    OtherRequest,
+    Requests
+  };
+
+  /** Buckets in the wait-to-resume histogram: four per power of two */
+  enum { LatencyBuckets = 4 * 64 };
+
+  /** Wait-to-resume times for one traced task */
+  struct TaskLatency
+  {
+    uint64_t count;
+    uint64_t total;   // ns
+    uint64_t worst;   // ns
+  };
+
+  /** Counters for one thread of the tracer */
+  struct Counters
+  {
+    uint64_t stageCount[Stages];
+    uint64_t stageCycles[Stages];
+    uint64_t stops[StopKinds];
+    uint64_t requests[StopKinds][Requests];
+    uint64_t batches;
+    uint64_t batchStops;
+    uint64_t largestBatch;
+    uint64_t latency[LatencyBuckets];
+    std::map<pid_t, TaskLatency> tasks;
+    StopKind current;
+    Counters *next;
+  };
+
+  extern bool enabled;
+
+  /** Start recording */
+  void enable();
+
+  /** The counters for the calling thread */
+  Counters &counters();
+
+  /** Charge subsequent ptrace requests to a stop of this kind */
+  inline void onStop(StopKind kind)
+  {
+    if (enabled)
+    {
+      Counters &c = counters();
+      c.current = kind;
+      ++c.stops[kind];
+    }
+  }
+
+  /** Count a batch of 'depth' stops collected from waitpid */
+  void onBatch(size_t depth);
+
+  /** Task 'tid' resumed 'ns' nanoseconds after waitpid reported its stop */
+  void onResume(pid_t tid, long long ns);
+
+  /** Count a ptrace request */
+  void count(__ptrace_request request);
+
+  /** Call ptrace, counting the request */
+  template <typename Addr, typename Data>
+  long ptrace(__ptrace_request request, pid_t pid, Addr addr, Data data)
+  {
+    if (enabled)
+    {
+      count(request);
+    }
+    return ::ptrace(request, pid, addr, data);
+  }
+
+  /** Time the enclosing scope as 'stage' */
+  class Timer
+  {
+  public:
+    explicit Timer(Stage stage)
+    : stage(stage), begin(enabled ? __rdtsc() : 0) {}
+
+    ~Timer()
+    {
+      if (enabled)
+      {
+        Counters &c = counters();
+        ++c.stageCount[stage];
+        c.stageCycles[stage] += __rdtsc() - begin;
+      }
+    }
+
+    Timer(Timer const &) = delete;
+    Timer &operator=(Timer const &) = delete;
+
+  private:
+    Stage const stage;
+    uint64_t const begin;
+  };
+
+  /** Print the totals over all threads */
+  void report(std::ostream &os);
+
+  /** The statistics policy interface used by TraceLoop::EventLoop */
+  struct Policy
+  {
+    typedef SelfStats::Stage Stage;
+    typedef SelfStats::StopKind StopKind;
+    typedef SelfStats::Timer Timer;
+
+    static constexpr Stage Wait = SelfStats::Wait;
+    static constexpr Stage Stop = SelfStats::Stop;
+    static constexpr Stage SysCall = SelfStats::SysCall;
+    static constexpr Stage Resume = SelfStats::Resume;
+
+    static constexpr StopKind Start = SelfStats::Start;
+    static constexpr StopKind SysCallStop = SelfStats::SysCallStop;
+    static constexpr StopKind EventStop = SelfStats::EventStop;
+    static constexpr StopKind TrapStop = SelfStats::TrapStop;
+    static constexpr StopKind SignalStop = SelfStats::SignalStop;
+    static constexpr StopKind ExitStop = SelfStats::ExitStop;
+    static constexpr StopKind OtherStop = SelfStats::OtherStop;
+
+    static bool enabled() { return SelfStats::enabled; }
+    static void onStop(StopKind kind) { SelfStats::onStop(kind); }
+    static void onBatch(size_t depth) { SelfStats::onBatch(depth); }
+    static void onResume(pid_t tid, long long ns) { SelfStats::onResume(tid, ns); }
+
+    template <typename Addr, typename Data>
+    static long ptrace(__ptrace_request request, pid_t pid, Addr addr, Data data)
+    {
+      return SelfStats::ptrace(request, pid, addr, data);
+    }
+  };
+} // namespace SelfStats
+
+#endif // SELF_STATS_H
@@ -0,0 +1,815 @@
+/*
+NAME
+    StackSampler
+
+DESCRIPTION
+    In-process CPU time stack sampler, linked into the program profiled
+    (or preloaded into it with STACK_SAMPLER=file[:hz] set).
+
+    Each thread has a POSIX timer on its own CPU time clock which sends
+    it SIGPROF (SIGEV_THREAD_ID), so threads are sampled in proportion
+    to the CPU they use and idle threads cost nothing. The signal
+    handler unwinds the interrupted stack and writes it into a single
+    producer, single consumer ring for the thread; it takes no locks,
+    allocates nothing and only reads the stack between the interrupted
+    stack pointer and the end of its mapping.
+
+    The handler cannot parse call frame information, so it uses rules
+    compiled by the background thread from .eh_frame, each covering the
+    address range of one row of the table: the CFA as rsp or rbp plus an
+    offset, and where the return address and rbp were saved. The rules
+    are kept sorted and replaced as a whole when rules are added, so the
+    handler can binary search them without locks. At an address with no
+    rule yet the handler uses the frame pointer, and the background
+    thread adds rules for the addresses it sees, so the unwinding of a
+    hot stack is exact after its first few samples.
+
+    The background thread wakes every 100ms (10ms at first, and while
+    it is still adding rules): it arms timers for new
+    threads and deletes those of threads which have gone, drains the
+    rings, names the frames (with any inlined calls) and adds the
+    stacks to the totals. The mappings used to bound the handler's
+    reads are replaced when the handler finds a stack outside them, and
+    the old copies freed once no handler is running.
+
+    The folded output has one line per distinct stack:
+      thread;outermost;...;innermost samples
+    which can be fed straight to flamegraph.pl.
+
+    SIGPROF is taken over while sampling: a program using it itself, or
+    setitimer(ITIMER_PROF), should not use this library. The handler is
+    left installed after sampling stops, so a signal already queued
+    when its timer is deleted is ignored rather than fatal.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "StackSampler.h"
+#include "ElfDebugInfo.h"
+#include "ElfSymbols.h"
+#include "StackUnwinder.h"
+
+#include <dirent.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+namespace
+{
+  enum
+  {
+    MaxThreads = 256,        // threads sampled at once
+    RingSize = 32,           // samples buffered for each thread (a power of 2)
+    MaxDepth = 64            // frames in a sample
+  };
+
+  /** Milliseconds between passes of the background thread; shorter
+   * at first and while it is still adding rules, each of which lets the
+   * handler unwind one more frame of some stack */
+  int const Interval = 100;
+  int const LearningInterval = 10;
+
+  /** One stack, innermost first */
+  struct Sample
+  {
+    uint32_t depth;
+    uint64_t cfiFrames;
+    uint64_t fpFrames;
+    uint64_t nsec;         // time taken to unwind
+    uint64_t pcs[MaxDepth];
+  };
+
+  /** The samples of one thread, written by its signal handler and
+   * read by the background thread */
+  struct Slot
+  {
+    pid_t tid;
+    timer_t timer;
+    std::string name;
+    std::atomic<uint64_t> dropped;
+    alignas(64) std::atomic<uint64_t> head;  // next sample to write
+    alignas(64) std::atomic<uint64_t> tail;  // next sample to read
+    Sample samples[RingSize];
+  };
+
+  /** How to step from a frame at an address in [begin, end) to its caller */
+  struct Rule
+  {
+    enum Kind : uint8_t
+    {
+      FramePointer,   // no usable call frame information
+      Cfa,            // CFA is rsp or rbp plus cfaOffset
+      Outermost       // the return address is undefined
+    };
+
+    unsigned long begin;
+    unsigned long end;
+    int32_t cfaOffset;
+    int16_t raOffset;            // from the CFA
+    int16_t rbpOffset;
+    uint8_t kind;
+    uint8_t cfaRbp;              // the CFA is based on rbp, not rsp
+    uint8_t rbpSaved;            // rbp is saved at CFA + rbpOffset
+    uint8_t rbpLost;             // rbp cannot be recovered
+  };
+
+  /** The rules, sorted by address; the ranges do not overlap */
+  typedef std::vector<Rule> Rules;
+
+  /** The address ranges of the mappings, sorted, to bound stack reads */
+  typedef std::vector<std::pair<unsigned long, unsigned long> > Mappings;
+
+  std::atomic<Slot *> slots[MaxThreads];
+  std::atomic<Rules const *> rules;
+  std::atomic<Mappings const *> mappings;
+  std::atomic<int> readers;          // signal handlers running
+  std::atomic<bool> stale;           // a stack was outside the mappings
+
+  /** The rule in 'table' for 'pc' (or 0); safe in a signal handler */
+  Rule const *findRule(Rules const *table, unsigned long pc)
+  {
+    if (!table)
+      return 0;
+    Rules::const_iterator it = std::upper_bound(table->begin(), table->end(), pc,
+      [](unsigned long addr, Rule const &rule) { return addr < rule.begin; });
+    if (it != table->begin() && pc < (--it)->end)
+      return &*it;
+    return 0;
+  }
+
+  /** The end of the mapping holding stack pointer 'sp', or 0 if not known */
+  unsigned long stackEnd(unsigned long sp)
+  {
+    Mappings const *current = mappings.load(std::memory_order_acquire);
+    if (current)
+    {
+      Mappings::const_iterator it = std::upper_bound(current->begin(), current->end(),
+                                                     std::make_pair(sp, ~0UL));
+      if (it != current->begin() && sp < (--it)->second)
+        return it->second;
+    }
+    stale.store(true, std::memory_order_relaxed);
+    return 0;
+  }
+
+  /** Read the stack word at 'addr' if it is between 'low' and 'high' */
+  bool readStack(unsigned long addr, unsigned long low, unsigned long high, unsigned long &value)
+  {
+    if (addr < low || addr > high - sizeof(value) || (addr & (sizeof(value) - 1)))
+      return false;
+    value = *reinterpret_cast<unsigned long const *>(addr);
+    return true;
+  }
+
+  /** Unwind the interrupted stack of 'context' into 'sample' */
+  void unwind(ucontext_t const &context, Sample &sample)
+  {
+    unsigned long pc = context.uc_mcontext.gregs[REG_RIP];
+    unsigned long sp = context.uc_mcontext.gregs[REG_RSP];
+    unsigned long rbp = context.uc_mcontext.gregs[REG_RBP];
+    bool rbpValid(true);
+    unsigned long const low = sp;
+    unsigned long const high = stackEnd(sp);
+    Rules const *const table = rules.load(std::memory_order_acquire);
+    sample.depth = 0;
+    sample.cfiFrames = sample.fpFrames = 0;
+    while (sample.depth != MaxDepth)
+    {
+      sample.pcs[sample.depth++] = pc;
+      if (high == 0)
+        break;
+      // A return address may be just past the end of the calling function
+      Rule const *rule = findRule(table, sample.depth == 1 ? pc : pc - 1);
+      unsigned long cfa, ra;
+      if (rule && rule->kind == Rule::Outermost)
+        break;
+      if (rule && rule->kind == Rule::Cfa && (!rule->cfaRbp || rbpValid))
+      {
+        cfa = (rule->cfaRbp ? rbp : sp) + rule->cfaOffset;
+        if (!readStack(cfa + rule->raOffset, low, high, ra))
+          break;
+        if (rule->rbpSaved)
+          rbpValid = readStack(cfa + rule->rbpOffset, low, high, rbp);
+        else if (rule->rbpLost)
+          rbpValid = false;
+        ++sample.cfiFrames;
+      }
+      else
+      {
+        if (!rbpValid || rbp < sp || !readStack(rbp + 8, low, high, ra))
+          break;
+        cfa = rbp + 16;
+        readStack(rbp, low, high, rbp);
+        ++sample.fpFrames;
+      }
+      // The stack must move towards its base on each step
+      if (ra == 0 || cfa <= sp)
+        break;
+      pc = ra;
+      sp = cfa;
+    }
+  }
+
+  /** The SIGPROF handler: the slot index is the timer's value */
+  void onSample(int, siginfo_t *info, void *context)
+  {
+    if (info->si_code != SI_TIMER)
+    {
+      return;
+    }
+    readers.fetch_add(1);
+    unsigned const index = info->si_value.sival_int;
+    Slot *const slot = (index < MaxThreads) ? slots[index].load(std::memory_order_acquire) : 0;
+    if (slot)
+    {
+      uint64_t const head = slot->head.load(std::memory_order_relaxed);
+      if (head - slot->tail.load(std::memory_order_acquire) == RingSize)
+      {
+        slot->dropped.fetch_add(1, std::memory_order_relaxed);
+      }
+      else
+      {
+        // clock_gettime is async-signal-safe, and only a vDSO call
+        Sample &sample = slot->samples[head & (RingSize - 1)];
+        struct timespec begin, end;
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        unwind(*static_cast<ucontext_t const *>(context), sample);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        sample.nsec = (end.tv_sec - begin.tv_sec) * 1000000000ULL + end.tv_nsec - begin.tv_nsec;
+        slot->head.store(head + 1, std::memory_order_release);
+      }
+    }
+    readers.fetch_sub(1);
+  }
+
+  /** The clock of the CPU time of thread 'tid' of this process
+   * (MAKE_THREAD_CPUCLOCK(tid, CPUCLOCK_SCHED) in the kernel) */
+  clockid_t threadClock(pid_t tid)
+  {
+    return (clockid_t)((~(unsigned)tid << 3) | 6);
+  }
+
+  /** The background thread, and everything not used by the signal handler */
+  class Sampler
+  {
+  public:
+    Sampler(std::string const &fileName, int hz);
+
+    /** Start the background thread; false if no thread could be sampled */
+    bool start();
+
+    /** Stop sampling, free the slots and write the stacks */
+    void finish();
+
+    StackSampler::Stats stats();
+
+  private:
+    void run();
+
+    /** Arm timers for new threads and delete those of exited ones */
+    void scanThreads();
+
+    /** Start sampling thread 'tid'; false on failure */
+    bool addThread(pid_t tid);
+
+    /** Stop sampling the thread in slot 'index' */
+    void removeThread(size_t index);
+
+    /** Re-read the mappings, for the handler and for naming frames */
+    void refreshMappings();
+
+    /** Move the samples of 'slot' into the totals */
+    void drain(Slot &slot);
+
+    /** Add a rule for stepping from address 'pc', if there is none */
+    void learn(unsigned long pc);
+
+    /** Replace the handler's rules with them plus those just learnt */
+    void publishRules();
+
+    /** The name of the frame at 'pc', followed by any calls inlined there */
+    std::string const &frameName(unsigned long pc);
+
+    /** Free the slots, rules and mappings retired once no handler can be using them */
+    void reclaim(bool wait);
+
+    /** Write the folded stacks */
+    void write(std::ostream &os) const;
+
+    std::string const fileName;
+    long const period;                   // ns of CPU time between samples
+    pid_t self;                          // the background thread
+    std::thread thread;
+    std::mutex lock;
+    std::condition_variable wake;
+    bool started;
+    bool stopping;
+    bool armed;                          // the first pass has been done
+
+    ProcessModules modules;
+    bool refreshed;                      // modules re-read in this pass
+    bool learned;                        // rules added in this pass
+    int warmup;                          // passes left before any are slower
+    Rules pending;                       // rules not yet published
+    std::map<pid_t, size_t> tasks;       // thread id => slot index
+    std::vector<Slot *> retiredSlots;
+    std::vector<Rules const *> retiredRules;
+    std::vector<Mappings const *> retiredMappings;
+    std::map<unsigned long, std::string> names;
+    std::map<std::string, uint64_t> folded;
+    StackSampler::Stats counts;
+  };
+
+  std::mutex control;
+  Sampler *sampler(0);
+
+  /** A forked child has no background thread to stop */
+  void atForkChild()
+  {
+    sampler = 0;
+  }
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+Sampler::Sampler(std::string const &fileName, int hz)
+: fileName(fileName), period(1000000000L / std::max(hz, 1)), self(0), started(false), stopping(false),
+  armed(false), modules(getpid()), refreshed(false), learned(false),
+  warmup(Interval / LearningInterval), counts()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool Sampler::start()
+{
+  refreshMappings();
+  thread = std::thread(&Sampler::run, this);
+  std::unique_lock<std::mutex> guard(lock);
+  wake.wait(guard, [this]() { return armed; });
+  return !tasks.empty();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void Sampler::run()
+{
+  // This thread's own time is the cost of the profiler, not of the program
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGPROF);
+  pthread_sigmask(SIG_BLOCK, &mask, 0);
+  self = syscall(SYS_gettid);
+
+  std::unique_lock<std::mutex> guard(lock);
+  while (true)
+  {
+    refreshed = false;
+    scanThreads();
+    if (stale.exchange(false))
+    {
+      refreshMappings();
+    }
+    for (std::map<pid_t, size_t>::const_iterator it = tasks.begin(); it != tasks.end(); ++it)
+    {
+      drain(*slots[it->second].load());
+    }
+    publishRules();
+    reclaim(false);
+    if (!armed)
+    {
+      armed = true;
+      wake.notify_all();
+    }
+    if (stopping)
+      break;
+    if (warmup)
+      --warmup;
+    wake.wait_for(guard, std::chrono::milliseconds(learned || warmup ? LearningInterval : Interval));
+  }
+  while (!tasks.empty())
+  {
+    removeThread(tasks.begin()->second);
+  }
+  reclaim(true);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void Sampler::scanThreads()
+{
+  std::set<pid_t> current;
+  if (DIR *dir = opendir("/proc/self/task"))
+  {
+    while (dirent *entry = readdir(dir))
+    {
+      pid_t const tid = atoi(entry->d_name);
+      if (tid != 0 && tid != self)
+        current.insert(tid);
+    }
+    closedir(dir);
+  }
+  for (std::map<pid_t, size_t>::iterator it = tasks.begin(); it != tasks.end(); )
+  {
+    size_t const index = (it++)->second;
+    if (!current.count(slots[index].load()->tid))
+      removeThread(index);
+  }
+  for (std::set<pid_t>::const_iterator it = current.begin(); it != current.end(); ++it)
+  {
+    if (!tasks.count(*it))
+      addThread(*it);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool Sampler::addThread(pid_t tid)
+{
+  size_t index(0);
+  while (index != MaxThreads && slots[index].load())
+  {
+    ++index;
+  }
+  if (index == MaxThreads)
+  {
+    return false;
+  }
+  Slot *const slot = new Slot;
+  slot->tid = tid;
+  slot->dropped = 0;
+  slot->head = 0;
+  slot->tail = 0;
+  std::ostringstream name;
+  name << "/proc/self/task/" << tid << "/comm";
+  std::ifstream is(name.str().c_str());
+  if (!std::getline(is, slot->name) || slot->name.empty())
+  {
+    slot->name = std::to_string(tid);
+  }
+  std::replace(slot->name.begin(), slot->name.end(), ';', '_');
+  std::replace(slot->name.begin(), slot->name.end(), ' ', '_');
+
+  sigevent event = sigevent();
+  event.sigev_notify = SIGEV_THREAD_ID;
+  event.sigev_signo = SIGPROF;
+  event.sigev_value.sival_int = index;
+  event.sigev_notify_thread_id = tid;
+  if (timer_create(threadClock(tid), &event, &slot->timer) == -1)
+  {
+    delete slot;  // eg the thread has already exited
+    return false;
+  }
+  slots[index].store(slot, std::memory_order_release);
+  itimerspec spec;
+  spec.it_interval.tv_sec = spec.it_value.tv_sec = period / 1000000000L;
+  spec.it_interval.tv_nsec = spec.it_value.tv_nsec = period % 1000000000L;
+  timer_settime(slot->timer, 0, &spec, 0);
+  tasks[tid] = index;
+  ++counts.threads;
+  return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void Sampler::removeThread(size_t index)
+{
+  Slot *const slot = slots[index].load();
+  timer_delete(slot->timer);
+  drain(*slot);
+  tasks.erase(slot->tid);
+  slots[index].store(0);
+  retiredSlots.push_back(slot);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void Sampler::refreshMappings()
+{
+  modules.refresh();
+  refreshed = true;
+  Mappings *const current = new Mappings;
+  std::vector<ProcessModules::Module> const &list = modules.modules();
+  for (size_t idx = 0; idx != list.size(); ++idx)
+  {
+    current->push_back(std::make_pair(list[idx].start, list[idx].end));
+  }
+  if (Mappings const *previous = mappings.exchange(current))
+  {
+    retiredMappings.push_back(previous);
+  }
+  names.clear();   // a module may have been unloaded
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void Sampler::reclaim(bool wait)
+{
+  if (retiredSlots.empty() && retiredRules.empty() && retiredMappings.empty())
+  {
+    return;
+  }
+  // A handler which could see a retired object started before it was retired
+  while (readers.load() != 0)
+  {
+    if (!wait)
+      return;
+    std::this_thread::yield();
+  }
+  for (size_t idx = 0; idx != retiredSlots.size(); ++idx)
+  {
+    delete retiredSlots[idx];
+  }
+  for (size_t idx = 0; idx != retiredRules.size(); ++idx)
+  {
+    delete retiredRules[idx];
+  }
+  for (size_t idx = 0; idx != retiredMappings.size(); ++idx)
+  {
+    delete retiredMappings[idx];
+  }
+  retiredSlots.clear();
+  retiredRules.clear();
+  retiredMappings.clear();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void Sampler::drain(Slot &slot)
+{
+  uint64_t const head = slot.head.load(std::memory_order_acquire);
+  uint64_t tail = slot.tail.load(std::memory_order_relaxed);
+  std::vector<unsigned long> pcs;
+  for (; tail != head; ++tail)
+  {
+    Sample const &sample = slot.samples[tail & (RingSize - 1)];
+    pcs.assign(sample.pcs, sample.pcs + sample.depth);
+    counts.cfiFrames += sample.cfiFrames;
+    counts.fpFrames += sample.fpFrames;
+    counts.handlerNsec += sample.nsec;
+    slot.tail.store(tail + 1, std::memory_order_release);
+    ++counts.samples;
+    for (size_t idx = 0; idx != pcs.size(); ++idx)
+    {
+      learn(idx == 0 ? pcs[idx] : pcs[idx] - 1);
+    }
+    std::string name = slot.name;
+    for (size_t idx = pcs.size(); idx-- != 0; )
+    {
+      name += ';';
+      name += frameName(idx == 0 ? pcs[idx] : pcs[idx] - 1);
+    }
+    ++folded[name];
+  }
+  counts.dropped += slot.dropped.exchange(0);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void Sampler::learn(unsigned long pc)
+{
+  if (findRule(rules.load(), pc))
+  {
+    return;
+  }
+  for (size_t idx = 0; idx != pending.size(); ++idx)
+  {
+    if (pending[idx].begin <= pc && pc < pending[idx].end)
+      return;
+  }
+  ProcessModules::Module const *module = modules.find(pc);
+  if (!module && !refreshed)
+  {
+    refreshMappings();
+    module = modules.find(pc);
+  }
+  ElfUnwind::Frame frame;
+  long const vaddr = module ? modules.toVaddr(*module, pc) : -1;
+  Rule rule = Rule();
+  rule.kind = Rule::FramePointer;
+  rule.begin = pc;
+  rule.end = pc + 1;
+  if (vaddr != -1 && ElfUnwind::get(module->path)->find(vaddr, frame) && frame.cfaValid &&
+      (frame.cfaRegister == ElfUnwind::RSP || frame.cfaRegister == ElfUnwind::RBP))
+  {
+    ElfUnwind::Rule const &ra = frame.rules[ElfUnwind::RA];
+    ElfUnwind::Rule const &rbp = frame.rules[ElfUnwind::RBP];
+    rule.begin = pc - (vaddr - frame.rowBegin);
+    rule.end = pc + (frame.rowEnd - vaddr);
+    if (ra.kind == ElfUnwind::Rule::Undefined)
+    {
+      rule.kind = Rule::Outermost;
+    }
+    else if (ra.kind == ElfUnwind::Rule::Offset && ra.value == (int16_t)ra.value &&
+             frame.cfaOffset == (int32_t)frame.cfaOffset)
+    {
+      rule.kind = Rule::Cfa;
+      rule.cfaRbp = frame.cfaRegister == ElfUnwind::RBP;
+      rule.cfaOffset = frame.cfaOffset;
+      rule.raOffset = ra.value;
+      if (rbp.kind == ElfUnwind::Rule::Offset && rbp.value == (int16_t)rbp.value)
+      {
+        rule.rbpSaved = true;
+        rule.rbpOffset = rbp.value;
+      }
+      else if (rbp.kind != ElfUnwind::Rule::SameValue)
+      {
+        rule.rbpLost = true;
+      }
+    }
+  }
+  pending.push_back(rule);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void Sampler::publishRules()
+{
+  learned = !pending.empty();
+  if (!learned)
+  {
+    return;
+  }
+  Rules const *const previous = rules.load();
+  Rules *const current = previous ? new Rules(*previous) : new Rules;
+  current->insert(current->end(), pending.begin(), pending.end());
+  std::sort(current->begin(), current->end(),
+            [](Rule const &lhs, Rule const &rhs) { return lhs.begin < rhs.begin; });
+  pending.clear();
+  rules.store(current, std::memory_order_release);
+  if (previous)
+  {
+    retiredRules.push_back(previous);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// Inlined frames are marked with the _[i] suffix flamegraph.pl colours
+std::string const &Sampler::frameName(unsigned long pc)
+{
+  std::map<unsigned long, std::string>::iterator it = names.find(pc);
+  if (it != names.end())
+  {
+    return it->second;
+  }
+  std::string &name = names[pc];
+  name = modules.function(pc);
+  ProcessModules::Module const *module = modules.find(pc);
+  long const vaddr = module ? modules.toVaddr(*module, pc) : -1;
+  std::vector<ElfDebugInfo::InlineFrame> inlines;
+  if (vaddr != -1 && ElfDebugInfo::get(module->path)->inlinedAt(vaddr, inlines))
+  {
+    for (size_t idx = inlines.size(); idx-- != 0; )
+    {
+      name += ';';
+      name += inlines[idx].function;
+      name += "_[i]";
+    }
+  }
+  return name;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void Sampler::finish()
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+    wake.notify_all();
+  }
+  thread.join();
+  std::ofstream ofs(fileName.c_str());
+  write(ofs);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void Sampler::write(std::ostream &os) const
+{
+  for (std::map<std::string, uint64_t>::const_iterator it = folded.begin(); it != folded.end(); ++it)
+  {
+    os << it->first << ' ' << it->second << '\n';
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+StackSampler::Stats Sampler::stats()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  StackSampler::Stats result(counts);
+  clockid_t clock;
+  struct timespec ts;
+  if (pthread_getcpuclockid(thread.native_handle(), &clock) == 0 && clock_gettime(clock, &ts) == 0)
+  {
+    result.samplerNsec = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  }
+  return result;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool StackSampler::start(std::string const &fileName, int hz)
+{
+  std::lock_guard<std::mutex> guard(control);
+  if (sampler)
+  {
+    return false;
+  }
+  static bool installed(false);
+  if (!installed)
+  {
+    struct sigaction action = {};
+    action.sa_sigaction = onSample;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, 0) == -1)
+    {
+      return false;
+    }
+    pthread_atfork(0, 0, atForkChild);
+    installed = true;
+  }
+  sampler = new Sampler(fileName, hz);
+  if (!sampler->start())
+  {
+    sampler->finish();
+    delete sampler;
+    sampler = 0;
+    return false;
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void StackSampler::stop()
+{
+  std::lock_guard<std::mutex> guard(control);
+  if (sampler)
+  {
+    sampler->finish();
+    delete sampler;
+    sampler = 0;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+StackSampler::Stats StackSampler::stats()
+{
+  std::lock_guard<std::mutex> guard(control);
+  return sampler ? sampler->stats() : Stats();
+}
+
+namespace
+{
+  /** Start sampling if the environment asks for it */
+  __attribute__((constructor))
+  void initialise()
+  {
+    char const *const env = getenv(StackSampler::EnvVar);
+    if (!env || !*env)
+      return;
+    std::string fileName(env);
+    int hz(100);
+    std::string::size_type const colon = fileName.rfind(':');
+    if (colon != std::string::npos)
+    {
+      hz = atoi(fileName.c_str() + colon + 1);
+      fileName.erase(colon);
+    }
+    std::string::size_type const pid = fileName.find("%p");
+    if (pid != std::string::npos)
+    {
+      fileName.replace(pid, 2, std::to_string(getpid()));
+    }
+    // The caches used by stop() must be destroyed after it runs, so
+    // must be constructed before it is registered
+    ElfSymbols::get(std::string());
+    ElfUnwind::get(std::string());
+    ElfDebugInfo::get(std::string());
+    if (StackSampler::start(fileName, hz > 0 ? hz : 100))
+    {
+      atexit(StackSampler::stop);
+    }
+  }
+} // namespace
@@ -0,0 +1,68 @@
+#ifndef STACK_SAMPLER_H
+#define STACK_SAMPLER_H
+
+/**@file
+
+  In-process CPU time stack sampler, linked into the program profiled
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include <stdint.h>
+
+#include <string>
+
+/** Samples the stacks of every thread of the calling process, driven by
+ * a timer on the CPU time of each thread, and writes them as folded
+ * stacks for flame graph tools. No tracer is involved: the stacks are
+ * unwound in a signal handler in the thread itself and named by a
+ * background thread. */
+namespace StackSampler
+{
+  /** Environment variable which starts sampling when the library is
+   * loaded, as file[:hz]; "%p" in the file name is replaced by the pid */
+  char const EnvVar[] = "STACK_SAMPLER";
+
+  /** Counts of the work done so far */
+  struct Stats
+  {
+    uint64_t samples;     // stacks recorded
+    uint64_t dropped;     // lost because a thread's buffer was full
+    uint64_t cfiFrames;   // frames unwound with call frame information
+    uint64_t fpFrames;    // frames unwound with the frame pointer
+    uint64_t threads;     // threads sampled
+    uint64_t handlerNsec; // time spent unwinding in the signal handler
+    uint64_t samplerNsec; // CPU time of the background thread
+  };
+
+  /** Start sampling each thread 'hz' times per second of the CPU time it
+   * uses, writing the folded stacks to 'fileName' when sampling stops.
+   * Returns false if already started or the timers cannot be created */
+  bool start(std::string const &fileName, int hz = 100);
+
+  /** Stop sampling and write the folded stacks; does nothing if not started */
+  void stop();
+
+  /** The counts so far */
+  Stats stats();
+} // namespace StackSampler
+
+#endif // STACK_SAMPLER_H
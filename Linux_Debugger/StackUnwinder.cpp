@@ -0,0 +1,618 @@
+/*
+NAME
+    StackUnwinder
+
+DESCRIPTION
+    Unwind the user stack of a stopped task using .eh_frame.
+
+    The call frame information describes, for each address in a
+    function, how to find the canonical frame address (CFA: the value
+    of the stack pointer before the call) and where the caller's
+    registers were saved relative to it. Only the rules compilers
+    emit for x86_64 functions are interpreted; a CFA given as a DWARF
+    expression (as in PLT stubs) ends the walk at that frame.
+
+    Stack memory is read a page at a time with process_vm_readv and
+    cached for the duration of one unwind, or for as long as the caller
+    keeps the RemoteMemory, eg to read the variables of each frame.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "StackUnwinder.h"
+#include "ElfSymbols.h"
+#include "TraceUtils.h"
+
+#include <elf.h>
+#include <string.h>
+#include <sys/user.h>
+
+#include <algorithm>
+#include <fstream>
+
+namespace
+{
+  /** Pointer encodings and call frame instructions from the DWARF
+   * and LSB specifications (as in libdwarf's dwarf.h) */
+  enum
+  {
+    DW_EH_PE_absptr = 0x00, DW_EH_PE_uleb128 = 0x01, DW_EH_PE_udata2 = 0x02,
+    DW_EH_PE_udata4 = 0x03, DW_EH_PE_udata8 = 0x04, DW_EH_PE_sleb128 = 0x09,
+    DW_EH_PE_sdata2 = 0x0a, DW_EH_PE_sdata4 = 0x0b, DW_EH_PE_sdata8 = 0x0c,
+    DW_EH_PE_pcrel = 0x10
+  };
+
+  enum
+  {
+    DW_CFA_advance_loc = 0x40, DW_CFA_offset = 0x80, DW_CFA_restore = 0xc0,
+    DW_CFA_nop = 0x00, DW_CFA_set_loc = 0x01, DW_CFA_advance_loc1 = 0x02,
+    DW_CFA_advance_loc2 = 0x03, DW_CFA_advance_loc4 = 0x04,
+    DW_CFA_offset_extended = 0x05, DW_CFA_restore_extended = 0x06,
+    DW_CFA_undefined = 0x07, DW_CFA_same_value = 0x08, DW_CFA_register = 0x09,
+    DW_CFA_remember_state = 0x0a, DW_CFA_restore_state = 0x0b,
+    DW_CFA_def_cfa = 0x0c, DW_CFA_def_cfa_register = 0x0d,
+    DW_CFA_def_cfa_offset = 0x0e, DW_CFA_def_cfa_expression = 0x0f,
+    DW_CFA_expression = 0x10, DW_CFA_offset_extended_sf = 0x11,
+    DW_CFA_def_cfa_sf = 0x12, DW_CFA_def_cfa_offset_sf = 0x13,
+    DW_CFA_val_offset = 0x14, DW_CFA_val_offset_sf = 0x15,
+    DW_CFA_val_expression = 0x16, DW_CFA_GNU_args_size = 0x2e,
+    DW_CFA_GNU_negative_offset_extended = 0x2f
+  };
+
+  /** Largest frame we believe in when following frame pointers */
+  unsigned long const MaxFrame = 8 * 1024 * 1024;
+
+  unsigned long readULeb(std::vector<unsigned char> const &data, size_t &offset)
+  {
+    unsigned long result(0);
+    int shift(0);
+    while (offset < data.size())
+    {
+      unsigned char const byte = data[offset++];
+      result |= (unsigned long)(byte & 0x7f) << shift;
+      shift += 7;
+      if (!(byte & 0x80))
+        break;
+    }
+    return result;
+  }
+
+  long readSLeb(std::vector<unsigned char> const &data, size_t &offset)
+  {
+    long result(0);
+    int shift(0);
+    unsigned char byte(0);
+    while (offset < data.size())
+    {
+      byte = data[offset++];
+      result |= (long)(byte & 0x7f) << shift;
+      shift += 7;
+      if (!(byte & 0x80))
+        break;
+    }
+    if (shift < 64 && (byte & 0x40))
+    {
+      result |= -(1L << shift);
+    }
+    return result;
+  }
+
+  template <typename T>
+  T readFixed(std::vector<unsigned char> const &data, size_t &offset)
+  {
+    T value(0);
+    if (offset + sizeof(T) <= data.size())
+    {
+      memcpy(&value, &data[offset], sizeof(T));
+    }
+    offset += sizeof(T);
+    return value;
+  }
+
+  /** Read the .eh_frame section of 'path' and its link-time address */
+  bool readEhFrame(std::string const &path, std::vector<unsigned char> &section, unsigned long &addr)
+  {
+    std::ifstream ifs(path.c_str(), std::ios::binary);
+    Elf64_Ehdr ehdr;
+    if (!ifs.read((char *)&ehdr, sizeof(ehdr)) ||
+        memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0 || ehdr.e_ident[EI_CLASS] != ELFCLASS64 ||
+        ehdr.e_shentsize != sizeof(Elf64_Shdr) || ehdr.e_shstrndx >= ehdr.e_shnum)
+    {
+      return false;
+    }
+    std::vector<Elf64_Shdr> shdr(ehdr.e_shnum);
+    ifs.seekg(ehdr.e_shoff);
+    if (!ifs.read((char *)&shdr[0], shdr.size() * sizeof(Elf64_Shdr)))
+    {
+      return false;
+    }
+    Elf64_Shdr const &strtab = shdr[ehdr.e_shstrndx];
+    std::vector<char> names(strtab.sh_size + 1);
+    ifs.seekg(strtab.sh_offset);
+    ifs.read(&names[0], strtab.sh_size);
+    for (size_t idx = 0; idx != shdr.size(); ++idx)
+    {
+      if (shdr[idx].sh_name < strtab.sh_size && shdr[idx].sh_type == SHT_PROGBITS &&
+          strcmp(&names[shdr[idx].sh_name], ".eh_frame") == 0)
+      {
+        section.resize(shdr[idx].sh_size);
+        addr = shdr[idx].sh_addr;
+        ifs.seekg(shdr[idx].sh_offset);
+        return section.empty() || ifs.read((char *)&section[0], section.size()).good();
+      }
+    }
+    return false;
+  }
+
+  /** Stack memory of one task, read a page at a time */
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool RemoteMemory::read(unsigned long addr, void *buffer, size_t len)
+{
+  unsigned char *out = static_cast<unsigned char *>(buffer);
+  while (len != 0)
+  {
+    unsigned long const page = addr & ~0xfffUL;
+    std::map<unsigned long, std::vector<unsigned char> >::iterator it = pages.find(page);
+    if (it == pages.end())
+    {
+      std::vector<unsigned char> &bytes = pages[page];
+      bytes.resize(0x1000);
+      bytes.resize(readRemote(tid, page, &bytes[0], bytes.size()));
+      it = pages.find(page);
+    }
+    size_t const count = std::min<size_t>(len, page + 0x1000 - addr);
+    if (addr - page + count > it->second.size())
+    {
+      return false;
+    }
+    memcpy(out, &it->second[addr - page], count);
+    out += count;
+    addr += count;
+    len -= count;
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+ElfUnwind::ElfUnwind(std::string const &path)
+: sectionAddr(0)
+{
+  if (readEhFrame(path, data, sectionAddr))
+  {
+    parse();
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+std::shared_ptr<ElfUnwind const> ElfUnwind::get(std::string const &path)
+{
+  static std::map<std::string, std::shared_ptr<ElfUnwind const> > cache;
+  std::shared_ptr<ElfUnwind const> &entry = cache[path];
+  if (!entry)
+  {
+    entry.reset(new ElfUnwind(path));
+  }
+  return entry;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void ElfUnwind::parse()
+{
+  size_t offset(0);
+  while (offset + 4 <= data.size())
+  {
+    size_t const start = offset;
+    unsigned long length = readFixed<uint32_t>(data, offset);
+    if (length == 0)
+    {
+      break;   // terminator
+    }
+    if (length == 0xffffffff)
+    {
+      length = readFixed<uint64_t>(data, offset);
+    }
+    size_t const end = offset + length;
+    if (end > data.size())
+    {
+      break;
+    }
+    size_t const idOffset = offset;
+    uint32_t const id = readFixed<uint32_t>(data, offset);
+    if (id == 0)
+    {
+      Cie cie = { 1, 1, RA, DW_EH_PE_absptr, false, 0, end };
+      unsigned char const version = data[offset++];
+      std::string const augmentation((char const *)&data[offset]);
+      offset += augmentation.size() + 1;
+      cie.codeAlign = readULeb(data, offset);
+      cie.dataAlign = readSLeb(data, offset);
+      cie.raRegister = (version == 1) ? data[offset++] : readULeb(data, offset);
+      size_t augEnd(offset);
+      for (size_t idx = 0; idx != augmentation.size(); ++idx)
+      {
+        switch (augmentation[idx])
+        {
+        case 'z':
+          cie.augmented = true;
+          augEnd = readULeb(data, offset);
+          augEnd += offset;
+          break;
+        case 'R':
+          cie.fdeEncoding = data[offset++];
+          break;
+        case 'L':
+          ++offset;
+          break;
+        case 'P':
+          readEncoded(offset, data[offset++]);
+          break;
+        }
+      }
+      cie.instructions = cie.augmented ? augEnd : offset;
+      cies[start] = cie;
+    }
+    else
+    {
+      std::map<size_t, Cie>::const_iterator const it = cies.find(idOffset - id);
+      if (it != cies.end())
+      {
+        Cie const &cie = it->second;
+        Fde fde;
+        fde.begin = readEncoded(offset, cie.fdeEncoding);
+        fde.end = fde.begin + readEncoded(offset, cie.fdeEncoding & 0x0f);
+        if (cie.augmented)
+        {
+          size_t const augLength = readULeb(data, offset);
+          offset += augLength;
+        }
+        fde.cie = it->first;
+        fde.instructions = offset;
+        fde.finish = end;
+        fdes.push_back(fde);
+      }
+    }
+    offset = end;
+  }
+  std::sort(fdes.begin(), fdes.end(),
+    [](Fde const &lhs, Fde const &rhs) { return lhs.begin < rhs.begin; });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+unsigned long ElfUnwind::readEncoded(size_t &offset, unsigned char encoding) const
+{
+  unsigned long const fieldAddr = sectionAddr + offset;
+  unsigned long value(0);
+  switch (encoding & 0x0f)
+  {
+  case DW_EH_PE_absptr: value = readFixed<uint64_t>(data, offset); break;
+  case DW_EH_PE_uleb128: value = readULeb(data, offset); break;
+  case DW_EH_PE_udata2: value = readFixed<uint16_t>(data, offset); break;
+  case DW_EH_PE_udata4: value = readFixed<uint32_t>(data, offset); break;
+  case DW_EH_PE_udata8: value = readFixed<uint64_t>(data, offset); break;
+  case DW_EH_PE_sleb128: value = readSLeb(data, offset); break;
+  case DW_EH_PE_sdata2: value = readFixed<int16_t>(data, offset); break;
+  case DW_EH_PE_sdata4: value = readFixed<int32_t>(data, offset); break;
+  case DW_EH_PE_sdata8: value = readFixed<int64_t>(data, offset); break;
+  }
+  if ((encoding & 0x70) == DW_EH_PE_pcrel)
+  {
+    value += fieldAddr;
+  }
+  return value;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool ElfUnwind::find(unsigned long pc, Frame &frame) const
+{
+  std::vector<Fde>::const_iterator it = std::upper_bound(fdes.begin(), fdes.end(), pc,
+    [](unsigned long value, Fde const &fde) { return value < fde.begin; });
+  if (it == fdes.begin())
+  {
+    return false;
+  }
+  --it;
+  if (pc >= it->end)
+  {
+    return false;
+  }
+  Cie const &cie = cies.find(it->cie)->second;
+
+  frame.cfaValid = true;
+  frame.cfaRegister = RSP;
+  frame.cfaOffset = 8;
+  for (int idx = 0; idx != Registers; ++idx)
+  {
+    frame.rules[idx].kind = Rule::SameValue;
+    frame.rules[idx].value = 0;
+  }
+  if (!execute(cie, cie.instructions, cie.end, it->begin, it->begin, frame, frame))
+  {
+    return false;
+  }
+  Frame const initial(frame);
+  frame.rowBegin = it->begin;
+  frame.rowEnd = it->end;
+  return execute(cie, it->instructions, it->finish, it->begin, pc, frame, initial);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool ElfUnwind::execute(Cie const &cie, size_t begin, size_t end, unsigned long loc,
+                        unsigned long pc, Frame &frame, Frame const &initial) const
+{
+  std::vector<Frame> stack;   // for remember/restore state
+  size_t offset = begin;
+  unsigned long row = loc;     // start of the row containing 'pc'
+  while (offset < end && loc <= pc)
+  {
+    row = loc;
+    unsigned char const op = data[offset++];
+    unsigned int reg(0);
+    long value(0);
+    switch (op & 0xc0)
+    {
+    case DW_CFA_advance_loc:
+      loc += (op & 0x3f) * cie.codeAlign;
+      continue;
+    case DW_CFA_offset:
+      reg = op & 0x3f;
+      value = readULeb(data, offset) * cie.dataAlign;
+      if (reg < Registers)
+      {
+        frame.rules[reg].kind = Rule::Offset;
+        frame.rules[reg].value = value;
+      }
+      continue;
+    case DW_CFA_restore:
+      reg = op & 0x3f;
+      if (reg < Registers)
+        frame.rules[reg] = initial.rules[reg];
+      continue;
+    }
+
+    switch (op)
+    {
+    case DW_CFA_nop:
+      break;
+    case DW_CFA_set_loc:
+      loc = readEncoded(offset, cie.fdeEncoding);
+      break;
+    case DW_CFA_advance_loc1:
+      loc += readFixed<uint8_t>(data, offset) * cie.codeAlign;
+      break;
+    case DW_CFA_advance_loc2:
+      loc += readFixed<uint16_t>(data, offset) * cie.codeAlign;
+      break;
+    case DW_CFA_advance_loc4:
+      loc += readFixed<uint32_t>(data, offset) * cie.codeAlign;
+      break;
+    case DW_CFA_offset_extended:
+    case DW_CFA_offset_extended_sf:
+    case DW_CFA_val_offset:
+    case DW_CFA_val_offset_sf:
+    case DW_CFA_GNU_negative_offset_extended:
+      reg = readULeb(data, offset);
+      if (op == DW_CFA_offset_extended || op == DW_CFA_val_offset)
+        value = readULeb(data, offset) * cie.dataAlign;
+      else if (op == DW_CFA_GNU_negative_offset_extended)
+        value = -(long)readULeb(data, offset) * cie.dataAlign;
+      else
+        value = readSLeb(data, offset) * cie.dataAlign;
+      if (reg < Registers)
+      {
+        bool const val = (op == DW_CFA_val_offset || op == DW_CFA_val_offset_sf);
+        frame.rules[reg].kind = val ? Rule::ValOffset : Rule::Offset;
+        frame.rules[reg].value = value;
+      }
+      break;
+    case DW_CFA_restore_extended:
+      reg = readULeb(data, offset);
+      if (reg < Registers)
+        frame.rules[reg] = initial.rules[reg];
+      break;
+    case DW_CFA_undefined:
+    case DW_CFA_same_value:
+      reg = readULeb(data, offset);
+      if (reg < Registers)
+        frame.rules[reg].kind = (op == DW_CFA_undefined) ? Rule::Undefined : Rule::SameValue;
+      break;
+    case DW_CFA_register:
+      reg = readULeb(data, offset);
+      value = readULeb(data, offset);
+      if (reg < Registers)
+      {
+        frame.rules[reg].kind = Rule::Register;
+        frame.rules[reg].value = value;
+      }
+      break;
+    case DW_CFA_remember_state:
+      stack.push_back(frame);
+      break;
+    case DW_CFA_restore_state:
+      if (!stack.empty())
+      {
+        // Compilers rely on the CFA being restored too, as libgcc does
+        frame = stack.back();
+        stack.pop_back();
+      }
+      break;
+    case DW_CFA_def_cfa:
+      frame.cfaRegister = readULeb(data, offset);
+      frame.cfaOffset = readULeb(data, offset);
+      frame.cfaValid = true;
+      break;
+    case DW_CFA_def_cfa_sf:
+      frame.cfaRegister = readULeb(data, offset);
+      frame.cfaOffset = readSLeb(data, offset) * cie.dataAlign;
+      frame.cfaValid = true;
+      break;
+    case DW_CFA_def_cfa_register:
+      frame.cfaRegister = readULeb(data, offset);
+      break;
+    case DW_CFA_def_cfa_offset:
+      frame.cfaOffset = readULeb(data, offset);
+      break;
+    case DW_CFA_def_cfa_offset_sf:
+      frame.cfaOffset = readSLeb(data, offset) * cie.dataAlign;
+      break;
+    case DW_CFA_def_cfa_expression:
+      offset += readULeb(data, offset);
+      frame.cfaValid = false;
+      break;
+    case DW_CFA_expression:
+    case DW_CFA_val_expression:
+      reg = readULeb(data, offset);
+      offset += readULeb(data, offset);
+      if (reg < Registers)
+        frame.rules[reg].kind = Rule::Unsupported;
+      break;
+    case DW_CFA_GNU_args_size:
+      readULeb(data, offset);
+      break;
+    default:
+      // Unknown instruction: we cannot know its operands
+      return false;
+    }
+  }
+  frame.rowBegin = std::max(frame.rowBegin, loc <= pc ? loc : row);
+  if (loc > pc)
+    frame.rowEnd = std::min(frame.rowEnd, loc);
+  return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void unwindStack(pid_t tid, ProcessModules &modules, user_regs_struct const &regs,
+                 std::vector<unsigned long> &pcs, size_t maxDepth)
+{
+  RemoteMemory memory(tid);
+  std::vector<StackFrame> frames;
+  unwindStack(tid, modules, regs, memory, frames, maxDepth);
+  pcs.clear();
+  for (size_t idx = 0; idx != frames.size(); ++idx)
+  {
+    pcs.push_back(frames[idx].pc);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void unwindStack(pid_t tid, ProcessModules &modules, user_regs_struct const &regs,
+                 RemoteMemory &memory, std::vector<StackFrame> &frames, size_t maxDepth)
+{
+  unsigned long value[ElfUnwind::Registers] = {
+    regs.rax, regs.rdx, regs.rcx, regs.rbx, regs.rsi, regs.rdi, regs.rbp, regs.rsp,
+    regs.r8, regs.r9, regs.r10, regs.r11, regs.r12, regs.r13, regs.r14, regs.r15, regs.rip };
+  bool valid[ElfUnwind::Registers];
+  std::fill(valid, valid + ElfUnwind::Registers, true);
+  int const saved[] = { ElfUnwind::RBX, ElfUnwind::RBP, ElfUnwind::RSP, ElfUnwind::R12,
+                        ElfUnwind::R13, ElfUnwind::R14, ElfUnwind::R15, ElfUnwind::RA };
+
+  bool refreshed(false);
+  frames.clear();
+  while (frames.size() < maxDepth)
+  {
+    frames.push_back(StackFrame());
+    StackFrame &current = frames.back();
+    current.pc = value[ElfUnwind::RA];
+    current.cfa = 0;
+    std::copy(value, value + ElfUnwind::Registers, current.regs);
+    std::copy(valid, valid + ElfUnwind::Registers, current.valid);
+
+    unsigned long const pc = current.pc;
+    // A return address may be just past the end of the calling function
+    unsigned long const lookup = (frames.size() == 1) ? pc : pc - 1;
+    ProcessModules::Module const *module = modules.find(lookup);
+    if (!module && !refreshed)
+    {
+      modules.refresh();
+      refreshed = true;
+      module = modules.find(lookup);
+    }
+
+    ElfUnwind::Frame frame;
+    long const vaddr = module ? modules.toVaddr(*module, lookup) : -1;
+    unsigned long next[ElfUnwind::Registers];
+    std::copy(value, value + ElfUnwind::Registers, next);
+    if (vaddr != -1 && ElfUnwind::get(module->path)->find(vaddr, frame) && frame.cfaValid &&
+        frame.cfaRegister < ElfUnwind::Registers && valid[frame.cfaRegister])
+    {
+      unsigned long const cfa = value[frame.cfaRegister] + frame.cfaOffset;
+      current.cfa = cfa;
+      bool ok(true);
+      for (size_t idx = 0; ok && idx != sizeof(saved) / sizeof(saved[0]); ++idx)
+      {
+        int const reg = saved[idx];
+        ElfUnwind::Rule const &rule = frame.rules[reg];
+        switch (rule.kind)
+        {
+        case ElfUnwind::Rule::SameValue:
+          break;
+        case ElfUnwind::Rule::Undefined:
+          if (reg == ElfUnwind::RA)
+            return;     // the outermost frame
+          valid[reg] = false;
+          break;
+        case ElfUnwind::Rule::Offset:
+          ok = memory.read(cfa + rule.value, next[reg]);
+          valid[reg] = ok;
+          break;
+        case ElfUnwind::Rule::ValOffset:
+          next[reg] = cfa + rule.value;
+          break;
+        case ElfUnwind::Rule::Register:
+          if (rule.value < ElfUnwind::Registers && valid[rule.value])
+            next[reg] = value[rule.value];
+          else
+            valid[reg] = false;
+          break;
+        case ElfUnwind::Rule::Unsupported:
+          valid[reg] = false;
+          break;
+        }
+      }
+      if (!ok || !valid[ElfUnwind::RA])
+        return;
+      next[ElfUnwind::RSP] = cfa;
+    }
+    else
+    {
+      // No call frame information: try the frame pointer
+      unsigned long const rbp = value[ElfUnwind::RBP];
+      if (!valid[ElfUnwind::RBP] || rbp < value[ElfUnwind::RSP] ||
+          rbp - value[ElfUnwind::RSP] > MaxFrame ||
+          !memory.read(rbp + 8, next[ElfUnwind::RA]) ||
+          !memory.read(rbp, next[ElfUnwind::RBP]))
+        return;
+      next[ElfUnwind::RSP] = rbp + 16;
+      current.cfa = rbp + 16;
+    }
+    valid[ElfUnwind::RSP] = true;
+
+    // The stack must move towards its base on each step
+    if (next[ElfUnwind::RA] == 0 || next[ElfUnwind::RSP] <= value[ElfUnwind::RSP])
+      return;
+    std::copy(next, next + ElfUnwind::Registers, value);
+
+    // Only the callee-saved registers are preserved across the call
+    bool preserved[ElfUnwind::Registers] = { false };
+    for (size_t idx = 0; idx != sizeof(saved) / sizeof(saved[0]); ++idx)
+    {
+      preserved[saved[idx]] = valid[saved[idx]];
+    }
+    std::copy(preserved, preserved + ElfUnwind::Registers, valid);
+  }
+}
@@ -0,0 +1,157 @@
+#ifndef STACK_UNWINDER_H
+#define STACK_UNWINDER_H
+
+/**@file
+
+  Unwind the user stack of a stopped task using .eh_frame
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include <sys/types.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ProcessModules;
+struct user_regs_struct;
+
+/** The call frame information (.eh_frame) of one ELF file */
+class ElfUnwind
+{
+public:
+  /** DWARF register numbers used on x86_64 */
+  enum
+  {
+    RAX = 0, RDX = 1, RCX = 2, RBX = 3, RSI = 4, RDI = 5, RBP = 6, RSP = 7,
+    R8 = 8, R9 = 9, R10 = 10, R11 = 11, R12 = 12, R13 = 13, R14 = 14, R15 = 15,
+    RA = 16,   // the return address column
+    Registers = 17
+  };
+
+  /** How to recover a register in the caller's frame */
+  struct Rule
+  {
+    enum Kind { SameValue, Undefined, Offset, ValOffset, Register, Unsupported } kind;
+    long value;
+  };
+
+  /** The unwind rules in force at one address */
+  struct Frame
+  {
+    bool cfaValid;     // false if the CFA is a DWARF expression
+    int cfaRegister;
+    long cfaOffset;
+    Rule rules[Registers];
+    unsigned long rowBegin;    // link-time addresses over which the
+    unsigned long rowEnd;      // rules stay the same
+  };
+
+  /** Load the .eh_frame section of 'path'; an unreadable file has none */
+  explicit ElfUnwind(std::string const &path);
+
+  /** Find the rules at link-time address 'pc'; false if there are none */
+  bool find(unsigned long pc, Frame &frame) const;
+
+  /** The cached call frame information for 'path' */
+  static std::shared_ptr<ElfUnwind const> get(std::string const &path);
+
+private:
+  /** Common information entry */
+  struct Cie
+  {
+    unsigned long codeAlign;
+    long dataAlign;
+    unsigned int raRegister;
+    unsigned char fdeEncoding;
+    bool augmented;            // 'z': FDEs have augmentation data
+    size_t instructions;       // initial instructions: offset of start and end
+    size_t end;
+  };
+
+  /** Frame description entry: the range of one function */
+  struct Fde
+  {
+    unsigned long begin;
+    unsigned long end;
+    size_t cie;                // offset of its CIE
+    size_t instructions;
+    size_t finish;
+  };
+
+  /** Parse the entries of the section */
+  void parse();
+
+  /** Read a pointer with encoding 'encoding' at 'offset', advancing it */
+  unsigned long readEncoded(size_t &offset, unsigned char encoding) const;
+
+  /** Run the instructions from 'begin' to 'end' until passing 'pc' */
+  bool execute(Cie const &cie, size_t begin, size_t end, unsigned long loc,
+               unsigned long pc, Frame &frame, Frame const &initial) const;
+
+  std::vector<unsigned char> data;
+  unsigned long sectionAddr;       // link-time address of .eh_frame
+  std::map<size_t, Cie> cies;
+  std::vector<Fde> fdes;           // sorted by address
+};
+
+/** The memory of a stopped task, read a page at a time with
+ * process_vm_readv and cached while the task stays stopped */
+class RemoteMemory
+{
+public:
+  explicit RemoteMemory(pid_t tid) : tid(tid) {}
+
+  /** Read 'len' bytes at 'addr'; false if any are unreadable */
+  bool read(unsigned long addr, void *buffer, size_t len);
+
+  template <typename T>
+  bool read(unsigned long addr, T &value) { return read(addr, &value, sizeof(value)); }
+
+private:
+  pid_t const tid;
+  std::map<unsigned long, std::vector<unsigned char> > pages;
+};
+
+/** The registers of one frame of an unwound stack. The caller-saved
+ * registers are only known in the innermost frame */
+struct StackFrame
+{
+  unsigned long pc;
+  unsigned long cfa;                                // 0 if not known
+  unsigned long regs[ElfUnwind::Registers];         // by DWARF number
+  bool valid[ElfUnwind::Registers];
+};
+
+/** Unwind the stack of stopped task 'tid' from its registers, using the
+ * call frame information of its modules and falling back to the frame
+ * pointer where there is none. 'pcs' receives the instruction pointer
+ * followed by the return addresses, innermost first */
+void unwindStack(pid_t tid, ProcessModules &modules, user_regs_struct const &regs,
+                 std::vector<unsigned long> &pcs, size_t maxDepth = 64);
+
+/** Unwind the stack as above, keeping the registers of each frame */
+void unwindStack(pid_t tid, ProcessModules &modules, user_regs_struct const &regs,
+                 RemoteMemory &memory, std::vector<StackFrame> &frames, size_t maxDepth = 64);
+
+#endif // STACK_UNWINDER_H
@@ -0,0 +1,217 @@
+/*
+NAME
+    TestStackSampler
+
+DESCRIPTION
+    Test the in-process stack sampler, as TestStackWalker does for the
+    Windows stack walker, and measure what it costs.
+
+    TestStackSampler [-t threads] [-n rounds] [-f hz] [-r repeats] [-o file]
+
+    Runs a fixed amount of CPU bound work in each thread, through a few
+    levels of calls some of which are inlined: 'repeats' times without
+    sampling, 'repeats' times sampling at 'hz' (default 100) into 'file'
+    (default /tmp/TestStackSampler.folded) and 'repeats' times more
+    without. The overhead compares the fastest sampled run with the
+    fastest unsampled one, as a run can only be slowed by anything else
+    on the machine. As that difference is within the noise of most
+    machines, the sampler's own cost is also shown: the time its signal
+    handler spent unwinding and the CPU time of its background thread,
+    as a share of the sampled runs. Neither includes delivering the
+    signals. Prints the CPU times, the overhead and the sampler's counts.
+
+    Fails if nothing was sampled, or if no folded stack has the calls
+    outer, middle and inner in that order.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "StackSampler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  double cpuTime()
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+  }
+
+  inline unsigned long mix(unsigned long value)
+  {
+    value ^= value >> 31;
+    value *= 0x7fb5d329728ea185UL;
+    return value ^ (value >> 27);
+  }
+
+  __attribute__((noinline)) unsigned long inner(unsigned long seed, int count)
+  {
+    for (int idx = 0; idx != count; ++idx)
+    {
+      seed = mix(seed + idx);
+    }
+    return seed;
+  }
+
+  __attribute__((noinline)) unsigned long middle(unsigned long seed, int depth)
+  {
+    if (depth == 0)
+      return inner(seed, 4000);
+    return middle(seed, depth - 1) + inner(seed, 1000);
+  }
+
+  __attribute__((noinline)) unsigned long outer(unsigned long seed, long rounds)
+  {
+    unsigned long result(0);
+    for (long idx = 0; idx != rounds; ++idx)
+    {
+      result += middle(seed + idx, idx % 4);
+    }
+    return result;
+  }
+
+  /** Run 'rounds' of work in each of 'threads' threads, returning the CPU time used */
+  double run(int threads, long rounds)
+  {
+    double const start = cpuTime();
+    std::vector<std::thread> pool;
+    std::vector<unsigned long> results(threads);
+    for (int idx = 0; idx != threads; ++idx)
+    {
+      pool.push_back(std::thread([&results, idx, rounds]() { results[idx] = outer(idx, rounds); }));
+    }
+    for (int idx = 0; idx != threads; ++idx)
+    {
+      pool[idx].join();
+    }
+    return cpuTime() - start;
+  }
+
+  /** The fastest of 'repeats' runs */
+  double fastest(int repeats, int threads, long rounds)
+  {
+    double best(0);
+    for (int idx = 0; idx != repeats; ++idx)
+    {
+      double const time = run(threads, rounds);
+      if (idx == 0 || time < best)
+        best = time;
+    }
+    return best;
+  }
+
+  /** Does folded stack 'line' contain 'names' in order, each as a whole frame? */
+  bool hasFrames(std::string const &line, std::vector<std::string> const &names)
+  {
+    std::string::size_type pos(0);
+    for (size_t idx = 0; idx != names.size(); ++idx)
+    {
+      pos = line.find("::" + names[idx] + "(", pos);
+      if (pos == std::string::npos)
+        return false;
+      pos += names[idx].size();
+    }
+    return true;
+  }
+
+  /** The number of samples in 'fileName' whose stacks have outer, middle and inner */
+  unsigned long nestedSamples(std::string const &fileName)
+  {
+    std::vector<std::string> const names = { "outer", "middle", "inner" };
+    std::ifstream ifs(fileName.c_str());
+    std::string line;
+    unsigned long result(0);
+    while (std::getline(ifs, line))
+    {
+      std::string::size_type const space = line.rfind(' ');
+      if (space != std::string::npos && hasFrames(line.substr(0, space), names))
+        result += strtoul(line.c_str() + space + 1, 0, 10);
+    }
+    return result;
+  }
+} // namespace
+
+int main(int argc, char **argv)
+{
+  int threads(4);
+  long rounds(10000);
+  int hz(100);
+  int repeats(5);
+  std::string fileName("/tmp/TestStackSampler.folded");
+  int opt;
+  while ((opt = getopt(argc, argv, "t:n:f:r:o:")) != -1)
+  {
+    switch (opt)
+    {
+    case 't': threads = atoi(optarg); break;
+    case 'n': rounds = atol(optarg); break;
+    case 'f': hz = atoi(optarg); break;
+    case 'r': repeats = std::max(1, atoi(optarg)); break;
+    case 'o': fileName = optarg; break;
+    default:
+      fprintf(stderr, "Syntax: TestStackSampler [-t threads] [-n rounds] [-f hz] [-r repeats] [-o file]\n");
+      return 1;
+    }
+  }
+
+  double const before = fastest(repeats, threads, rounds);
+  if (!StackSampler::start(fileName, hz))
+  {
+    fprintf(stderr, "Unable to start sampling\n");
+    return 1;
+  }
+  double const sampled = fastest(repeats, threads, rounds);
+  StackSampler::Stats const stats = StackSampler::stats();
+  StackSampler::stop();
+  double const plain = std::min(before, fastest(repeats, threads, rounds));
+
+  printf("fastest of %d: unsampled %.3fs cpu, sampled at %d Hz %.3fs cpu, overhead %.2f%%\n",
+         repeats, plain, hz, sampled, (sampled - plain) * 100 / plain);
+  printf("samples %lu dropped %lu threads %lu frames: cfi %lu frame pointer %lu\n",
+         (unsigned long)stats.samples, (unsigned long)stats.dropped, (unsigned long)stats.threads,
+         (unsigned long)stats.cfiFrames, (unsigned long)stats.fpFrames);
+
+  printf("sampler cost %.2f%% of sampled cpu: unwinding %.3fms (%.1fus a sample), background thread %.3fms\n",
+         (stats.handlerNsec + stats.samplerNsec) / 1e7 / (repeats * sampled),
+         stats.handlerNsec / 1e6, stats.samples ? stats.handlerNsec / 1e3 / stats.samples : 0.0,
+         stats.samplerNsec / 1e6);
+
+  unsigned long const nested = nestedSamples(fileName);
+  printf("samples in outer;middle;inner %lu, written to %s\n", nested, fileName.c_str());
+  if (stats.samples == 0)
+  {
+    fprintf(stderr, "FAILED: no samples taken\n");
+    return 1;
+  }
+  if (nested == 0)
+  {
+    fprintf(stderr, "FAILED: no stack with outer, middle and inner in %s\n", fileName.c_str());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,308 @@
+/*
+NAME
+    ThreadStorm
+
+DESCRIPTION
+    Scalable thread and process storm workload, growing MultiThread
+    into something which exercises the clone and __WALL handling of
+    the tracers at realistic scale.
+
+    ThreadStorm [options]
+      -t threads   threads per round (default 4)
+      -n calls     system calls per thread (default 100)
+      -k kinds     comma separated list of call kinds, used in rotation:
+                   getpid, open (fopen/fclose of /dev/null as MultiThread
+                   does), stat, write, lock (stat while holding a mutex
+                   shared by all the threads) (default open)
+      -r rounds    thread churn: create and join the threads this many
+                   times (default 1)
+      -d depth     fork/exec fan-out: each process below this depth
+                   starts 'width' copies of itself (default 0)
+      -w width     fan-out width for -d (default 2)
+      -s signals   signal storm: send this many SIGUSR1 to the running
+                   threads while they work (default 0)
+
+    Each process prints its own totals and timings on stderr, so
+    traced and untraced runs can be compared directly. The first also
+    prints "events <count> seconds <elapsed>" to stdout, as BenchWorkload
+    does, where count is the calls made by its own threads.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <wait.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <atomic>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+  enum Kind { GetPid, Open, Stat, Write, Lock };
+
+  struct Options
+  {
+    int threads;
+    long calls;
+    std::vector<Kind> kinds;
+    int rounds;
+    int depth;
+    int width;
+    long signals;
+  };
+
+  Options options;
+  std::atomic<long> signalsReceived(0);
+  std::atomic<long> callsMade(0);
+  pthread_mutex_t stormLock = PTHREAD_MUTEX_INITIALIZER;
+
+  double now()
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+  }
+
+  void onSignal(int)
+  {
+    signalsReceived.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  bool parseKinds(char const *text)
+  {
+    options.kinds.clear();
+    std::istringstream iss(text);
+    std::string kind;
+    while (std::getline(iss, kind, ','))
+    {
+      if (kind == "getpid")
+        options.kinds.push_back(GetPid);
+      else if (kind == "open")
+        options.kinds.push_back(Open);
+      else if (kind == "stat")
+        options.kinds.push_back(Stat);
+      else if (kind == "write")
+        options.kinds.push_back(Write);
+      else if (kind == "lock")
+        options.kinds.push_back(Lock);
+      else
+        return false;
+    }
+    return !options.kinds.empty();
+  }
+
+  void *threadStart(void *)
+  {
+    int const null = open("/dev/null", O_WRONLY);
+    struct stat st;
+    char const ch = 0;
+    size_t const nkinds = options.kinds.size();
+    for (long idx = 0; idx != options.calls; ++idx)
+    {
+      switch (options.kinds[idx % nkinds])
+      {
+      case GetPid:
+        syscall(SYS_getpid);
+        break;
+      case Open:
+        if (FILE *fp = fopen("/dev/null", "r"))
+        {
+          fclose(fp);
+        }
+        break;
+      case Stat:
+        stat("/dev/null", &st);
+        break;
+      case Write:
+        if (write(null, &ch, 1) == -1)
+        {
+          perror("write");
+        }
+        break;
+      case Lock:
+        pthread_mutex_lock(&stormLock);
+        stat("/dev/null", &st);
+        pthread_mutex_unlock(&stormLock);
+        break;
+      }
+    }
+    close(null);
+    callsMade.fetch_add(options.calls, std::memory_order_relaxed);
+    return 0;
+  }
+
+  /** Start the threads, send any signals, and join them again */
+  void runRound(std::vector<pthread_t> &threads)
+  {
+    int created = 0;
+    for (int idx = 0; idx != options.threads; ++idx)
+    {
+      if (pthread_create(&threads[idx], 0, threadStart, 0) != 0)
+      {
+        perror("pthread_create");
+        break;
+      }
+      ++created;
+    }
+    long const perRound = options.signals / options.rounds;
+    for (long idx = 0; created && idx != perRound; ++idx)
+    {
+      // Threads may already have finished: ignore failures
+      pthread_kill(threads[idx % created], SIGUSR1);
+    }
+    for (int idx = 0; idx != created; ++idx)
+    {
+      pthread_join(threads[idx], 0);
+    }
+  }
+
+  /** Start 'width' copies of this program one level deeper */
+  std::vector<pid_t> fanOut(int argc, char **argv, int level)
+  {
+    std::vector<pid_t> children;
+    if (level >= options.depth)
+    {
+      return children;
+    }
+    std::ostringstream oss;
+    oss << level + 1;
+    std::string const next = oss.str();
+    std::vector<char *> args;
+    args.push_back(argv[0]);
+    args.push_back(const_cast<char *>("--level"));
+    args.push_back(const_cast<char *>(next.c_str()));
+    args.insert(args.end(), argv + 1, argv + argc);
+    args.push_back(0);
+    for (int idx = 0; idx != options.width; ++idx)
+    {
+      pid_t const pid = fork();
+      if (pid == 0)
+      {
+        execv("/proc/self/exe", &args[0]);
+        _exit(127);
+      }
+      if (pid > 0)
+      {
+        children.push_back(pid);
+      }
+    }
+    return children;
+  }
+} // namespace
+
+int main(int argc, char **argv)
+{
+  options.threads = 4;
+  options.calls = 100;
+  options.kinds.push_back(Open);
+  options.rounds = 1;
+  options.depth = 0;
+  options.width = 2;
+  options.signals = 0;
+  int level = 0;
+
+  // Children started by fanOut have their level prepended to the options
+  if (argc > 2 && strcmp(argv[1], "--level") == 0)
+  {
+    level = atoi(argv[2]);
+    argv[2] = argv[0];
+    argv += 2;
+    argc -= 2;
+  }
+
+  int opt;
+  while ((opt = getopt(argc, argv, "t:n:k:r:d:w:s:")) != -1)
+  {
+    switch (opt)
+    {
+    case 't': options.threads = atoi(optarg); break;
+    case 'n': options.calls = atol(optarg); break;
+    case 'k':
+      if (!parseKinds(optarg))
+      {
+        std::cerr << "Unknown kind in: " << optarg << std::endl;
+        return 1;
+      }
+      break;
+    case 'r': options.rounds = atoi(optarg); break;
+    case 'd': options.depth = atoi(optarg); break;
+    case 'w': options.width = atoi(optarg); break;
+    case 's': options.signals = atol(optarg); break;
+    default:
+      std::cerr << "Syntax: ThreadStorm [-t threads] [-n calls] [-k getpid,open,stat,write,lock]\n"
+                   "                   [-r rounds] [-d depth] [-w width] [-s signals]" << std::endl;
+      return 1;
+    }
+  }
+  if (options.threads < 1) options.threads = 1;
+  if (options.rounds < 1) options.rounds = 1;
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = onSignal;
+  sa.sa_flags = SA_RESTART;
+  sigaction(SIGUSR1, &sa, 0);
+
+  double const start = now();
+  std::vector<pid_t> const children = fanOut(argc, argv, level);
+  double const forked = now();
+
+  std::vector<pthread_t> threads(options.threads);
+  for (int round = 0; round != options.rounds; ++round)
+  {
+    runRound(threads);
+  }
+  double const threaded = now();
+
+  int failed = 0;
+  for (size_t idx = 0; idx != children.size(); ++idx)
+  {
+    int status;
+    if (waitpid(children[idx], &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status))
+      ++failed;
+  }
+  double const end = now();
+
+  std::ostringstream oss;
+  oss << "ThreadStorm pid " << getpid() << " level " << level
+      << ": threads " << long(options.threads) * options.rounds
+      << " calls " << callsMade.load()
+      << " signals " << signalsReceived.load() << "/" << options.signals
+      << " children " << children.size() << (failed ? " (some failed)" : "")
+      << " | fork " << forked - start
+      << "s threads " << threaded - forked
+      << "s wait " << end - threaded
+      << "s total " << end - start << "s\n";
+  std::cerr << oss.str();
+  if (level == 0)
+  {
+    printf("events %ld seconds %.6f\n", callsMade.load(), end - start);
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,96 @@
+#ifndef TRACE_LISTENER_H
+#define TRACE_LISTENER_H
+
+/**@file
+
+  Interface for the optional analyses which ProcessTracer
+  can drive from the events it receives.
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include <sys/types.h>
+
+#include <iosfwd>
+
+struct user_regs_struct;
+
+/** Receives the events seen by the tracer.
+ * All the methods have empty default implementations
+ * so a listener only overrides the ones it needs; the
+ * tracer only calls those it overrides. */
+class TraceListener
+{
+public:
+  virtual ~TraceListener() {}
+
+  /** The initial process 'pid' has started */
+  virtual void OnStart(pid_t pid) {}
+
+  /** Task 'parent' created task 'child' with the ptrace 'event' */
+  virtual void OnFork(pid_t parent, pid_t child, int event) {}
+
+  /** Task 'pid' has completed an exec */
+  virtual void OnExec(pid_t pid) {}
+
+  /** Task 'pid' has terminated with wait 'status' */
+  virtual void OnExit(pid_t pid, int status) {}
+
+  /** Task 'pid' stopped with SIGTRAP other than for a system call
+   * or ptrace event, eg for a breakpoint or watchpoint */
+  virtual void OnTrap(pid_t pid) {}
+
+  /** Task 'pid' stopped with 'signal', including the initial
+   * SIGSTOP of each new task */
+  virtual void OnSignal(pid_t pid, int signal) {}
+
+  /** Check if specified system call is of interest */
+  virtual bool SelectedCall(int func) { return false; }
+
+  /** Registers of task 'pid' on entry to system call 'func';
+   * called for every listener before any OnCallEntry */
+  virtual void OnCallRegisters(pid_t pid, int func, user_regs_struct const &regs) {}
+
+  /** System call 'func' being entered by task 'pid' */
+  virtual void OnCallEntry(pid_t pid, int func, long const args[]) {}
+
+  /** The result 'rc' of system call 'func' in task 'pid', or a
+   * replacement for it, eg for an injected failure; called for every
+   * listener before any OnCallExit, which then sees the replacement */
+  virtual long OnCallResult(pid_t pid, int func, long rc) { return rc; }
+
+  /** System call 'func' being exited by task 'pid' */
+  virtual void OnCallExit(pid_t pid, int func, long const args[], long rc) {}
+
+  /** Nanoseconds to keep task 'pid' stopped before resuming it from
+   * the current stop, eg to slow down the system call being entered */
+  virtual long long OnResume(pid_t pid) { return 0; }
+
+  /** Should task 'pid' be resumed for one instruction only, eg to
+   * execute the instruction under a breakpoint? OnTrap is called
+   * when the step completes */
+  virtual bool SingleStep(pid_t pid) { return false; }
+
+  /** Tracing has finished: write any summary */
+  virtual void Report(std::ostream &os) {}
+};
+
+#endif // TRACE_LISTENER_H
@@ -0,0 +1,802 @@
+#ifndef TRACE_LOOP_H
+#define TRACE_LOOP_H
+
+/**@file
+
+  Header-only ptrace event loop, parameterised on a handler
+
+  The handler is any class providing some of these hooks:
+
+    void OnStart(pid_t pid);                           first stop of the initial task
+    void OnSysCallEntry(pid_t pid, SysCall const &call);
+    void OnSysCallExit(pid_t pid, SysCall const &call);
+    void OnFork(pid_t parent, pid_t child, int event); fork, vfork or clone
+    void OnExec(pid_t pid);
+    void OnTrap(pid_t pid);                            SIGTRAP, eg a breakpoint
+    int OnSignal(pid_t pid, int signal);               returns the signal to deliver
+    void OnExit(pid_t pid, int status);                exited or terminated
+    long long OnResume(pid_t pid);                     nanoseconds to hold the task
+                                                       stopped before resuming it
+    bool SingleStep(pid_t pid);                        resume the task for one
+                                                       instruction only; the stop
+                                                       which ends the step is
+                                                       waited for and handled at once
+
+  Hooks which are not provided compile out, as do the ptrace options
+  and stops they would need: without either system call hook tasks
+  are resumed with PTRACE_CONT rather than PTRACE_SYSCALL, and without
+  OnFork new processes and threads are not traced. There is no
+  virtual dispatch. A handler may also name a statistics policy
+  as 'typedef ... Stats' (see NoStats for the interface.)
+
+  ProcessTracer itself is one such handler, but it fans each hook
+  out through the virtual functions of TraceListener, as its analyses
+  are chosen on the command line and a composition fixed at compile
+  time would need every combination of them instantiated. The cost is
+  kept to one indirect call per listener that overrides the hook, as
+  the overrides are found at compile time when a listener is added,
+  and the system call hooks are indexed by call number so that only
+  the listeners selecting a call see it; this is small beside the two
+  context switches of each ptrace stop. A single-purpose tool wanting
+  none of it can be a handler for EventLoop directly.
+
+  Which calls stop is also a run time choice (setSysCallStops): a
+  handler which wants none is resumed with PTRACE_CONT, and one which
+  wants a few has them selected by a seccomp filter installed by
+  CreateProcess, so only those calls stop the task.
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <wait.h>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <sys/prctl.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/user.h>
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace TraceLoop
+{
+  inline std::runtime_error make_error(std::string const &action)
+  {
+    std::string const what(action + " failed: " + strerror(errno));
+    return std::runtime_error(what);
+  }
+
+  /** Install a seccomp filter in the calling process which returns
+   * 'action' for the system 'calls' and allows the rest, passing
+   * 'flags' to seccomp; returns the result of seccomp */
+  inline int installFilter(std::vector<int> const &calls, unsigned int action, unsigned int flags)
+  {
+#if __x86_64__
+    unsigned int const auditArch = AUDIT_ARCH_X86_64;
+#elif __i386__
+    unsigned int const auditArch = AUDIT_ARCH_I386;
+#else
+#error Unknown target architecture
+#endif // __x86_64__
+    std::vector<struct sock_filter> filter;
+    struct sock_filter const checkArch[] = {
+      BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, arch)),
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, auditArch, 1, 0),
+      BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+      BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr)),
+    };
+    filter.assign(checkArch, checkArch + sizeof(checkArch) / sizeof(checkArch[0]));
+
+    // A jump offset is eight bits, so each test skips to an action
+    // placed after the block of at most 255 tests it belongs to
+    size_t const Block = 255;
+    for (size_t begin = 0; begin < calls.size(); begin += Block)
+    {
+      size_t const count = std::min(Block, calls.size() - begin);
+      for (size_t idx = 0; idx != count; ++idx)
+      {
+        // If this call matches jump to the 'action' return after the block
+        struct sock_filter const test =
+          BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (unsigned)calls[begin + idx], (unsigned char)(count - idx), 0);
+        filter.push_back(test);
+      }
+      struct sock_filter const skip = BPF_JUMP(BPF_JMP | BPF_JA, 1, 0, 0);
+      struct sock_filter const ret = BPF_STMT(BPF_RET | BPF_K, action);
+      filter.push_back(skip);
+      filter.push_back(ret);
+    }
+    struct sock_filter const allow = BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW);
+    filter.push_back(allow);
+
+    struct sock_fprog prog = { (unsigned short)filter.size(), &filter[0] };
+    if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == -1)
+    {
+      throw make_error("prctl(PR_SET_NO_NEW_PRIVS)");
+    }
+    int const rc = syscall(__NR_seccomp, SECCOMP_SET_MODE_FILTER, flags, &prog);
+    if (rc == -1)
+    {
+      throw make_error("seccomp(SECCOMP_SET_MODE_FILTER)");
+    }
+    return rc;
+  }
+
+  /** Which system calls stop the traced tasks */
+  enum SysCallStops
+  {
+    AllCalls,        // every call, resuming with PTRACE_SYSCALL
+    NoCalls,         // none, resuming with PTRACE_CONT
+    FilteredCalls    // those selected by a filter from CreateProcess
+  };
+
+  /** The stops needed to see the system 'calls'. A filter cannot
+   * select exec, which the child makes before the tracer has set the
+   * options that let the filter stop it; and is no gain for every call */
+  inline SysCallStops stopsFor(std::vector<int> const &calls, size_t possible)
+  {
+    if (calls.empty())
+    {
+      return NoCalls;
+    }
+    if (calls.size() == possible ||
+        std::find(calls.begin(), calls.end(), (int)__NR_execve) != calls.end() ||
+        std::find(calls.begin(), calls.end(), (int)__NR_execveat) != calls.end())
+    {
+      return AllCalls;
+    }
+    return FilteredCalls;
+  }
+
+  /** Fork a child process, running under ptrace, and return its pid.
+   * If 'calls' is given only those system calls stop the child and its
+   * descendants, which must then be traced with FilteredCalls */
+  inline pid_t CreateProcess(int argc, char **argv, std::vector<int> const &calls = std::vector<int>())
+  {
+    pid_t const cpid = fork();
+    if (cpid > 0)
+    {
+      // In the parent
+      return cpid;
+    }
+    else if (cpid == 0)
+    {
+      // In the new child
+      if (ptrace(PTRACE_TRACEME, 0, 0, 0) == -1)
+      {
+        throw make_error("ptrace(PTRACE_TRACEME)");
+      }
+      if (!calls.empty())
+      {
+        installFilter(calls, SECCOMP_RET_TRACE, 0);
+      }
+      execv(argv[0], argv);
+      throw make_error("execv");
+    }
+    else
+    {
+      throw make_error("fork");
+    }
+  }
+
+  /** A system call stop, decoded from the registers */
+  struct SysCall
+  {
+    struct user_regs_struct regs;
+    int func;
+    long args[6];
+    long rc;          // -ENOSYS on entry
+  };
+
+  /** Order in which a batch of stopped tasks is handled and resumed */
+  enum ResumePolicy
+  {
+    Fifo,            // in the order waitpid reported them
+    RoundRobin,      // one task from each process in turn
+    ShortestFirst    // least expected handling time first
+  };
+
+  /** Statistics policy which records nothing */
+  struct NoStats
+  {
+    enum Stage { Wait, Stop, SysCall, Resume };
+    enum StopKind { Start, SysCallStop, EventStop, TrapStop, SignalStop, ExitStop, OtherStop };
+
+    static constexpr bool enabled() { return false; }
+    static void onStop(StopKind) {}
+    static void onBatch(size_t) {}
+    static void onResume(pid_t, long long) {}
+
+    template <typename Addr, typename Data>
+    static long ptrace(__ptrace_request request, pid_t pid, Addr addr, Data data)
+    {
+      return ::ptrace(request, pid, addr, data);
+    }
+
+    struct Timer
+    {
+      explicit Timer(Stage) {}
+    };
+  };
+
+  namespace detail
+  {
+#define TRACE_LOOP_HOOK(NAME, ...) \
+    template <typename H, typename = void> \
+    struct Has##NAME : std::false_type {}; \
+    template <typename H> \
+    struct Has##NAME<H, std::void_t<decltype(std::declval<H &>().NAME(__VA_ARGS__))> > \
+      : std::true_type {};
+
+    TRACE_LOOP_HOOK(OnStart, pid_t())
+    TRACE_LOOP_HOOK(OnSysCallEntry, pid_t(), std::declval<SysCall const &>())
+    TRACE_LOOP_HOOK(OnSysCallExit, pid_t(), std::declval<SysCall const &>())
+    TRACE_LOOP_HOOK(OnFork, pid_t(), pid_t(), int())
+    TRACE_LOOP_HOOK(OnExec, pid_t())
+    TRACE_LOOP_HOOK(OnTrap, pid_t())
+    TRACE_LOOP_HOOK(OnSignal, pid_t(), int())
+    TRACE_LOOP_HOOK(OnExit, pid_t(), int())
+    TRACE_LOOP_HOOK(OnResume, pid_t())
+    TRACE_LOOP_HOOK(SingleStep, pid_t())
+
+#undef TRACE_LOOP_HOOK
+
+    template <typename H, typename = void>
+    struct StatsOf { typedef NoStats type; };
+    template <typename H>
+    struct StatsOf<H, std::void_t<typename H::Stats> > { typedef typename H::Stats type; };
+
+    inline long long nanoseconds()
+    {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+
+    /** Read the thread group id of task 'tid' (0 if it has gone) */
+    inline pid_t readTgid(pid_t tid)
+    {
+      std::ostringstream name;
+      name << "/proc/" << tid << "/status";
+      std::ifstream ifs(name.str().c_str());
+      std::string line;
+      while (std::getline(ifs, line))
+      {
+        if (line.compare(0, 5, "Tgid:") == 0)
+        {
+          return atoi(line.c_str() + 5);
+        }
+      }
+      return 0;
+    }
+  } // namespace detail
+
+  /** Trace the task 'pid', and its descendants if the handler
+   * wants fork events, passing each stop to 'handler' */
+  template <typename Handler>
+  class EventLoop
+  {
+  public:
+    typedef typename detail::StatsOf<Handler>::type Stats;
+
+    static constexpr bool onSysCall =
+      detail::HasOnSysCallEntry<Handler>::value || detail::HasOnSysCallExit<Handler>::value;
+    static constexpr bool onFork = detail::HasOnFork<Handler>::value;
+    static constexpr bool onExec = detail::HasOnExec<Handler>::value;
+
+    /** The ptrace options needed by the handler's hooks */
+    static constexpr long options =
+      (onSysCall ? PTRACE_O_TRACESYSGOOD : 0) |
+      (onFork ? PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK | PTRACE_O_TRACECLONE : 0) |
+      (onExec ? PTRACE_O_TRACEEXEC : 0);
+
+    EventLoop(Handler &handler, pid_t pid)
+    : handler(handler), pid(pid), policy(Fifo), stops(onSysCall ? AllCalls : NoCalls),
+      batches(0), initialised(false) {}
+
+    /** Set which system calls stop the tasks: FilteredCalls needs the
+     * process to have been created with the calls wanted */
+    void setSysCallStops(SysCallStops stops) { this->stops = onSysCall ? stops : NoCalls; }
+
+    /** Set the order in which a batch of stopped tasks is resumed */
+    void setResumePolicy(ResumePolicy policy) { this->policy = policy; }
+
+    /** Run until there are no more traced tasks */
+    void run();
+
+  private:
+    /** A stopped task waiting to be handled */
+    struct Pending
+    {
+      pid_t pid;
+      int status;
+      long long drained;   // time collected by waitpid (ns)
+    };
+
+    /** Wait for a task to stop and collect any others already stopped */
+    bool drain(std::vector<Pending> &batch);
+
+    /** Wait for the next status change of any task, resuming held
+     * tasks as they become due; returns the task or -1 */
+    pid_t wait(int &status);
+
+    /** Resume task 'pid' delivering 'signal', or hold it or step it
+     * if the handler asks; returns whether it was stepped */
+    bool resumeTask(int signal);
+
+    /** How to resume task 'tid': a filtered call which has stopped
+     * continues to its exit stop */
+    __ptrace_request resumeRequest(pid_t tid) const
+    {
+      return stops == AllCalls ? PTRACE_SYSCALL :
+             stops == FilteredCalls && inSysCall.count(tid) ? PTRACE_SYSCALL : PTRACE_CONT;
+    }
+
+    /** Order the batch according to the resume policy */
+    void order(std::vector<Pending> &batch);
+
+    /** Process id of task 'tid', cached */
+    pid_t processOf(pid_t tid);
+
+    /** Handle the status of task 'pid'; returns whether to resume it
+     * and sets 'signal' to the signal to deliver */
+    bool OnStatus(int status, int &signal);
+
+    /** Handle a stop, returning the signal to deliver */
+    int OnStop(int signal, int event);
+
+    /** Handle a ptrace extension event */
+    void OnEvent(int event);
+
+    /** Handle a system call stop */
+    void OnSysCall();
+
+    Handler &handler;
+    pid_t pid;
+    ResumePolicy policy;
+    SysCallStops stops;
+    unsigned batches;
+    bool initialised;
+    std::map<pid_t, pid_t> tgids;            // task id => process id
+    std::map<pid_t, long long> serviceTime;  // task id => average handling time (ns)
+    std::map<pid_t, int> inSysCall;          // task id => system call entered
+    std::multimap<long long, std::pair<pid_t, int> > held;   // due time => task id, signal
+
+    EventLoop(EventLoop const &) = delete;
+    EventLoop &operator=(EventLoop const &) = delete;
+  };
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////
+  // Collecting every task that is already stopped before handling any
+  // of them saves a trip through the scheduler per stop when many
+  // threads are busy, and lets the policy decide who is served first.
+  template <typename Handler>
+  void EventLoop<Handler>::run()
+  {
+    bool const timed = Stats::enabled() || policy == ShortestFirst;
+    std::vector<Pending> batch;
+
+    while (drain(batch))
+    {
+      order(batch);
+      for (size_t idx = 0; idx != batch.size(); ++idx)
+      {
+        pid = batch[idx].pid;
+        long long const begin = timed ? detail::nanoseconds() : 0;
+        int status(batch[idx].status);
+        int signal(0);
+        // Whatever ends a step is handled before anything else, so a
+        // breakpoint lifted for the step is missing for as short a time
+        // as possible, and an exit or event during it is seen as usual
+        while (OnStatus(status, signal) && resumeTask(signal))
+        {
+          typename Stats::Timer timer(Stats::Wait);
+          if (waitpid(pid, &status, __WALL) != pid)
+            break;
+        }
+        if (timed)
+        {
+          long long const end = detail::nanoseconds();
+          Stats::onResume(pid, end - batch[idx].drained);
+          if (policy == ShortestFirst)
+          {
+            long long &average = serviceTime[pid];
+            average = (average * 7 + (end - begin)) / 8;
+          }
+        }
+      }
+    }
+    if (errno != ECHILD)
+    {
+      throw make_error("wait");
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////
+  // waitpid with WNOHANG rather than waitid, so the status (and
+  // hence the ptrace event) decodes exactly as for the blocking call
+  template <typename Handler>
+  bool EventLoop<Handler>::drain(std::vector<Pending> &batch)
+  {
+    bool const timed = Stats::enabled();
+    batch.clear();
+    Pending next;
+    {
+      typename Stats::Timer timer(Stats::Wait);
+      next.pid = wait(next.status);
+    }
+    if (next.pid == -1)
+    {
+      return false;
+    }
+    next.drained = timed ? detail::nanoseconds() : 0;
+    batch.push_back(next);
+    while ((next.pid = waitpid(-1, &next.status, __WALL | WNOHANG)) > 0)
+    {
+      next.drained = timed ? detail::nanoseconds() : 0;
+      batch.push_back(next);
+    }
+    Stats::onBatch(batch.size());
+    return true;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////
+  // While tasks are held SIGCHLD is blocked, so one arriving after the
+  // WNOHANG poll stays pending and ends the timed wait at once
+  template <typename Handler>
+  pid_t EventLoop<Handler>::wait(int &status)
+  {
+    while (!held.empty())
+    {
+      long long const now = detail::nanoseconds();
+      while (!held.empty() && held.begin()->first <= now)
+      {
+        typename Stats::Timer timer(Stats::Resume);
+        pid_t const tid = held.begin()->second.first;
+        Stats::ptrace(resumeRequest(tid), tid, 0, held.begin()->second.second);
+        held.erase(held.begin());
+      }
+      pid_t const next = waitpid(-1, &status, __WALL | WNOHANG);
+      if (next != 0 || held.empty())
+      {
+        if (next != 0)
+          return next;
+        break;
+      }
+      long long const delay = held.begin()->first - now;
+      struct timespec const timeout = { delay / 1000000000, delay % 1000000000 };
+      sigset_t chld;
+      sigemptyset(&chld);
+      sigaddset(&chld, SIGCHLD);
+      sigtimedwait(&chld, 0, &timeout);
+    }
+    return waitpid(-1, &status, __WALL);
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////
+  template <typename Handler>
+  bool EventLoop<Handler>::resumeTask(int signal)
+  {
+    // A step ends with SIGTRAP, or at the start of the handler of 'signal'
+    if constexpr (detail::HasSingleStep<Handler>::value)
+    {
+      if (handler.SingleStep(pid))
+      {
+        typename Stats::Timer timer(Stats::Resume);
+        return Stats::ptrace(PTRACE_SINGLESTEP, pid, 0, signal) == 0;
+      }
+    }
+    if constexpr (detail::HasOnResume<Handler>::value)
+    {
+      long long const hold = handler.OnResume(pid);
+      if (hold > 0)
+      {
+        if (held.empty())
+        {
+          sigset_t chld;
+          sigemptyset(&chld);
+          sigaddset(&chld, SIGCHLD);
+          sigprocmask(SIG_BLOCK, &chld, 0);
+        }
+        held.insert(std::make_pair(detail::nanoseconds() + hold, std::make_pair(pid, signal)));
+        return false;
+      }
+    }
+    typename Stats::Timer timer(Stats::Resume);
+    Stats::ptrace(resumeRequest(pid), pid, 0, signal);
+    return false;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////
+  template <typename Handler>
+  void EventLoop<Handler>::order(std::vector<Pending> &batch)
+  {
+    ++batches;
+    if (batch.size() < 2)
+    {
+      return;
+    }
+    if (policy == RoundRobin)
+    {
+      // Group by process, in order of first appearance, then take one
+      // task from each process in turn starting from a different
+      // process on each batch
+      std::vector<pid_t> order;
+      std::map<pid_t, std::vector<Pending> > byProcess;
+      for (size_t idx = 0; idx != batch.size(); ++idx)
+      {
+        pid_t const tgid = processOf(batch[idx].pid);
+        std::vector<Pending> &tasks = byProcess[tgid];
+        if (tasks.empty())
+        {
+          order.push_back(tgid);
+        }
+        tasks.push_back(batch[idx]);
+      }
+      std::rotate(order.begin(), order.begin() + batches % order.size(), order.end());
+      batch.clear();
+      for (size_t round = 0; !order.empty(); ++round)
+      {
+        std::vector<pid_t> remaining;
+        for (size_t idx = 0; idx != order.size(); ++idx)
+        {
+          std::vector<Pending> const &tasks = byProcess[order[idx]];
+          batch.push_back(tasks[round]);
+          if (round + 1 < tasks.size())
+          {
+            remaining.push_back(order[idx]);
+          }
+        }
+        order.swap(remaining);
+      }
+    }
+    else if (policy == ShortestFirst)
+    {
+      std::map<pid_t, long long> const &expected = serviceTime;
+      std::stable_sort(batch.begin(), batch.end(),
+        [&expected](Pending const &lhs, Pending const &rhs)
+        {
+          typename std::map<pid_t, long long>::const_iterator const l = expected.find(lhs.pid);
+          typename std::map<pid_t, long long>::const_iterator const r = expected.find(rhs.pid);
+          return (l == expected.end() ? 0 : l->second) < (r == expected.end() ? 0 : r->second);
+        });
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////
+  template <typename Handler>
+  pid_t EventLoop<Handler>::processOf(pid_t tid)
+  {
+    typename std::map<pid_t, pid_t>::const_iterator const it = tgids.find(tid);
+    if (it != tgids.end())
+    {
+      return it->second;
+    }
+    pid_t tgid = detail::readTgid(tid);
+    if (tgid == 0)
+    {
+      tgid = tid;
+    }
+    tgids[tid] = tgid;
+    return tgid;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////
+  template <typename Handler>
+  bool EventLoop<Handler>::OnStatus(int status, int &signal)
+  {
+    typename Stats::Timer timer(Stats::Stop);
+    if (WIFSTOPPED(status))
+    {
+      signal = OnStop(WSTOPSIG(status), status >> 16);
+      return true;
+    }
+    if (WIFEXITED(status) || WIFSIGNALED(status))
+    {
+      Stats::onStop(Stats::ExitStop);
+      tgids.erase(pid);
+      serviceTime.erase(pid);
+      inSysCall.erase(pid);
+      if constexpr (detail::HasOnExit<Handler>::value)
+      {
+        handler.OnExit(pid, status);
+      }
+      return false;
+    }
+    // Without WCONTINUED in the wait options nothing else is expected
+    Stats::onStop(Stats::OtherStop);
+    return true;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////
+  // Handle the various types of ptrace 'stop' events
+  // 1) the first stop when starting debugging
+  // 2) system call entry and exit
+  // 3) extension events from fork/vfork/clone/exec
+  // 4) signals
+  //
+  template <typename Handler>
+  int EventLoop<Handler>::OnStop(int signal, int event)
+  {
+    if (!initialised)
+    {
+      initialised = true;
+      long const required = options | (stops == FilteredCalls ? PTRACE_O_TRACESECCOMP : 0);
+      if (required != 0 && Stats::ptrace(PTRACE_SETOPTIONS, pid, 0, required) == -1)
+      {
+        throw make_error("PTRACE_SETOPTIONS");
+      }
+      if constexpr (detail::HasOnStart<Handler>::value)
+      {
+        Stats::onStop(Stats::Start);
+        handler.OnStart(pid);
+        return 0;
+      }
+    }
+
+    if (onSysCall && signal == (SIGTRAP | 0x80))
+    {
+      Stats::onStop(Stats::SysCallStop);
+      OnSysCall();
+      return 0;
+    }
+    // A call selected by the filter stops in place of its entry stop
+    if (onSysCall && signal == SIGTRAP && event == PTRACE_EVENT_SECCOMP)
+    {
+      Stats::onStop(Stats::SysCallStop);
+      OnSysCall();
+      return 0;
+    }
+    if (signal == SIGTRAP && event)
+    {
+      Stats::onStop(Stats::EventStop);
+      OnEvent(event);
+      return 0;
+    }
+    if constexpr (detail::HasOnTrap<Handler>::value)
+    {
+      if (signal == SIGTRAP)
+      {
+        Stats::onStop(Stats::TrapStop);
+        handler.OnTrap(pid);
+        return 0;
+      }
+    }
+    Stats::onStop(Stats::SignalStop);
+    if constexpr (detail::HasOnSignal<Handler>::value)
+    {
+      return handler.OnSignal(pid, signal);
+    }
+    else
+    {
+      return (signal == SIGTRAP || signal == SIGSTOP) ? 0 : signal;
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////
+  template <typename Handler>
+  void EventLoop<Handler>::OnEvent(int event)
+  {
+    switch (event)
+    {
+    case PTRACE_EVENT_CLONE:
+    case PTRACE_EVENT_FORK:
+    case PTRACE_EVENT_VFORK:
+      if constexpr (onFork)
+      {
+        unsigned long message(0);
+        if (Stats::ptrace(PTRACE_GETEVENTMSG, pid, 0, &message) == 0)
+        {
+          handler.OnFork(pid, message, event);
+        }
+      }
+      break;
+    case PTRACE_EVENT_EXEC:
+      if constexpr (onSysCall)
+      {
+        // A thread other than the leader which execs takes over its id
+        unsigned long former(0);
+        if (Stats::ptrace(PTRACE_GETEVENTMSG, pid, 0, &former) == 0 && pid_t(former) != pid)
+        {
+          typename std::map<pid_t, int>::iterator const it = inSysCall.find(former);
+          if (it != inSysCall.end())
+          {
+            inSysCall[pid] = it->second;
+            inSysCall.erase(it);
+          }
+        }
+      }
+      if constexpr (onExec)
+      {
+        handler.OnExec(pid);
+      }
+      break;
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////
+  template <typename Handler>
+  void EventLoop<Handler>::OnSysCall()
+  {
+    if constexpr (onSysCall)
+    {
+      typename Stats::Timer timer(Stats::SysCall);
+      SysCall call;
+      if (Stats::ptrace(PTRACE_GETREGS, pid, 0, &call.regs) == -1)
+      {
+        throw make_error("ptrace(PTRACE_GETREGS)");
+      }
+      struct user_regs_struct const &regs = call.regs;
+#if __x86_64__
+      call.rc = regs.rax;
+      call.func = regs.orig_rax;
+      long const args[] = { (long)regs.rdi, (long)regs.rsi, (long)regs.rdx,
+                            (long)regs.r10, (long)regs.r8, (long)regs.r9 };
+#elif __i386__
+      call.rc = regs.eax;
+      call.func = regs.orig_eax;
+      long const args[] = { regs.ebx, regs.ecx, regs.edx, regs.esi, regs.edi, regs.ebp };
+#else
+#error Unknown target architecture
+#endif // __x86_64__
+      std::copy(args, args + 6, call.args);
+
+      // The return code is -ENOSYS on entry, but also on the exit of a
+      // call which does not exist or was skipped by the handler setting
+      // the number to -1, so follow whether each task is in a call
+      typename std::map<pid_t, int>::iterator const entered = inSysCall.find(pid);
+      if (entered == inSysCall.end())
+      {
+        inSysCall.insert(std::make_pair(pid, call.func));
+        if constexpr (detail::HasOnSysCallEntry<Handler>::value)
+        {
+          handler.OnSysCallEntry(pid, call);
+        }
+      }
+      else
+      {
+        call.func = entered->second;
+        inSysCall.erase(entered);
+        if constexpr (detail::HasOnSysCallExit<Handler>::value)
+        {
+          handler.OnSysCallExit(pid, call);
+        }
+      }
+    }
+  }
+} // namespace TraceLoop
+
+#endif // TRACE_LOOP_H
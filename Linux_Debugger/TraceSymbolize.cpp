@@ -0,0 +1,288 @@
+/*
+NAME
+    TraceSymbolize
+
+DESCRIPTION
+    Resolve the raw addresses written by ProcessTracer --deferred-symbols.
+
+    TraceSymbolize [-f] [-j threads] input [output]
+
+    The input has "@module image start end bias build-id path" records
+    of the executable mappings of each traced image, and other lines in
+    which each @image:address is replaced by the name of the function
+    containing it. With -f the lines are folded stacks ending in a count
+    and lines that resolve to the same stack are merged; a frame in
+    inlined code is then followed by the functions inlined there, as
+    ProcessTracer --offcpu names them.
+
+    Each distinct address is resolved once. The addresses are grouped
+    by module and sorted so each symbol table is read once and searched
+    in order, and the modules are shared out between the threads (by
+    default one per processor). A module whose build id no longer
+    matches the one recorded is not used: its frames are just named
+    [module], as for one without symbols.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "ElfDebugInfo.h"
+#include "ElfSymbols.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  /** An executable mapping of an image */
+  struct Mapping
+  {
+    unsigned long start;
+    unsigned long end;
+    unsigned long bias;    // run-time less link-time address
+    std::string build;
+    std::string path;
+  };
+
+  /** An address to resolve in a module */
+  struct Lookup
+  {
+    unsigned long vaddr;
+    std::string build;
+    std::string *name;
+  };
+
+  bool byVaddr(Lookup const &lhs, Lookup const &rhs)
+  {
+    return lhs.vaddr < rhs.vaddr;
+  }
+
+  /** The addresses to resolve in one file */
+  struct Work
+  {
+    std::string path;
+    std::vector<Lookup> lookups;
+  };
+
+  typedef std::pair<size_t, unsigned long> Address;   // image, address
+
+  /** Parse an @image:address token at 'pos' in 'line', setting 'end' past it */
+  bool parseToken(std::string const &line, size_t pos, Address &address, size_t &end)
+  {
+    char const *const begin = line.c_str() + pos + 1;
+    char *ptr(0);
+    address.first = strtoul(begin, &ptr, 10);
+    if (ptr == begin || *ptr != ':')
+      return false;
+    char const *const hex = ptr + 1;
+    address.second = strtoul(hex, &ptr, 16);
+    if (ptr == hex)
+      return false;
+    end = ptr - line.c_str();
+    return true;
+  }
+
+  void resolve(Work &work, bool inlines)
+  {
+    std::shared_ptr<ElfSymbols const> const symbols = ElfSymbols::get(work.path);
+    std::shared_ptr<ElfDebugInfo const> const debugInfo = inlines ? ElfDebugInfo::get(work.path) : 0;
+    std::vector<ElfDebugInfo::InlineFrame> frames;
+    std::string const module = "[" + work.path.substr(work.path.rfind('/') + 1) + "]";
+    std::sort(work.lookups.begin(), work.lookups.end(), byVaddr);
+    for (std::vector<Lookup>::const_iterator it = work.lookups.begin(); it != work.lookups.end(); ++it)
+    {
+      ElfSymbols::Symbol const *symbol(0);
+      bool const current = it->build == "-" || it->build == symbols->buildId();
+      if (current)
+      {
+        symbol = symbols->find(it->vaddr);
+      }
+      *it->name = symbol ? symbol->name : module;
+      if (current && debugInfo && debugInfo->inlinedAt(it->vaddr, frames))
+      {
+        for (size_t idx = frames.size(); idx-- != 0; )
+        {
+          *it->name += ';' + frames[idx].function + "_[i]";
+        }
+      }
+    }
+  }
+} // namespace
+
+int main(int argc, char **argv)
+{
+  bool folded(false);
+  unsigned threads = std::thread::hardware_concurrency();
+  int opt;
+  while ((opt = getopt(argc, argv, "fj:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'f':
+      folded = true;
+      break;
+    case 'j':
+      threads = atoi(optarg);
+      break;
+    default:
+      argc = 0;
+      break;
+    }
+  }
+  if (argc <= optind || argc > optind + 2)
+  {
+    std::cerr << "Syntax: TraceSymbolize [-f] [-j threads] input [output]\n"
+                 "  -f  the input is folded stacks: merge lines naming the same stack\n"
+                 "  -j  number of threads reading symbol tables (default: one per processor)"
+              << std::endl;
+    return 1;
+  }
+  std::ifstream ifs(argv[optind]);
+  if (!ifs)
+  {
+    std::cerr << "Unable to open " << argv[optind] << std::endl;
+    return 1;
+  }
+
+  // Read the module records and collect the distinct addresses
+  std::map<size_t, std::vector<Mapping> > images;
+  std::map<Address, std::string> names;
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(ifs, line))
+  {
+    if (line.compare(0, 8, "@module ") == 0)
+    {
+      std::istringstream iss(line.substr(8));
+      size_t image;
+      Mapping mapping;
+      iss >> image >> std::hex >> mapping.start >> mapping.end >> mapping.bias >> mapping.build;
+      std::getline(iss >> std::ws, mapping.path);
+      if (iss)
+        images[image].push_back(mapping);
+      continue;
+    }
+    for (size_t pos = line.find('@'); pos != std::string::npos; pos = line.find('@', pos + 1))
+    {
+      Address address;
+      size_t end;
+      if (parseToken(line, pos, address, end))
+        names[address];
+    }
+    lines.push_back(line);
+  }
+
+  // Group the addresses by file; later records of an image take precedence
+  std::map<std::string, Work> byPath;
+  for (std::map<Address, std::string>::iterator it = names.begin(); it != names.end(); ++it)
+  {
+    std::vector<Mapping> const &mappings = images[it->first.first];
+    std::vector<Mapping>::const_reverse_iterator m = mappings.rbegin();
+    while (m != mappings.rend() && (it->first.second < m->start || it->first.second >= m->end))
+      ++m;
+    if (m == mappings.rend())
+    {
+      std::ostringstream oss;
+      oss << "0x" << std::hex << it->first.second;
+      it->second = oss.str();
+      continue;
+    }
+    Work &work = byPath[m->path];
+    work.path = m->path;
+    Lookup const lookup = { it->first.second - m->bias, m->build, &it->second };
+    work.lookups.push_back(lookup);
+  }
+
+  std::vector<Work *> work;
+  for (std::map<std::string, Work>::iterator it = byPath.begin(); it != byPath.end(); ++it)
+  {
+    work.push_back(&it->second);
+  }
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> pool;
+  for (unsigned idx = 0; idx < std::max(threads, 1u) && idx < work.size(); ++idx)
+  {
+    pool.push_back(std::thread([&work, &next, folded]()
+      {
+        for (size_t item; (item = next++) < work.size(); )
+        {
+          resolve(*work[item], folded);
+        }
+      }));
+  }
+  for (size_t idx = 0; idx != pool.size(); ++idx)
+  {
+    pool[idx].join();
+  }
+
+  // Substitute the names
+  std::ofstream ofs;
+  if (argc == optind + 2)
+  {
+    ofs.open(argv[optind + 1]);
+    if (!ofs)
+    {
+      std::cerr << "Unable to open " << argv[optind + 1] << std::endl;
+      return 1;
+    }
+  }
+  std::ostream &os = (argc == optind + 2) ? ofs : std::cout;
+  std::map<std::string, long long> merged;
+  for (std::vector<std::string>::const_iterator it = lines.begin(); it != lines.end(); ++it)
+  {
+    std::string result;
+    size_t done(0);
+    for (size_t pos = it->find('@'); pos != std::string::npos; pos = it->find('@', pos + 1))
+    {
+      Address address;
+      size_t end;
+      if (parseToken(*it, pos, address, end))
+      {
+        result.append(*it, done, pos - done);
+        result += names[address];
+        done = end;
+        pos = end - 1;
+      }
+    }
+    result.append(*it, done, std::string::npos);
+    size_t const space = result.rfind(' ');
+    if (folded && space != std::string::npos)
+    {
+      merged[result.substr(0, space)] += atoll(result.c_str() + space + 1);
+    }
+    else
+    {
+      os << result << '\n';
+    }
+  }
+  for (std::map<std::string, long long>::const_iterator it = merged.begin(); it != merged.end(); ++it)
+  {
+    os << it->first << ' ' << it->second << '\n';
+  }
+  std::cerr << "Resolved " << names.size() << " addresses in " << byPath.size() << " modules using "
+            << pool.size() << " threads" << std::endl;
+  return os ? 0 : 1;
+}
@@ -0,0 +1,390 @@
+/*
+NAME
+    TraceTimeline
+
+DESCRIPTION
+    Timeline of system calls in Chrome Trace Event format for ProcessTracer.
+
+    The output is the JSON array format, which the viewers accept
+    even without the closing bracket, so a trace cut short by a crash
+    still loads. Each system call is a complete ('X') event on the track
+    of its thread within its process; fork, exec, exit and signals are
+    thread-scoped instant ('i') events, and process and thread names
+    are metadata ('M') events, written again when the name changes.
+    A call that never returns, such as exit_group, ends when the
+    thread does.
+
+    Every system call produces an event, so the events are formatted
+    by hand into a fixed buffer which is written out when full,
+    rather than through an ostream a field at a time.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "TraceTimeline.h"
+#include "TraceLoop.h"
+#include "TraceUtils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <asm/unistd.h>
+#include <sys/prctl.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using TraceLoop::make_error;
+
+namespace
+{
+  /** The name of task 'tid' from /proc, as set by prctl(PR_SET_NAME) */
+  std::string readComm(pid_t tid)
+  {
+    std::ifstream ifs(procName(tid, "comm").c_str());
+    std::string result;
+    std::getline(ifs, result);
+    return result;
+  }
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+TraceTimeline::TraceTimeline(std::string const &fileName)
+: fileName(fileName), fd(-1), failed(false), used(0)
+{
+  if (!fileName.empty())
+  {
+    fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd == -1)
+    {
+      throw make_error("open " + fileName);
+    }
+    put("[\n");
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+TraceTimeline::~TraceTimeline()
+{
+  if (fd != -1)
+  {
+    flush();
+    close(fd);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void TraceTimeline::OnStart(pid_t pid)
+{
+  images.OnStart(pid);
+  name(pid, true);
+  name(pid, false);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void TraceTimeline::OnFork(pid_t parent, pid_t child, int event)
+{
+  images.OnFork(parent, child, event);
+  begin(event == PTRACE_EVENT_CLONE ? "clone" : event == PTRACE_EVENT_VFORK ? "vfork" : "fork", 'i', parent, elapsed.nsec());
+  put(",\"s\":\"t\",\"args\":{\"child\":");
+  put((long long)child);
+  put("}},\n");
+  if (images.processOf(child) == child)
+  {
+    name(child, true);
+  }
+  name(child, false);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void TraceTimeline::OnExec(pid_t pid)
+{
+  // When another thread execs it takes over the process id, so any
+  // call here is that of the old leader which has gone
+  std::map<pid_t, Call>::iterator const it = calls.find(pid);
+  if (it != calls.end() && it->second.func != __NR_execve && it->second.func != __NR_execveat)
+  {
+    call(pid, it->second, elapsed.nsec(), 0);
+    calls.erase(it);
+  }
+  images.OnExec(pid);
+  begin("exec", 'i', pid, elapsed.nsec());
+  put(",\"s\":\"t\",\"args\":{\"command\":");
+  putString(readCommand(pid));
+  put("}},\n");
+  name(pid, true);
+  name(pid, false);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void TraceTimeline::OnExit(pid_t pid, int status)
+{
+  nsec const end = elapsed.nsec();
+  std::map<pid_t, Call>::iterator const it = calls.find(pid);
+  if (it != calls.end())
+  {
+    call(pid, it->second, end, 0);
+    calls.erase(it);
+  }
+  begin("exit", 'i', pid, end);
+  put(",\"s\":\"t\",\"args\":{");
+  if (WIFSIGNALED(status))
+  {
+    std::ostringstream oss;
+    oss << sigstrm(WTERMSIG(status));
+    put("\"signal\":");
+    putString(oss.str());
+  }
+  else
+  {
+    put("\"status\":");
+    put((long long)WEXITSTATUS(status));
+  }
+  put("}},\n");
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// The SIGSTOP each new task starts with is an artefact of tracing
+void TraceTimeline::OnSignal(pid_t pid, int signal)
+{
+  if (signal == SIGSTOP)
+  {
+    return;
+  }
+  std::ostringstream oss;
+  oss << sigstrm(signal);
+  begin("signal", 'i', pid, elapsed.nsec());
+  put(",\"s\":\"t\",\"args\":{\"signal\":");
+  putString(oss.str());
+  put("}},\n");
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool TraceTimeline::SelectedCall(int func)
+{
+  return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void TraceTimeline::OnCallEntry(pid_t pid, int func, long const args[])
+{
+  Call &entry = calls[pid];
+  entry.func = func;
+  entry.entry = elapsed.nsec();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void TraceTimeline::OnCallExit(pid_t pid, int func, long const args[], long rc)
+{
+  std::map<pid_t, Call>::iterator const it = calls.find(pid);
+  if (it == calls.end())
+  {
+    return;
+  }
+  char result[24];
+  snprintf(result, sizeof(result), "%ld", rc);
+  call(pid, it->second, elapsed.nsec(), result);
+  calls.erase(it);
+  if (func == __NR_prctl && args[0] == PR_SET_NAME && rc == 0)
+  {
+    name(pid, false);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void TraceTimeline::call(pid_t tid, Call const &call, nsec end, char const *result)
+{
+  begin(syscallName(call.func).c_str(), 'X', tid, call.entry);
+  put(",\"dur\":");
+  putTime(end - call.entry);
+  if (result)
+  {
+    put(",\"args\":{\"rc\":");
+    put(result);
+    put('}');
+  }
+  put("},\n");
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void TraceTimeline::name(pid_t tid, bool process)
+{
+  std::string const comm = readComm(tid);
+  if (comm.empty())
+  {
+    return;
+  }
+  put("{\"name\":\"");
+  put(process ? "process_name" : "thread_name");
+  put("\",\"ph\":\"M\",\"pid\":");
+  put((long long)images.processOf(tid));
+  put(",\"tid\":");
+  put((long long)tid);
+  put(",\"args\":{\"name\":");
+  putString(process ? readCommand(tid) : comm);
+  put("}},\n");
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void TraceTimeline::begin(char const *name, char ph, pid_t tid, nsec ts)
+{
+  put("{\"name\":\"");
+  put(name);
+  put("\",\"ph\":\"");
+  put(ph);
+  put("\",\"pid\":");
+  put((long long)images.processOf(tid));
+  put(",\"tid\":");
+  put((long long)tid);
+  put(",\"ts\":");
+  putTime(ts);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void TraceTimeline::put(char ch)
+{
+  if (used == sizeof(buffer))
+  {
+    flush();
+  }
+  buffer[used++] = ch;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void TraceTimeline::put(char const *text)
+{
+  size_t len = strlen(text);
+  while (len != 0)
+  {
+    if (used == sizeof(buffer))
+    {
+      flush();
+    }
+    size_t const chunk = std::min(len, sizeof(buffer) - used);
+    memcpy(buffer + used, text, chunk);
+    used += chunk;
+    text += chunk;
+    len -= chunk;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void TraceTimeline::put(long long value)
+{
+  char digits[24];
+  char *ptr = digits + sizeof(digits);
+  *--ptr = '\0';
+  unsigned long long magnitude = value < 0 ? 0ULL - value : value;
+  do
+  {
+    *--ptr = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude != 0);
+  if (value < 0)
+  {
+    *--ptr = '-';
+  }
+  put(ptr);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void TraceTimeline::putTime(nsec value)
+{
+  put(value / 1000);
+  char fraction[5] = { '.', char('0' + value / 100 % 10), char('0' + value / 10 % 10), char('0' + value % 10), '\0' };
+  put(fraction);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void TraceTimeline::putString(std::string const &text)
+{
+  put('"');
+  for (std::string::const_iterator it = text.begin(); it != text.end(); ++it)
+  {
+    unsigned char const ch = *it;
+    if (ch == '"' || ch == '\\')
+    {
+      put('\\');
+      put(char(ch));
+    }
+    else if (ch < 0x20)
+    {
+      static char const hex[] = "0123456789abcdef";
+      char escape[7] = { '\\', 'u', '0', '0', hex[ch >> 4], hex[ch & 0xf], '\0' };
+      put(escape);
+    }
+    else
+    {
+      put(char(ch));
+    }
+  }
+  put('"');
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void TraceTimeline::flush()
+{
+  char const *data = buffer;
+  while (used != 0 && !failed)
+  {
+    ssize_t const rc = write(fd, data, used);
+    if (rc == -1 && errno == EINTR)
+      continue;
+    if (rc <= 0)
+    {
+      failed = true;
+      break;
+    }
+    data += rc;
+    used -= rc;
+  }
+  used = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// Calls still in progress are left out; closing the array makes the
+// file strict JSON for tools other than the trace viewers
+void TraceTimeline::Report(std::ostream &os)
+{
+  if (fd == -1)
+  {
+    return;
+  }
+  // Replace the trailing ",\n" of the last event
+  if (used >= 2 && buffer[used - 2] == ',')
+  {
+    used -= 2;
+    put("\n]\n");
+  }
+  else
+  {
+    put("{}\n]\n");
+  }
+  flush();
+  close(fd);
+  fd = -1;
+  if (failed)
+  {
+    os << "Unable to write timeline to " << fileName << std::endl;
+  }
+}
@@ -0,0 +1,97 @@
+#ifndef TRACE_TIMELINE_H
+#define TRACE_TIMELINE_H
+
+/**@file
+
+  Timeline of system calls in Chrome Trace Event format for ProcessTracer
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "ProcessImages.h"
+#include "TraceListener.h"
+#include "TraceUtils.h"
+
+#include <map>
+#include <string>
+
+/** Write each system call as a duration event on the track of its
+ * thread, with process events as instants, for loading into Perfetto
+ * or chrome://tracing */
+class TraceTimeline : public TraceListener
+{
+public:
+  /** Stream the events to 'fileName', if not empty.
+   * Throws std::runtime_error if the file cannot be created */
+  explicit TraceTimeline(std::string const &fileName);
+
+  ~TraceTimeline();
+
+  void OnStart(pid_t pid) override;
+  void OnFork(pid_t parent, pid_t child, int event) override;
+  void OnExec(pid_t pid) override;
+  void OnExit(pid_t pid, int status) override;
+  void OnSignal(pid_t pid, int signal) override;
+  bool SelectedCall(int func) override;
+  void OnCallEntry(pid_t pid, int func, long const args[]) override;
+  void OnCallExit(pid_t pid, int func, long const args[], long rc) override;
+  void Report(std::ostream &os) override;
+
+private:
+  /** Times are in nanoseconds since the tracer started */
+  typedef long long nsec;
+
+  /** A system call in progress */
+  struct Call
+  {
+    int func;
+    nsec entry;
+  };
+
+  /** Start an event of phase 'ph' for task 'tid' at time 'ts' */
+  void begin(char const *name, char ph, pid_t tid, nsec ts);
+
+  /** Write the metadata event naming process 'pid' or thread 'tid' */
+  void name(pid_t tid, bool process);
+
+  /** Write a system call of 'tid' that started at 'call' and ended at 'end' */
+  void call(pid_t tid, Call const &call, nsec end, char const *result);
+
+  void put(char ch);
+  void put(char const *text);
+  void put(long long value);
+  /** A time in microseconds, as Trace Event timestamps are */
+  void putTime(nsec value);
+  /** A quoted and escaped JSON string */
+  void putString(std::string const &text);
+  void flush();
+
+  std::string fileName;
+  int fd;
+  bool failed;
+  Stopwatch elapsed;                 // since the start of tracing
+  size_t used;
+  char buffer[64 * 1024];
+  ProcessImages images;
+  std::map<pid_t, Call> calls;      // thread id => call in progress
+};
+
+#endif // TRACE_TIMELINE_H
@@ -0,0 +1,462 @@
+/*
+NAME
+    TraceUtils
+
+DESCRIPTION
+    Helpers for reading the state of a traced process.
+
+    Memory is read with process_vm_readv, which transfers a whole
+    block in one system call rather than a word at a time as
+    PTRACE_PEEKDATA does.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "TraceUtils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <asm/unistd.h>
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+  static struct
+  {
+    int code;
+    char const *name;
+  } signals[] = {
+  { SIGHUP,    "hangup" },
+  { SIGINT,    "interrupt" },
+  { SIGQUIT,   "quit" },
+  { SIGILL,    "illegal instruction" },
+  { SIGTRAP,   "trap" },
+  { SIGABRT,   "abort" },
+  { SIGBUS,    "bus error" },
+  { SIGFPE,    "floating point exception" },
+  { SIGKILL,   "kill" },
+  { SIGUSR1,   "user 1" },
+  { SIGSEGV,   "segmentation violation" },
+  { SIGUSR2,   "user 2" },
+  { SIGPIPE,   "broken pipe" },
+  { SIGALRM,   "alarm" },
+  { SIGTERM,   "terminate" },
+  { SIGSTKFLT, "stack fault" },
+  { SIGCHLD,   "child" },
+  { SIGCONT,   "continue" },
+  { SIGSTOP,   "stop" },
+  { SIGTSTP,   "tty stop" },
+  { SIGTTIN,   "tty in" },
+  { SIGTTOU,   "tty out" },
+  { SIGURG,    "urgent" },
+  { SIGXCPU,   "exceeded CPU" },
+  { SIGXFSZ,   "exceeded file size"},
+  { SIGVTALRM, "virtual alarm" },
+  { SIGPROF,   "profiling" },
+  { SIGWINCH,  "window size change" },
+  { SIGPOLL,   "poll" },
+  };
+
+#define SYSCALL(name) { __NR_##name, #name }
+
+  /** System call names, from asm/unistd_64.h */
+  static struct
+  {
+    int code;
+    char const *name;
+  } const syscalls[] = {
+    SYSCALL(read), SYSCALL(write), SYSCALL(open), SYSCALL(close), SYSCALL(stat), SYSCALL(fstat),
+    SYSCALL(lstat), SYSCALL(poll), SYSCALL(lseek), SYSCALL(mmap), SYSCALL(mprotect),
+    SYSCALL(munmap), SYSCALL(brk), SYSCALL(rt_sigaction), SYSCALL(rt_sigprocmask),
+    SYSCALL(rt_sigreturn), SYSCALL(ioctl), SYSCALL(pread64), SYSCALL(pwrite64), SYSCALL(readv),
+    SYSCALL(writev), SYSCALL(access), SYSCALL(pipe), SYSCALL(select), SYSCALL(sched_yield),
+    SYSCALL(mremap), SYSCALL(msync), SYSCALL(mincore), SYSCALL(madvise), SYSCALL(shmget),
+    SYSCALL(shmat), SYSCALL(shmctl), SYSCALL(dup), SYSCALL(dup2), SYSCALL(pause),
+    SYSCALL(nanosleep), SYSCALL(getitimer), SYSCALL(alarm), SYSCALL(setitimer), SYSCALL(getpid),
+    SYSCALL(sendfile), SYSCALL(socket), SYSCALL(connect), SYSCALL(accept), SYSCALL(sendto),
+    SYSCALL(recvfrom), SYSCALL(sendmsg), SYSCALL(recvmsg), SYSCALL(shutdown), SYSCALL(bind),
+    SYSCALL(listen), SYSCALL(getsockname), SYSCALL(getpeername), SYSCALL(socketpair),
+    SYSCALL(setsockopt), SYSCALL(getsockopt), SYSCALL(clone), SYSCALL(fork), SYSCALL(vfork),
+    SYSCALL(execve), SYSCALL(exit), SYSCALL(wait4), SYSCALL(kill), SYSCALL(uname),
+    SYSCALL(semget), SYSCALL(semop), SYSCALL(semctl), SYSCALL(shmdt), SYSCALL(msgget),
+    SYSCALL(msgsnd), SYSCALL(msgrcv), SYSCALL(msgctl), SYSCALL(fcntl), SYSCALL(flock),
+    SYSCALL(fsync), SYSCALL(fdatasync), SYSCALL(truncate), SYSCALL(ftruncate),
+    SYSCALL(getdents), SYSCALL(getcwd), SYSCALL(chdir), SYSCALL(fchdir), SYSCALL(rename),
+    SYSCALL(mkdir), SYSCALL(rmdir), SYSCALL(creat), SYSCALL(link), SYSCALL(unlink),
+    SYSCALL(symlink), SYSCALL(readlink), SYSCALL(chmod), SYSCALL(fchmod), SYSCALL(chown),
+    SYSCALL(fchown), SYSCALL(lchown), SYSCALL(umask), SYSCALL(gettimeofday), SYSCALL(getrlimit),
+    SYSCALL(getrusage), SYSCALL(sysinfo), SYSCALL(times), SYSCALL(ptrace), SYSCALL(getuid),
+    SYSCALL(syslog), SYSCALL(getgid), SYSCALL(setuid), SYSCALL(setgid), SYSCALL(geteuid),
+    SYSCALL(getegid), SYSCALL(setpgid), SYSCALL(getppid), SYSCALL(getpgrp), SYSCALL(setsid),
+    SYSCALL(setreuid), SYSCALL(setregid), SYSCALL(getgroups), SYSCALL(setgroups),
+    SYSCALL(setresuid), SYSCALL(getresuid), SYSCALL(setresgid), SYSCALL(getresgid),
+    SYSCALL(getpgid), SYSCALL(setfsuid), SYSCALL(setfsgid), SYSCALL(getsid), SYSCALL(capget),
+    SYSCALL(capset), SYSCALL(rt_sigpending), SYSCALL(rt_sigtimedwait), SYSCALL(rt_sigqueueinfo),
+    SYSCALL(rt_sigsuspend), SYSCALL(sigaltstack), SYSCALL(utime), SYSCALL(mknod),
+    SYSCALL(uselib), SYSCALL(personality), SYSCALL(ustat), SYSCALL(statfs), SYSCALL(fstatfs),
+    SYSCALL(sysfs), SYSCALL(getpriority), SYSCALL(setpriority), SYSCALL(sched_setparam),
+    SYSCALL(sched_getparam), SYSCALL(sched_setscheduler), SYSCALL(sched_getscheduler),
+    SYSCALL(sched_get_priority_max), SYSCALL(sched_get_priority_min),
+    SYSCALL(sched_rr_get_interval), SYSCALL(mlock), SYSCALL(munlock), SYSCALL(mlockall),
+    SYSCALL(munlockall), SYSCALL(vhangup), SYSCALL(modify_ldt), SYSCALL(pivot_root),
+    SYSCALL(_sysctl), SYSCALL(prctl), SYSCALL(arch_prctl), SYSCALL(adjtimex),
+    SYSCALL(setrlimit), SYSCALL(chroot), SYSCALL(sync), SYSCALL(acct), SYSCALL(settimeofday),
+    SYSCALL(mount), SYSCALL(umount2), SYSCALL(swapon), SYSCALL(swapoff), SYSCALL(reboot),
+    SYSCALL(sethostname), SYSCALL(setdomainname), SYSCALL(iopl), SYSCALL(ioperm),
+    SYSCALL(create_module), SYSCALL(init_module), SYSCALL(delete_module),
+    SYSCALL(get_kernel_syms), SYSCALL(query_module), SYSCALL(quotactl), SYSCALL(nfsservctl),
+    SYSCALL(getpmsg), SYSCALL(putpmsg), SYSCALL(afs_syscall), SYSCALL(tuxcall),
+    SYSCALL(security), SYSCALL(gettid), SYSCALL(readahead), SYSCALL(setxattr),
+    SYSCALL(lsetxattr), SYSCALL(fsetxattr), SYSCALL(getxattr), SYSCALL(lgetxattr),
+    SYSCALL(fgetxattr), SYSCALL(listxattr), SYSCALL(llistxattr), SYSCALL(flistxattr),
+    SYSCALL(removexattr), SYSCALL(lremovexattr), SYSCALL(fremovexattr), SYSCALL(tkill),
+    SYSCALL(time), SYSCALL(futex), SYSCALL(sched_setaffinity), SYSCALL(sched_getaffinity),
+    SYSCALL(set_thread_area), SYSCALL(io_setup), SYSCALL(io_destroy), SYSCALL(io_getevents),
+    SYSCALL(io_submit), SYSCALL(io_cancel), SYSCALL(get_thread_area), SYSCALL(lookup_dcookie),
+    SYSCALL(epoll_create), SYSCALL(epoll_ctl_old), SYSCALL(epoll_wait_old),
+    SYSCALL(remap_file_pages), SYSCALL(getdents64), SYSCALL(set_tid_address),
+    SYSCALL(restart_syscall), SYSCALL(semtimedop), SYSCALL(fadvise64), SYSCALL(timer_create),
+    SYSCALL(timer_settime), SYSCALL(timer_gettime), SYSCALL(timer_getoverrun),
+    SYSCALL(timer_delete), SYSCALL(clock_settime), SYSCALL(clock_gettime),
+    SYSCALL(clock_getres), SYSCALL(clock_nanosleep), SYSCALL(exit_group), SYSCALL(epoll_wait),
+    SYSCALL(epoll_ctl), SYSCALL(tgkill), SYSCALL(utimes), SYSCALL(vserver), SYSCALL(mbind),
+    SYSCALL(set_mempolicy), SYSCALL(get_mempolicy), SYSCALL(mq_open), SYSCALL(mq_unlink),
+    SYSCALL(mq_timedsend), SYSCALL(mq_timedreceive), SYSCALL(mq_notify), SYSCALL(mq_getsetattr),
+    SYSCALL(kexec_load), SYSCALL(waitid), SYSCALL(add_key), SYSCALL(request_key),
+    SYSCALL(keyctl), SYSCALL(ioprio_set), SYSCALL(ioprio_get), SYSCALL(inotify_init),
+    SYSCALL(inotify_add_watch), SYSCALL(inotify_rm_watch), SYSCALL(migrate_pages),
+    SYSCALL(openat), SYSCALL(mkdirat), SYSCALL(mknodat), SYSCALL(fchownat), SYSCALL(futimesat),
+    SYSCALL(newfstatat), SYSCALL(unlinkat), SYSCALL(renameat), SYSCALL(linkat),
+    SYSCALL(symlinkat), SYSCALL(readlinkat), SYSCALL(fchmodat), SYSCALL(faccessat),
+    SYSCALL(pselect6), SYSCALL(ppoll), SYSCALL(unshare), SYSCALL(set_robust_list),
+    SYSCALL(get_robust_list), SYSCALL(splice), SYSCALL(tee), SYSCALL(sync_file_range),
+    SYSCALL(vmsplice), SYSCALL(move_pages), SYSCALL(utimensat), SYSCALL(epoll_pwait),
+    SYSCALL(signalfd), SYSCALL(timerfd_create), SYSCALL(eventfd), SYSCALL(fallocate),
+    SYSCALL(timerfd_settime), SYSCALL(timerfd_gettime), SYSCALL(accept4), SYSCALL(signalfd4),
+    SYSCALL(eventfd2), SYSCALL(epoll_create1), SYSCALL(dup3), SYSCALL(pipe2),
+    SYSCALL(inotify_init1), SYSCALL(preadv), SYSCALL(pwritev), SYSCALL(rt_tgsigqueueinfo),
+    SYSCALL(perf_event_open), SYSCALL(recvmmsg), SYSCALL(fanotify_init), SYSCALL(fanotify_mark),
+    SYSCALL(prlimit64), SYSCALL(name_to_handle_at), SYSCALL(open_by_handle_at),
+    SYSCALL(clock_adjtime), SYSCALL(syncfs), SYSCALL(sendmmsg), SYSCALL(setns), SYSCALL(getcpu),
+    SYSCALL(process_vm_readv), SYSCALL(process_vm_writev), SYSCALL(kcmp), SYSCALL(finit_module),
+    SYSCALL(sched_setattr), SYSCALL(sched_getattr), SYSCALL(renameat2), SYSCALL(seccomp),
+    SYSCALL(getrandom), SYSCALL(memfd_create), SYSCALL(kexec_file_load), SYSCALL(bpf),
+    SYSCALL(execveat), SYSCALL(userfaultfd), SYSCALL(membarrier), SYSCALL(mlock2),
+    SYSCALL(copy_file_range), SYSCALL(preadv2), SYSCALL(pwritev2), SYSCALL(pkey_mprotect),
+    SYSCALL(pkey_alloc), SYSCALL(pkey_free), SYSCALL(statx), SYSCALL(io_pgetevents),
+    SYSCALL(rseq), SYSCALL(pidfd_send_signal), SYSCALL(io_uring_setup), SYSCALL(io_uring_enter),
+    SYSCALL(io_uring_register), SYSCALL(open_tree), SYSCALL(move_mount), SYSCALL(fsopen),
+    SYSCALL(fsconfig), SYSCALL(fsmount), SYSCALL(fspick), SYSCALL(pidfd_open), SYSCALL(clone3),
+    SYSCALL(close_range), SYSCALL(openat2), SYSCALL(pidfd_getfd), SYSCALL(faccessat2),
+    SYSCALL(process_madvise), SYSCALL(epoll_pwait2), SYSCALL(mount_setattr),
+    SYSCALL(quotactl_fd), SYSCALL(landlock_create_ruleset), SYSCALL(landlock_add_rule),
+    SYSCALL(landlock_restrict_self), SYSCALL(memfd_secret), SYSCALL(process_mrelease),
+    SYSCALL(futex_waitv), SYSCALL(set_mempolicy_home_node),
+  };
+
+#undef SYSCALL
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+size_t readRemote(pid_t pid, unsigned long addr, void *buffer, size_t len)
+{
+  struct iovec local = { buffer, len };
+  struct iovec remote = { (void *)addr, len };
+  ssize_t const count = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+  return count < 0 ? 0 : count;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// Read up to the end of each page at a time, so we never ask
+// for memory past the end of a mapping unless the string does.
+std::string readRemoteString(pid_t pid, unsigned long addr)
+{
+  static size_t const pageSize = sysconf(_SC_PAGESIZE);
+  std::string result;
+  char buffer[PATH_MAX];
+  for (;;)
+  {
+    size_t len = pageSize - addr % pageSize;
+    if (len > sizeof(buffer))
+      len = sizeof(buffer);
+    size_t const count = readRemote(pid, addr, buffer, len);
+    if (count == 0)
+      break;
+    size_t const end = strnlen(buffer, count);
+    result.append(buffer, end);
+    if (end != count)
+      break;
+    addr += count;
+  }
+  return result;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+std::string readCommand(pid_t pid)
+{
+  std::ifstream ifs(procName(pid, "cmdline").c_str(), std::ios::binary);
+  std::string result;
+  std::string arg;
+  while (std::getline(ifs, arg, '\0'))
+  {
+    if (!result.empty())
+      result += ' ';
+    result += arg;
+  }
+  return result;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool poke(pid_t tid, unsigned long addr, unsigned char byte, unsigned char *original)
+{
+  errno = 0;
+  long word = ptrace(PTRACE_PEEKTEXT, tid, addr, 0);
+  if (errno != 0)
+  {
+    return false;
+  }
+  if (original)
+  {
+    *original = word & 0xff;
+  }
+  word = (word & ~0xffL) | byte;
+  return ptrace(PTRACE_POKETEXT, tid, addr, word) == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+long long monotonicNsec()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+pid_t readTgid(pid_t tid)
+{
+  std::ifstream ifs(procName(tid, "status").c_str());
+  std::string line;
+  while (std::getline(ifs, line))
+  {
+    if (line.compare(0, 5, "Tgid:") == 0)
+    {
+      return atoi(line.c_str() + 5);
+    }
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// A short-lived thread may already have been resumed and exited by the
+// time the clone event reaches us, but a new process remains as a zombie
+// until reaped: so a child with no /proc entry was a thread of 'parent'.
+pid_t cloneTgid(pid_t parent, pid_t child)
+{
+  pid_t const tgid = readTgid(child);
+  return tgid ? tgid : readTgid(parent);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+std::string procName(pid_t tid, std::string const &entry)
+{
+  std::ostringstream oss;
+  oss << "/proc/" << tid << '/' << entry;
+  return oss.str();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+std::string readLink(std::string const &path)
+{
+  char buffer[PATH_MAX];
+  ssize_t const len = readlink(path.c_str(), buffer, sizeof(buffer));
+  return len < 0 ? std::string() : std::string(buffer, len);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+std::string syscallName(int func)
+{
+  for (size_t idx = 0; idx != sizeof(syscalls) / sizeof(syscalls[0]); ++idx)
+  {
+    if (syscalls[idx].code == func)
+    {
+      return syscalls[idx].name;
+    }
+  }
+  std::ostringstream oss;
+  oss << "syscall_" << func;
+  return oss.str();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+int syscallNumber(std::string const &name)
+{
+  for (size_t idx = 0; idx != sizeof(syscalls) / sizeof(syscalls[0]); ++idx)
+  {
+    if (name == syscalls[idx].name)
+    {
+      return syscalls[idx].code;
+    }
+  }
+  return -1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+int pathArgument(int func)
+{
+  switch (func)
+  {
+  case __NR_open:
+  case __NR_creat:
+  case __NR_stat:
+  case __NR_lstat:
+  case __NR_access:
+  case __NR_execve:
+  case __NR_unlink:
+  case __NR_mkdir:
+  case __NR_rmdir:
+  case __NR_rename:
+  case __NR_truncate:
+  case __NR_readlink:
+  case __NR_chdir:
+  case __NR_chmod:
+  case __NR_chown:
+  case __NR_link:
+  case __NR_mknod:
+  case __NR_statfs:
+    return 0;
+  case __NR_openat:
+  case __NR_openat2:
+  case __NR_newfstatat:
+  case __NR_statx:
+  case __NR_faccessat:
+  case __NR_faccessat2:
+  case __NR_execveat:
+  case __NR_unlinkat:
+  case __NR_mkdirat:
+  case __NR_renameat:
+  case __NR_renameat2:
+  case __NR_readlinkat:
+  case __NR_fchmodat:
+  case __NR_fchownat:
+  case __NR_linkat:
+  case __NR_mknodat:
+  case __NR_symlink:
+    return 1;
+  case __NR_symlinkat:
+    return 2;
+  }
+  return -1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void writeCallEntry(std::ostream &os, int func, long const args[], std::string const &path)
+{
+  switch (func)
+  {
+  case __NR_open:
+    os << "open(\"" << path << "\") = ";
+    break;
+  case __NR_openat:
+    os << "openat(";
+    if ((int)args[0] == AT_FDCWD)
+      os << "AT_FDCWD";
+    else
+      os << (int)args[0];
+    os << ", \"" << path << "\") = ";
+    break;
+  case __NR_close:
+    os << "close(" << args[0] << ") = ";
+    break;
+  case __NR_read:
+    os << "read(" << args[0] << ", " << args[2] << ") = ";
+    break;
+  case __NR_write:
+    os << "write(" << args[0] << ", " << args[2] << ") = ";
+    break;
+  default:
+  {
+    int const pathArg = path.empty() ? -1 : pathArgument(func);
+    os << syscallName(func) << "(";
+    for (int idx = 0; idx != 3; ++idx)
+    {
+      if (idx)
+        os << ", ";
+      if (idx == pathArg)
+        os << '"' << path << '"';
+      else
+        os << args[idx];
+    }
+    os << ") = ";
+    break;
+  }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void writeCallExit(std::ostream &os, long rc)
+{
+  if (rc < 0)
+  {
+    os << rc << "(" << strerror(-rc) << ")";
+  }
+  else
+  {
+    os << std::hex << rc << std::dec;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+std::ostream & operator<<(std::ostream& os, sigstrm const &rhs)
+{
+  int idx = 0;
+  for (; idx != sizeof(signals)/sizeof(signals[0]); ++idx)
+  {
+    if (signals[idx].code == rhs.signal)
+    {
+      os << signals[idx].name;
+      break;
+    }
+  }
+  if (idx == sizeof(signals)/sizeof(signals[0]))
+  {
+    os << "signal " << rhs.signal;
+  }
+  return os;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+std::ostream & operator<<(std::ostream& os, msecs const &rhs)
+{
+  std::ostringstream oss;
+  if (rhs.usec < 0)
+    oss << '-';
+  else
+    oss << rhs.usec / 1000 << '.' << std::setw(3) << std::setfill('0') << rhs.usec % 1000;
+  return os << std::setw(rhs.width) << oss.str();
+}
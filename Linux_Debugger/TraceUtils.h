@@ -0,0 +1,118 @@
+#ifndef TRACE_UTILS_H
+#define TRACE_UTILS_H
+
+/**@file
+
+  Helpers for reading the state of a traced process
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include <iosfwd>
+#include <string>
+
+/** Read 'len' bytes at 'addr' in task 'pid' into 'buffer'.
+ * Returns the number of bytes read, which may be short */
+size_t readRemote(pid_t pid, unsigned long addr, void *buffer, size_t len);
+
+/** Read a nul terminated string at 'addr' in task 'pid' */
+std::string readRemoteString(pid_t pid, unsigned long addr);
+
+/** Read the command line of process 'pid' from /proc */
+std::string readCommand(pid_t pid);
+
+/** Read the thread group (ie process) id of task 'tid' (0 if it has gone) */
+pid_t readTgid(pid_t tid);
+
+/** The thread group of 'child', reported by PTRACE_EVENT_CLONE in 'parent' */
+pid_t cloneTgid(pid_t parent, pid_t child);
+
+/** Nanoseconds on the monotonic clock */
+long long monotonicNsec();
+
+/** Time elapsed on the monotonic clock since construction */
+class Stopwatch
+{
+  long long const start;
+public:
+  Stopwatch() : start(monotonicNsec()) {}
+
+  long long nsec() const { return monotonicNsec() - start; }
+  long long usec() const { return nsec() / 1000; }
+};
+
+/** The x86 breakpoint instruction */
+unsigned char const Int3 = 0xcc;
+
+/** Replace the byte at 'addr' in task 'tid' with 'byte', returning
+ * the original in 'original' if not null, eg to plant a breakpoint */
+bool poke(pid_t tid, unsigned long addr, unsigned char byte, unsigned char *original);
+
+/** The name of 'entry' in the /proc directory of task 'tid', eg "/proc/42/maps" */
+std::string procName(pid_t tid, std::string const &entry);
+
+/** Read the target of the symbolic link 'path' (empty on failure) */
+std::string readLink(std::string const &path);
+
+/** The name of system call 'func' */
+std::string syscallName(int func);
+
+/** The number of the system call called 'name' (or -1) */
+int syscallNumber(std::string const &name);
+
+/** Index of the path name argument of system call 'func' (or -1) */
+int pathArgument(int func);
+
+/** Stream helper for signals */
+class sigstrm
+{
+  int const signal;
+public:
+  sigstrm(int signal) : signal(signal) {}
+
+  friend std::ostream & operator<<(std::ostream& os, sigstrm const &rhs);
+};
+
+/** Stream helper for a duration in microseconds, as milliseconds to
+ * three places right aligned in 'width' columns; a negative duration,
+ * meaning none, is shown as '-' */
+class msecs
+{
+  long long const usec;
+  int const width;
+public:
+  explicit msecs(long long usec, int width = 12) : usec(usec), width(width) {}
+
+  friend std::ostream & operator<<(std::ostream& os, msecs const &rhs);
+};
+
+/** Write the entry of system call 'func' in the call trace
+ * format, such as 'open("/dev/null") = '. 'path' is the
+ * string argument, if any, read from the target */
+void writeCallEntry(std::ostream &os, int func, long const args[], std::string const &path);
+
+/** Write the return code 'rc' of a system call in the call trace format */
+void writeCallExit(std::ostream &os, long rc);
+
+#endif // TRACE_UTILS_H
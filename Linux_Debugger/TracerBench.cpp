@@ -0,0 +1,432 @@
+/*
+NAME
+    TracerBench
+
+DESCRIPTION
+    Measure the overhead of the tracers in this directory.
+
+    Runs each BenchWorkload untraced and under each tracer mode for a
+    number of trials and reports, with 95% confidence intervals:
+    - the wall clock time
+    - the slowdown relative to the untraced run
+    - the traced events per second
+    - the CPU time used by the tracer process itself per event
+
+    The tracer's own CPU time is read from /proc/<pid> after it exits
+    but before it is reaped, so it does not include the CPU time of the
+    workload, which is accumulated separately as the tracer reaps it.
+
+    The ProcessTracer fifo, rr and spf modes run with --self-stats and
+    the matching --resume policy, and also report the 99th percentile
+    and worst time from a task's stop being reported to its resumption;
+    the threadstorm workload (32 threads of ThreadStorm) is where the
+    policies differ.
+
+    Syntax: TracerBench [-n trials] [-s scale] [workload...]
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "TraceLoop.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <wait.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+  using TraceLoop::make_error;
+
+  /** A workload, the command (relative to this program) to which the
+   * iteration count is appended, and the iteration count for scale 1 */
+  struct Workload
+  {
+    char const *name;
+    char const *command;
+    long count;
+  } const workloads[] = {
+    { "getpid", "BenchWorkload getpid", 100000 },
+    { "openclose", "BenchWorkload openclose", 50000 },
+    { "pipe", "BenchWorkload pipe", 20000 },
+    { "forkexec", "BenchWorkload forkexec", 200 },
+    { "tcp", "BenchWorkload tcp", 20000 },
+    { "unix", "BenchWorkload unix", 20000 },
+    { "uring", "BenchWorkload uring", 200000 },
+    { "threadstorm", "ThreadStorm -t 32 -k getpid,stat -n", 2000 },
+  };
+
+  /** A way of running the workload; the tool name is relative to this program,
+   * and the options are separated by spaces */
+  struct Mode
+  {
+    char const *name;
+    char const *tool;
+    char const *options;
+    bool latency;       // report the wait-to-resume times from --self-stats
+  } const modes[] = {
+    { "untraced", 0, 0, false },
+    { "TrivialPtrace", "TrivialPtrace", 0, false },
+    { "MultiPtrace", "MultiPtrace", 0, false },
+    { "ProcessTracer", "ProcessTracer", 0, false },
+    { "ProcessTracer --tree", "ProcessTracer", "--tree", false },
+    { "ProcessTracer --deps", "ProcessTracer", "--deps=/dev/null", false },
+    { "ProcessTracer preload", "ProcessTracer", "--backend=preload", false },
+    { "ProcessTracer seccomp", "ProcessTracer", "--backend=seccomp", false },
+    { "ProcessTracer fifo", "ProcessTracer", "--self-stats --resume=fifo", true },
+    { "ProcessTracer rr", "ProcessTracer", "--self-stats --resume=rr", true },
+    { "ProcessTracer spf", "ProcessTracer", "--self-stats --resume=spf", true },
+  };
+
+  /** Result of one run */
+  struct Sample
+  {
+    double wall;        // seconds
+    double tracerCpu;   // seconds of CPU in the tracer itself
+    long events;        // as reported by the workload
+    double p99;         // wait-to-resume times in us, if reported
+    double worst;
+  };
+
+  /** Summary of a set of values */
+  struct Stats
+  {
+    double mean;
+    double ci;          // half width of the 95% confidence interval
+  };
+
+  double now()
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+  }
+
+  /** Two-sided 95% point of Student's t distribution */
+  double student(size_t df)
+  {
+    static double const table[] = { 0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447,
+                                     2.365, 2.306, 2.262, 2.228, 2.201, 2.179, 2.160,
+                                     2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086 };
+    return df < sizeof(table) / sizeof(table[0]) ? table[df] : 1.96;
+  }
+
+  Stats summarise(std::vector<double> const &values)
+  {
+    Stats result = { 0, 0 };
+    size_t const n = values.size();
+    for (size_t idx = 0; idx != n; ++idx)
+      result.mean += values[idx];
+    result.mean /= n;
+    if (n > 1)
+    {
+      double sumsq = 0;
+      for (size_t idx = 0; idx != n; ++idx)
+        sumsq += (values[idx] - result.mean) * (values[idx] - result.mean);
+      result.ci = student(n - 1) * sqrt(sumsq / (n - 1) / n);
+    }
+    return result;
+  }
+
+  /** CPU seconds used by process 'pid' itself, which must not yet be reaped.
+   * The tracers are single threaded so the nanosecond run time of the
+   * main thread in schedstat is all we need; the clock tick counts in
+   * stat are the fallback if the kernel does not provide it. */
+  double selfCpu(pid_t pid)
+  {
+    std::ostringstream schedstat;
+    schedstat << "/proc/" << pid << "/schedstat";
+    std::ifstream sched(schedstat.str().c_str());
+    unsigned long long runtime(0);
+    if (sched >> runtime && runtime)
+    {
+      return runtime / 1e9;
+    }
+
+    std::ostringstream name;
+    name << "/proc/" << pid << "/stat";
+    std::ifstream ifs(name.str().c_str());
+    std::string line;
+    std::getline(ifs, line);
+    std::string::size_type const pos = line.rfind(')');
+    if (pos == std::string::npos)
+      return 0;
+    // Fields after the command: state ppid ... utime(14) stime(15)
+    std::istringstream iss(line.substr(pos + 2));
+    std::string field;
+    unsigned long utime(0), stime(0);
+    for (int idx = 3; idx <= 15 && iss >> field; ++idx)
+    {
+      if (idx == 14)
+        utime = strtoul(field.c_str(), 0, 10);
+      else if (idx == 15)
+        stime = strtoul(field.c_str(), 0, 10);
+    }
+    return double(utime + stime) / sysconf(_SC_CLK_TCK);
+  }
+
+  /** Append the words of 'text' to 'args', the first prefixed by 'home' */
+  void addWords(std::vector<std::string> &args, char const *text, std::string const &home)
+  {
+    std::istringstream iss(text);
+    std::string word;
+    for (bool first = true; iss >> word; first = false)
+    {
+      args.push_back(first ? home + word : word);
+    }
+  }
+
+  /** Parse the p99 and max wait-to-resume times from the --self-stats report */
+  void readLatency(std::string const &text, Sample &sample)
+  {
+    std::string::size_type pos = text.find("wait-to-resume us:");
+    if (pos == std::string::npos)
+    {
+      throw std::runtime_error("no wait-to-resume times reported");
+    }
+    std::istringstream iss(text.substr(pos + 18, text.find('\n', pos) - pos - 18));
+    std::string label;
+    double value;
+    while (iss >> label >> value)
+    {
+      if (label == "p99")
+        sample.p99 = value;
+      else if (label == "max")
+        sample.worst = value;
+    }
+  }
+
+  /** Run 'args' with stdout captured and stderr discarded, or
+   * captured in a temporary file if 'latency' is wanted from it */
+  Sample runOnce(std::vector<std::string> const &args, bool latency)
+  {
+    std::vector<char *> argv;
+    for (size_t idx = 0; idx != args.size(); ++idx)
+      argv.push_back(const_cast<char *>(args[idx].c_str()));
+    argv.push_back(0);
+
+    int output[2];
+    if (pipe(output) == -1)
+    {
+      throw make_error("pipe");
+    }
+    char errorFile[] = "/tmp/TracerBench.XXXXXX";
+    int const error = latency ? mkstemp(errorFile) : open("/dev/null", O_WRONLY);
+    if (error == -1)
+    {
+      throw make_error("open");
+    }
+    if (latency)
+    {
+      unlink(errorFile);
+    }
+    double const start = now();
+    pid_t const pid = fork();
+    if (pid == -1)
+    {
+      throw make_error("fork");
+    }
+    if (pid == 0)
+    {
+      dup2(output[1], 1);
+      dup2(error, 2);
+      close(output[0]);
+      close(output[1]);
+      close(error);
+      execv(argv[0], &argv[0]);
+      _exit(127);
+    }
+    close(output[1]);
+    std::string text;
+    char buffer[256];
+    ssize_t len;
+    while ((len = read(output[0], buffer, sizeof(buffer))) > 0)
+      text.append(buffer, len);
+    close(output[0]);
+
+    siginfo_t info;
+    if (waitid(P_PID, pid, &info, WEXITED | WNOWAIT) == -1)
+    {
+      throw make_error("waitid");
+    }
+    Sample sample;
+    sample.wall = now() - start;
+    sample.tracerCpu = selfCpu(pid);
+    sample.events = 0;
+    sample.p99 = sample.worst = 0;
+    int status;
+    waitpid(pid, &status, 0);
+
+    std::string report;
+    lseek(error, 0, SEEK_SET);
+    while ((len = read(error, buffer, sizeof(buffer))) > 0)
+      report.append(buffer, len);
+    close(error);
+
+    std::string::size_type const pos = text.find("events ");
+    if (pos != std::string::npos)
+      sample.events = atol(text.c_str() + pos + 7);
+    if (!WIFEXITED(status) || sample.events == 0)
+    {
+      throw std::runtime_error("run of " + args[0] + " failed");
+    }
+    if (latency)
+    {
+      readLatency(report, sample);
+    }
+    return sample;
+  }
+
+  /** Directory containing this program, with a trailing '/' */
+  std::string homeDir()
+  {
+    char buffer[PATH_MAX];
+    ssize_t const len = readlink("/proc/self/exe", buffer, sizeof(buffer));
+    std::string path(buffer, len < 0 ? 0 : len);
+    return path.substr(0, path.rfind('/') + 1);
+  }
+} // namespace
+
+int main(int argc, char **argv)
+{
+  int trials(5);
+  double scale(1.0);
+  int opt;
+  while ((opt = getopt(argc, argv, "n:s:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'n':
+      trials = atoi(optarg);
+      break;
+    case 's':
+      scale = atof(optarg);
+      break;
+    default:
+      std::cerr << "Syntax: TracerBench [-n trials] [-s scale] [workload...]" << std::endl;
+      return 1;
+    }
+  }
+  if (trials < 1)
+    trials = 1;
+
+  std::string const home = homeDir();
+  int rc(0);
+  for (size_t w = 0; w != sizeof(workloads) / sizeof(workloads[0]); ++w)
+  {
+    Workload const &workload = workloads[w];
+    bool wanted = (optind == argc);
+    for (int idx = optind; idx < argc; ++idx)
+      wanted = wanted || strcmp(argv[idx], workload.name) == 0;
+    if (!wanted)
+      continue;
+
+    std::ostringstream count;
+    count << long(workload.count * scale);
+    std::cout << "\n" << workload.name << " x " << count.str() << " (" << trials << " trials)\n"
+              << std::left << std::setw(24) << "mode" << std::right
+              << std::setw(20) << "wall (s)" << std::setw(18) << "slowdown"
+              << std::setw(14) << "events/s" << std::setw(22) << "tracer CPU us/event"
+              << std::setw(24) << "resume p99/max us" << '\n';
+
+    Stats baseline = { 0, 0 };
+    for (size_t m = 0; m != sizeof(modes) / sizeof(modes[0]); ++m)
+    {
+      Mode const &mode = modes[m];
+      std::vector<std::string> args;
+      if (mode.tool)
+        args.push_back(home + mode.tool);
+      if (mode.options)
+        addWords(args, mode.options, std::string());
+      addWords(args, workload.command, home);
+      args.push_back(count.str());
+
+      std::vector<double> walls, rates, cpus, p99s, worsts;
+      try
+      {
+        for (int trial = 0; trial != trials; ++trial)
+        {
+          Sample const sample = runOnce(args, mode.latency);
+          walls.push_back(sample.wall);
+          rates.push_back(sample.events / sample.wall);
+          cpus.push_back(sample.tracerCpu * 1e6 / sample.events);
+          p99s.push_back(sample.p99);
+          worsts.push_back(sample.worst);
+        }
+      }
+      catch (std::exception &ex)
+      {
+        std::cout << std::left << std::setw(24) << mode.name << std::right
+                  << "  " << ex.what() << '\n';
+        rc = 1;
+        continue;
+      }
+
+      Stats const wall = summarise(walls);
+      Stats const rate = summarise(rates);
+      Stats const cpu = summarise(cpus);
+      if (!mode.tool)
+        baseline = wall;
+
+      std::ostringstream w1, w2, w3, w4, w5;
+      w1 << std::fixed << std::setprecision(3) << wall.mean << " +- " << wall.ci;
+      // No slowdown can be given if the untraced run failed
+      if (baseline.mean > 0)
+      {
+        // Confidence interval of a ratio, to first order
+        double const slowdown = wall.mean / baseline.mean;
+        double const slowdownCi = slowdown * sqrt(pow(wall.ci / wall.mean, 2) +
+                                                  pow(baseline.ci / baseline.mean, 2));
+        w2 << std::fixed << std::setprecision(2) << slowdown << " +- " << slowdownCi;
+      }
+      else
+      {
+        w2 << "-";
+      }
+      w3 << std::setprecision(3) << rate.mean;
+      if (mode.tool)
+        w4 << std::fixed << std::setprecision(2) << cpu.mean << " +- " << cpu.ci;
+      else
+        w4 << "-";
+      // The worst time of any trial is the tail that matters, not the mean
+      if (mode.latency)
+        w5 << std::fixed << std::setprecision(1) << summarise(p99s).mean << " / "
+           << *std::max_element(worsts.begin(), worsts.end());
+      else
+        w5 << "-";
+      std::cout << std::left << std::setw(24) << mode.name << std::right
+                << std::setw(20) << w1.str() << std::setw(18) << w2.str()
+                << std::setw(14) << w3.str() << std::setw(22) << w4.str()
+                << std::setw(24) << w5.str() << std::endl;
+    }
+  }
+  return rc;
+}
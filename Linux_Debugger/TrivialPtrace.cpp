@@ -24,107 +24,41 @@ COPYRIGHT
 
 static char const szRCSID[] = "$Id: TrivialPtrace.cpp 256 2020-04-09 21:35:25Z Roger $";
 
-#include <errno.h>
-#include <string.h>
-#include <unistd.h>
-#include <wait.h>
-#include <sys/ptrace.h>
+#include "TraceLoop.h"
 
 #include <iostream>
-#include <stdexcept>
-#include <string>
 
-namespace
-{
-  std::runtime_error make_error(std::string const &action)
-  {
-    std::string const what(action + " failed: " + strerror(errno));
-    return std::runtime_error(what);
-  }
-} // namespace
-
-/** Trivial ptrace user */
+/** Trivial ptrace user: a handler for TraceLoop::EventLoop */
 class TrivialPtrace
 {
 private:
-  pid_t pid;
   std::ostream &os;
 
 public:
   /** Create */
-  TrivialPtrace(pid_t pid, std::ostream &os)
-  : pid(pid), os(os) {}
+  explicit TrivialPtrace(std::ostream &os)
+  : os(os) {}
 
-  /** Run the debug loop */
-  void run();
-};
-
-/////////////////////////////////////////////////////////////////////////////////////////////////
-void TrivialPtrace::run()
-{
-  int status(0); // Status of the stopped child process
+  /** Signal received */
+  int OnSignal(pid_t pid, int signal)
+  {
+    os << "Signal: " << signal << std::endl;
+    return signal == SIGTRAP ? 0 : signal;
+  }
 
-  // This is the main tracing loop. When the child stops,
-  // we examine the system call and its arguments
-  while ((pid = wait(&status)) != -1)
+  /** Task exited or was terminated */
+  void OnExit(pid_t pid, int status)
   {
-    int send_signal(0);
-    if (WIFSTOPPED(status))
-    {
-      int const signal(WSTOPSIG(status));
-      os << "Signal: " << signal << std::endl;
-      if (signal != SIGTRAP) send_signal = signal;
-    }
-    else if (WIFEXITED(status))
+    if (WIFEXITED(status))
     {
       os << "Exit(" << WEXITSTATUS(status) << ")" << std::endl;
     }
-    else if (WIFSIGNALED(status))
-    {
-      os << "Terminated: signal " << WTERMSIG(status) << std::endl;
-    }
-    else if (WIFCONTINUED(status))
-    {
-      os << "Continued" << std::endl;
-    }
     else
     {
-      os << "Unexpected status: " << status << std::endl;
-    }
-
-    ptrace(PTRACE_CONT, pid, 0, send_signal);
-  }
-  if (errno != ECHILD)
-  {
-    throw make_error("wait");
-  }
-}
-
-/////////////////////////////////////////////////////////////////////////////////////////////////
-// Fork a child process, running under ptrace, and return its pid
-pid_t CreateProcess(int argc, char **argv)
-{
-  pid_t const cpid = fork();
-  if (cpid > 0)
-  {
-    // In the parent
-    return cpid; 
-  }
-  else if (cpid == 0)
-  {
-    // In the new child
-    if (ptrace(PTRACE_TRACEME, 0, 0, 0) == -1)
-    {
-      throw make_error("ptrace(PTRACE_TRACEME)");
+      os << "Terminated: signal " << WTERMSIG(status) << std::endl;
     }
-    execv( argv[0], argv );
-    throw make_error("execv");
   }
-  else
-  {
-    throw make_error("fork");
-  }
-}
+};
 
 int main(int argc, char **argv)
 {
@@ -140,8 +74,9 @@ int main(int argc, char **argv)
 
   try
   {
-    pid_t pid = CreateProcess(argc, argv);
-    TrivialPtrace(pid, std::cerr).run();
+    pid_t pid = TraceLoop::CreateProcess(argc, argv);
+    TrivialPtrace handler(std::cerr);
+    TraceLoop::EventLoop<TrivialPtrace>(handler, pid).run();
     rc = 0;
   }
   catch ( std::exception &ex)
@@ -0,0 +1,368 @@
+/*
+NAME
+    Watchpoints
+
+DESCRIPTION
+    Hardware data watchpoints for ProcessTracer.
+
+    The addresses are written to debug registers DR0-DR3 and enabled
+    in DR7 with PTRACE_POKEUSER. Debug registers belong to a thread
+    and are not inherited, so each task is armed at its first stop:
+    the initial task at the start, a new task at its initial SIGSTOP
+    and the survivor of an exec at the exec event, with the symbols
+    looked up afresh in the new program.
+
+    The processor raises a debug exception after an instruction
+    accesses a watched address, which the tracer sees as a SIGTRAP.
+    DR6 says which of the watchpoints fired; a SIGTRAP with none set
+    is something else, such as the int3 in BreakPoint.cpp, and is
+    left alone. For a data watchpoint the instruction pointer is that
+    of the next instruction; an execute watchpoint fires before the
+    instruction, so the resume flag is set to let it run.
+
+    Nothing is checked until a watched address is touched, so the
+    traced program runs at full speed.
+
+COPYRIGHT
+    Copyright (C) 2012, 2026 by Roger Orr <rogero@howzatt.co.uk>
+
+    This software is distributed in the hope that it will be useful, but
+    without WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    Permission is granted to anyone to make or distribute verbatim
+    copies of this software provided that the copyright notice and
+    this permission notice are preserved, and that the distributor
+    grants the recipent permission for further distribution as permitted
+    by this notice.
+
+    Comments and suggestions are always welcome.
+    Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "Watchpoints.h"
+#include "TraceUtils.h"
+
+#include <signal.h>
+#include <stddef.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ptrace.h>
+#include <sys/user.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+  /** Number of accesses listed individually */
+  size_t const MaxHits = 20;
+
+  /** Number of instructions listed for each watchpoint */
+  size_t const TopCount = 10;
+
+  /** EFLAGS resume flag: suppress instruction breakpoints for one instruction */
+  unsigned long const ResumeFlag = 0x10000;
+
+  /** Offset of debug register 'reg' in struct user */
+  long debugReg(int reg)
+  {
+    return offsetof(struct user, u_debugreg) + reg * sizeof(long);
+  }
+
+  /** The DR7 length field for 'len' bytes */
+  unsigned long lengthBits(size_t len)
+  {
+    switch (len)
+    {
+    case 2:
+      return 1;
+    case 4:
+      return 3;
+    case 8:
+      return 2;
+    }
+    return 0;
+  }
+
+  char const *accessName(int access)
+  {
+    return access == 0 ? "execute" : access == 1 ? "write" : "read/write";
+  }
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void Watchpoints::add(std::string const &spec)
+{
+  if (watches.size() == Slots)
+  {
+    throw std::runtime_error("At most four watchpoints can be set: " + spec);
+  }
+  std::vector<std::string> parts;
+  std::istringstream iss(spec);
+  std::string part;
+  while (std::getline(iss, part, ':'))
+  {
+    parts.push_back(part);
+  }
+  if (parts.empty() || parts[0].empty() || parts.size() > 3)
+  {
+    throw std::runtime_error("Invalid watchpoint: " + spec);
+  }
+
+  Watch watch;
+  watch.target = parts[0];
+  watch.addr = 0;
+  watch.len = 0;
+  watch.access = Write;
+  if (parts[0].compare(0, 2, "0x") == 0)
+  {
+    char *end(0);
+    watch.addr = strtoul(parts[0].c_str(), &end, 16);
+    if (*end || watch.addr == 0)
+      throw std::runtime_error("Invalid watchpoint address: " + spec);
+    watch.len = 1;
+  }
+  else
+  {
+    watch.symbol = parts[0];
+  }
+  for (size_t idx = 1; idx != parts.size(); ++idx)
+  {
+    if (parts[idx] == "w")
+      watch.access = Write;
+    else if (parts[idx] == "rw")
+      watch.access = ReadWrite;
+    else if (parts[idx] == "x")
+      watch.access = Execute;
+    else if (parts[idx] == "1" || parts[idx] == "2" || parts[idx] == "4" || parts[idx] == "8")
+      watch.len = atoi(parts[idx].c_str());
+    else
+      throw std::runtime_error("Invalid watchpoint length or access: " + spec);
+  }
+  if (watch.access == Execute)
+  {
+    watch.len = 1;
+  }
+  else if (watch.addr % (watch.len ? watch.len : 1) != 0)
+  {
+    throw std::runtime_error("Watchpoint address must be aligned to its length: " + spec);
+  }
+  watches.push_back(watch);
+  counts.push_back(0);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void Watchpoints::OnStart(pid_t pid)
+{
+  images.OnStart(pid);
+  arm(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// The child is usually not yet stopped, so this normally fails and
+// the child is armed at its initial SIGSTOP instead
+void Watchpoints::OnFork(pid_t parent, pid_t child, int event)
+{
+  images.OnFork(parent, child, event);
+  arm(child);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void Watchpoints::OnExec(pid_t pid)
+{
+  images.OnExec(pid);
+  armed.erase(pid);
+  arm(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void Watchpoints::OnExit(pid_t pid, int status)
+{
+  armed.erase(pid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void Watchpoints::OnSignal(pid_t pid, int signal)
+{
+  if (signal == SIGSTOP)
+  {
+    arm(pid);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void Watchpoints::OnTrap(pid_t pid)
+{
+  errno = 0;
+  unsigned long const dr6 = ptrace(PTRACE_PEEKUSER, pid, debugReg(6), 0);
+  if (errno != 0 || (dr6 & 0xf) == 0)
+  {
+    return;
+  }
+  ptrace(PTRACE_POKEUSER, pid, debugReg(6), 0);
+
+  user_regs_struct regs;
+  if (ptrace(PTRACE_GETREGS, pid, 0, &regs) == -1)
+  {
+    return;
+  }
+  size_t const image = images.imageOf(pid);
+  std::vector<std::pair<unsigned long, size_t> > const &where = resolve(image);
+  bool execute(false);
+  for (size_t idx = 0; idx != watches.size(); ++idx)
+  {
+    if (!(dr6 & (1UL << idx)) || where[idx].first == 0)
+      continue;
+    std::string const value =
+      (watches[idx].access == Execute) ? std::string() : readValue(pid, where[idx].first, where[idx].second);
+    execute = execute || watches[idx].access == Execute;
+    ++counts[idx];
+    Site &site = sites[std::make_pair(idx, std::make_pair(image, regs.rip))];
+    ++site.hits;
+    ++site.threads[pid];
+    site.value = value;
+    if (hits.size() != MaxHits)
+    {
+      Hit const hit = { pid, idx, image, regs.rip, value };
+      hits.push_back(hit);
+    }
+  }
+  if (execute)
+  {
+    regs.eflags |= ResumeFlag;
+    ptrace(PTRACE_SETREGS, pid, 0, &regs);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+std::vector<std::pair<unsigned long, size_t> > const &Watchpoints::resolve(size_t image)
+{
+  std::map<size_t, std::vector<std::pair<unsigned long, size_t> > >::const_iterator const it = resolved.find(image);
+  if (it != resolved.end())
+  {
+    return it->second;
+  }
+  std::vector<std::pair<unsigned long, size_t> > &where = resolved[image];
+  ProcessModules const &modules = images[image].modules;
+  std::string const exe = readLink(procName(images[image].pid, "exe"));
+  for (size_t idx = 0; idx != watches.size(); ++idx)
+  {
+    Watch const &watch = watches[idx];
+    unsigned long addr = watch.addr;
+    size_t len = watch.len;
+    if (!watch.symbol.empty())
+    {
+      addr = 0;
+      ElfSymbols::Symbol const *symbol = ElfSymbols::get(exe)->find(watch.symbol);
+      if (symbol)
+      {
+        addr = modules.fromVaddr(exe, symbol->value);
+        if (len == 0)
+        {
+          len = (symbol->size == 2 || symbol->size == 4 || symbol->size == 8) ? symbol->size : 1;
+        }
+        // Watch the aligned block containing the start of the symbol
+        addr &= ~(len - 1);
+      }
+    }
+    where.push_back(std::make_pair(addr, len));
+  }
+  return where;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void Watchpoints::arm(pid_t tid)
+{
+  if (watches.empty() || armed.count(tid))
+  {
+    return;
+  }
+  std::vector<std::pair<unsigned long, size_t> > const &where = resolve(images.imageOf(tid));
+  unsigned long dr7(0);
+  for (size_t idx = 0; idx != watches.size(); ++idx)
+  {
+    if (where[idx].first == 0)
+      continue;
+    if (ptrace(PTRACE_POKEUSER, tid, debugReg(idx), where[idx].first) == -1)
+      return;
+    dr7 |= (1UL << (idx * 2)) |
+      (static_cast<unsigned long>(watches[idx].access) << (16 + idx * 4)) |
+      (lengthBits(where[idx].second) << (18 + idx * 4));
+  }
+  if (dr7 == 0 || ptrace(PTRACE_POKEUSER, tid, debugReg(7), dr7) == 0)
+  {
+    armed.insert(tid);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+std::string Watchpoints::readValue(pid_t tid, unsigned long addr, size_t len)
+{
+  unsigned long long value(0);
+  if (readRemote(tid, addr, &value, len) != len)
+  {
+    return "?";
+  }
+  std::ostringstream oss;
+  oss << value << " (0x" << std::hex << value << ")";
+  return oss.str();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void Watchpoints::Report(std::ostream &os)
+{
+  for (size_t idx = 0; idx != watches.size(); ++idx)
+  {
+    Watch const &watch = watches[idx];
+    os << "\nWatchpoint " << idx << ": " << watch.target << " (" << accessName(watch.access) << ")"
+       << " hit " << counts[idx] << " times\n";
+    bool unresolved(true);
+    for (std::map<size_t, std::vector<std::pair<unsigned long, size_t> > >::const_iterator it = resolved.begin();
+         it != resolved.end(); ++it)
+    {
+      unresolved = unresolved && it->second[idx].first == 0;
+    }
+    if (unresolved)
+    {
+      os << "  not found in the traced programs\n";
+      continue;
+    }
+    if (counts[idx] == 0)
+      continue;
+
+    std::vector<std::pair<long, std::pair<size_t, unsigned long> > > bySite;
+    for (std::map<std::pair<size_t, std::pair<size_t, unsigned long> >, Site>::const_iterator it = sites.begin();
+         it != sites.end(); ++it)
+    {
+      if (it->first.first == idx)
+        bySite.push_back(std::make_pair(-it->second.hits, it->first.second));
+    }
+    std::sort(bySite.begin(), bySite.end());
+    os << "      hits   threads  instruction after the access                last value\n";
+    for (size_t site = 0; site != bySite.size() && site != TopCount; ++site)
+    {
+      Site const &data = sites[std::make_pair(idx, bySite[site].second)];
+      ProcessImages::Image const &image = images[bySite[site].second.first];
+      os << std::setw(10) << data.hits << std::setw(10) << data.threads.size() << "  "
+         << std::left << std::setw(44) << image.modules.describe(bySite[site].second.second) << std::right
+         << data.value << '\n';
+    }
+  }
+
+  if (!hits.empty())
+  {
+    os << "\nFirst watchpoint hits\n"
+       << "       tid  watch  instruction after the access                value\n";
+    for (std::vector<Hit>::const_iterator it = hits.begin(); it != hits.end(); ++it)
+    {
+      os << std::setw(10) << it->tid << std::setw(7) << it->watch << "  "
+         << std::left << std::setw(44) << images[it->image].modules.describe(it->rip) << std::right
+         << it->value << '\n';
+    }
+  }
+}
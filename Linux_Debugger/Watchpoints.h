@@ -0,0 +1,118 @@
+#ifndef WATCHPOINTS_H
+#define WATCHPOINTS_H
+
+/**@file
+
+  Hardware data watchpoints for ProcessTracer
+
+  @author Roger Orr <rogero@howzatt.co.uk>
+
+  Copyright &copy; 2012, 2026.
+  This software is distributed in the hope
+  that it will be useful, but without WITHOUT
+  ANY WARRANTY; without even the implied
+  warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.
+
+  Permission is granted to anyone to make or
+  distribute verbatim copies of this software
+  provided that the copyright notice and this
+  permission notice are preserved, and that
+  the distributor grants the recipent
+  permission for further distribution as
+  permitted by this notice.
+
+  Comments and suggestions are always welcome.
+  Please report bugs to rogero@howzatt.co.uk.
+*/
+
+#include "ProcessImages.h"
+#include "TraceListener.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/** Watch up to four addresses with the x86 debug registers in every
+ * thread of the traced processes and record each access */
+class Watchpoints : public TraceListener
+{
+public:
+  /** Add a watchpoint described by 'spec': target[:len][:w|rw|x]
+   * where target is a hex address or the name of a symbol in the
+   * program, len is 1, 2, 4 or 8 (by default the symbol size, or 1)
+   * and the access is write (the default), read/write or execute.
+   * Throws std::runtime_error if the spec is invalid or too many */
+  void add(std::string const &spec);
+
+  /** Are there any watchpoints? */
+  bool empty() const { return watches.empty(); }
+
+  void OnStart(pid_t pid) override;
+  void OnFork(pid_t parent, pid_t child, int event) override;
+  void OnExec(pid_t pid) override;
+  void OnExit(pid_t pid, int status) override;
+  void OnTrap(pid_t pid) override;
+  void OnSignal(pid_t pid, int signal) override;
+  void Report(std::ostream &os) override;
+
+private:
+  /** The number of address debug registers, DR0-DR3 */
+  static size_t const Slots = 4;
+
+  /** Accesses detected, as encoded in the DR7 R/W fields */
+  enum Access
+  {
+    Execute = 0,
+    Write = 1,
+    ReadWrite = 3
+  };
+
+  /** What to watch */
+  struct Watch
+  {
+    std::string target;    // the spec's target
+    std::string symbol;    // empty for an address
+    unsigned long addr;
+    size_t len;            // 0 to use the symbol's size
+    Access access;
+  };
+
+  /** Accesses from one instruction */
+  struct Site
+  {
+    long hits;
+    std::map<pid_t, long> threads;
+    std::string value;     // after the most recent access
+  };
+
+  /** One access, kept for the first few */
+  struct Hit
+  {
+    pid_t tid;
+    size_t watch;
+    size_t image;
+    unsigned long rip;
+    std::string value;
+  };
+
+  /** Where each watch is in 'image' (0 if absent), and its length */
+  std::vector<std::pair<unsigned long, size_t> > const &resolve(size_t image);
+
+  /** Program the debug registers of stopped task 'tid' */
+  void arm(pid_t tid);
+
+  /** Read and format the watched value */
+  std::string readValue(pid_t tid, unsigned long addr, size_t len);
+
+  ProcessImages images;
+  std::vector<Watch> watches;
+  std::map<size_t, std::vector<std::pair<unsigned long, size_t> > > resolved;  // by image
+  std::set<pid_t> armed;
+  std::map<std::pair<size_t, std::pair<size_t, unsigned long> >, Site> sites;   // (watch, (image, rip))
+  std::vector<Hit> hits;
+  std::vector<long> counts;      // hits by watch
+};
+
+#endif // WATCHPOINTS_H